@@ -120,6 +120,10 @@ int IsUnused(struct drive *drive, int secondary, uint32_t index);
 int IsKernel(struct drive *drive, int secondary, uint32_t index);
 int IsRoot(struct drive *drive, int secondary, uint32_t index);
 
+// The root partitions of a drive, as seen by KernelIndexBuild() and friends.
+// The table pointer passed to them is the struct drive.
+extern const PartitionTableOps cgpt_root_ops;
+
 // For usage and error messages.
 extern const char* progname;
 extern const char* command;
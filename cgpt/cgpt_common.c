@@ -772,6 +772,41 @@ int IsRoot(struct drive *drive, int secondary, uint32_t index) {
   return GuidEqual(&entry->type, &guid_coreos_rootfs);
 }
 
+// Lets the kernel selection code in cgptlib look at a drive's primary root
+// partitions.
+static int RootOpsIsKernel(void *table, uint32_t i) {
+  return IsRoot((struct drive *)table, PRIMARY, i);
+}
+
+static int RootOpsGetPriority(void *table, uint32_t i) {
+  return GetPriority((struct drive *)table, PRIMARY, i);
+}
+
+static int RootOpsGetTries(void *table, uint32_t i) {
+  return GetTries((struct drive *)table, PRIMARY, i);
+}
+
+static int RootOpsGetSuccessful(void *table, uint32_t i) {
+  return GetSuccessful((struct drive *)table, PRIMARY, i);
+}
+
+static void RootOpsSetPriority(void *table, uint32_t i, int priority) {
+  SetPriority((struct drive *)table, PRIMARY, i, priority);
+}
+
+static void RootOpsSetTries(void *table, uint32_t i, int tries) {
+  SetTries((struct drive *)table, PRIMARY, i, tries);
+}
+
+const PartitionTableOps cgpt_root_ops = {
+  RootOpsIsKernel,
+  RootOpsGetPriority,
+  RootOpsGetTries,
+  RootOpsGetSuccessful,
+  RootOpsSetPriority,
+  RootOpsSetTries,
+};
+
 
 #define TOSTRING(A) #A
 const char *GptError(int errnum) {
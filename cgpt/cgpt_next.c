@@ -16,9 +16,10 @@ int next_priority, next_index;
 
 static int do_search(CgptNextParams *params) {
   struct drive drive;
+  KernelIndex roots;
   uint32_t max_part;
   int gpt_retval;
-  int priority, tries, successful;
+  int priority;
   int i;
 
   if (CGPT_OK != DriveOpen(params->drive_name, &drive, 0, O_RDONLY))
@@ -32,25 +33,30 @@ static int do_search(CgptNextParams *params) {
 
   max_part = GetNumberOfEntries(&drive);
 
-  for (i = 0; i < max_part; i++) {
-    if (!IsRoot(&drive, PRIMARY, i))
-      continue;
-
+  // The best root on this drive is the first one in its index
+  memset(&roots, 0, sizeof(roots));
+  KernelIndexBuild(&roots, &cgpt_root_ops, &drive, max_part,
+                   KERNEL_INDEX_PRIORITY_ZERO);
+  if (GPT_SUCCESS == KernelIndexNext(&roots, &cgpt_root_ops, &drive, &i)) {
     priority = GetPriority(&drive, PRIMARY, i);
-    tries = GetTries(&drive, PRIMARY, i);
-    successful = GetSuccessful(&drive, PRIMARY, i);
-
-    if (next_index == -1 || ((priority > next_priority) && (successful || tries))) {
+    if (next_index == -1 || priority > next_priority) {
+      strncpy(next_file_name, params->drive_name, BUFSIZE);
+      next_priority = priority;
+      next_index = i;
+    }
+  } else if (next_index == -1) {
+    // Nothing bootable, so settle for the first root partition
+    for (i = 0; i < max_part; i++) {
+      if (!IsRoot(&drive, PRIMARY, i))
+        continue;
       strncpy(next_file_name, params->drive_name, BUFSIZE);
-      if (successful || tries) {
-        next_priority = priority;
-      } else {
-        next_priority = -1;
-      }
+      next_priority = -1;
       next_index = i;
+      break;
     }
   }
 
+  KernelIndexFree(&roots);
   return DriveClose(&drive, 0);
 }
 
@@ -8,100 +8,28 @@
 #include "cgptlib_internal.h"
 #include "vboot_host.h"
 
-//////////////////////////////////////////////////////////////////////////////
-// We need a sorted list of priority groups, where each element in the list
-// contains an unordered list of GPT partition numbers.
-
-#define MAX_GROUPS 17                   // 0-15, plus one "higher"
-
-typedef struct {
-  int priority;                         // priority of this group
-  int num_parts;                        // number of partitions in this group
-  uint32_t *part;                       // array of partitions in this group
-} group_t;
-
-typedef struct {
-  int max_parts;                       // max number of partitions in any group
-  int num_groups;                      // number of non-empty groups
-  group_t group[MAX_GROUPS];           // array of groups
-} group_list_t;
-
-
-static group_list_t *NewGroupList(int max_p) {
-  int i;
-  group_list_t *gl = (group_list_t *)malloc(sizeof(group_list_t));
-  require(gl);
-  gl->max_parts = max_p;
-  gl->num_groups = 0;
-  // reserve space for the maximum number of partitions in every group
-  for (i=0; i<MAX_GROUPS; i++) {
-    gl->group[i].priority = -1;
-    gl->group[i].num_parts = 0;
-    gl->group[i].part = (uint32_t *)malloc(sizeof(uint32_t) * max_p);
-    require(gl->group[i].part);
-  }
-
-  return gl;
-}
-
-static void FreeGroups(group_list_t *gl) {
-  int i;
-  for (i=0; i<MAX_GROUPS; i++)
-    free(gl->group[i].part);
-  free(gl);
-}
-
-static void AddToGroup(group_list_t *gl, int priority, int partition) {
-  int i;
-  // See if I've already got a group with this priority
-  for (i=0; i<gl->num_groups; i++)
-    if (gl->group[i].priority == priority)
-      break;
-  if (i == gl->num_groups) {
-    // no, add a group
-    require(i < MAX_GROUPS);
-    gl->num_groups++;
-    gl->group[i].priority = priority;
-  }
-  // add the partition to it
-  int j = gl->group[i].num_parts;
-  gl->group[i].part[j] = partition;
-  gl->group[i].num_parts++;
-}
-
-static void ChangeGroup(group_list_t *gl, int old_priority, int new_priority) {
-  int i;
-  for (i=0; i<gl->num_groups; i++)
-    if (gl->group[i].priority == old_priority) {
-      gl->group[i].priority = new_priority;
-      break;
-    }
-}
-
-static void SortGroups(group_list_t *gl) {
-  int i, j;
-  group_t tmp;
-
-  // straight insertion sort is fast enough
-  for (i=1; i<gl->num_groups; i++) {
-    tmp = gl->group[i];
-    for (j=i; j && (gl->group[j-1].priority < tmp.priority); j--)
-      gl->group[j] = gl->group[j-1];
-    gl->group[j] = tmp;
-  }
+// Is partition [i], with the given priority, one of those being moved to the
+// top?
+static int IsMoving(CgptPrioritizeParams *params, uint32_t i, int priority) {
+  if (!params->set_partition)
+    return 0;
+  if (i + 1 == params->set_partition)
+    return 1;
+  return params->set_friends && priority == params->orig_priority;
 }
 
 int CgptPrioritize(CgptPrioritizeParams *params) {
   struct drive drive;
+  KernelIndex roots;
 
-  int priority;
+  int priority, prev_priority;
 
   int gpt_retval;
   uint32_t index;
   uint32_t max_part;
-  int num_root;
-  int i,j;
-  group_list_t *groups;
+  int num_groups;
+  int *new_priority;
+  int i, k;
 
   if (params == NULL)
     return CGPT_FAILED;
@@ -129,72 +57,80 @@ int CgptPrioritize(CgptPrioritizeParams *params) {
       Error("partition %d is not a CoreOS root\n", params->set_partition);
       goto bad;
     }
+    params->orig_priority = GetPriority(&drive, PRIMARY, index);
   }
 
-  // How many kernel partitions do I have?
-  num_root = 0;
-  for (i = 0; i < max_part; i++) {
-    if (IsRoot(&drive, PRIMARY, i))
-      num_root++;
-  }
-
-  if (num_root) {
-    // Determine the current priority groups
-    groups = NewGroupList(num_root);
-    for (i = 0; i < max_part; i++) {
-      if (!IsRoot(&drive, PRIMARY, i))
-        continue;
-
+  // All the root partitions, by decreasing priority. Partitions with the
+  // same priority make up a group.
+  memset(&roots, 0, sizeof(roots));
+  KernelIndexBuild(&roots, &cgpt_root_ops, &drive, max_part,
+                   KERNEL_INDEX_ALL);
+
+  if (roots.count) {
+    // Count the groups. The partition being set (and its friends, if asked)
+    // make a new group at the top. We'll never lower anything to zero, nor
+    // raise anything from it unless it's being moved, so we can ignore
+    // priority zero.
+    num_groups = params->set_partition ? 1 : 0;
+    prev_priority = -1;
+    for (k = 0; k < roots.count; k++) {
+      i = roots.entry[k];
       priority = GetPriority(&drive, PRIMARY, i);
-
-      // Is this partition special?
-      if (params->set_partition && (i+1 == params->set_partition)) {
-        params->orig_priority = priority;  // remember the original priority
-        if (params->set_friends)
-          AddToGroup(groups, priority, i); // we'll move them all later
-        else
-          AddToGroup(groups, 99, i);       // move only this one
-      } else {
-        AddToGroup(groups, priority, i);   // just remember
-      }
-    }
-
-    // If we're including friends, then change the original group priority
-    if (params->set_partition && params->set_friends) {
-      ChangeGroup(groups, params->orig_priority, 99);
+      if (IsMoving(params, i, priority))
+        continue;
+      if (priority == 0)
+        break;
+      if (priority != prev_priority)
+        num_groups++;
+      prev_priority = priority;
     }
 
-    // Sorting gives the new order. Now we just need to reassign the
-    // priorities.
-    SortGroups(groups);
-
-    // We'll never lower anything to zero, so if the last group is priority zero
-    // we can ignore it.
-    i = groups->num_groups;
-    if (groups->group[i-1].priority == 0)
-      groups->num_groups--;
-
     // Where do we start?
     if (params->max_priority)
       priority = params->max_priority;
     else
-      priority = groups->num_groups > 15 ? 15 : groups->num_groups;
-
-    // Figure out what the new values should be
-    for (i=0; i<groups->num_groups; i++) {
-      groups->group[i].priority = priority;
+      priority = num_groups > 15 ? 15 : num_groups;
+
+    // Figure out what the new values should be, keeping the order
+    new_priority = (int *)malloc(max_part * sizeof(int));
+    require(new_priority);
+    for (i = 0; i < max_part; i++)
+      new_priority[i] = -1;
+
+    if (params->set_partition) {
+      for (k = 0; k < roots.count; k++) {
+        i = roots.entry[k];
+        if (IsMoving(params, i, GetPriority(&drive, PRIMARY, i)))
+          new_priority[i] = priority;
+      }
       if (priority > 1)
         priority--;
     }
 
+    prev_priority = -1;
+    for (k = 0; k < roots.count; k++) {
+      int old_priority;
+      i = roots.entry[k];
+      old_priority = GetPriority(&drive, PRIMARY, i);
+      if (IsMoving(params, i, old_priority))
+        continue;
+      if (old_priority == 0)
+        break;
+      if (prev_priority != -1 && old_priority != prev_priority &&
+          priority > 1)
+        priority--;
+      new_priority[i] = priority;
+      prev_priority = old_priority;
+    }
+
     // Now apply the ranking to the GPT
-    for (i=0; i<groups->num_groups; i++)
-      for (j=0; j<groups->group[i].num_parts; j++)
-        SetPriority(&drive, PRIMARY,
-                    groups->group[i].part[j], groups->group[i].priority);
+    for (i = 0; i < max_part; i++)
+      if (new_priority[i] >= 0)
+        SetPriority(&drive, PRIMARY, i, new_priority[i]);
 
-    FreeGroups(groups);
+    free(new_priority);
   }
+  KernelIndexFree(&roots);
 
   // Write it all out
   UpdateAllEntries(&drive);
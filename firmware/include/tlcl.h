@@ -51,6 +51,52 @@ uint32_t TlclSendReceive(const uint8_t *request, uint8_t *response,
  */
 int TlclPacketSize(const uint8_t *packet);
 
+/* Split-phase operations */
+
+/* States of a TlclCommand */
+enum {
+	TLCL_COMMAND_IDLE = 0,
+	TLCL_COMMAND_PENDING,
+	TLCL_COMMAND_DONE,
+};
+
+/*
+ * A TPM command which is sent with TlclCommandSubmit() and completed later
+ * with TlclCommandPoll(), so the caller can do other work while the TPM is
+ * busy.  Only one command may be outstanding at a time.
+ */
+typedef struct TlclCommand {
+	uint8_t request[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+	uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+	uint32_t result;  /* TPM error code, once state is TLCL_COMMAND_DONE */
+	int state;  /* TLCL_COMMAND_* */
+	int no_retry;  /* Don't retry if the self test hasn't run */
+} TlclCommand;
+
+/**
+ * Send the request in [cmd].  If the firmware doesn't support split TPM
+ * transactions, the command is run to completion before returning.  Returns
+ * 0 if the command was sent (check the result with TlclCommandPoll()),
+ * nonzero if error.
+ */
+uint32_t TlclCommandSubmit(TlclCommand *cmd);
+
+/**
+ * Check whether the TPM has finished the command in [cmd].  Returns
+ * TPM_E_COMMAND_PENDING if not; otherwise the TPM error code of the command.
+ */
+uint32_t TlclCommandPoll(TlclCommand *cmd);
+
+/* How long TlclCommandWait() waits for the TPM to answer */
+#define TLCL_COMMAND_TIMEOUT_MS 10000
+
+/**
+ * Wait for the command in [cmd] to finish.  The TPM driver blocks until the
+ * response arrives.  The TPM error code is returned, or TPM_E_COMMAND_TIMEOUT
+ * if the TPM hasn't answered after TLCL_COMMAND_TIMEOUT_MS.
+ */
+uint32_t TlclCommandWait(TlclCommand *cmd);
+
 /* Commands */
 
 /**
@@ -84,6 +130,11 @@ uint32_t TlclSelfTestFull(void);
  */
 uint32_t TlclContinueSelfTest(void);
 
+/**
+ * Start a ContinueSelfTest with [cmd]; see TlclCommandSubmit().
+ */
+uint32_t TlclContinueSelfTestStart(TlclCommand *cmd);
+
 /**
  * Define a space with permission [perm].  [index] is the index for the space,
  * [size] the usable data size.  The TPM error code is returned.
@@ -102,6 +153,18 @@ uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length);
  */
 uint32_t TlclRead(uint32_t index, void *data, uint32_t length);
 
+/**
+ * Start reading [length] bytes from space at [index] with [cmd]; see
+ * TlclCommandSubmit().
+ */
+uint32_t TlclReadStart(TlclCommand *cmd, uint32_t index, uint32_t length);
+
+/**
+ * Wait for the read started by TlclReadStart() to finish and copy [length]
+ * bytes into [data].  The TPM error code is returned.
+ */
+uint32_t TlclReadFinish(TlclCommand *cmd, void *data, uint32_t length);
+
 /**
  * Read PCR at [index] into [data].  [length] must be TPM_PCR_DIGEST or
  * larger. The TPM error code is returned.
@@ -216,4 +279,102 @@ uint32_t TlclGetOwnership(uint8_t *owned);
  */
 uint32_t TlclGetRandom(uint8_t *data, uint32_t length, uint32_t *size);
 
+/*****************************************************************************/
+/* Functions implemented in tlcl_transaction.c */
+
+/*
+ * An NVRAM transaction collects the reads, writes and locks needed for a boot
+ * phase and sends the TPM only the commands which make a difference: reads
+ * of a space whose contents are already known (read or written earlier in the
+ * transaction) are answered from memory, writes of the value a space already
+ * holds or which a later write in the same commit overwrites are dropped, and
+ * repeated locks are sent once.  Reads of a read-locked space and writes after
+ * a write lock or global lock always go to the TPM, so it can refuse them.
+ *
+ * Queued reads only fill in their buffers when the transaction is committed.
+ */
+
+#define TLCL_TXN_MAX_OPS 8      /* Queued operations per commit */
+#define TLCL_TXN_MAX_SPACES 4   /* Spaces whose contents are remembered */
+#define TLCL_TXN_MAX_DATA 16    /* Largest space remembered, in bytes */
+
+/* Kinds of queued operation */
+enum {
+	TLCL_TXN_READ = 0,
+	TLCL_TXN_WRITE,
+	TLCL_TXN_READ_LOCK,
+	TLCL_TXN_WRITE_LOCK,
+	TLCL_TXN_GLOBAL_LOCK,
+};
+
+typedef struct TlclTransactionOp {
+	int type;  /* TLCL_TXN_* */
+	uint32_t index;
+	uint32_t length;
+	void *read_data;  /* Where to put the data, for reads */
+	uint8_t write_data[TLCL_TXN_MAX_DATA];  /* Data, for writes */
+} TlclTransactionOp;
+
+/* What the transaction knows about one NVRAM space */
+typedef struct TlclTransactionSpace {
+	uint32_t index;
+	uint32_t length;  /* Bytes of data known; 0 if unknown */
+	uint8_t data[TLCL_TXN_MAX_DATA];
+	int read_locked;
+	int write_locked;
+} TlclTransactionSpace;
+
+typedef struct TlclTransaction {
+	TlclTransactionOp ops[TLCL_TXN_MAX_OPS];
+	int num_ops;
+	TlclTransactionSpace spaces[TLCL_TXN_MAX_SPACES];
+	int num_spaces;
+	int global_locked;
+	/* Statistics, across all commits */
+	uint32_t commands_sent;   /* TPM commands actually sent */
+	uint32_t commands_saved;  /* Commands answered or dropped without the TPM */
+} TlclTransaction;
+
+/**
+ * Start an empty transaction.
+ */
+void TlclTransactionInit(TlclTransaction *txn);
+
+/**
+ * Queue a read of [length] bytes from space at [index] into [data].  Queueing
+ * functions only talk to the TPM if the queue is full, in which case they
+ * commit it first; the TPM error code from that is returned.
+ */
+uint32_t TlclTransactionRead(TlclTransaction *txn, uint32_t index,
+                             void *data, uint32_t length);
+
+/**
+ * Queue a write of [length] bytes of [data] to space at [index].  [data] is
+ * copied, so need not stay valid until commit.
+ */
+uint32_t TlclTransactionWrite(TlclTransaction *txn, uint32_t index,
+                              const void *data, uint32_t length);
+
+/**
+ * Queue a read lock, write lock or global lock.
+ */
+uint32_t TlclTransactionReadLock(TlclTransaction *txn, uint32_t index);
+uint32_t TlclTransactionWriteLock(TlclTransaction *txn, uint32_t index);
+uint32_t TlclTransactionSetGlobalLock(TlclTransaction *txn);
+
+/**
+ * Send the queued operations to the TPM, in order, leaving out redundant
+ * ones.  Stops at the first command which fails and returns its TPM error
+ * code; the rest of the queue is discarded, as is everything the transaction
+ * knew about space contents.
+ */
+uint32_t TlclTransactionCommit(TlclTransaction *txn);
+
+/**
+ * Forget what the transaction knows about the contents of space at [index],
+ * so the next read of it goes to the TPM.  Use this when the data read looks
+ * corrupted, or to read back a write for verification.
+ */
+void TlclTransactionForget(TlclTransaction *txn, uint32_t index);
+
 #endif  /* TPM_LITE_TLCL_H_ */
@@ -104,6 +104,12 @@ enum VbErrorPredefined_t {
 	VBERROR_VGA_OPROM_MISMATCH            = 0x10021,
 	/* Need EC to reboot to read-only code */
 	VBERROR_EC_REBOOT_TO_RO_REQUIRED      = 0x10022,
+	/* VbExDiskReadAsync() isn't supported; use VbExDiskRead() */
+	VBERROR_NO_ASYNC_DISK_READ            = 0x10023,
+	/* VbExTpmSendRequest() isn't supported; use VbExTpmSendReceive() */
+	VBERROR_NO_ASYNC_TPM                  = 0x10024,
+	/* VbExTpmGetResponse() called before the TPM has finished */
+	VBERROR_TPM_RESPONSE_PENDING          = 0x10025,
 
 	/* VbExEcGetExpectedRWHash() may return the following codes */
 	/* Compute expected RW hash from the EC image; BIOS doesn't have it */
@@ -460,6 +466,33 @@ VbError_t VbExTpmOpen(void);
 VbError_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
                              uint8_t *response, uint32_t *response_length);
 
+/**
+ * Send a request_length-byte request to the TPM without waiting for the
+ * response.  Only one request may be outstanding at a time; the caller must
+ * collect the response with VbExTpmGetResponse() before sending another
+ * command.
+ *
+ * Returns VBERROR_SUCCESS if the request was sent, or VBERROR_NO_ASYNC_TPM
+ * if the firmware doesn't support split TPM transactions, in which case the
+ * caller will use VbExTpmSendReceive() instead.  Other non-zero values
+ * indicate the request could not be sent.
+ */
+VbError_t VbExTpmSendRequest(const uint8_t *request, uint32_t request_length);
+
+/**
+ * Collect the response to the request sent by VbExTpmSendRequest(), waiting
+ * up to timeout_ms milliseconds for the TPM to finish executing it (0 means
+ * don't wait).  On input, response_length is the size of the response buffer
+ * in bytes.  On exit, response_length is set to the actual received response
+ * length in bytes.
+ *
+ * Returns VBERROR_SUCCESS if the response was received,
+ * VBERROR_TPM_RESPONSE_PENDING if the TPM is still busy (call again later),
+ * or another non-zero value if error.
+ */
+VbError_t VbExTpmGetResponse(uint8_t *response, uint32_t *response_length,
+                             uint32_t timeout_ms);
+
 /*****************************************************************************/
 /* Non-volatile storage */
 
@@ -589,6 +622,29 @@ VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
                        uint64_t lba_count, void *buffer);
 
+/**
+ * Start reading lba_count LBA sectors, starting at sector lba_start, from the
+ * disk into the buffer, and return without waiting for the read to finish.
+ * This lets the caller hash one chunk of data while the next one is read.
+ *
+ * At most one read may be in flight per disk handle.  The caller must call
+ * VbExDiskReadWait() before starting another read or touching the buffer.
+ *
+ * Returns VBERROR_SUCCESS if the read was started, or
+ * VBERROR_NO_ASYNC_DISK_READ if the firmware doesn't support asynchronous
+ * reads, in which case the caller will use VbExDiskRead() instead.  Other
+ * non-zero values indicate the read could not be started.
+ */
+VbError_t VbExDiskReadAsync(VbExDiskHandle_t handle, uint64_t lba_start,
+                            uint64_t lba_count, void *buffer);
+
+/**
+ * Wait for the read started by VbExDiskReadAsync() on the disk to finish.
+ *
+ * Returns VBERROR_SUCCESS if all the data was read, non-zero if error.
+ */
+VbError_t VbExDiskReadWait(VbExDiskHandle_t handle);
+
 /**
  * Write lba_count LBA sectors, starting at sector lba_start, to the disk, from
  * the buffer.
@@ -378,6 +378,67 @@ typedef struct VbSharedDataKernelCall {
 /* Number of kernel calls to track.  Must be power of 2. */
 #define VBSD_MAX_KERNEL_CALLS 4
 
+/*
+ * Events for VbSharedDataTimestamp.event.  Most come in START/END pairs
+ * around a boot phase; the data stored with each is listed after it.
+ */
+#define VBSD_TS_NONE                       0
+/* VbInit() setting up the TPM; no data */
+#define VBSD_TS_TPM_SETUP_START            1
+#define VBSD_TS_TPM_SETUP_END              2
+/* LoadFirmware() verifying a key block; firmware index (0=A, 1=B) */
+#define VBSD_TS_LF_KEYBLOCK_START          3
+#define VBSD_TS_LF_KEYBLOCK_END            4
+/* LoadFirmware() verifying a preamble; firmware index */
+#define VBSD_TS_LF_PREAMBLE_START          5
+#define VBSD_TS_LF_PREAMBLE_END            6
+/* LoadFirmware() hashing and verifying a body; firmware index */
+#define VBSD_TS_LF_BODY_START              7
+#define VBSD_TS_LF_BODY_END                8
+/* VbSelectFirmware() writing and locking the firmware TPM space; no data */
+#define VBSD_TS_TPM_FIRMWARE_START         9
+#define VBSD_TS_TPM_FIRMWARE_END           10
+/* EC software sync; no data */
+#define VBSD_TS_EC_SYNC_START              11
+#define VBSD_TS_EC_SYNC_END                12
+/* Reading the kernel TPM space; no data */
+#define VBSD_TS_TPM_KERNEL_READ_START      13
+#define VBSD_TS_TPM_KERNEL_READ_END        14
+/* LoadKernel() reading and parsing the GPT; no data */
+#define VBSD_TS_LK_GPT_READ_START          15
+#define VBSD_TS_LK_GPT_READ_END            16
+/* LoadKernel() verifying a key block; partition number (1...M) */
+#define VBSD_TS_LK_KEYBLOCK_START          17
+#define VBSD_TS_LK_KEYBLOCK_END            18
+/* LoadKernel() verifying a preamble; partition number */
+#define VBSD_TS_LK_PREAMBLE_START          19
+#define VBSD_TS_LK_PREAMBLE_END            20
+/*
+ * LoadKernel() reading and verifying a body; partition number.  Reads and
+ * hashing are interleaved, so just before BODY_END, BODY_READ and BODY_HASH
+ * record the timer ticks spent on each, saturating at 0xFFFFFFFF.
+ */
+#define VBSD_TS_LK_BODY_START              21
+#define VBSD_TS_LK_BODY_READ               22
+#define VBSD_TS_LK_BODY_HASH               23
+#define VBSD_TS_LK_BODY_END                24
+/* Writing the kernel TPM space; no data */
+#define VBSD_TS_TPM_KERNEL_WRITE_START     25
+#define VBSD_TS_TPM_KERNEL_WRITE_END       26
+/* Locking the kernel TPM space; no data */
+#define VBSD_TS_TPM_KERNEL_LOCK_START      27
+#define VBSD_TS_TPM_KERNEL_LOCK_END        28
+
+/* One boot event, with the VbExGetTimer() value when it happened */
+typedef struct VbSharedDataTimestamp {
+	uint64_t timer;  /* VbExGetTimer() value */
+	uint32_t event;  /* See VBSD_TS_* */
+	uint32_t data;   /* Event-specific */
+} __attribute__((packed)) VbSharedDataTimestamp;
+
+/* Number of timestamps to keep.  Must be power of 2. */
+#define VBSD_MAX_TIMESTAMPS 32
+
 /*
  * Data shared between LoadFirmware(), LoadKernel(), and OS.
  *
@@ -480,10 +541,24 @@ typedef struct VbSharedDataHeader {
 	uint32_t kernel_version_lowest;
 
 	/*
-	 * After read-only firmware which uses version 2 is released, any
+	 * Fields added in version 3.  Before accessing, make sure that
+	 * struct_version >= 3
+	 */
+	/*
+	 * Number of timestamps recorded; the last VBSD_MAX_TIMESTAMPS of them
+	 * are kept in timestamps[], at index (number & (VBSD_MAX_TIMESTAMPS -
+	 * 1)).  See VbSharedDataAddTimestamp().
+	 */
+	uint32_t timestamp_count;
+	/* Reserved for padding */
+	uint32_t reserved3;
+	VbSharedDataTimestamp timestamps[VBSD_MAX_TIMESTAMPS];
+
+	/*
+	 * After read-only firmware which uses version 3 is released, any
 	 * additional fields must be added below, and the struct version must
 	 * be increased.  Before reading/writing those fields, make sure that
-	 * the struct being accessed is at least version 3.
+	 * the struct being accessed is at least version 4.
 	 *
 	 * It's always ok for an older firmware to access a newer struct, since
 	 * all the fields it knows about are present.  Newer firmware needs to
@@ -499,7 +574,8 @@ typedef struct VbSharedDataHeader {
  */
 #define VB_SHARED_DATA_HEADER_SIZE_V1 1072
 #define VB_SHARED_DATA_HEADER_SIZE_V2 1096
+#define VB_SHARED_DATA_HEADER_SIZE_V3 1616
 
-#define VB_SHARED_DATA_VERSION 2      /* Version for struct_version */
+#define VB_SHARED_DATA_VERSION 3      /* Version for struct_version */
 
 #endif  /* VBOOT_REFERENCE_VBOOT_STRUCT_H_ */
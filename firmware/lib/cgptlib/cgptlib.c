@@ -12,13 +12,57 @@
 #include "utility.h"
 #include "vboot_api.h"
 
+static GptEntry *GptOpsEntry(void *table, uint32_t i)
+{
+	GptData *gpt = (GptData *)table;
+	return (GptEntry *)gpt->primary_entries + i;
+}
+
+static int GptOpsIsKernel(void *table, uint32_t i)
+{
+	return IsKernelEntry(GptOpsEntry(table, i));
+}
+
+static int GptOpsGetPriority(void *table, uint32_t i)
+{
+	return GetEntryPriority(GptOpsEntry(table, i));
+}
+
+static int GptOpsGetTries(void *table, uint32_t i)
+{
+	return GetEntryTries(GptOpsEntry(table, i));
+}
+
+static int GptOpsGetSuccessful(void *table, uint32_t i)
+{
+	return GetEntrySuccessful(GptOpsEntry(table, i));
+}
+
+static void GptOpsSetPriority(void *table, uint32_t i, int priority)
+{
+	SetEntryPriority(GptOpsEntry(table, i), priority);
+}
+
+static void GptOpsSetTries(void *table, uint32_t i, int tries)
+{
+	SetEntryTries(GptOpsEntry(table, i), tries);
+}
+
+static const PartitionTableOps gpt_ops = {
+	GptOpsIsKernel,
+	GptOpsGetPriority,
+	GptOpsGetTries,
+	GptOpsGetSuccessful,
+	GptOpsSetPriority,
+	GptOpsSetTries,
+};
+
 int GptInit(GptData *gpt)
 {
 	int retval;
 
 	gpt->modified = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	gpt->current_priority = 999;
 
 	retval = GptSanityCheck(gpt);
 	if (GPT_SUCCESS != retval) {
@@ -27,86 +71,30 @@ int GptInit(GptData *gpt)
 	}
 
 	GptRepair(gpt);
+	KernelIndexBuild(&gpt->kernel_index, &gpt_ops, gpt,
+			 ((GptHeader *)gpt->primary_header)->number_of_entries,
+			 0);
 	return GPT_SUCCESS;
 }
 
+void GptFree(GptData *gpt)
+{
+	KernelIndexFree(&gpt->kernel_index);
+}
+
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 {
-	GptHeader *header = (GptHeader *)gpt->primary_header;
-	GptEntry *entries = (GptEntry *)gpt->primary_entries;
 	GptEntry *e;
-	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	int new_prio = 0;
-	uint32_t i;
-
-	/*
-	 * If we already found a kernel, continue the scan at the current
-	 * kernel's priority, in case there is another kernel with the same
-	 * priority.
-	 */
-	if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-		for (i = gpt->current_kernel + 1;
-		     i < header->number_of_entries; i++) {
-			e = entries + i;
-			if (!IsKernelEntry(e))
-				continue;
-			VBDEBUG(("GptNextKernelEntry looking at same prio "
-				 "partition %d\n", i+1));
-			VBDEBUG(("GptNextKernelEntry s%d t%d p%d\n",
-				 GetEntrySuccessful(e), GetEntryTries(e),
-				 GetEntryPriority(e)));
-			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-				continue;
-			if (GetEntryPriority(e) == gpt->current_priority) {
-				gpt->current_kernel = i;
-				*start_sector = e->starting_lba;
-				*size = e->ending_lba - e->starting_lba + 1;
-				VBDEBUG(("GptNextKernelEntry likes it\n"));
-				return GPT_SUCCESS;
-			}
-		}
-	}
-
-	/*
-	 * We're still here, so scan for the remaining kernel with the highest
-	 * priority less than the previous attempt.
-	 */
-	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
-		int current_prio = GetEntryPriority(e);
-		if (!IsKernelEntry(e))
-			continue;
-		VBDEBUG(("GptNextKernelEntry looking at new prio "
-			 "partition %d\n", i+1));
-		VBDEBUG(("GptNextKernelEntry s%d t%d p%d\n",
-			 GetEntrySuccessful(e), GetEntryTries(e),
-			 GetEntryPriority(e)));
-		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-			continue;
-		if (current_prio >= gpt->current_priority) {
-			/* Already returned this kernel in a previous call */
-			continue;
-		}
-		if (current_prio > new_prio) {
-			new_kernel = i;
-			new_prio = current_prio;
-		}
-	}
-
-	/*
-	 * Save what we found.  Note that if we didn't find a new kernel,
-	 * new_prio will still be -1, so future calls to this function will
-	 * also fail.
-	 */
-	gpt->current_kernel = new_kernel;
-	gpt->current_priority = new_prio;
 
-	if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
+	if (GPT_SUCCESS != KernelIndexNext(&gpt->kernel_index, &gpt_ops, gpt,
+					   &gpt->current_kernel)) {
 		VBDEBUG(("GptNextKernelEntry no more kernels\n"));
 		return GPT_ERROR_NO_VALID_KERNEL;
 	}
 
-	VBDEBUG(("GptNextKernelEntry likes partition %d\n", new_kernel + 1));
-	e = entries + new_kernel;
+	VBDEBUG(("GptNextKernelEntry likes partition %d\n",
+		 gpt->current_kernel + 1));
+	e = (GptEntry *)gpt->primary_entries + gpt->current_kernel;
 	*start_sector = e->starting_lba;
 	*size = e->ending_lba - e->starting_lba + 1;
 	return GPT_SUCCESS;
@@ -114,55 +102,13 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 
 int GptUpdateKernelEntry(GptData *gpt, uint32_t update_type)
 {
-	GptEntry *entries = (GptEntry *)gpt->primary_entries;
-	GptEntry *e = entries + gpt->current_kernel;
 	int modified = 0;
+	int retval;
 
-	if (gpt->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND)
-		return GPT_ERROR_INVALID_UPDATE_TYPE;
-	if (!IsKernelEntry(e))
-		return GPT_ERROR_INVALID_UPDATE_TYPE;
-
-	switch (update_type) {
-	case GPT_UPDATE_ENTRY_TRY: {
-		/* Used up a try */
-		int tries;
-		if (GetEntrySuccessful(e)) {
-			/*
-			 * Successfully booted this partition, so tries field
-			 * is ignored.
-			 */
-			return GPT_SUCCESS;
-		}
-		tries = GetEntryTries(e);
-		if (tries > 1) {
-			/* Still have tries left */
-			modified = 1;
-			SetEntryTries(e, tries - 1);
-			break;
-		}
-		/* Out of tries, so drop through and mark partition bad. */
-	}
-	case GPT_UPDATE_ENTRY_BAD: {
-		/* Giving up on this partition entirely. */
-		if (!GetEntrySuccessful(e)) {
-			/*
-			 * Only clear tries and priority if the successful bit
-			 * is not set.
-			 */
-			modified = 1;
-			SetEntryTries(e, 0);
-			SetEntryPriority(e, 0);
-		}
-		break;
-	}
-	default:
-		return GPT_ERROR_INVALID_UPDATE_TYPE;
-	}
-
-	if (modified) {
+	retval = KernelEntryUpdate(&gpt_ops, gpt, gpt->current_kernel,
+				   update_type, &modified);
+	if (modified)
 		GptModified(gpt);
-	}
 
-	return GPT_SUCCESS;
+	return retval;
 }
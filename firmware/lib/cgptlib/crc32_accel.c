@@ -0,0 +1,305 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * CRC32 using carry-less multiply instructions, with runtime selection of the
+ * best implementation the CPU supports.  This is only built into host
+ * (userspace) versions of the library; firmware always uses the table-driven
+ * code in crc32.c.
+ *
+ * The input is folded 64 bytes at a time into four 128-bit accumulators,
+ * which are then folded into one, reduced to 64 bits and finally to the
+ * 32-bit CRC with a Barrett reduction.  The constants are powers of x modulo
+ * the bit-reflected CRC32 polynomial; see Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction".
+ */
+
+#include "sysincludes.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_ACCEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define CRC32_ACCEL_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
+
+#include "crc32.h"
+
+/* Folding constants */
+#define CRC32_K1 0x154442bd4ULL  /* x^(4*128+32) mod P, for folding by 64 */
+#define CRC32_K2 0x1c6e41596ULL  /* x^(4*128-32) mod P */
+#define CRC32_K3 0x1751997d0ULL  /* x^(128+32) mod P, for folding by 16 */
+#define CRC32_K4 0x0ccaa009eULL  /* x^(128-32) mod P */
+#define CRC32_K5 0x163cd6124ULL  /* x^64 mod P, for reducing 64 to 32 bits */
+#define CRC32_P  0x1db710641ULL  /* P' (bit-reflected polynomial) */
+#define CRC32_U  0x1f7011641ULL  /* u' = x^64 / P, for Barrett reduction */
+
+/* Shortest input worth folding */
+#define CRC32_FOLD_MIN 64
+
+typedef uint32_t (*Crc32FoldFn)(uint32_t *value, const uint8_t *data,
+				uint32_t len);
+
+typedef struct Crc32Impl {
+	const char *name;
+	int (*supported)(void);  /* Returns non-zero if the CPU can run this */
+	Crc32FoldFn fold;  /* NULL to use the table-driven code */
+} Crc32Impl;
+
+#ifdef CRC32_ACCEL_X86
+
+static int X86HasPclmul(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return !!(ecx & bit_PCLMUL);
+}
+
+/* Multiply the low and high halves of [x] by the low and high halves of [k],
+ * and add the products. */
+__attribute__((target("pclmul,sse2")))
+static __m128i X86Fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+			     _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+__attribute__((target("pclmul,sse2")))
+static uint32_t Crc32FoldPclmul(uint32_t *value, const uint8_t *data,
+				uint32_t len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(CRC32_K2, CRC32_K1);
+	const __m128i k3k4 = _mm_set_epi64x(CRC32_K4, CRC32_K3);
+	const __m128i k5 = _mm_set_epi64x(0, CRC32_K5);
+	const __m128i pu = _mm_set_epi64x(CRC32_U, CRC32_P);
+	const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+	__m128i x0, x1, x2, x3, t;
+	uint32_t done;
+
+	len &= ~15U;
+
+	x0 = _mm_loadu_si128((const __m128i *)data);
+	x1 = _mm_loadu_si128((const __m128i *)(data + 16));
+	x2 = _mm_loadu_si128((const __m128i *)(data + 32));
+	x3 = _mm_loadu_si128((const __m128i *)(data + 48));
+	x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128(*value));
+	done = 64;
+
+	for (; len - done >= 64; done += 64) {
+		const uint8_t *p = data + done;
+
+		x0 = _mm_xor_si128(X86Fold(x0, k1k2),
+				   _mm_loadu_si128((const __m128i *)p));
+		x1 = _mm_xor_si128(X86Fold(x1, k1k2),
+				   _mm_loadu_si128((const __m128i *)(p + 16)));
+		x2 = _mm_xor_si128(X86Fold(x2, k1k2),
+				   _mm_loadu_si128((const __m128i *)(p + 32)));
+		x3 = _mm_xor_si128(X86Fold(x3, k1k2),
+				   _mm_loadu_si128((const __m128i *)(p + 48)));
+	}
+
+	/* Fold the four accumulators into one, then any remaining blocks */
+	x0 = _mm_xor_si128(X86Fold(x0, k3k4), x1);
+	x0 = _mm_xor_si128(X86Fold(x0, k3k4), x2);
+	x0 = _mm_xor_si128(X86Fold(x0, k3k4), x3);
+	for (; done < len; done += 16)
+		x0 = _mm_xor_si128(X86Fold(x0, k3k4),
+				   _mm_loadu_si128((const __m128i *)
+						   (data + done)));
+
+	/* 128 bits to 64, appending 32 zero bits */
+	t = _mm_clmulepi64_si128(x0, k3k4, 0x10);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), t);
+
+	/* 64 bits to 32 */
+	t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 4), t);
+
+	/* Barrett reduction */
+	t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), pu, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), pu, 0x00);
+	x0 = _mm_xor_si128(x0, t);
+
+	*value = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x0, 4));
+	return done;
+}
+
+#endif  /* CRC32_ACCEL_X86 */
+
+#ifdef CRC32_ACCEL_ARMV8
+
+static int Armv8HasPmull(void)
+{
+	return !!(getauxval(AT_HWCAP) & (1 << 4));  /* HWCAP_PMULL */
+}
+
+/* Carry-less multiply of the low half of [a] by the low or high half of [b] */
+__attribute__((target("+crypto")))
+static uint64x2_t Armv8ClmulLo(uint64x2_t a, uint64x2_t b, int b_high)
+{
+	poly64_t bb = (poly64_t)(b_high ? vgetq_lane_u64(b, 1) :
+				 vgetq_lane_u64(b, 0));
+
+	return vreinterpretq_u64_p128(
+		vmull_p64((poly64_t)vgetq_lane_u64(a, 0), bb));
+}
+
+__attribute__((target("+crypto")))
+static uint64x2_t Armv8Fold(uint64x2_t x, uint64x2_t k)
+{
+	return veorq_u64(Armv8ClmulLo(x, k, 0),
+			 vreinterpretq_u64_p128(vmull_high_p64(
+				 vreinterpretq_p64_u64(x),
+				 vreinterpretq_p64_u64(k))));
+}
+
+static uint64x2_t Armv8Load(const uint8_t *p)
+{
+	return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+/* Shift [x] right by [n] bytes, like _mm_srli_si128() */
+#define ARMV8_SHR_BYTES(x, n) vreinterpretq_u64_u8(vextq_u8( \
+	vreinterpretq_u8_u64(x), vdupq_n_u8(0), (n)))
+
+__attribute__((target("+crypto")))
+static uint32_t Crc32FoldArmv8(uint32_t *value, const uint8_t *data,
+			       uint32_t len)
+{
+	const uint64x2_t k1k2 = vcombine_u64(vcreate_u64(CRC32_K1),
+					     vcreate_u64(CRC32_K2));
+	const uint64x2_t k3k4 = vcombine_u64(vcreate_u64(CRC32_K3),
+					     vcreate_u64(CRC32_K4));
+	const uint64x2_t k5 = vcombine_u64(vcreate_u64(CRC32_K5),
+					   vcreate_u64(0));
+	const uint64x2_t pu = vcombine_u64(vcreate_u64(CRC32_P),
+					   vcreate_u64(CRC32_U));
+	const uint64x2_t mask32 = vcombine_u64(vcreate_u64(0xffffffffULL),
+					       vcreate_u64(0));
+	uint64x2_t x0, x1, x2, x3, t;
+	uint32_t done;
+
+	len &= ~15U;
+
+	x0 = veorq_u64(Armv8Load(data),
+		       vcombine_u64(vcreate_u64(*value), vcreate_u64(0)));
+	x1 = Armv8Load(data + 16);
+	x2 = Armv8Load(data + 32);
+	x3 = Armv8Load(data + 48);
+	done = 64;
+
+	for (; len - done >= 64; done += 64) {
+		const uint8_t *p = data + done;
+
+		x0 = veorq_u64(Armv8Fold(x0, k1k2), Armv8Load(p));
+		x1 = veorq_u64(Armv8Fold(x1, k1k2), Armv8Load(p + 16));
+		x2 = veorq_u64(Armv8Fold(x2, k1k2), Armv8Load(p + 32));
+		x3 = veorq_u64(Armv8Fold(x3, k1k2), Armv8Load(p + 48));
+	}
+
+	/* Fold the four accumulators into one, then any remaining blocks */
+	x0 = veorq_u64(Armv8Fold(x0, k3k4), x1);
+	x0 = veorq_u64(Armv8Fold(x0, k3k4), x2);
+	x0 = veorq_u64(Armv8Fold(x0, k3k4), x3);
+	for (; done < len; done += 16)
+		x0 = veorq_u64(Armv8Fold(x0, k3k4), Armv8Load(data + done));
+
+	/* 128 bits to 64, appending 32 zero bits */
+	t = Armv8ClmulLo(x0, k3k4, 1);
+	x0 = veorq_u64(ARMV8_SHR_BYTES(x0, 8), t);
+
+	/* 64 bits to 32 */
+	t = Armv8ClmulLo(vandq_u64(x0, mask32), k5, 0);
+	x0 = veorq_u64(ARMV8_SHR_BYTES(x0, 4), t);
+
+	/* Barrett reduction */
+	t = Armv8ClmulLo(vandq_u64(x0, mask32), pu, 1);
+	t = Armv8ClmulLo(vandq_u64(t, mask32), pu, 0);
+	x0 = veorq_u64(x0, t);
+
+	*value = vgetq_lane_u32(vreinterpretq_u32_u64(x0), 1);
+	return done;
+}
+
+#endif  /* CRC32_ACCEL_ARMV8 */
+
+static int AlwaysSupported(void)
+{
+	return 1;
+}
+
+/*
+ * Implementations, in increasing order of preference.  Entry 0 must be the
+ * table-driven code.
+ */
+static const Crc32Impl crc32_impls[] = {
+	{"table", AlwaysSupported, NULL},
+#ifdef CRC32_ACCEL_X86
+	{"x86-pclmul", X86HasPclmul, Crc32FoldPclmul},
+#endif
+#ifdef CRC32_ACCEL_ARMV8
+	{"armv8-pmull", Armv8HasPmull, Crc32FoldArmv8},
+#endif
+};
+
+#define NUM_CRC32_IMPLS ((int)(sizeof(crc32_impls) / sizeof(crc32_impls[0])))
+
+/*
+ * Fold function currently in use, and whether it has been chosen yet.
+ * Choosing is idempotent, so racing threads all store the same values.
+ */
+static Crc32FoldFn crc32_fold;
+static int crc32_fold_chosen;
+
+int Crc32ImplCount(void)
+{
+	return NUM_CRC32_IMPLS;
+}
+
+const char *Crc32ImplName(int impl)
+{
+	if (impl < 0 || impl >= NUM_CRC32_IMPLS)
+		return NULL;
+	return crc32_impls[impl].name;
+}
+
+int Crc32ImplSupported(int impl)
+{
+	if (impl < 0 || impl >= NUM_CRC32_IMPLS)
+		return 0;
+	return crc32_impls[impl].supported();
+}
+
+int Crc32ImplSelect(int impl)
+{
+	int i;
+
+	if (impl < 0) {
+		for (i = NUM_CRC32_IMPLS - 1; i > 0; i--) {
+			if (crc32_impls[i].supported())
+				break;
+		}
+		impl = i;
+	} else if (!Crc32ImplSupported(impl)) {
+		return 1;
+	}
+
+	crc32_fold = crc32_impls[impl].fold;
+	crc32_fold_chosen = 1;
+	return 0;
+}
+
+uint32_t Crc32AccelUpdate(uint32_t *value, const uint8_t *data, uint32_t len)
+{
+	if (!crc32_fold_chosen)
+		Crc32ImplSelect(-1);
+
+	if (!crc32_fold || len < CRC32_FOLD_MIN)
+		return 0;
+	return crc32_fold(value, data, len);
+}
@@ -57,6 +57,33 @@ enum {
 	GPT_UPDATE_ENTRY_BAD = 2,
 };
 
+/*
+ * Partition entries to try booting from, in the order to try them.  This is
+ * built once when the partition table is initialized, so that finding the
+ * next kernel doesn't have to look at every entry again.  [entry] is
+ * allocated to fit the partition table; see KernelIndexBuild().
+ */
+typedef struct {
+	uint16_t *entry;
+	uint16_t count;
+	uint16_t next;		/* Index in entry[] of the next one to try */
+	uint32_t flags;		/* KERNEL_INDEX_* flags it was built with */
+} KernelIndex;
+
+/*
+ * How the kernel selection code gets at the attributes of entry [i] in a
+ * partition table, so the same code can handle GPT and MTD partition tables.
+ * [table] is passed through from the caller.
+ */
+typedef struct {
+	int (*is_kernel)(void *table, uint32_t i);
+	int (*get_priority)(void *table, uint32_t i);
+	int (*get_tries)(void *table, uint32_t i);
+	int (*get_successful)(void *table, uint32_t i);
+	void (*set_priority)(void *table, uint32_t i, int priority);
+	void (*set_tries)(void *table, uint32_t i, int tries);
+} PartitionTableOps;
+
 typedef struct {
 	/* Fill in the following fields before calling GptInit() */
 	/* GPT primary header, from sector 1 of disk (size: 512 bytes) */
@@ -84,7 +111,7 @@ typedef struct {
 
 	/* Internal variables */
 	uint32_t valid_headers, valid_entries;
-	int current_priority;
+	KernelIndex kernel_index;
 } GptData;
 
 /**
@@ -99,6 +126,9 @@ typedef struct {
  *   sector_bytes
  *   drive_sectors
  *
+ * The internal variables must be zero before the first call.  GptInit() may be
+ * called again on the same data; call GptFree() when done with it.
+ *
  * On return the modified field may be set, if the GPT data has been modified
  * and should be written to disk.
  *
@@ -112,6 +142,12 @@ typedef struct {
  *                                    small) */
 int GptInit(GptData *gpt);
 
+/**
+ * Frees the memory GptInit() allocated.  The header and entry buffers belong
+ * to the caller and are not freed.
+ */
+void GptFree(GptData *gpt);
+
 /**
  * Provides the location of the next kernel partition, in order of decreasing
  * priority.
@@ -121,6 +157,9 @@ int GptInit(GptData *gpt);
  * kernel partition in LBA sectors.  gpt.current_kernel contains the partition
  * index of the current chromeos kernel partition.
  *
+ * The order is worked out once by GptInit(), so changes to other entries'
+ * priorities after that don't reorder them.
+ *
  * Returns GPT_SUCCESS if successful, else
  *   GPT_ERROR_NO_VALID_KERNEL, no avaliable kernel, enters recovery mode */
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size);
@@ -161,6 +161,51 @@ int IsKernelEntry(const GptEntry *e);
  */
 void GetCurrentKernelUniqueGuid(GptData *gpt, void *dest);
 
+/* Flags for KernelIndexBuild() */
+/* Also include bootable kernels with priority 0, after all the others */
+#define KERNEL_INDEX_PRIORITY_ZERO 0x01
+/* Include every kernel, bootable or not */
+#define KERNEL_INDEX_ALL 0x02
+
+/**
+ * Build the index of kernels to try, from the first [num_entries] entries of
+ * the partition table [table].
+ *
+ * Unless [flags] says otherwise, only entries which the firmware may boot are
+ * included: kernels with non-zero priority which have booted successfully or
+ * have tries left.  They're ordered by decreasing priority, then increasing
+ * entry number.
+ *
+ * The entries are allocated with VbExMalloc(); any index [ki] already holds is
+ * freed first, so [ki] must be zero before it is built the first time.
+ */
+void KernelIndexBuild(KernelIndex *ki, const PartitionTableOps *ops,
+		      void *table, uint32_t num_entries, uint32_t flags);
+
+/**
+ * Free the entries of an index built by KernelIndexBuild(), leaving it empty.
+ */
+void KernelIndexFree(KernelIndex *ki);
+
+/**
+ * Find the next kernel to try in the index, skipping any which are no longer
+ * bootable.  On success, stores its entry number in [current_kernel] and
+ * returns GPT_SUCCESS.  If there are no more, sets [current_kernel] to
+ * CGPT_KERNEL_ENTRY_NOT_FOUND and returns GPT_ERROR_NO_VALID_KERNEL.
+ */
+int KernelIndexNext(KernelIndex *ki, const PartitionTableOps *ops,
+		    void *table, int *current_kernel);
+
+/**
+ * Update the tries and priority of entry [current_kernel], using the
+ * specified type of update (GPT_UPDATE_ENTRY_*).  Sets [modified] if the
+ * entry was changed.
+ *
+ * Returns GPT_SUCCESS if successful, else GPT_ERROR_INVALID_UPDATE_TYPE.
+ */
+int KernelEntryUpdate(const PartitionTableOps *ops, void *table,
+		      int current_kernel, uint32_t update_type, int *modified);
+
 /**
  * Return a pointer to text describing the passed in error.
  */
@@ -9,4 +9,43 @@
 
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Continue a CRC32 over [len] more bytes of [buffer].  [crc] is the value
+ * returned for the data so far, or 0 to start a new CRC, so
+ * Crc32Update(Crc32(a, a_len), b, b_len) is the CRC of a followed by b.
+ */
+uint32_t Crc32Update(uint32_t crc, const void *buffer, uint32_t len);
+
+/*
+ * Accelerated CRC32.
+ *
+ * Host builds of the library can compute the CRC using carry-less multiply
+ * instructions.  Implementation 0 is always the portable table-driven code;
+ * by default the most preferred implementation the CPU supports is chosen on
+ * first use.  Firmware builds always use the table-driven code.
+ */
+
+/* Returns the number of implementations built in. */
+int Crc32ImplCount(void);
+
+/* Returns the name of implementation [impl], or NULL if out of range. */
+const char *Crc32ImplName(int impl);
+
+/* Returns non-zero if the CPU supports implementation [impl]. */
+int Crc32ImplSupported(int impl);
+
+/**
+ * Use implementation [impl] for subsequent CRCs, or the best supported one if
+ * [impl] is negative.  Returns 0 on success, 1 if [impl] is not supported on
+ * this CPU.
+ */
+int Crc32ImplSelect(int impl);
+
+/**
+ * Internal hook for Crc32Update().  Folds a leading part of [data] into the
+ * running (inverted) CRC [*value] and returns how many bytes it consumed,
+ * which may be 0 if [len] is too short or no accelerated code is selected.
+ */
+uint32_t Crc32AccelUpdate(uint32_t *value, const uint8_t *data, uint32_t len);
+
 #endif  /* VBOOT_REFERENCE_GPT_CRC32_H_ */
@@ -107,18 +107,19 @@ typedef struct {
    * found on drive.
    */
   int current_kernel;
-  int current_priority;
 
   /* If set, the flags partition has been modified and needs to be flushed */
   int modified;
 
   /* Internal variables */
   MtdDiskLayout primary;
+  KernelIndex kernel_index;
 } MtdData;
 
 
 /* APIs are documented in cgptlib.h & cgptlib_internal.h */
 int MtdInit(MtdData *mtd);
+void MtdFree(MtdData *mtd);
 int MtdCheckParameters(MtdData *mtd);
 
 int MtdNextKernelEntry(MtdData *gpt, uint64_t *start_sector, uint64_t *size);
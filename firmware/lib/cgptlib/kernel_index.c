@@ -0,0 +1,145 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Choosing which kernel partition to boot.  This is shared by the GPT and MTD
+ * partition table code, and by cgpt; each supplies a PartitionTableOps to get
+ * at its entries' priority, tries and successful bits.
+ */
+
+#include "sysincludes.h"
+
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "utility.h"
+#include "vboot_api.h"
+
+/* Priorities are 4 bits */
+#define NUM_PRIORITIES (CGPT_ATTRIBUTE_MAX_PRIORITY + 1)
+
+static int IsCandidate(const PartitionTableOps *ops, void *table, uint32_t i,
+		       uint32_t flags)
+{
+	if (!ops->is_kernel(table, i))
+		return 0;
+	if (flags & KERNEL_INDEX_ALL)
+		return 1;
+	if (!(ops->get_successful(table, i) || ops->get_tries(table, i)))
+		return 0;
+	return (ops->get_priority(table, i) > 0 ||
+		(flags & KERNEL_INDEX_PRIORITY_ZERO));
+}
+
+void KernelIndexBuild(KernelIndex *ki, const PartitionTableOps *ops,
+		      void *table, uint32_t num_entries, uint32_t flags)
+{
+	uint32_t next_pos[NUM_PRIORITIES];
+	uint32_t count[NUM_PRIORITIES];
+	uint32_t pos = 0;
+	uint32_t i;
+	int p;
+
+	KernelIndexFree(ki);
+	ki->flags = flags;
+	if (!num_entries)
+		return;
+	ki->entry = (uint16_t *)VbExMalloc(num_entries * sizeof(uint16_t));
+
+	/*
+	 * Counting sort by priority.  Entries with the same priority stay in
+	 * entry number order.
+	 */
+	Memset(count, 0, sizeof(count));
+	for (i = 0; i < num_entries; i++) {
+		if (IsCandidate(ops, table, i, flags))
+			count[ops->get_priority(table, i)]++;
+	}
+	for (p = NUM_PRIORITIES - 1; p >= 0; p--) {
+		next_pos[p] = pos;
+		pos += count[p];
+	}
+	for (i = 0; i < num_entries; i++) {
+		if (IsCandidate(ops, table, i, flags))
+			ki->entry[next_pos[ops->get_priority(table, i)]++] = i;
+	}
+	ki->count = pos;
+}
+
+void KernelIndexFree(KernelIndex *ki)
+{
+	if (ki->entry)
+		VbExFree(ki->entry);
+	ki->entry = NULL;
+	ki->count = 0;
+	ki->next = 0;
+}
+
+int KernelIndexNext(KernelIndex *ki, const PartitionTableOps *ops,
+		    void *table, int *current_kernel)
+{
+	while (ki->next < ki->count) {
+		uint32_t i = ki->entry[ki->next++];
+
+		VBDEBUG(("KernelIndexNext looking at partition %d: s%d t%d "
+			 "p%d\n", i + 1, ops->get_successful(table, i),
+			 ops->get_tries(table, i),
+			 ops->get_priority(table, i)));
+		/* It may have been marked bad since the index was built */
+		if (!IsCandidate(ops, table, i, ki->flags))
+			continue;
+
+		*current_kernel = i;
+		return GPT_SUCCESS;
+	}
+
+	*current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	return GPT_ERROR_NO_VALID_KERNEL;
+}
+
+int KernelEntryUpdate(const PartitionTableOps *ops, void *table,
+		      int current_kernel, uint32_t update_type, int *modified)
+{
+	if (current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND)
+		return GPT_ERROR_INVALID_UPDATE_TYPE;
+	if (!ops->is_kernel(table, current_kernel))
+		return GPT_ERROR_INVALID_UPDATE_TYPE;
+
+	switch (update_type) {
+	case GPT_UPDATE_ENTRY_TRY: {
+		/* Used up a try */
+		int tries;
+		if (ops->get_successful(table, current_kernel)) {
+			/*
+			 * Successfully booted this partition, so tries field
+			 * is ignored.
+			 */
+			return GPT_SUCCESS;
+		}
+		tries = ops->get_tries(table, current_kernel);
+		if (tries > 1) {
+			/* Still have tries left */
+			*modified = 1;
+			ops->set_tries(table, current_kernel, tries - 1);
+			break;
+		}
+		/* Out of tries, so drop through and mark partition bad. */
+	}
+	case GPT_UPDATE_ENTRY_BAD: {
+		/* Giving up on this partition entirely. */
+		if (!ops->get_successful(table, current_kernel)) {
+			/*
+			 * Only clear tries and priority if the successful bit
+			 * is not set.
+			 */
+			*modified = 1;
+			ops->set_tries(table, current_kernel, 0);
+			ops->set_priority(table, current_kernel, 0);
+		}
+		break;
+	}
+	default:
+		return GPT_ERROR_INVALID_UPDATE_TYPE;
+	}
+
+	return GPT_SUCCESS;
+}
@@ -11,12 +11,49 @@
 #include "utility.h"
 #include "vboot_api.h"
 
+static MtdDiskPartition *MtdOpsEntry(void *table, uint32_t i) {
+  MtdData *mtd = (MtdData *)table;
+  return mtd->primary.partitions + i;
+}
+
+static int MtdOpsIsKernel(void *table, uint32_t i) {
+  return MtdIsKernelEntry(MtdOpsEntry(table, i));
+}
+
+static int MtdOpsGetPriority(void *table, uint32_t i) {
+  return MtdGetEntryPriority(MtdOpsEntry(table, i));
+}
+
+static int MtdOpsGetTries(void *table, uint32_t i) {
+  return MtdGetEntryTries(MtdOpsEntry(table, i));
+}
+
+static int MtdOpsGetSuccessful(void *table, uint32_t i) {
+  return MtdGetEntrySuccessful(MtdOpsEntry(table, i));
+}
+
+static void MtdOpsSetPriority(void *table, uint32_t i, int priority) {
+  MtdSetEntryPriority(MtdOpsEntry(table, i), priority);
+}
+
+static void MtdOpsSetTries(void *table, uint32_t i, int tries) {
+  MtdSetEntryTries(MtdOpsEntry(table, i), tries);
+}
+
+static const PartitionTableOps mtd_ops = {
+  MtdOpsIsKernel,
+  MtdOpsGetPriority,
+  MtdOpsGetTries,
+  MtdOpsGetSuccessful,
+  MtdOpsSetPriority,
+  MtdOpsSetTries,
+};
+
 int MtdInit(MtdData *mtd) {
   int ret;
 
   mtd->modified = 0;
   mtd->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-  mtd->current_priority = 999;
 
   ret = MtdSanityCheck(mtd);
   if (GPT_SUCCESS != ret) {
@@ -24,9 +61,14 @@ int MtdInit(MtdData *mtd) {
     return ret;
   }
 
+  KernelIndexBuild(&mtd->kernel_index, &mtd_ops, mtd, MTD_MAX_PARTITIONS, 0);
   return GPT_SUCCESS;
 }
 
+void MtdFree(MtdData *mtd) {
+  KernelIndexFree(&mtd->kernel_index);
+}
+
 int MtdCheckParameters(MtdData *disk) {
   if (disk->sector_bytes != 512) {
     return GPT_ERROR_INVALID_SECTOR_SIZE;
@@ -167,12 +209,13 @@ int MtdSanityCheck(MtdData *disk) {
     return GPT_ERROR_INVALID_SECTOR_NUMBER;
   }
 
+  /* The CRC covers [size] bytes, so check that first */
+  if (h->size < MTD_DRIVE_V1_SIZE || h->size > sizeof(*h)) {
+    return GPT_ERROR_INVALID_HEADERS;
+  }
   if (h->crc32 != MtdHeaderCrc(h)) {
     return GPT_ERROR_CRC_CORRUPTED;
   }
-  if (h->size < MTD_DRIVE_V1_SIZE) {
-    return GPT_ERROR_INVALID_HEADERS;
-  }
   return MtdCheckEntries(h->partitions, h);
 }
 
@@ -200,81 +243,17 @@ uint32_t MtdHeaderCrc(MtdDiskLayout *h) {
 
 int MtdNextKernelEntry(MtdData *mtd, uint64_t *start_sector, uint64_t *size)
 {
-  MtdDiskLayout *header = &mtd->primary;
-  MtdDiskPartition *entries = header->partitions;
   MtdDiskPartition *e;
-  int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-  int new_prio = 0;
-  uint32_t i;
-
-  /*
-   * If we already found a kernel, continue the scan at the current
-   * kernel's priority, in case there is another kernel with the same
-   * priority.
-   */
-  if (mtd->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-    for (i = mtd->current_kernel + 1;
-         i < MTD_MAX_PARTITIONS; i++) {
-      e = entries + i;
-      if (!MtdIsKernelEntry(e))
-        continue;
-      VBDEBUG(("GptNextKernelEntry looking at same prio "
-         "partition %d\n", i+1));
-      VBDEBUG(("GptNextKernelEntry s%d t%d p%d\n",
-         MtdGetEntrySuccessful(e), MtdGetEntryTries(e),
-         MtdGetEntryPriority(e)));
-      if (!(MtdGetEntrySuccessful(e) || MtdGetEntryTries(e)))
-        continue;
-      if (MtdGetEntryPriority(e) == mtd->current_priority) {
-        mtd->current_kernel = i;
-        *start_sector = e->starting_lba;
-        *size = e->ending_lba - e->starting_lba + 1;
-        VBDEBUG(("GptNextKernelEntry likes it\n"));
-        return GPT_SUCCESS;
-      }
-    }
-  }
-
-  /*
-   * We're still here, so scan for the remaining kernel with the highest
-   * priority less than the previous attempt.
-   */
-  for (i = 0, e = entries; i < MTD_MAX_PARTITIONS; i++, e++) {
-    int current_prio = MtdGetEntryPriority(e);
-    if (!MtdIsKernelEntry(e))
-      continue;
-    VBDEBUG(("GptNextKernelEntry looking at new prio "
-       "partition %d\n", i+1));
-    VBDEBUG(("GptNextKernelEntry s%d t%d p%d\n",
-       MtdGetEntrySuccessful(e), MtdGetEntryTries(e),
-       MtdGetEntryPriority(e)));
-    if (!(MtdGetEntrySuccessful(e) || MtdGetEntryTries(e)))
-      continue;
-    if (current_prio >= mtd->current_priority) {
-      /* Already returned this kernel in a previous call */
-      continue;
-    }
-    if (current_prio > new_prio) {
-      new_kernel = i;
-      new_prio = current_prio;
-    }
-  }
 
-  /*
-   * Save what we found.  Note that if we didn't find a new kernel,
-   * new_prio will still be -1, so future calls to this function will
-   * also fail.
-   */
-  mtd->current_kernel = new_kernel;
-  mtd->current_priority = new_prio;
-
-  if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
-    VBDEBUG(("GptNextKernelEntry no more kernels\n"));
+  if (GPT_SUCCESS != KernelIndexNext(&mtd->kernel_index, &mtd_ops, mtd,
+                                     &mtd->current_kernel)) {
+    VBDEBUG(("MtdNextKernelEntry no more kernels\n"));
     return GPT_ERROR_NO_VALID_KERNEL;
   }
 
-  VBDEBUG(("GptNextKernelEntry likes partition %d\n", new_kernel + 1));
-  e = entries + new_kernel;
+  VBDEBUG(("MtdNextKernelEntry likes partition %d\n",
+           mtd->current_kernel + 1));
+  e = mtd->primary.partitions + mtd->current_kernel;
   *start_sector = e->starting_lba;
   *size = e->ending_lba - e->starting_lba + 1;
   return GPT_SUCCESS;
@@ -282,56 +261,13 @@ int MtdNextKernelEntry(MtdData *mtd, uint64_t *start_sector, uint64_t *size)
 
 int MtdUpdateKernelEntry(MtdData *mtd, uint32_t update_type)
 {
-  MtdDiskLayout *header = &mtd->primary;
-  MtdDiskPartition *entries = header->partitions;
-  MtdDiskPartition *e = entries + mtd->current_kernel;
   int modified = 0;
+  int ret;
 
-  if (mtd->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND)
-    return GPT_ERROR_INVALID_UPDATE_TYPE;
-  if (!MtdIsKernelEntry(e))
-    return GPT_ERROR_INVALID_UPDATE_TYPE;
-
-  switch (update_type) {
-  case GPT_UPDATE_ENTRY_TRY: {
-    /* Used up a try */
-    int tries;
-    if (MtdGetEntrySuccessful(e)) {
-      /*
-       * Successfully booted this partition, so tries field
-       * is ignored.
-       */
-      return GPT_SUCCESS;
-    }
-    tries = MtdGetEntryTries(e);
-    if (tries > 1) {
-      /* Still have tries left */
-      modified = 1;
-      MtdSetEntryTries(e, tries - 1);
-      break;
-    }
-    /* Out of tries, so drop through and mark partition bad. */
-  }
-  case GPT_UPDATE_ENTRY_BAD: {
-    /* Giving up on this partition entirely. */
-    if (!MtdGetEntrySuccessful(e)) {
-      /*
-       * Only clear tries and priority if the successful bit
-       * is not set.
-       */
-      modified = 1;
-      MtdSetEntryTries(e, 0);
-      MtdSetEntryPriority(e, 0);
-    }
-    break;
-  }
-  default:
-    return GPT_ERROR_INVALID_UPDATE_TYPE;
-  }
-
-  if (modified) {
+  ret = KernelEntryUpdate(&mtd_ops, mtd, mtd->current_kernel, update_type,
+                          &modified);
+  if (modified)
     MtdModified(mtd);
-  }
 
-  return GPT_SUCCESS;
+  return ret;
 }
@@ -22,14 +22,99 @@
 #define RSA4096NUMWORDS (RSA4096NUMBYTES / sizeof(uint32_t))
 #define RSA8192NUMWORDS (RSA8192NUMBYTES / sizeof(uint32_t))
 
+/* Montgomery multiplication can use 64-bit limbs (with 128-bit intermediate
+ * products) when RSA_64BIT_LIMBS is defined and the compiler provides a
+ * 128-bit integer type.  Otherwise only the 32-bit limb code is built. */
+#if defined(RSA_64BIT_LIMBS) && defined(__SIZEOF_INT128__)
+#define RSA_HAVE_64BIT_LIMBS
+#endif
+
 typedef struct RSAPublicKey {
   uint32_t len;  /* Length of n[] in number of uint32_t */
   uint32_t n0inv;  /* -1 / n[0] mod 2^32 */
   uint32_t* n;  /* modulus as little endian array */
   uint32_t* rr; /* R^2 as little endian array */
   unsigned int algorithm; /* Algorithm to use when verifying with the key */
+  /* The following are only filled in when the key is loaded by a library
+   * built with RSA_HAVE_64BIT_LIMBS.  If n64 is NULL, the 32-bit limb code is
+   * used. */
+  uint64_t n0inv64;  /* -1 / n[0] mod 2^64 */
+  uint64_t* n64;  /* modulus as little endian array of len / 2 uint64_t */
+  uint64_t* rr64;  /* R^2 as little endian array of len / 2 uint64_t */
+  unsigned int flags;  /* RSA_KEY_* flags */
+  uint8_t* blob_copy;  /* Aligned copy of the key blob made for a view */
 } RSAPublicKey;
 
+/* Flags for RSAPublicKey.flags */
+#define RSA_KEY_VIEW 0x01  /* n, rr, n64 and rr64 point into a key blob which
+                            * the key does not own (see RSAPublicKeyView()) */
+#define RSA_KEY_CALLER_STORAGE 0x02  /* The RSAPublicKey struct itself was
+                                      * provided by the caller */
+
+/* Size in bytes of the scratch space needed to verify a signature with a key
+ * of [len] uint32_t words: a copy of the signature plus three bignums used
+ * during exponentiation. */
+#define RSA_VERIFY_WORKBUF_SIZE(len) (4 * (uint64_t)(len) * sizeof(uint32_t))
+
+/* Scratch space large enough for any supported key length. */
+#define RSA_MAX_VERIFY_WORKBUF_SIZE RSA_VERIFY_WORKBUF_SIZE(RSA8192NUMWORDS)
+
+/* Reusable signature verification context.  Holds an already-parsed key and
+ * caller-provided scratch space, so that repeated verifications against the
+ * same key need no heap allocations and no key re-parsing.  Only one
+ * verification may use a given context at a time. */
+typedef struct RSAVerifyContext {
+  const RSAPublicKey* key;  /* Key used for verification */
+  RSAPublicKey* owned_key;  /* Non-NULL if the context allocated [key] */
+  uint32_t* workbuf;  /* Scratch space, at least RSA_VERIFY_WORKBUF_SIZE() */
+  uint64_t workbuf_size;  /* Size of [workbuf] in bytes */
+} RSAVerifyContext;
+
+/* Initialize [ctx] to verify signatures with [key], using [workbuf] of
+ * [workbuf_size] bytes as scratch space.  The context does not take ownership
+ * of [key] or [workbuf]; both must outlive it.
+ *
+ * Returns 1 on success, 0 on failure (for example if [workbuf] is too small).
+ */
+int RSAVerifyContextInit(RSAVerifyContext* ctx,
+                         const RSAPublicKey* key,
+                         uint32_t* workbuf,
+                         uint64_t workbuf_size);
+
+/* Like RSAVerifyContextInit(), but parses the key from the pre-processed key
+ * blob [key_blob] of length [len].  The parsed key is owned by the context and
+ * released by RSAVerifyContextFree().
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int RSAVerifyContextInitFromBuf(RSAVerifyContext* ctx,
+                                const uint8_t* key_blob,
+                                uint64_t len,
+                                uint32_t* workbuf,
+                                uint64_t workbuf_size);
+
+/* Release any key owned by [ctx].  The caller still owns the work buffer. */
+void RSAVerifyContextFree(RSAVerifyContext* ctx);
+
+/* Same as RSAVerify(), but uses the key and scratch space in [ctx] and does
+ * not allocate memory.  Returns 0 on failure, 1 on success.
+ */
+int RSAVerifyWithContext(const RSAVerifyContext* ctx,
+                         const uint8_t* sig,
+                         const uint32_t sig_len,
+                         const uint8_t sig_type,
+                         const uint8_t* hash);
+
+/* Same as RSAVerifyBinary_f(), but uses the key and scratch space in [ctx]
+ * and does not allocate memory.  Returns 1 on verification success, 0 on
+ * verification failure or invalid arguments.
+ */
+int RSAVerifyBinaryWithContext(const RSAVerifyContext* ctx,
+                               const uint8_t* buf,
+                               uint64_t len,
+                               const uint8_t* sig,
+                               unsigned int algorithm);
+
 /* Verify a RSA PKCS1.5 signature [sig] of [sig_type] and length [sig_len]
  * against an expected [hash] using [key]. Returns 0 on failure, 1 on success.
  */
@@ -81,9 +166,17 @@ uint64_t RSAProcessedKeySize(uint64_t algorithm, uint64_t* out_size);
  * NULL */
 RSAPublicKey* RSAPublicKeyNew(void);
 
-/* Deep free the contents of [key]. */
+/* Deep free the contents of [key].  For a key view from RSAPublicKeyView(),
+ * frees only what the view allocated. */
 void RSAPublicKeyFree(RSAPublicKey* key);
 
+/* Fill in the 64-bit limb fields of [key] from its 32-bit n[] and rr[] arrays.
+ * Does nothing unless built with RSA_HAVE_64BIT_LIMBS.
+ *
+ * Returns 1 on success, 0 on failure.
+ */
+int RSAPublicKeyPrecompute64(RSAPublicKey* key);
+
 /* Create a RSAPublic key structure from binary blob [buf] of length
  * [len].
  *
@@ -91,5 +184,17 @@ void RSAPublicKeyFree(RSAPublicKey* key);
  */
 RSAPublicKey* RSAPublicKeyFromBuf(const uint8_t* buf, uint64_t len);
 
+/* Like RSAPublicKeyFromBuf(), but fills in [storage] instead of allocating a
+ * new key, and points its n[] and rr[] (and the 64-bit limb arrays, where the
+ * blob layout allows) into [buf] instead of copying them.  If [buf] is not
+ * suitably aligned, a single aligned copy of it is made.  [buf] must not
+ * change or be freed while the view is in use.
+ *
+ * Returns [storage] on success, NULL on failure.  Release the view with
+ * RSAPublicKeyFree(), which does not free [storage] itself.
+ */
+RSAPublicKey* RSAPublicKeyView(RSAPublicKey* storage,
+                               const uint8_t* buf, uint64_t len);
+
 
 #endif  /* VBOOT_REFERENCE_RSA_H_ */
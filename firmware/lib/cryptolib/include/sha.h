@@ -84,6 +84,59 @@ uint8_t* internal_SHA256(const uint8_t* data, uint64_t len, uint8_t* digest);
 uint8_t* internal_SHA512(const uint8_t* data, uint64_t len, uint8_t* digest);
 
 
+/*---- Accelerated block transforms.
+ *
+ * Host builds of the library can run the SHA-256 and SHA-512 block
+ * transforms on CPU crypto extensions.  Implementation 0 is always the
+ * portable C code; by default the most preferred implementation the CPU
+ * supports is chosen on first use.  Firmware builds always use the C code.
+ */
+
+/* Returns the number of implementations built in. */
+int ShaImplCount(void);
+
+/* Returns the name of implementation [impl], or NULL if out of range. */
+const char* ShaImplName(int impl);
+
+/* Returns non-zero if the CPU supports implementation [impl]. */
+int ShaImplSupported(int impl);
+
+/* Use implementation [impl] for subsequent hashing, or the best supported
+ * one if [impl] is negative.  An explicit choice is kept until the next call;
+ * the automatic choice on first use never replaces it.  Call this before
+ * starting threads which hash, not while they run.  Returns 0 on success, 1
+ * if [impl] is not supported on this CPU.
+ */
+int ShaImplSelect(int impl);
+
+/* Internal hooks for the SHA-256 and SHA-512 block transforms.  Process
+ * [block_nb] blocks of [data] into state [h] and return 1, or return 0 if the
+ * selected implementation has no transform for this algorithm. */
+int ShaAccelSHA256Blocks(uint32_t* h, const uint8_t* data,
+                         unsigned int block_nb);
+int ShaAccelSHA512Blocks(uint64_t* h, const uint8_t* data,
+                         unsigned int block_nb);
+
+/* One buffer to hash with DigestBatch(). */
+typedef struct DigestBatchItem {
+  const uint8_t* data;  /* Data to hash */
+  uint64_t len;  /* Length of data in bytes */
+  int sig_algorithm;  /* Signature algorithm; determines the hash used */
+  uint8_t digest[SHA512_DIGEST_SIZE];  /* Output digest */
+} DigestBatchItem;
+
+/* Internal hook for DigestBatch().  Hashes every item in [items] whose
+ * signature algorithm uses hash [hash_algorithm] (one of the
+ * *_DIGEST_ALGORITHM values) and returns 1, or returns 0 if the selected
+ * implementation has no multi-buffer code for that hash. */
+int ShaAccelDigestBatch(DigestBatchItem* items, int count, int hash_algorithm);
+
+/* SHA-256 and SHA-512 round constants, shared with the accelerated
+ * transforms. */
+extern const uint32_t sha256_k[64];
+extern const uint64_t sha512_k[80];
+
+
 /*---- Utility functions/wrappers for message digests. */
 
 #define SHA1_DIGEST_ALGORITHM 0
@@ -124,5 +177,18 @@ uint8_t* DigestFile(char* input_file, int sig_algorithm);
  */
 uint8_t* DigestBuf(const uint8_t* buf, uint64_t len, int sig_algorithm);
 
+/* Compute the digests of [count] independent buffers in [items].  Buffers
+ * are hashed several at a time across SIMD lanes when the CPU supports it,
+ * so this is faster than calling DigestBuf() on each when there are many
+ * small buffers.  The items may use different algorithms.
+ */
+void DigestBatch(DigestBatchItem* items, int count);
+
+/* Same as DigestBuf(), but stores the digest in caller-provided [digest],
+ * which must be at least SHA512_DIGEST_SIZE bytes.  Returns [digest].
+ */
+uint8_t* DigestBufNoAlloc(const uint8_t* buf, uint64_t len, int sig_algorithm,
+                          uint8_t* digest);
+
 
 #endif  /* VBOOT_REFERENCE_SHA_H_ */
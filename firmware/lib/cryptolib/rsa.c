@@ -77,12 +77,14 @@ static void montMul(const RSAPublicKey *key,
 
 /* In-place public exponentiation. (65537}
  * Input and output big-endian byte array in inout.
+ * [workbuf] must hold at least 3 * key->len words of scratch space.
  */
 static void modpowF4(const RSAPublicKey *key,
-                    uint8_t* inout) {
-  uint32_t* a = (uint32_t*) VbExMalloc(key->len * sizeof(uint32_t));
-  uint32_t* aR = (uint32_t*) VbExMalloc(key->len * sizeof(uint32_t));
-  uint32_t* aaR = (uint32_t*) VbExMalloc(key->len * sizeof(uint32_t));
+                    uint8_t* inout,
+                    uint32_t* workbuf) {
+  uint32_t* a = workbuf;
+  uint32_t* aR = a + key->len;
+  uint32_t* aaR = aR + key->len;
 
   uint32_t* aaa = aaR;  /* Re-use location. */
   int i;
@@ -118,27 +120,165 @@ static void modpowF4(const RSAPublicKey *key,
     *inout++ = (uint8_t)(tmp >>  8);
     *inout++ = (uint8_t)(tmp >>  0);
   }
+}
+
+#ifdef RSA_HAVE_64BIT_LIMBS
+/* 64-bit limb versions of the above.  These operate on key->n64 and
+ * key->rr64, which hold key->len / 2 limbs. */
+
+typedef unsigned __int128 uint128_t;
+typedef __int128 int128_t;
 
-  VbExFree(a);
-  VbExFree(aR);
-  VbExFree(aaR);
+/* a[] -= mod */
+static void subM64(const RSAPublicKey *key, uint64_t *a) {
+  int128_t A = 0;
+  uint32_t i;
+  for (i = 0; i < key->len / 2; ++i) {
+    A += (uint128_t)a[i] - key->n64[i];
+    a[i] = (uint64_t)A;
+    A >>= 64;
+  }
 }
 
-/* Verify a RSA PKCS1.5 signature against an expected hash.
+/* return a[] >= mod */
+static int geM64(const RSAPublicKey *key, uint64_t *a) {
+  uint32_t i;
+  for (i = key->len / 2; i;) {
+    --i;
+    if (a[i] < key->n64[i]) return 0;
+    if (a[i] > key->n64[i]) return 1;
+  }
+  return 1;  /* equal */
+}
+
+/* montgomery c[] += a * b[] / R % mod */
+static void montMulAdd64(const RSAPublicKey *key,
+                         uint64_t* c,
+                         const uint64_t a,
+                         const uint64_t* b) {
+  uint128_t A = (uint128_t)a * b[0] + c[0];
+  uint64_t d0 = (uint64_t)A * key->n0inv64;
+  uint128_t B = (uint128_t)d0 * key->n64[0] + (uint64_t)A;
+  uint32_t i;
+
+  for (i = 1; i < key->len / 2; ++i) {
+    A = (A >> 64) + (uint128_t)a * b[i] + c[i];
+    B = (B >> 64) + (uint128_t)d0 * key->n64[i] + (uint64_t)A;
+    c[i - 1] = (uint64_t)B;
+  }
+
+  A = (A >> 64) + (B >> 64);
+
+  c[i - 1] = (uint64_t)A;
+
+  if (A >> 64) {
+    subM64(key, c);
+  }
+}
+
+/* montgomery c[] = a[] * b[] / R % mod */
+static void montMul64(const RSAPublicKey *key,
+                      uint64_t* c,
+                      uint64_t* a,
+                      uint64_t* b) {
+  uint32_t i;
+  for (i = 0; i < key->len / 2; ++i) {
+    c[i] = 0;
+  }
+  for (i = 0; i < key->len / 2; ++i) {
+    montMulAdd64(key, c, a[i], b);
+  }
+}
+
+/* In-place public exponentiation using 64-bit limbs.
+ * Input and output big-endian byte array in inout.
+ * [workbuf] must hold at least 3 * key->len / 2 limbs of scratch space.
+ */
+static void modpowF4_64(const RSAPublicKey *key,
+                        uint8_t* inout,
+                        uint64_t* workbuf) {
+  int len = (int)key->len / 2;
+  uint64_t* a = workbuf;
+  uint64_t* aR = a + len;
+  uint64_t* aaR = aR + len;
+
+  uint64_t* aaa = aaR;  /* Re-use location. */
+  int i, j;
+
+  /* Convert from big endian byte array to little endian limb array. */
+  for (i = 0; i < len; ++i) {
+    const uint8_t* p = inout + (len - 1 - i) * 8;
+    uint64_t tmp = 0;
+    for (j = 0; j < 8; ++j)
+      tmp = (tmp << 8) | p[j];
+    a[i] = tmp;
+  }
+
+  montMul64(key, aR, a, key->rr64);  /* aR = a * RR / R mod M   */
+  for (i = 0; i < 16; i+=2) {
+    montMul64(key, aaR, aR, aR);  /* aaR = aR * aR / R mod M */
+    montMul64(key, aR, aaR, aaR);  /* aR = aaR * aaR / R mod M */
+  }
+  montMul64(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
+
+  /* Make sure aaa < mod; aaa is at most 1x mod too large. */
+  if (geM64(key, aaa)) {
+    subM64(key, aaa);
+  }
+
+  /* Convert to bigendian byte array */
+  for (i = len - 1; i >= 0; --i) {
+    uint64_t tmp = aaa[i];
+    for (j = 56; j >= 0; j -= 8)
+      *inout++ = (uint8_t)(tmp >> j);
+  }
+}
+#endif  /* RSA_HAVE_64BIT_LIMBS */
+
+int RSAVerifyContextInit(RSAVerifyContext* ctx,
+                         const RSAPublicKey* key,
+                         uint32_t* workbuf,
+                         uint64_t workbuf_size) {
+  if (!ctx)
+    return 0;
+
+  ctx->key = NULL;
+  ctx->owned_key = NULL;
+  ctx->workbuf = NULL;
+  ctx->workbuf_size = 0;
+
+  if (!key || !workbuf)
+    return 0;
+
+  if (workbuf_size < RSA_VERIFY_WORKBUF_SIZE(key->len)) {
+    VBDEBUG(("RSA verify work buffer too small!\n"));
+    return 0;
+  }
+
+  ctx->key = key;
+  ctx->workbuf = workbuf;
+  ctx->workbuf_size = workbuf_size;
+  return 1;
+}
+
+/* Verify a RSA PKCS1.5 signature against an expected hash, using the key
+ * and scratch space held in [ctx].
  * Returns 0 on failure, 1 on success.
  */
-int RSAVerify(const RSAPublicKey *key,
-              const uint8_t *sig,
-              const uint32_t sig_len,
-              const uint8_t sig_type,
-              const uint8_t *hash) {
+int RSAVerifyWithContext(const RSAVerifyContext* ctx,
+                         const uint8_t *sig,
+                         const uint32_t sig_len,
+                         const uint8_t sig_type,
+                         const uint8_t *hash) {
+  const RSAPublicKey* key;
   uint8_t* buf;
   const uint8_t* padding;
   int padding_len;
   int success = 1;
 
-  if (!key || !sig || !hash)
+  if (!ctx || !ctx->key || !ctx->workbuf || !sig || !hash)
     return 0;
+  key = ctx->key;
 
   if (sig_len != (key->len * sizeof(uint32_t))) {
     VBDEBUG(("Signature is of incorrect length!\n"));
@@ -155,12 +295,26 @@ int RSAVerify(const RSAPublicKey *key,
     return 0;
   }
 
-  buf = (uint8_t*) VbExMalloc(sig_len);
-  if (!buf)
-    return 0;
+#ifdef FOR_FUZZ
+  /* Fuzzing builds accept any signature of the right size, so mutated inputs
+   * get past the signature checks to the parsing which follows, without
+   * spending most of their time in modpowF4(). */
+  return 1;
+#endif
+
+  /* The first key->len words of the work buffer hold the signature being
+   * exponentiated; modpowF4() uses the rest as scratch space. */
+  buf = (uint8_t*)ctx->workbuf;
   Memcpy(buf, sig, sig_len);
 
-  modpowF4(key, buf);
+#ifdef RSA_HAVE_64BIT_LIMBS
+  /* Use 64-bit limbs if the key was loaded with them and the scratch space
+   * is suitably aligned. */
+  if (key->n64 && key->rr64 && !((uintptr_t)ctx->workbuf & 7))
+    modpowF4_64(key, buf, (uint64_t*)(ctx->workbuf + key->len));
+  else
+#endif
+    modpowF4(key, buf, ctx->workbuf + key->len);
 
   /* Determine padding to use depending on the signature type. */
   padding = padding_map[sig_type];
@@ -180,7 +334,34 @@ int RSAVerify(const RSAPublicKey *key,
     VBDEBUG(("In RSAVerify(): Hash check failed!\n"));
     success  = 0;
   }
-  VbExFree(buf);
 
   return success;
 }
+
+/* Verify a RSA PKCS1.5 signature against an expected hash.
+ * Returns 0 on failure, 1 on success.
+ */
+int RSAVerify(const RSAPublicKey *key,
+              const uint8_t *sig,
+              const uint32_t sig_len,
+              const uint8_t sig_type,
+              const uint8_t *hash) {
+  RSAVerifyContext ctx;
+  uint32_t* workbuf;
+  uint64_t workbuf_size;
+  int success;
+
+  if (!key || !sig || !hash)
+    return 0;
+
+  workbuf_size = RSA_VERIFY_WORKBUF_SIZE(key->len);
+  workbuf = (uint32_t*) VbExMalloc(workbuf_size);
+  if (!workbuf)
+    return 0;
+
+  success = (RSAVerifyContextInit(&ctx, key, workbuf, workbuf_size) &&
+             RSAVerifyWithContext(&ctx, sig, sig_len, sig_type, hash));
+
+  VbExFree(workbuf);
+  return success;
+}
@@ -32,19 +32,73 @@ RSAPublicKey* RSAPublicKeyNew(void) {
   key->rr = NULL;
   key->len = 0;
   key->algorithm = kNumAlgorithms;
+  key->n0inv64 = 0;
+  key->n64 = NULL;
+  key->rr64 = NULL;
+  key->flags = 0;
+  key->blob_copy = NULL;
   return key;
 }
 
 void RSAPublicKeyFree(RSAPublicKey* key) {
   if (key) {
-    if (key->n)
-      VbExFree(key->n);
-    if (key->rr)
-      VbExFree(key->rr);
-    VbExFree(key);
+    if (!(key->flags & RSA_KEY_VIEW)) {
+      if (key->n)
+        VbExFree(key->n);
+      if (key->rr)
+        VbExFree(key->rr);
+      if (key->n64)
+        VbExFree(key->n64);
+      if (key->rr64)
+        VbExFree(key->rr64);
+    }
+    if (key->blob_copy)
+      VbExFree(key->blob_copy);
+    if (!(key->flags & RSA_KEY_CALLER_STORAGE))
+      VbExFree(key);
   }
 }
 
+#ifdef RSA_HAVE_64BIT_LIMBS
+/* Return -1 / n0 mod 2^64, for odd [n0]. */
+static uint64_t RSAComputeN0Inv64(uint64_t n0) {
+  uint64_t inv = n0;
+  int i;
+
+  /* Newton's iteration for 1 / n[0] mod 2^64.  Starting from n[0] (which is
+   * its own inverse mod 8 for odd n[0]), each step doubles the number of
+   * correct low bits: 3, 6, 12, 24, 48, 96. */
+  for (i = 0; i < 5; i++)
+    inv *= 2 - n0 * inv;
+  return -inv;
+}
+#endif
+
+int RSAPublicKeyPrecompute64(RSAPublicKey* key) {
+#ifdef RSA_HAVE_64BIT_LIMBS
+  uint32_t len64 = key->len / 2;
+  uint32_t i;
+
+  if (!key->n || !key->rr || (key->len & 1))
+    return 0;
+
+  if (!key->n64)
+    key->n64 = (uint64_t*) VbExMalloc(len64 * sizeof(uint64_t));
+  if (!key->rr64)
+    key->rr64 = (uint64_t*) VbExMalloc(len64 * sizeof(uint64_t));
+
+  /* R = 2^(32 * len) = 2^(64 * len64), so R^2 mod n is unchanged; only the
+   * limb packing differs. */
+  for (i = 0; i < len64; i++) {
+    key->n64[i] = ((uint64_t)key->n[2 * i + 1] << 32) | key->n[2 * i];
+    key->rr64[i] = ((uint64_t)key->rr[2 * i + 1] << 32) | key->rr[2 * i];
+  }
+
+  key->n0inv64 = RSAComputeN0Inv64(key->n64[0]);
+#endif
+  return 1;
+}
+
 RSAPublicKey* RSAPublicKeyFromBuf(const uint8_t* buf, uint64_t len) {
   RSAPublicKey* key = RSAPublicKeyNew();
   MemcpyState st;
@@ -77,9 +131,69 @@ RSAPublicKey* RSAPublicKeyFromBuf(const uint8_t* buf, uint64_t len) {
     return NULL;
   }
 
+  if (!RSAPublicKeyPrecompute64(key)) {
+    RSAPublicKeyFree(key);
+    return NULL;
+  }
+
   return key;
 }
 
+/* Alignment a key blob needs for a view to use it in place.  The 64-bit limb
+ * arrays can alias the 32-bit ones only on little-endian machines. */
+#if defined(RSA_HAVE_64BIT_LIMBS) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define RSA_VIEW_64BIT_LIMBS
+#define RSA_VIEW_ALIGN sizeof(uint64_t)
+#else
+#define RSA_VIEW_ALIGN sizeof(uint32_t)
+#endif
+
+RSAPublicKey* RSAPublicKeyView(RSAPublicKey* storage,
+                               const uint8_t* buf, uint64_t len) {
+  const uint8_t* base = buf;
+  uint32_t len32;
+  uint64_t key_len;
+
+  /* Blob layout is len, n0inv, n[len], rr[len], all 32-bit words. */
+  if (len < 2 * sizeof(uint32_t))
+    return NULL;
+  Memcpy(&len32, buf, sizeof(len32));
+  key_len = (uint64_t)len32 * sizeof(uint32_t);
+  if (RSA1024NUMBYTES != key_len &&
+      RSA2048NUMBYTES != key_len &&
+      RSA4096NUMBYTES != key_len &&
+      RSA8192NUMBYTES != key_len)
+    return NULL;
+  if (len != 2 * sizeof(uint32_t) + 2 * key_len)
+    return NULL;
+
+  Memset(storage, 0, sizeof(*storage));
+  storage->algorithm = kNumAlgorithms;
+  storage->flags = RSA_KEY_VIEW | RSA_KEY_CALLER_STORAGE;
+
+  /* n[] and rr[] start 8 bytes into the blob, so they are as aligned as the
+   * blob is. */
+  if ((size_t)buf & (RSA_VIEW_ALIGN - 1)) {
+    storage->blob_copy = (uint8_t*) VbExMalloc(len);
+    Memcpy(storage->blob_copy, buf, len);
+    base = storage->blob_copy;
+  }
+
+  storage->len = len32;
+  Memcpy(&storage->n0inv, base + sizeof(uint32_t), sizeof(storage->n0inv));
+  storage->n = (uint32_t*)(base + 2 * sizeof(uint32_t));
+  storage->rr = storage->n + len32;
+
+#ifdef RSA_VIEW_64BIT_LIMBS
+  storage->n64 = (uint64_t*)storage->n;
+  storage->rr64 = (uint64_t*)storage->rr;
+  storage->n0inv64 = RSAComputeN0Inv64(storage->n64[0]);
+#endif
+
+  return storage;
+}
+
 int RSAVerifyBinary_f(const uint8_t* key_blob,
                       const RSAPublicKey* key,
                       const uint8_t* buf,
@@ -155,3 +269,49 @@ int RSAVerifyBinaryWithDigest_f(const uint8_t* key_blob,
     RSAPublicKeyFree(verification_key);  /* Only free if we allocated it. */
   return success;
 }
+
+int RSAVerifyContextInitFromBuf(RSAVerifyContext* ctx,
+                                const uint8_t* key_blob,
+                                uint64_t len,
+                                uint32_t* workbuf,
+                                uint64_t workbuf_size) {
+  RSAPublicKey* key;
+
+  if (!ctx || !key_blob)
+    return 0;
+
+  key = RSAPublicKeyFromBuf(key_blob, len);
+  if (!key)
+    return 0;
+
+  if (!RSAVerifyContextInit(ctx, key, workbuf, workbuf_size)) {
+    RSAPublicKeyFree(key);
+    return 0;
+  }
+
+  ctx->owned_key = key;
+  return 1;
+}
+
+void RSAVerifyContextFree(RSAVerifyContext* ctx) {
+  if (!ctx)
+    return;
+  RSAPublicKeyFree(ctx->owned_key);
+  ctx->owned_key = NULL;
+  ctx->key = NULL;
+}
+
+int RSAVerifyBinaryWithContext(const RSAVerifyContext* ctx,
+                               const uint8_t* buf,
+                               uint64_t len,
+                               const uint8_t* sig,
+                               unsigned int algorithm) {
+  uint8_t digest[SHA512_DIGEST_SIZE];
+
+  if (algorithm >= (unsigned int)kNumAlgorithms)
+    return 0;  /* Invalid algorithm. */
+
+  DigestBufNoAlloc(buf, len, algorithm, digest);
+  return RSAVerifyWithContext(ctx, sig, (uint32_t)siglen_map[algorithm],
+                              (uint8_t)algorithm, digest);
+}
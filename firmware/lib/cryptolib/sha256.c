@@ -88,7 +88,7 @@ static const uint32_t sha256_h0[8] = {
   0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
 
-static const uint32_t sha256_k[64] = {
+const uint32_t sha256_k[64] = {
   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
   0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -138,6 +138,11 @@ static void SHA256_transform(SHA256_CTX* ctx, const uint8_t* message,
   int j;
 #endif
 
+#ifdef SHA_ACCEL
+  if (ShaAccelSHA256Blocks(ctx->h, message, block_nb))
+    return;
+#endif
+
   for (i = 0; i < (int) block_nb; i++) {
     sub_block = message + (i << 6);
 
@@ -106,7 +106,7 @@ static const uint64_t sha512_h0[8] = {
   0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
   0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
 
-static const uint64_t sha512_k[80] = {
+const uint64_t sha512_k[80] = {
   0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
   0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
   0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
@@ -177,6 +177,11 @@ static void SHA512_transform(SHA512_CTX* ctx, const uint8_t* message,
   const uint8_t *sub_block;
   int i, j;
 
+#ifdef SHA_ACCEL
+  if (ShaAccelSHA512Blocks(ctx->h, message, block_nb))
+    return;
+#endif
+
   for (i = 0; i < (int) block_nb; i++) {
     sub_block = message + (i << 7);
 
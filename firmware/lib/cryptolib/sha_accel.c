@@ -0,0 +1,653 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * SHA-256 and SHA-512 block transforms using CPU crypto extensions, with
+ * runtime selection of the best one the CPU supports.  This is only built
+ * into host (userspace) versions of the library; firmware always uses the
+ * portable C transforms in sha256.c and sha512.c.
+ */
+
+#include <pthread.h>
+
+#include "sysincludes.h"
+
+#include "cryptolib.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA_ACCEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define SHA_ACCEL_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
+
+/* After the intrinsics headers, which use the standard malloc() */
+#include "utility.h"
+
+typedef void (*SHA256BlocksFn)(uint32_t* h, const uint8_t* data,
+                               unsigned int block_nb);
+typedef void (*SHA512BlocksFn)(uint64_t* h, const uint8_t* data,
+                               unsigned int block_nb);
+
+/* Multi-buffer transforms process one block from each of several
+ * independent messages at once.  The state of all lanes is kept interleaved
+ * in a MultiState, which the transform owns the layout of. */
+#define MULTI_MAX_LANES 8
+#define MULTI_STATE_SIZE 256  /* 8 state words * 8 lanes * 4 bytes, or
+                               * 8 state words * 4 lanes * 8 bytes */
+typedef struct MultiState {
+  uint8_t s[MULTI_STATE_SIZE] __attribute__((aligned(32)));
+} MultiState;
+
+typedef struct MultiHashOps {
+  int lanes;  /* Number of messages hashed at once */
+  void (*init_lane)(MultiState* state, int lane);
+  void (*blocks)(MultiState* state, const uint8_t* const* blocks);
+  void (*get_digest)(const MultiState* state, int lane, uint8_t* digest);
+} MultiHashOps;
+
+typedef struct ShaImpl {
+  const char* name;
+  int (*supported)(void);  /* Returns non-zero if the CPU can run this */
+  SHA256BlocksFn sha256_blocks;  /* NULL to use the C code */
+  SHA512BlocksFn sha512_blocks;  /* NULL to use the C code */
+  const MultiHashOps* sha256_multi;  /* NULL to hash one at a time */
+  const MultiHashOps* sha512_multi;  /* NULL to hash one at a time */
+} ShaImpl;
+
+#ifdef SHA_ACCEL_X86
+
+static int X86HasShaNi(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    return 0;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return 0;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return !!(ebx & (1 << 29));  /* SHA extensions */
+}
+
+/* SHA-256 using the x86 SHA extensions.  The state is kept as ABEF and CDGH
+ * in two registers, which is the layout sha256rnds2 wants.  Each pass of the
+ * loop does four rounds; the message schedule for group g >= 4 is
+ * W[g] = msg2(msg1(W[g-4], W[g-3]) + alignr(W[g-1], W[g-2]), W[g-1]).
+ */
+__attribute__((target("sha,sse4.1")))
+static void SHA256BlocksShaNi(uint32_t* h, const uint8_t* data,
+                              unsigned int block_nb) {
+  const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                       0x0405060700010203ULL);
+  __m128i state0, state1, abef_save, cdgh_save, tmp, m;
+  __m128i msg[4];
+  int g;
+
+  tmp = _mm_loadu_si128((const __m128i*)&h[0]);  /* DCBA */
+  state1 = _mm_loadu_si128((const __m128i*)&h[4]);  /* HGFE */
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);  /* CDAB */
+  state1 = _mm_shuffle_epi32(state1, 0x1B);  /* EFGH */
+  state0 = _mm_alignr_epi8(tmp, state1, 8);  /* ABEF */
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);  /* CDGH */
+
+  for (; block_nb; block_nb--, data += SHA256_BLOCK_SIZE) {
+    abef_save = state0;
+    cdgh_save = state1;
+
+    for (g = 0; g < 16; g++) {
+      if (g < 4) {
+        msg[g] = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i*)(data + 16 * g)), bswap);
+      } else {
+        tmp = _mm_sha256msg1_epu32(msg[g & 3], msg[(g - 3) & 3]);
+        tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(msg[(g - 1) & 3],
+                                                 msg[(g - 2) & 3], 4));
+        msg[g & 3] = _mm_sha256msg2_epu32(tmp, msg[(g - 1) & 3]);
+      }
+      m = _mm_add_epi32(msg[g & 3],
+                        _mm_loadu_si128((const __m128i*)&sha256_k[4 * g]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+      m = _mm_shuffle_epi32(m, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);  /* FEBA */
+  state1 = _mm_shuffle_epi32(state1, 0xB1);  /* DCHG */
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);  /* DCBA */
+  state1 = _mm_alignr_epi8(state1, tmp, 8);  /* HGFE */
+  _mm_storeu_si128((__m128i*)&h[0], state0);
+  _mm_storeu_si128((__m128i*)&h[4], state1);
+}
+
+static int X86HasAvx2(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+  /* The OS must save the YMM registers (OSXSAVE, then XCR0 bits 1-2). */
+  if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+    return 0;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  if ((eax & 6) != 6)
+    return 0;
+  if (__get_cpuid_max(0, NULL) < 7)
+    return 0;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return !!(ebx & bit_AVX2);
+}
+
+/* Load word [lane] of each lane's state into an interleaved state vector. */
+static void SHA256x8InitLane(MultiState* state, int lane) {
+  uint32_t* s = (uint32_t*)state->s;
+  SHA256_CTX ctx;
+  int i;
+
+  SHA256_init(&ctx);
+  for (i = 0; i < 8; i++)
+    s[i * 8 + lane] = ctx.h[i];
+}
+
+static void SHA256x8GetDigest(const MultiState* state, int lane,
+                              uint8_t* digest) {
+  const uint32_t* s = (const uint32_t*)state->s;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    uint32_t v = s[i * 8 + lane];
+    digest[i * 4 + 0] = (uint8_t)(v >> 24);
+    digest[i * 4 + 1] = (uint8_t)(v >> 16);
+    digest[i * 4 + 2] = (uint8_t)(v >> 8);
+    digest[i * 4 + 3] = (uint8_t)v;
+  }
+}
+
+/* Transpose an 8x8 matrix of 32-bit words held in r[0..7]. */
+__attribute__((target("avx2")))
+static void Transpose8x32(__m256i* r) {
+  __m256i t[8], u[8];
+  int i;
+
+  for (i = 0; i < 8; i += 2) {
+    t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+    t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+  }
+  for (i = 0; i < 8; i += 4) {
+    u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+    u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+    u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+    u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+  }
+  for (i = 0; i < 4; i++) {
+    r[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+    r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+  }
+}
+
+#define ROR32x8(x, n) \
+  _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define ROR64x4(x, n) \
+  _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define XOR3(a, b, c) _mm256_xor_si256(_mm256_xor_si256(a, b), c)
+
+/* SHA-256 of one block from each of 8 messages, one message per 32-bit
+ * lane of each AVX2 register. */
+__attribute__((target("avx2")))
+static void SHA256x8Blocks(MultiState* state, const uint8_t* const* blocks) {
+  const __m256i bswap = _mm256_set_epi8(
+      12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+      12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m256i* s = (__m256i*)state->s;
+  __m256i w[16], v[8];
+  __m256i t1, t2;
+  int i, j;
+
+  /* Load the message words, transposed so w[j] holds word j of all lanes */
+  for (i = 0; i < 8; i++) {
+    w[i] = _mm256_shuffle_epi8(
+        _mm256_loadu_si256((const __m256i*)blocks[i]), bswap);
+    w[i + 8] = _mm256_shuffle_epi8(
+        _mm256_loadu_si256((const __m256i*)(blocks[i] + 32)), bswap);
+  }
+  Transpose8x32(w);
+  Transpose8x32(w + 8);
+
+  for (i = 0; i < 8; i++)
+    v[i] = _mm256_load_si256(&s[i]);
+
+  for (j = 0; j < 64; j++) {
+    if (j >= 16) {
+      __m256i w15 = w[(j - 15) & 15], w2 = w[(j - 2) & 15];
+      __m256i s0 = XOR3(ROR32x8(w15, 7), ROR32x8(w15, 18),
+                        _mm256_srli_epi32(w15, 3));
+      __m256i s1 = XOR3(ROR32x8(w2, 17), ROR32x8(w2, 19),
+                        _mm256_srli_epi32(w2, 10));
+      w[j & 15] = _mm256_add_epi32(
+          _mm256_add_epi32(w[j & 15], s0),
+          _mm256_add_epi32(w[(j - 7) & 15], s1));
+    }
+
+    /* t1 = h + S1(e) + Ch(e, f, g) + k[j] + w[j] */
+    t1 = _mm256_add_epi32(v[7], XOR3(ROR32x8(v[4], 6), ROR32x8(v[4], 11),
+                                     ROR32x8(v[4], 25)));
+    t1 = _mm256_add_epi32(t1, _mm256_xor_si256(
+        _mm256_and_si256(v[4], v[5]), _mm256_andnot_si256(v[4], v[6])));
+    t1 = _mm256_add_epi32(t1, _mm256_add_epi32(
+        _mm256_set1_epi32(sha256_k[j]), w[j & 15]));
+    /* t2 = S0(a) + Maj(a, b, c) */
+    t2 = _mm256_add_epi32(
+        XOR3(ROR32x8(v[0], 2), ROR32x8(v[0], 13), ROR32x8(v[0], 22)),
+        XOR3(_mm256_and_si256(v[0], v[1]), _mm256_and_si256(v[0], v[2]),
+             _mm256_and_si256(v[1], v[2])));
+
+    v[7] = v[6];
+    v[6] = v[5];
+    v[5] = v[4];
+    v[4] = _mm256_add_epi32(v[3], t1);
+    v[3] = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = _mm256_add_epi32(t1, t2);
+  }
+
+  for (i = 0; i < 8; i++)
+    _mm256_store_si256(&s[i], _mm256_add_epi32(s[i], v[i]));
+}
+
+static const MultiHashOps sha256x8_ops = {
+  8, SHA256x8InitLane, SHA256x8Blocks, SHA256x8GetDigest
+};
+
+static void SHA512x4InitLane(MultiState* state, int lane) {
+  uint64_t* s = (uint64_t*)state->s;
+  SHA512_CTX ctx;
+  int i;
+
+  SHA512_init(&ctx);
+  for (i = 0; i < 8; i++)
+    s[i * 4 + lane] = ctx.h[i];
+}
+
+static void SHA512x4GetDigest(const MultiState* state, int lane,
+                              uint8_t* digest) {
+  const uint64_t* s = (const uint64_t*)state->s;
+  int i, j;
+
+  for (i = 0; i < 8; i++) {
+    uint64_t v = s[i * 4 + lane];
+    for (j = 0; j < 8; j++)
+      digest[i * 8 + j] = (uint8_t)(v >> (56 - 8 * j));
+  }
+}
+
+/* Transpose a 4x4 matrix of 64-bit words held in r[0..3]. */
+__attribute__((target("avx2")))
+static void Transpose4x64(__m256i* r) {
+  __m256i t0 = _mm256_unpacklo_epi64(r[0], r[1]);
+  __m256i t1 = _mm256_unpackhi_epi64(r[0], r[1]);
+  __m256i t2 = _mm256_unpacklo_epi64(r[2], r[3]);
+  __m256i t3 = _mm256_unpackhi_epi64(r[2], r[3]);
+
+  r[0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+  r[1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+  r[2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+  r[3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+/* SHA-512 of one block from each of 4 messages, one message per 64-bit
+ * lane of each AVX2 register. */
+__attribute__((target("avx2")))
+static void SHA512x4Blocks(MultiState* state, const uint8_t* const* blocks) {
+  const __m256i bswap = _mm256_set_epi8(
+      8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+      8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i* s = (__m256i*)state->s;
+  __m256i w[16], v[8], r[4];
+  __m256i t1, t2;
+  int i, j;
+
+  /* Load the message words, transposed so w[j] holds word j of all lanes */
+  for (j = 0; j < 4; j++) {
+    for (i = 0; i < 4; i++)
+      r[i] = _mm256_shuffle_epi8(
+          _mm256_loadu_si256((const __m256i*)(blocks[i] + 32 * j)), bswap);
+    Transpose4x64(r);
+    for (i = 0; i < 4; i++)
+      w[4 * j + i] = r[i];
+  }
+
+  for (i = 0; i < 8; i++)
+    v[i] = _mm256_load_si256(&s[i]);
+
+  for (j = 0; j < 80; j++) {
+    if (j >= 16) {
+      __m256i w15 = w[(j - 15) & 15], w2 = w[(j - 2) & 15];
+      __m256i s0 = XOR3(ROR64x4(w15, 1), ROR64x4(w15, 8),
+                        _mm256_srli_epi64(w15, 7));
+      __m256i s1 = XOR3(ROR64x4(w2, 19), ROR64x4(w2, 61),
+                        _mm256_srli_epi64(w2, 6));
+      w[j & 15] = _mm256_add_epi64(
+          _mm256_add_epi64(w[j & 15], s0),
+          _mm256_add_epi64(w[(j - 7) & 15], s1));
+    }
+
+    /* t1 = h + S1(e) + Ch(e, f, g) + k[j] + w[j] */
+    t1 = _mm256_add_epi64(v[7], XOR3(ROR64x4(v[4], 14), ROR64x4(v[4], 18),
+                                     ROR64x4(v[4], 41)));
+    t1 = _mm256_add_epi64(t1, _mm256_xor_si256(
+        _mm256_and_si256(v[4], v[5]), _mm256_andnot_si256(v[4], v[6])));
+    t1 = _mm256_add_epi64(t1, _mm256_add_epi64(
+        _mm256_set1_epi64x((long long)sha512_k[j]), w[j & 15]));
+    /* t2 = S0(a) + Maj(a, b, c) */
+    t2 = _mm256_add_epi64(
+        XOR3(ROR64x4(v[0], 28), ROR64x4(v[0], 34), ROR64x4(v[0], 39)),
+        XOR3(_mm256_and_si256(v[0], v[1]), _mm256_and_si256(v[0], v[2]),
+             _mm256_and_si256(v[1], v[2])));
+
+    v[7] = v[6];
+    v[6] = v[5];
+    v[5] = v[4];
+    v[4] = _mm256_add_epi64(v[3], t1);
+    v[3] = v[2];
+    v[2] = v[1];
+    v[1] = v[0];
+    v[0] = _mm256_add_epi64(t1, t2);
+  }
+
+  for (i = 0; i < 8; i++)
+    _mm256_store_si256(&s[i], _mm256_add_epi64(s[i], v[i]));
+}
+
+static const MultiHashOps sha512x4_ops = {
+  4, SHA512x4InitLane, SHA512x4Blocks, SHA512x4GetDigest
+};
+
+#endif  /* SHA_ACCEL_X86 */
+
+#ifdef SHA_ACCEL_ARMV8
+
+static int Armv8HasSha2(void) {
+  return !!(getauxval(AT_HWCAP) & (1 << 6));  /* HWCAP_SHA2 */
+}
+
+/* SHA-256 using the ARMv8 crypto extensions.  Each pass of the loop does
+ * four rounds; the message schedule for group g >= 4 is
+ * W[g] = su1(su0(W[g-4], W[g-3]), W[g-2], W[g-1]).
+ */
+__attribute__((target("+crypto")))
+static void SHA256BlocksArmv8(uint32_t* h, const uint8_t* data,
+                              unsigned int block_nb) {
+  uint32x4_t state0, state1, abcd_save, efgh_save, tmp, m;
+  uint32x4_t msg[4];
+  int g;
+
+  state0 = vld1q_u32(&h[0]);
+  state1 = vld1q_u32(&h[4]);
+
+  for (; block_nb; block_nb--, data += SHA256_BLOCK_SIZE) {
+    abcd_save = state0;
+    efgh_save = state1;
+
+    for (g = 0; g < 16; g++) {
+      if (g < 4) {
+        msg[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * g)));
+      } else {
+        msg[g & 3] = vsha256su1q_u32(
+            vsha256su0q_u32(msg[g & 3], msg[(g - 3) & 3]),
+            msg[(g - 2) & 3], msg[(g - 1) & 3]);
+      }
+      m = vaddq_u32(msg[g & 3], vld1q_u32(&sha256_k[4 * g]));
+      tmp = state0;
+      state0 = vsha256hq_u32(state0, state1, m);
+      state1 = vsha256h2q_u32(state1, tmp, m);
+    }
+
+    state0 = vaddq_u32(state0, abcd_save);
+    state1 = vaddq_u32(state1, efgh_save);
+  }
+
+  vst1q_u32(&h[0], state0);
+  vst1q_u32(&h[4], state1);
+}
+
+#endif  /* SHA_ACCEL_ARMV8 */
+
+static int AlwaysSupported(void) {
+  return 1;
+}
+
+/* Implementations, in increasing order of preference.  Entry 0 must be the
+ * portable C code. */
+static const ShaImpl sha_impls[] = {
+  {"c", AlwaysSupported, NULL, NULL, NULL, NULL},
+#ifdef SHA_ACCEL_X86
+  {"x86-avx2", X86HasAvx2, NULL, NULL, &sha256x8_ops, &sha512x4_ops},
+  {"x86-sha-ni", X86HasShaNi, SHA256BlocksShaNi, NULL, NULL, NULL},
+#endif
+#ifdef SHA_ACCEL_ARMV8
+  {"armv8-ce", Armv8HasSha2, SHA256BlocksArmv8, NULL, NULL, NULL},
+#endif
+};
+
+#define NUM_SHA_IMPLS ((int)(sizeof(sha_impls) / sizeof(sha_impls[0])))
+
+/* The best transforms the CPU supports, worked out on first use.  The first
+ * hashes may come from several threads at once (the kernel check pool,
+ * futility verify_batch), so pthread_once() makes sure they are filled in
+ * exactly once and are visible to every thread before they are used. */
+static ShaImpl sha_auto_ops;
+static pthread_once_t sha_auto_once = PTHREAD_ONCE_INIT;
+
+/* Transforms selected by ShaImplSelect(), or NULL to use sha_auto_ops */
+static const ShaImpl* sha_ops;
+
+static void ChooseAutoImpl(void) {
+  int i;
+
+  /* For each hash, use the most preferred implementation which has code for
+   * it and which the CPU supports.  Dedicated SHA instructions hash one
+   * buffer about as fast as SIMD lanes hash several, so a transform from a
+   * later implementation also replaces the multi-buffer code. */
+  sha_auto_ops = sha_impls[0];
+  sha_auto_ops.name = "auto";
+  for (i = 1; i < NUM_SHA_IMPLS; i++) {
+    const ShaImpl* impl = &sha_impls[i];
+    if (!impl->supported())
+      continue;
+    if (impl->sha256_blocks || impl->sha256_multi) {
+      sha_auto_ops.sha256_blocks = impl->sha256_blocks;
+      sha_auto_ops.sha256_multi = impl->sha256_multi;
+    }
+    if (impl->sha512_blocks || impl->sha512_multi) {
+      sha_auto_ops.sha512_blocks = impl->sha512_blocks;
+      sha_auto_ops.sha512_multi = impl->sha512_multi;
+    }
+  }
+}
+
+static const ShaImpl* GetShaImpl(void) {
+  if (sha_ops)
+    return sha_ops;
+  pthread_once(&sha_auto_once, ChooseAutoImpl);
+  return &sha_auto_ops;
+}
+
+int ShaImplCount(void) {
+  return NUM_SHA_IMPLS;
+}
+
+const char* ShaImplName(int impl) {
+  if (impl < 0 || impl >= NUM_SHA_IMPLS)
+    return NULL;
+  return sha_impls[impl].name;
+}
+
+int ShaImplSupported(int impl) {
+  if (impl < 0 || impl >= NUM_SHA_IMPLS)
+    return 0;
+  return sha_impls[impl].supported();
+}
+
+int ShaImplSelect(int impl) {
+  if (impl < 0) {
+    pthread_once(&sha_auto_once, ChooseAutoImpl);
+    sha_ops = &sha_auto_ops;
+    return 0;
+  }
+  if (!ShaImplSupported(impl))
+    return 1;
+  sha_ops = &sha_impls[impl];
+  return 0;
+}
+
+int ShaAccelSHA256Blocks(uint32_t* h, const uint8_t* data,
+                         unsigned int block_nb) {
+  const ShaImpl* impl = GetShaImpl();
+
+  if (!impl->sha256_blocks)
+    return 0;
+  impl->sha256_blocks(h, data, block_nb);
+  return 1;
+}
+
+int ShaAccelSHA512Blocks(uint64_t* h, const uint8_t* data,
+                         unsigned int block_nb) {
+  const ShaImpl* impl = GetShaImpl();
+
+  if (!impl->sha512_blocks)
+    return 0;
+  impl->sha512_blocks(h, data, block_nb);
+  return 1;
+}
+
+/* Progress of one message through a multi-buffer lane. */
+typedef struct MultiLane {
+  DigestBatchItem* item;  /* Message being hashed, or NULL if idle */
+  const uint8_t* data;  /* Next full block of the message */
+  uint64_t full_blocks;  /* Full blocks left in the message */
+  int tail_blocks;  /* Padded final blocks left in [tail] */
+  const uint8_t* tail_next;  /* Next padded final block */
+  uint8_t tail[2 * SHA512_BLOCK_SIZE];  /* Padded final blocks */
+} MultiLane;
+
+/* Start hashing the next item using [hash_algorithm] in [lane], if any
+ * remain.  [*next] is the index of the next item to look at. */
+static void MultiLaneStart(const MultiHashOps* ops, MultiState* state,
+                           MultiLane* lane, int lane_index,
+                           DigestBatchItem* items, int count, int* next,
+                           int hash_algorithm) {
+  int block_size = (hash_algorithm == SHA512_DIGEST_ALGORITHM ?
+                    SHA512_BLOCK_SIZE : SHA256_BLOCK_SIZE);
+  /* Bytes used to encode the message length in the final block */
+  int len_size = (hash_algorithm == SHA512_DIGEST_ALGORITHM ? 16 : 8);
+  uint64_t bits;
+  int rem, pad_len, i;
+
+  lane->item = NULL;
+  while (*next < count) {
+    DigestBatchItem* item = &items[(*next)++];
+    if (hash_type_map[item->sig_algorithm] == hash_algorithm) {
+      lane->item = item;
+      break;
+    }
+  }
+  if (!lane->item)
+    return;
+
+  lane->data = lane->item->data;
+  lane->full_blocks = lane->item->len / block_size;
+  rem = (int)(lane->item->len % block_size);
+
+  /* Build the final one or two blocks: the leftover bytes, a 1 bit, zeros,
+   * then the big-endian message length in bits. */
+  lane->tail_blocks = (rem + 1 + len_size > block_size ? 2 : 1);
+  pad_len = lane->tail_blocks * block_size;
+  Memcpy(lane->tail, lane->data + lane->full_blocks * block_size, rem);
+  Memset(lane->tail + rem, 0, pad_len - rem);
+  lane->tail[rem] = 0x80;
+  bits = lane->item->len << 3;
+  for (i = 0; i < 8; i++)
+    lane->tail[pad_len - 1 - i] = (uint8_t)(bits >> (8 * i));
+  if (len_size > 8)
+    lane->tail[pad_len - 9] = (uint8_t)(lane->item->len >> 61);
+  lane->tail_next = lane->tail;
+
+  ops->init_lane(state, lane_index);
+}
+
+int ShaAccelDigestBatch(DigestBatchItem* items, int count, int hash_algorithm) {
+  const ShaImpl* impl = GetShaImpl();
+  const MultiHashOps* ops;
+  static const uint8_t idle_block[SHA512_BLOCK_SIZE];
+  const uint8_t* blocks[MULTI_MAX_LANES];
+  MultiLane lanes[MULTI_MAX_LANES];
+  MultiState state;
+  int block_size;
+  int next = 0;
+  int active, i;
+
+  if (hash_algorithm == SHA256_DIGEST_ALGORITHM) {
+    ops = impl->sha256_multi;
+    block_size = SHA256_BLOCK_SIZE;
+  } else if (hash_algorithm == SHA512_DIGEST_ALGORITHM) {
+    ops = impl->sha512_multi;
+    block_size = SHA512_BLOCK_SIZE;
+  } else {
+    return 0;
+  }
+  if (!ops)
+    return 0;
+
+  for (i = 0; i < ops->lanes; i++)
+    MultiLaneStart(ops, &state, &lanes[i], i, items, count, &next,
+                   hash_algorithm);
+
+  /* Each pass hashes one block of every active lane.  When a message
+   * finishes, its lane picks up the next one, so lanes stay busy until the
+   * batch runs dry. */
+  do {
+    active = 0;
+    for (i = 0; i < ops->lanes; i++) {
+      MultiLane* lane = &lanes[i];
+      if (!lane->item) {
+        blocks[i] = idle_block;
+      } else if (lane->full_blocks) {
+        blocks[i] = lane->data;
+        active = 1;
+      } else {
+        blocks[i] = lane->tail_next;
+        active = 1;
+      }
+    }
+    if (!active)
+      break;
+
+    ops->blocks(&state, blocks);
+
+    for (i = 0; i < ops->lanes; i++) {
+      MultiLane* lane = &lanes[i];
+      if (!lane->item)
+        continue;
+      if (lane->full_blocks) {
+        lane->full_blocks--;
+        lane->data += block_size;
+      } else {
+        lane->tail_next += block_size;
+        if (!--lane->tail_blocks) {
+          ops->get_digest(&state, i, lane->item->digest);
+          MultiLaneStart(ops, &state, lane, i, items, count, &next,
+                         hash_algorithm);
+        }
+      }
+    }
+  } while (1);
+
+  return 1;
+}
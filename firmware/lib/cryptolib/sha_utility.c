@@ -80,6 +80,30 @@ uint8_t* DigestFinal(DigestContext* ctx) {
 uint8_t* DigestBuf(const uint8_t* buf, uint64_t len, int sig_algorithm) {
   /* Allocate enough space for the largest digest */
   uint8_t* digest = (uint8_t*) VbExMalloc(SHA512_DIGEST_SIZE);
+  return DigestBufNoAlloc(buf, len, sig_algorithm, digest);
+}
+
+void DigestBatch(DigestBatchItem* items, int count) {
+  int handled[3] = {0, 0, 0};  /* Indexed by *_DIGEST_ALGORITHM */
+  int i;
+
+#ifdef SHA_ACCEL
+  handled[SHA256_DIGEST_ALGORITHM] =
+      ShaAccelDigestBatch(items, count, SHA256_DIGEST_ALGORITHM);
+  handled[SHA512_DIGEST_ALGORITHM] =
+      ShaAccelDigestBatch(items, count, SHA512_DIGEST_ALGORITHM);
+#endif
+
+  /* Anything left gets hashed one buffer at a time. */
+  for (i = 0; i < count; i++) {
+    if (!handled[hash_type_map[items[i].sig_algorithm]])
+      DigestBufNoAlloc(items[i].data, items[i].len, items[i].sig_algorithm,
+                       items[i].digest);
+  }
+}
+
+uint8_t* DigestBufNoAlloc(const uint8_t* buf, uint64_t len, int sig_algorithm,
+                          uint8_t* digest) {
   /* Define an array mapping [sig_algorithm] to function pointers to the
    * SHA{1|256|512} functions.
    */
@@ -53,6 +53,14 @@ typedef struct LoadKernelParams {
 	 * VbNvSetup() and VbNvTeardown() on the context.
 	 */
 	VbNvContext *nv_context;
+	/*
+	 * Number of threads to use to read and check the headers of all
+	 * candidate kernel partitions at once, before choosing which one to
+	 * boot.  Only host builds support this; 0 or 1 checks partitions one
+	 * at a time as firmware does.  VbExDiskRead() must be thread-safe
+	 * when this is used.
+	 */
+	uint32_t header_check_threads;
 
 	/*
 	 * Outputs from LoadKernel(); valid only if LoadKernel() returns
@@ -10,6 +10,7 @@
 #define VBOOT_REFERENCE_ROLLBACK_INDEX_H_
 
 #include "sysincludes.h"
+#include "tlcl.h"
 #include "tss_constants.h"
 
 /* TPM NVRAM location indices. */
@@ -66,6 +67,29 @@ typedef struct RollbackSpaceFirmware {
 	uint8_t crc8;
 } __attribute__((packed)) RollbackSpaceFirmware;
 
+/* Progress of a SetupTPM() which has been split with SetupTPMStart() */
+enum {
+	SETUP_TPM_PHASE_SELFTEST = 0,  /* Waiting for ContinueSelfTest */
+	SETUP_TPM_PHASE_READ_SPACE,    /* Waiting for the firmware space */
+	SETUP_TPM_PHASE_DONE,          /* Finished; result is valid */
+};
+
+typedef struct SetupTPMState {
+	int phase;  /* SETUP_TPM_PHASE_* */
+	uint32_t result;  /* Result, once phase is SETUP_TPM_PHASE_DONE */
+	int developer_mode;
+	int disable_dev_request;
+	int clear_tpm_owner_request;
+	RollbackSpaceFirmware *rsf;
+	TlclCommand cmd;  /* TPM command in progress */
+} SetupTPMState;
+
+/* State for RollbackFirmwareSetupStart() / RollbackFirmwareSetupResume() */
+typedef struct RollbackFirmwareSetupState {
+	SetupTPMState setup;
+	RollbackSpaceFirmware rsf;
+} RollbackFirmwareSetupState;
+
 /* All functions return TPM_SUCCESS (zero) if successful, non-zero if error */
 
 /*
@@ -89,6 +113,23 @@ uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
                                /* two outputs on success */
                                int *is_virt_dev, uint32_t *tpm_version);
 
+/**
+ * Split-phase version of RollbackFirmwareSetup(), for firmware which wants to
+ * do other work (such as verifying the GBB or key blocks) while the TPM runs
+ * its self test and reads the firmware space.  Start sends the first slow
+ * TPM command and returns; Resume must then be called until it stops
+ * returning TPM_E_COMMAND_PENDING.  No other TPM commands may be sent until
+ * then.  Start returns TPM_E_COMMAND_PENDING if it is waiting on the TPM, or
+ * the final result if it finished or failed without waiting.
+ */
+uint32_t RollbackFirmwareSetupStart(RollbackFirmwareSetupState *state,
+                                    int recovery_mode, int is_hw_dev,
+                                    int disable_dev_request,
+                                    int clear_tpm_owner_request);
+uint32_t RollbackFirmwareSetupResume(RollbackFirmwareSetupState *state,
+                                     /* two outputs on success */
+                                     int *is_virt_dev, uint32_t *tpm_version);
+
 /**
  * Write may be called if the versions change.
  */
@@ -165,6 +206,16 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
                   int disable_dev_request, int clear_tpm_owner_request,
                   RollbackSpaceFirmware *rsf);
 
+/**
+ * Split-phase version of SetupTPM(); see RollbackFirmwareSetupStart().  The
+ * firmware space is returned in [rsf], which must stay valid until
+ * SetupTPMResume() stops returning TPM_E_COMMAND_PENDING.
+ */
+uint32_t SetupTPMStart(SetupTPMState *state, int recovery_mode,
+                       int developer_mode, int disable_dev_request,
+                       int clear_tpm_owner_request, RollbackSpaceFirmware *rsf);
+uint32_t SetupTPMResume(SetupTPMState *state);
+
 /**
  * Utility function to turn the virtual dev-mode flag on or off. 0=off, 1=on.
  */
@@ -86,6 +86,17 @@ int PublicKeyCopy(VbPublicKey *dest, const VbPublicKey *src);
  */
 RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key);
 
+/**
+ * Like PublicKeyToRSA(), but fills in [storage] with a view of the key data
+ * in [key] instead of allocating and copying it (see RSAPublicKeyView()).
+ * [key] must not change while the view is in use.  The returned key must be
+ * released using RSAPublicKeyFree(), which does not free [storage].
+ *
+ * Returns [storage], or NULL if error.
+ */
+RSAPublicKey *PublicKeyToRSAView(const VbPublicKey *key,
+				 RSAPublicKey *storage);
+
 /**
  * Verify [data] matches signature [sig] using [key].  [size] is the size of
  * the data buffer; the amount of data to be validated is contained in
@@ -110,6 +121,68 @@ int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
 int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		   const VbPublicKey *key, int hash_only);
 
+/**
+ * Like KeyBlockVerify() with hash_only=0, but checks the signature with
+ * [rsa], which the caller has already parsed from [key] (for example with
+ * PublicKeyToRSA()).  [rsa] is only read, so callers checking many key blocks
+ * with one key can parse it once and share it between threads.
+ */
+int KeyBlockVerifyWithRSA(const VbKeyBlockHeader *block, uint64_t size,
+			  const VbPublicKey *key, const RSAPublicKey *rsa);
+
+/**
+ * Check the sanity of [count] key blocks, where [blocks][i] has size
+ * [sizes][i] bytes, all against the same public key [key].  The key is parsed
+ * once and the blocks are hashed together, which is faster than calling
+ * KeyBlockVerify() on each.  Stores the result KeyBlockVerify() would return
+ * for each block in [results][i].
+ *
+ * Returns the number of blocks which verified.
+ */
+int KeyBlockVerifyBatch(const VbKeyBlockHeader * const *blocks,
+			const uint64_t *sizes, int count,
+			const VbPublicKey *key, int hash_only, int *results);
+
+/* Counters for the key block verification cache */
+typedef struct VbKeyBlockCacheStats {
+	uint32_t hits;           /* Signature checks skipped */
+	uint32_t misses;         /* Signature checks done */
+	uint32_t insertions;     /* Key blocks added after a good check */
+	uint32_t evictions;      /* Entries replaced because the cache was full */
+	uint32_t invalidations;  /* Entries removed by KeyBlockCacheInvalidate() */
+} VbKeyBlockCacheStats;
+
+/**
+ * Enable (enable != 0) or disable the key block verification cache, and
+ * clear its contents and counters.  The cache is disabled by default.
+ *
+ * While enabled, KeyBlockVerify() and KeyBlockVerifyBatch() remember key
+ * blocks whose signature has been verified, keyed by a digest of the signing
+ * key and a digest of the signed data and signature, and skip the RSA check
+ * the next time the same key block is checked with the same key.  Hash-only
+ * checks are not cached.  Host builds lock the cache, so it may be used by
+ * several threads at once; firmware builds do not.
+ *
+ * Firmware built with KEY_BLOCK_CACHE enables the cache on the first call to
+ * LoadFirmware() or LoadKernel() and keeps it for the rest of the boot.
+ */
+void KeyBlockCacheEnable(int enable);
+
+/**
+ * Return non-zero if the key block verification cache is enabled.
+ */
+int KeyBlockCacheIsEnabled(void);
+
+/**
+ * Remove key blocks verified with [key] from the cache, or all key blocks if
+ * [key] is NULL.
+ */
+void KeyBlockCacheInvalidate(const VbPublicKey *key);
+
+/**
+ * Copy the cache counters to [stats].
+ */
+void KeyBlockCacheGetStats(VbKeyBlockCacheStats *stats);
 
 /**
  * Check the sanity of a firmware preamble of size [size] bytes, using public
@@ -138,6 +211,17 @@ uint32_t VbGetFirmwarePreambleFlags(const VbFirmwarePreambleHeader *preamble);
 int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 			 uint64_t size, const RSAPublicKey *key);
 
+/**
+ * Check the sanity of [count] kernel preambles, where [preambles][i] has size
+ * [sizes][i] bytes, all using public key [key].  Stores the result
+ * VerifyKernelPreamble() would return for each preamble in [results][i].
+ *
+ * Returns the number of preambles which verified.
+ */
+int VerifyKernelPreambleBatch(const VbKernelPreambleHeader * const *preambles,
+			      const uint64_t *sizes, int count,
+			      const RSAPublicKey *key, int *results);
+
 
 /**
  * Initialize a verified boot shared data structure.
@@ -160,4 +244,12 @@ uint64_t VbSharedDataReserve(VbSharedDataHeader *header, uint64_t size);
 int VbSharedDataSetKernelKey(VbSharedDataHeader *header,
                              const VbPublicKey *src);
 
+/**
+ * Record boot event [event] (see VBSD_TS_*) and its event-specific [data] in
+ * the timestamp ring in the shared data, with the current VbExGetTimer()
+ * value.  Does nothing if [header] is NULL or older than version 3.
+ */
+void VbSharedDataAddTimestamp(VbSharedDataHeader *header, uint32_t event,
+			      uint32_t data);
+
 #endif  /* VBOOT_REFERENCE_VBOOT_COMMON_H_ */
@@ -31,6 +31,12 @@ void VbDoneWithFontForNow(VbFont_t *ptr);
 ImageInfo *VbFindFontGlyph(VbFont_t *font, uint32_t ascii,
 			   void **bufferptr, uint32_t *buffersize);
 
+/**
+ * Forget the bitmap block data found by VbDisplayScreenFromGBB(), so the next
+ * call looks in the GBB again.
+ */
+void VbDisplayFreeBmpfv(void);
+
 /**
  * Try to display the specified text at a particular position.
  */
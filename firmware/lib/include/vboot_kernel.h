@@ -27,6 +27,46 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
  */
 int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata);
 
+/*
+ * Results of reading and checking the headers of one candidate kernel
+ * partition ahead of time, so LoadKernel() can use them instead of reading
+ * and verifying the headers itself.
+ */
+typedef struct KernelPartPrecheck {
+	/* Location of the partition on the disk, in sectors */
+	uint64_t part_start;
+	uint64_t part_size;
+	/* Start of the partition, or NULL if it wasn't read */
+	uint8_t *kbuf;
+	/* VbExDiskRead() result for kbuf */
+	VbError_t read_result;
+	/* KeyBlockVerify() results when checking the signature and hash */
+	int key_block_sig_result;
+	int key_block_hash_result;
+	/* Non-zero if the preamble was checked, and the result */
+	int preamble_checked;
+	int preamble_result;
+} KernelPartPrecheck;
+
+/**
+ * Read and check the headers of every candidate kernel partition in [gpt],
+ * using up to [num_threads] threads.  The first [kbuf_size] bytes of each
+ * partition are read; key blocks are checked with [kernel_subkey].  [gpt]
+ * itself is not changed.
+ *
+ * Only available in host builds with PARALLEL_KERNEL_CHECK.  Returns the
+ * number of partitions checked and points [checks_ptr] at their results,
+ * which must be freed with LoadKernelPrecheckFree().
+ */
+int LoadKernelPrecheck(VbExDiskHandle_t disk_handle, const GptData *gpt,
+		       uint64_t kbuf_size, const VbPublicKey *kernel_subkey,
+		       int num_threads, KernelPartPrecheck **checks_ptr);
+
+/**
+ * Free the results from LoadKernelPrecheck().
+ */
+void LoadKernelPrecheckFree(KernelPartPrecheck *checks, int count);
+
 /**
  * Accessors for unit tests only.
  */
@@ -30,6 +30,18 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
 }
 
 
+uint32_t SetupTPMStart(SetupTPMState* state, int recovery_mode,
+                       int developer_mode, int disable_dev_request,
+                       int clear_tpm_owner_request, RollbackSpaceFirmware* rsf) {
+  return TPM_SUCCESS;
+}
+
+
+uint32_t SetupTPMResume(SetupTPMState* state) {
+  return TPM_SUCCESS;
+}
+
+
 uint32_t RollbackS3Resume(void) {
   return TPM_SUCCESS;
 }
@@ -44,6 +56,21 @@ uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
 }
 
 
+uint32_t RollbackFirmwareSetupStart(RollbackFirmwareSetupState* state,
+                                    int recovery_mode, int is_hw_dev,
+                                    int disable_dev_request,
+                                    int clear_tpm_owner_request) {
+  return TPM_SUCCESS;
+}
+
+
+uint32_t RollbackFirmwareSetupResume(RollbackFirmwareSetupState* state,
+                                     int *is_virt_dev, uint32_t *version) {
+  *version = 0;
+  return TPM_SUCCESS;
+}
+
+
 uint32_t RollbackFirmwareWrite(uint32_t version) {
   return TPM_SUCCESS;
 }
@@ -82,50 +82,97 @@ uint32_t SafeDefineSpace(uint32_t index, uint32_t perm, uint32_t size)
 	}
 }
 
-/* Functions to read and write firmware and kernel spaces. */
-uint32_t ReadSpaceFirmware(RollbackSpaceFirmware *rsf)
+/*
+ * Like SafeWrite(), but through a transaction, so a write of what the space
+ * already holds is skipped.
+ */
+static uint32_t SafeWriteTxn(TlclTransaction *txn, uint32_t index,
+			     const void *data, uint32_t length)
+{
+	uint32_t result = TlclTransactionWrite(txn, index, data, length);
+	if (result == TPM_SUCCESS)
+		result = TlclTransactionCommit(txn);
+	if (result == TPM_E_MAXNVWRITES) {
+		RETURN_ON_FAILURE(TPMClearAndReenable());
+		RETURN_ON_FAILURE(TlclTransactionWrite(txn, index, data,
+						       length));
+		return TlclTransactionCommit(txn);
+	}
+	return result;
+}
+
+/*
+ * Functions to read and write firmware and kernel spaces.  The *Txn versions
+ * go through a transaction shared with the caller, so a read-modify-write
+ * which doesn't change anything costs one TPM command instead of three.
+ */
+
+/*
+ * Check a firmware space just read from the TPM.  Returns TPM_SUCCESS if it's
+ * usable, or TPM_E_CORRUPTED_STATE if its CRC is bad.
+ */
+static uint32_t CheckSpaceFirmware(RollbackSpaceFirmware *rsf)
+{
+	/*
+	 * No CRC in this version, so we'll create one when we write it. Note
+	 * that we're marking this as version 2, not
+	 * ROLLBACK_SPACE_FIRMWARE_VERSION, because version 2 just added the
+	 * CRC. Later versions will need to set default values for any extra
+	 * fields explicitly (probably here).
+	 */
+	if (rsf->struct_version < 2) {
+		/* Danger Will Robinson! Danger! */
+		rsf->struct_version = 2;
+		return TPM_SUCCESS;
+	}
+
+	if (rsf->crc8 == Crc8(rsf, offsetof(RollbackSpaceFirmware, crc8)))
+		return TPM_SUCCESS;
+
+	VBDEBUG(("TPM: %s() - bad CRC\n", __func__));
+	return TPM_E_CORRUPTED_STATE;
+}
+
+static uint32_t ReadSpaceFirmwareTxn(TlclTransaction *txn,
+				     RollbackSpaceFirmware *rsf, int attempts)
 {
 	uint32_t r;
-	int attempts = 3;
 
 	while (attempts--) {
-		r = TlclRead(FIRMWARE_NV_INDEX, rsf,
-			     sizeof(RollbackSpaceFirmware));
+		r = TlclTransactionRead(txn, FIRMWARE_NV_INDEX, rsf,
+					sizeof(RollbackSpaceFirmware));
+		if (r == TPM_SUCCESS)
+			r = TlclTransactionCommit(txn);
 		if (r != TPM_SUCCESS)
 			return r;
 
-		/*
-		 * No CRC in this version, so we'll create one when we write
-		 * it. Note that we're marking this as version 2, not
-		 * ROLLBACK_SPACE_FIRMWARE_VERSION, because version 2 just
-		 * added the CRC. Later versions will need to set default
-		 * values for any extra fields explicitly (probably here).
-		 */
-		if (rsf->struct_version < 2) {
-			/* Danger Will Robinson! Danger! */
-			rsf->struct_version = 2;
-			return TPM_SUCCESS;
-		}
-
 		/*
 		 * If the CRC is good, we're done. If it's bad, try a couple
 		 * more times to see if it gets better before we give up. It
-		 * could just be noise.
+		 * could just be noise, so make sure we really read it again.
 		 */
-		if (rsf->crc8 == Crc8(rsf,
-				      offsetof(RollbackSpaceFirmware, crc8)))
+		if (CheckSpaceFirmware(rsf) == TPM_SUCCESS)
 			return TPM_SUCCESS;
-
-		VBDEBUG(("TPM: %s() - bad CRC\n", __func__));
+		TlclTransactionForget(txn, FIRMWARE_NV_INDEX);
 	}
 
 	VBDEBUG(("TPM: %s() - too many bad CRCs, giving up\n", __func__));
 	return TPM_E_CORRUPTED_STATE;
 }
 
-uint32_t WriteSpaceFirmware(RollbackSpaceFirmware *rsf)
+uint32_t ReadSpaceFirmware(RollbackSpaceFirmware *rsf)
+{
+	TlclTransaction txn;
+
+	TlclTransactionInit(&txn);
+	return ReadSpaceFirmwareTxn(&txn, rsf, 3);
+}
+
+static uint32_t WriteSpaceFirmwareTxn(TlclTransaction *txn,
+				      RollbackSpaceFirmware *rsf)
 {
 	RollbackSpaceFirmware rsf2;
+	uint32_t sent;
 	uint32_t r;
 	int attempts = 3;
 
@@ -135,14 +182,20 @@ uint32_t WriteSpaceFirmware(RollbackSpaceFirmware *rsf)
 	rsf->crc8 = Crc8(rsf, offsetof(RollbackSpaceFirmware, crc8));
 
 	while (attempts--) {
-		r = SafeWrite(FIRMWARE_NV_INDEX, rsf,
-			      sizeof(RollbackSpaceFirmware));
+		sent = txn->commands_sent;
+		r = SafeWriteTxn(txn, FIRMWARE_NV_INDEX, rsf,
+				 sizeof(RollbackSpaceFirmware));
 		/* Can't write, not gonna try again */
 		if (r != TPM_SUCCESS)
 			return r;
 
+		/* Nothing to check if the space already held these values */
+		if (txn->commands_sent == sent)
+			return TPM_SUCCESS;
+
 		/* Read it back to be sure it got the right values. */
-		r = ReadSpaceFirmware(&rsf2);    /* This checks the CRC */
+		TlclTransactionForget(txn, FIRMWARE_NV_INDEX);
+		r = ReadSpaceFirmwareTxn(txn, &rsf2, 3);  /* Checks the CRC */
 		if (r == TPM_SUCCESS)
 			return r;
 
@@ -154,12 +207,22 @@ uint32_t WriteSpaceFirmware(RollbackSpaceFirmware *rsf)
 	return TPM_E_CORRUPTED_STATE;
 }
 
+uint32_t WriteSpaceFirmware(RollbackSpaceFirmware *rsf)
+{
+	TlclTransaction txn;
+
+	TlclTransactionInit(&txn);
+	return WriteSpaceFirmwareTxn(&txn, rsf);
+}
+
 uint32_t SetVirtualDevMode(int val)
 {
 	RollbackSpaceFirmware rsf;
+	TlclTransaction txn;
 
 	VBDEBUG(("TPM: Entering %s()\n", __func__));
-	if (TPM_SUCCESS != ReadSpaceFirmware(&rsf))
+	TlclTransactionInit(&txn);
+	if (TPM_SUCCESS != ReadSpaceFirmwareTxn(&txn, &rsf, 3))
 		return VBERROR_TPM_FIRMWARE_SETUP;
 
 	VBDEBUG(("TPM: flags were 0x%02x\n", rsf.flags));
@@ -173,20 +236,24 @@ uint32_t SetVirtualDevMode(int val)
 	 */
 	VBDEBUG(("TPM: flags are now 0x%02x\n", rsf.flags));
 
-	if (TPM_SUCCESS != WriteSpaceFirmware(&rsf))
+	if (TPM_SUCCESS != WriteSpaceFirmwareTxn(&txn, &rsf))
 		return VBERROR_TPM_SET_BOOT_MODE_STATE;
 
 	VBDEBUG(("TPM: Leaving %s()\n", __func__));
 	return VBERROR_SUCCESS;
 }
 
-uint32_t ReadSpaceKernel(RollbackSpaceKernel *rsk)
+static uint32_t ReadSpaceKernelTxn(TlclTransaction *txn,
+				   RollbackSpaceKernel *rsk)
 {
 	uint32_t r;
 	int attempts = 3;
 
 	while (attempts--) {
-		r = TlclRead(KERNEL_NV_INDEX, rsk, sizeof(RollbackSpaceKernel));
+		r = TlclTransactionRead(txn, KERNEL_NV_INDEX, rsk,
+					sizeof(RollbackSpaceKernel));
+		if (r == TPM_SUCCESS)
+			r = TlclTransactionCommit(txn);
 		if (r != TPM_SUCCESS)
 			return r;
 
@@ -206,21 +273,32 @@ uint32_t ReadSpaceKernel(RollbackSpaceKernel *rsk)
 		/*
 		 * If the CRC is good, we're done. If it's bad, try a couple
 		 * more times to see if it gets better before we give up. It
-		 * could just be noise.
+		 * could just be noise, so make sure we really read it again.
 		 */
 		if (rsk->crc8 == Crc8(rsk, offsetof(RollbackSpaceKernel, crc8)))
 			return TPM_SUCCESS;
 
 		VBDEBUG(("TPM: %s() - bad CRC\n", __func__));
+		TlclTransactionForget(txn, KERNEL_NV_INDEX);
 	}
 
 	VBDEBUG(("TPM: %s() - too many bad CRCs, giving up\n", __func__));
 	return TPM_E_CORRUPTED_STATE;
 }
 
-uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk)
+uint32_t ReadSpaceKernel(RollbackSpaceKernel *rsk)
+{
+	TlclTransaction txn;
+
+	TlclTransactionInit(&txn);
+	return ReadSpaceKernelTxn(&txn, rsk);
+}
+
+static uint32_t WriteSpaceKernelTxn(TlclTransaction *txn,
+				    RollbackSpaceKernel *rsk)
 {
 	RollbackSpaceKernel rsk2;
+	uint32_t sent;
 	uint32_t r;
 	int attempts = 3;
 
@@ -230,14 +308,20 @@ uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk)
 	rsk->crc8 = Crc8(rsk, offsetof(RollbackSpaceKernel, crc8));
 
 	while (attempts--) {
-		r = SafeWrite(KERNEL_NV_INDEX, rsk,
-			      sizeof(RollbackSpaceKernel));
+		sent = txn->commands_sent;
+		r = SafeWriteTxn(txn, KERNEL_NV_INDEX, rsk,
+				 sizeof(RollbackSpaceKernel));
 		/* Can't write, not gonna try again */
 		if (r != TPM_SUCCESS)
 			return r;
 
+		/* Nothing to check if the space already held these values */
+		if (txn->commands_sent == sent)
+			return TPM_SUCCESS;
+
 		/* Read it back to be sure it got the right values. */
-		r = ReadSpaceKernel(&rsk2);    /* This checks the CRC */
+		TlclTransactionForget(txn, KERNEL_NV_INDEX);
+		r = ReadSpaceKernelTxn(txn, &rsk2);  /* Checks the CRC */
 		if (r == TPM_SUCCESS)
 			return r;
 
@@ -249,6 +333,14 @@ uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk)
 	return TPM_E_CORRUPTED_STATE;
 }
 
+uint32_t WriteSpaceKernel(RollbackSpaceKernel *rsk)
+{
+	TlclTransaction txn;
+
+	TlclTransactionInit(&txn);
+	return WriteSpaceKernelTxn(&txn, rsk);
+}
+
 uint32_t OneTimeInitializeTPM(RollbackSpaceFirmware *rsf,
                               RollbackSpaceKernel *rsk)
 {
@@ -323,80 +415,23 @@ uint32_t OneTimeInitializeTPM(RollbackSpaceFirmware *rsf,
 }
 
 
+static uint32_t SetupTPMDone(SetupTPMState *state, uint32_t result)
+{
+	state->phase = SETUP_TPM_PHASE_DONE;
+	state->result = result;
+	return result;
+}
+
 /*
- * SetupTPM starts the TPM and establishes the root of trust for the
- * anti-rollback mechanism.  SetupTPM can fail for three reasons.  1 A bug. 2 a
- * TPM hardware failure. 3 An unexpected TPM state due to some attack.  In
- * general we cannot easily distinguish the kind of failure, so our strategy is
- * to reboot in recovery mode in all cases.  The recovery mode calls SetupTPM
- * again, which executes (almost) the same sequence of operations.  There is a
- * good chance that, if recovery mode was entered because of a TPM failure, the
- * failure will repeat itself.  (In general this is impossible to guarantee
- * because we have no way of creating the exact TPM initial state at the
- * previous boot.)  In recovery mode, we ignore the failure and continue, thus
- * giving the recovery kernel a chance to fix things (that's why we don't set
- * bGlobalLock).  The choice is between a knowingly insecure device and a
- * bricked device.
- *
- * As a side note, observe that we go through considerable hoops to avoid using
- * the STCLEAR permissions for the index spaces.  We do this to avoid writing
- * to the TPM flashram at every reboot or wake-up, because of concerns about
- * the durability of the NVRAM.
+ * Make sure physical presence can be asserted and the TPM is enabled, then
+ * start reading the firmware space.
  */
-uint32_t SetupTPM(int recovery_mode, int developer_mode,
-                  int disable_dev_request, int clear_tpm_owner_request,
-                  RollbackSpaceFirmware* rsf)
+static uint32_t SetupTPMReadStart(SetupTPMState *state)
 {
-	uint8_t in_flags;
 	uint8_t disable;
 	uint8_t deactivated;
 	uint32_t result;
-	uint32_t versions;
-
-	VBDEBUG(("TPM: SetupTPM(r%d, d%d)\n", recovery_mode, developer_mode));
 
-	/* Global variables are usable in recovery mode */
-	if (recovery_mode)
-		g_rollback_recovery_mode = 1;
-
-	RETURN_ON_FAILURE(TlclLibInit());
-
-#ifdef TEGRA_SOFT_REBOOT_WORKAROUND
-	result = TlclStartup();
-	if (result == TPM_E_INVALID_POSTINIT) {
-		/*
-		 * Some prototype hardware doesn't reset the TPM on a CPU
-		 * reset.  We do a hard reset to get around this.
-		 */
-		VBDEBUG(("TPM: soft reset detected\n", result));
-		return TPM_E_MUST_REBOOT;
-	} else if (result != TPM_SUCCESS) {
-		VBDEBUG(("TPM: TlclStartup returned %08x\n", result));
-		return result;
-	}
-#else
-	RETURN_ON_FAILURE(TlclStartup());
-#endif
-
-  /*
-   * Some TPMs start the self test automatically at power on.  In that case we
-   * don't need to call ContinueSelfTest.  On some (other) TPMs,
-   * ContinueSelfTest may block.  In that case, we definitely don't want to
-   * call it here.  For TPMs in the intersection of these two sets, we're
-   * screwed.  (In other words: TPMs that require manually starting the
-   * self-test AND block will have poor performance until we split
-   * TlclSendReceive() into Send() and Receive(), and have a state machine to
-   * control setup.)
-   *
-   * This comment is likely to become obsolete in the near future, so don't
-   * trust it.  It may have not been updated.
-   */
-#ifdef TPM_MANUAL_SELFTEST
-#ifdef TPM_BLOCKING_CONTINUESELFTEST
-#warning "lousy TPM!"
-#endif
-	RETURN_ON_FAILURE(TlclContinueSelfTest());
-#endif
 	result = TlclAssertPhysicalPresence();
 	if (result != TPM_SUCCESS) {
 		/*
@@ -419,8 +454,35 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
 		return TPM_E_MUST_REBOOT;
 	}
 
-	/* Read the firmware space. */
-	result = ReadSpaceFirmware(rsf);
+	/* Start reading the firmware space. */
+	state->phase = SETUP_TPM_PHASE_READ_SPACE;
+	return TlclReadStart(&state->cmd, FIRMWARE_NV_INDEX,
+			     sizeof(RollbackSpaceFirmware));
+}
+
+/* Everything after the firmware space read has finished. */
+static uint32_t SetupTPMFinish(SetupTPMState *state)
+{
+	RollbackSpaceFirmware *rsf = state->rsf;
+	int developer_mode = state->developer_mode;
+	uint8_t in_flags;
+	uint32_t result;
+	uint32_t versions;
+
+	/*
+	 * Get the firmware space.  If the first read was noisy, read it again
+	 * the same number of times ReadSpaceFirmware() would have.
+	 */
+	result = TlclReadFinish(&state->cmd, rsf, sizeof(RollbackSpaceFirmware));
+	if (TPM_SUCCESS == result) {
+		result = CheckSpaceFirmware(rsf);
+		if (TPM_SUCCESS != result) {
+			TlclTransaction txn;
+
+			TlclTransactionInit(&txn);
+			result = ReadSpaceFirmwareTxn(&txn, rsf, 2);
+		}
+	}
 	if (TPM_E_BADINDEX == result) {
 		RollbackSpaceKernel rsk;
 
@@ -440,7 +502,7 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
 	in_flags = rsf->flags;
 
 	/* If we've been asked to clear the virtual dev-mode flag, do so now */
-	if (disable_dev_request) {
+	if (state->disable_dev_request) {
 		rsf->flags &= ~FLAG_VIRTUAL_DEV_MODE_ON;
 		VBDEBUG(("TPM: Clearing virt dev-switch: f%x\n", rsf->flags));
 	}
@@ -462,7 +524,7 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
 	    (in_flags & FLAG_LAST_BOOT_DEVELOPER)) {
 		VBDEBUG(("TPM: Developer flag changed; clearing owner.\n"));
 		RETURN_ON_FAILURE(TPMClearAndReenable());
-	} else if (clear_tpm_owner_request) {
+	} else if (state->clear_tpm_owner_request) {
 		VBDEBUG(("TPM: Clearing owner as specifically requested.\n"));
 		RETURN_ON_FAILURE(TPMClearAndReenable());
 	}
@@ -483,6 +545,133 @@ uint32_t SetupTPM(int recovery_mode, int developer_mode,
 	return TPM_SUCCESS;
 }
 
+/* Start the TPM, and the self test if it needs one. */
+static uint32_t SetupTPMBegin(SetupTPMState *state)
+{
+#ifdef TEGRA_SOFT_REBOOT_WORKAROUND
+	uint32_t result;
+#endif
+
+	RETURN_ON_FAILURE(TlclLibInit());
+
+#ifdef TEGRA_SOFT_REBOOT_WORKAROUND
+	result = TlclStartup();
+	if (result == TPM_E_INVALID_POSTINIT) {
+		/*
+		 * Some prototype hardware doesn't reset the TPM on a CPU
+		 * reset.  We do a hard reset to get around this.
+		 */
+		VBDEBUG(("TPM: soft reset detected\n", result));
+		return TPM_E_MUST_REBOOT;
+	} else if (result != TPM_SUCCESS) {
+		VBDEBUG(("TPM: TlclStartup returned %08x\n", result));
+		return result;
+	}
+#else
+	RETURN_ON_FAILURE(TlclStartup());
+#endif
+
+	/*
+	 * Some TPMs start the self test automatically at power on.  In that
+	 * case we don't need to call ContinueSelfTest.  On others,
+	 * ContinueSelfTest may block until the self test is done; we send it
+	 * split-phase so the caller can get on with other work meanwhile, on
+	 * firmware whose TPM driver supports that.
+	 */
+#ifdef TPM_MANUAL_SELFTEST
+	state->phase = SETUP_TPM_PHASE_SELFTEST;
+	return TlclContinueSelfTestStart(&state->cmd);
+#else
+	return SetupTPMReadStart(state);
+#endif
+}
+
+uint32_t SetupTPMStart(SetupTPMState *state, int recovery_mode,
+		       int developer_mode, int disable_dev_request,
+		       int clear_tpm_owner_request, RollbackSpaceFirmware *rsf)
+{
+	uint32_t result;
+
+	VBDEBUG(("TPM: SetupTPM(r%d, d%d)\n", recovery_mode, developer_mode));
+
+	/* Global variables are usable in recovery mode */
+	if (recovery_mode)
+		g_rollback_recovery_mode = 1;
+
+	Memset(state, 0, sizeof(*state));
+	state->developer_mode = developer_mode;
+	state->disable_dev_request = disable_dev_request;
+	state->clear_tpm_owner_request = clear_tpm_owner_request;
+	state->rsf = rsf;
+
+	result = SetupTPMBegin(state);
+	if (result != TPM_SUCCESS)
+		return SetupTPMDone(state, result);
+	return SetupTPMResume(state);
+}
+
+uint32_t SetupTPMResume(SetupTPMState *state)
+{
+	uint32_t result;
+
+	while (state->phase != SETUP_TPM_PHASE_DONE) {
+		result = TlclCommandPoll(&state->cmd);
+		if (result == TPM_E_COMMAND_PENDING)
+			return result;
+
+		if (state->phase == SETUP_TPM_PHASE_SELFTEST) {
+			if (result == TPM_SUCCESS)
+				result = SetupTPMReadStart(state);
+			if (result != TPM_SUCCESS) {
+				VBDEBUG(("Rollback: %08x returned by setup\n",
+					 (int)result));
+				SetupTPMDone(state, result);
+			}
+		} else {
+			SetupTPMDone(state, SetupTPMFinish(state));
+		}
+	}
+
+	return state->result;
+}
+
+/*
+ * SetupTPM starts the TPM and establishes the root of trust for the
+ * anti-rollback mechanism.  SetupTPM can fail for three reasons.  1 A bug. 2 a
+ * TPM hardware failure. 3 An unexpected TPM state due to some attack.  In
+ * general we cannot easily distinguish the kind of failure, so our strategy is
+ * to reboot in recovery mode in all cases.  The recovery mode calls SetupTPM
+ * again, which executes (almost) the same sequence of operations.  There is a
+ * good chance that, if recovery mode was entered because of a TPM failure, the
+ * failure will repeat itself.  (In general this is impossible to guarantee
+ * because we have no way of creating the exact TPM initial state at the
+ * previous boot.)  In recovery mode, we ignore the failure and continue, thus
+ * giving the recovery kernel a chance to fix things (that's why we don't set
+ * bGlobalLock).  The choice is between a knowingly insecure device and a
+ * bricked device.
+ *
+ * As a side note, observe that we go through considerable hoops to avoid using
+ * the STCLEAR permissions for the index spaces.  We do this to avoid writing
+ * to the TPM flashram at every reboot or wake-up, because of concerns about
+ * the durability of the NVRAM.
+ */
+uint32_t SetupTPM(int recovery_mode, int developer_mode,
+                  int disable_dev_request, int clear_tpm_owner_request,
+                  RollbackSpaceFirmware* rsf)
+{
+	SetupTPMState state;
+	uint32_t result;
+
+	result = SetupTPMStart(&state, recovery_mode, developer_mode,
+			       disable_dev_request, clear_tpm_owner_request,
+			       rsf);
+	while (result == TPM_E_COMMAND_PENDING) {
+		TlclCommandWait(&state.cmd);
+		result = SetupTPMResume(&state);
+	}
+	return result;
+}
+
 
 #ifdef DISABLE_ROLLBACK_TPM
 /* Dummy implementations which don't support TPM rollback protection */
@@ -500,11 +689,14 @@ uint32_t RollbackS3Resume(void)
 	return TPM_SUCCESS;
 }
 
-uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
-                               int disable_dev_request,
-                               int clear_tpm_owner_request,
-                               int *is_virt_dev, uint32_t *version)
+uint32_t RollbackFirmwareSetupStart(RollbackFirmwareSetupState *state,
+                                    int recovery_mode, int is_hw_dev,
+                                    int disable_dev_request,
+                                    int clear_tpm_owner_request)
 {
+	TlclCommand *cmd = &state->setup.cmd;
+
+	Memset(state, 0, sizeof(*state));
 #ifndef CHROMEOS_ENVIRONMENT
 	/*
 	 * Initialize the TPM, but ignores return codes.  In ChromeOS
@@ -512,10 +704,35 @@ uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
 	 */
 	TlclLibInit();
 	TlclStartup();
-	TlclContinueSelfTest();
+	TlclContinueSelfTestStart(cmd);
 #endif
+	if (TlclCommandPoll(cmd) == TPM_E_COMMAND_PENDING)
+		return TPM_E_COMMAND_PENDING;
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackFirmwareSetupResume(RollbackFirmwareSetupState *state,
+                                     int *is_virt_dev, uint32_t *version)
+{
 	*is_virt_dev = 0;
 	*version = 0;
+	if (TlclCommandPoll(&state->setup.cmd) == TPM_E_COMMAND_PENDING)
+		return TPM_E_COMMAND_PENDING;
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
+                               int disable_dev_request,
+                               int clear_tpm_owner_request,
+                               int *is_virt_dev, uint32_t *version)
+{
+	RollbackFirmwareSetupState state;
+
+	RollbackFirmwareSetupStart(&state, recovery_mode, is_hw_dev,
+				   disable_dev_request, clear_tpm_owner_request);
+	while (RollbackFirmwareSetupResume(&state, is_virt_dev, version) ==
+	       TPM_E_COMMAND_PENDING)
+		TlclCommandWait(&state.setup.cmd);
 	return TPM_SUCCESS;
 }
 
@@ -562,36 +779,65 @@ uint32_t RollbackS3Resume(void)
 	return result;
 }
 
-uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
-                               int disable_dev_request,
-                               int clear_tpm_owner_request,
-                               int *is_virt_dev, uint32_t *version)
+uint32_t RollbackFirmwareSetupStart(RollbackFirmwareSetupState *state,
+                                    int recovery_mode, int is_hw_dev,
+                                    int disable_dev_request,
+                                    int clear_tpm_owner_request)
 {
-	RollbackSpaceFirmware rsf;
+	return SetupTPMStart(&state->setup, recovery_mode, is_hw_dev,
+			     disable_dev_request, clear_tpm_owner_request,
+			     &state->rsf);
+}
+
+uint32_t RollbackFirmwareSetupResume(RollbackFirmwareSetupState *state,
+                                     int *is_virt_dev, uint32_t *version)
+{
+	uint32_t result;
 
 	/* Set version to 0 in case we fail */
 	*version = 0;
 
-	RETURN_ON_FAILURE(SetupTPM(recovery_mode, is_hw_dev,
-				   disable_dev_request,
-				   clear_tpm_owner_request, &rsf));
-	Memcpy(version, &rsf.fw_versions, sizeof(*version));
-	*is_virt_dev = (rsf.flags & FLAG_VIRTUAL_DEV_MODE_ON) ? 1 : 0;
+	result = SetupTPMResume(&state->setup);
+	if (result != TPM_SUCCESS)
+		return result;
+	Memcpy(version, &state->rsf.fw_versions, sizeof(*version));
+	*is_virt_dev = (state->rsf.flags & FLAG_VIRTUAL_DEV_MODE_ON) ? 1 : 0;
 	VBDEBUG(("TPM: RollbackFirmwareSetup %x\n", (int)*version));
 	return TPM_SUCCESS;
 }
 
+uint32_t RollbackFirmwareSetup(int recovery_mode, int is_hw_dev,
+                               int disable_dev_request,
+                               int clear_tpm_owner_request,
+                               int *is_virt_dev, uint32_t *version)
+{
+	RollbackFirmwareSetupState state;
+	uint32_t result;
+
+	RollbackFirmwareSetupStart(&state, recovery_mode, is_hw_dev,
+				   disable_dev_request, clear_tpm_owner_request);
+	for (;;) {
+		result = RollbackFirmwareSetupResume(&state, is_virt_dev,
+						     version);
+		if (result != TPM_E_COMMAND_PENDING)
+			return result;
+		TlclCommandWait(&state.setup.cmd);
+	}
+}
+
 uint32_t RollbackFirmwareWrite(uint32_t version)
 {
 	RollbackSpaceFirmware rsf;
+	TlclTransaction txn;
 	uint32_t old_version;
 
-	RETURN_ON_FAILURE(ReadSpaceFirmware(&rsf));
+	TlclTransactionInit(&txn);
+	RETURN_ON_FAILURE(ReadSpaceFirmwareTxn(&txn, &rsf, 3));
 	Memcpy(&old_version, &rsf.fw_versions, sizeof(old_version));
 	VBDEBUG(("TPM: RollbackFirmwareWrite %x --> %x\n", (int)old_version,
 		 (int)version));
 	Memcpy(&rsf.fw_versions, &version, sizeof(version));
-	return WriteSpaceFirmware(&rsf);
+	return WriteSpaceFirmwareTxn(&txn, &rsf);
 }
 
 uint32_t RollbackFirmwareLock(void)
@@ -626,13 +872,16 @@ uint32_t RollbackKernelRead(uint32_t* version)
 uint32_t RollbackKernelWrite(uint32_t version)
 {
 	RollbackSpaceKernel rsk;
+	TlclTransaction txn;
 	uint32_t old_version;
-	RETURN_ON_FAILURE(ReadSpaceKernel(&rsk));
+
+	TlclTransactionInit(&txn);
+	RETURN_ON_FAILURE(ReadSpaceKernelTxn(&txn, &rsk));
 	Memcpy(&old_version, &rsk.kernel_versions, sizeof(old_version));
 	VBDEBUG(("TPM: RollbackKernelWrite %x --> %x\n",
 		 (int)old_version, (int)version));
 	Memcpy(&rsk.kernel_versions, &version, sizeof(version));
-	return WriteSpaceKernel(&rsk);
+	return WriteSpaceKernelTxn(&txn, &rsk);
 }
 
 uint32_t RollbackKernelLock(void)
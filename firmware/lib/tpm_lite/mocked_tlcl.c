@@ -166,3 +166,30 @@ uint32_t TlclSendReceive(const uint8_t* request, uint8_t* response,
 {
   return TPM_SUCCESS;
 }
+
+uint32_t TlclCommandSubmit(TlclCommand* cmd) {
+  cmd->result = TPM_SUCCESS;
+  cmd->state = TLCL_COMMAND_DONE;
+  return TPM_SUCCESS;
+}
+
+uint32_t TlclCommandPoll(TlclCommand* cmd) {
+  return cmd->result;
+}
+
+uint32_t TlclCommandWait(TlclCommand* cmd) {
+  return cmd->result;
+}
+
+uint32_t TlclContinueSelfTestStart(TlclCommand* cmd) {
+  return TlclCommandSubmit(cmd);
+}
+
+uint32_t TlclReadStart(TlclCommand* cmd, uint32_t index, uint32_t length) {
+  return TlclCommandSubmit(cmd);
+}
+
+uint32_t TlclReadFinish(TlclCommand* cmd, void* data, uint32_t length) {
+  Memset(data, '\0', length);
+  return TPM_SUCCESS;
+}
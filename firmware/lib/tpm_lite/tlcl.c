@@ -136,6 +136,88 @@ uint32_t TlclSendReceive(const uint8_t* request, uint8_t* response,
   return result;
 }
 
+/* Split-phase commands.  These let the caller overlap slow TPM commands (the
+ * self test, NVRAM reads) with other work, on firmware whose TPM driver
+ * supports sending a request and collecting the response separately. */
+
+uint32_t TlclCommandSubmit(TlclCommand* cmd) {
+  VbError_t rv;
+
+  cmd->result = TPM_SUCCESS;
+  rv = VbExTpmSendRequest(cmd->request, TpmCommandSize(cmd->request));
+  if (VBERROR_NO_ASYNC_TPM == rv) {
+    /* No split transactions; just run the command now */
+    if (cmd->no_retry)
+      cmd->result = TlclSendReceiveNoRetry(cmd->request, cmd->response,
+                                           sizeof(cmd->response));
+    else
+      cmd->result = TlclSendReceive(cmd->request, cmd->response,
+                                    sizeof(cmd->response));
+    cmd->state = TLCL_COMMAND_DONE;
+    return TPM_SUCCESS;
+  } else if (VBERROR_SUCCESS != rv) {
+    VBDEBUG(("TPM: command 0x%x send failed: 0x%x\n",
+             TpmCommandCode(cmd->request), rv));
+    cmd->result = rv;
+    cmd->state = TLCL_COMMAND_DONE;
+    return rv;
+  }
+
+  cmd->state = TLCL_COMMAND_PENDING;
+  return TPM_SUCCESS;
+}
+
+/* Collects the response to [cmd], waiting up to [timeout_ms] for it. */
+static uint32_t CommandReceive(TlclCommand* cmd, uint32_t timeout_ms) {
+  uint32_t response_length = sizeof(cmd->response);
+  VbError_t rv;
+
+  if (TLCL_COMMAND_PENDING != cmd->state)
+    return cmd->result;
+
+  rv = VbExTpmGetResponse(cmd->response, &response_length, timeout_ms);
+  if (VBERROR_TPM_RESPONSE_PENDING == rv)
+    return TPM_E_COMMAND_PENDING;
+
+  cmd->state = TLCL_COMMAND_DONE;
+  if (VBERROR_SUCCESS != rv) {
+    /* Communication with TPM failed, so response is garbage */
+    VBDEBUG(("TPM: command 0x%x receive failed: 0x%x\n",
+             TpmCommandCode(cmd->request), rv));
+    cmd->result = rv;
+    return rv;
+  }
+  cmd->result = TpmReturnCode(cmd->response);
+  VBDEBUG(("TPM: command 0x%x returned 0x%x\n",
+           TpmCommandCode(cmd->request), cmd->result));
+
+#ifndef CHROMEOS_ENVIRONMENT
+  /* Same as TlclSendReceive(): if the self test hadn't finished, wait for it
+   * and reissue the command.  The TPM is idle now, so this can block. */
+  if (!cmd->no_retry && (cmd->result == TPM_E_NEEDS_SELFTEST ||
+                         cmd->result == TPM_E_DOING_SELFTEST))
+    cmd->result = TlclSendReceive(cmd->request, cmd->response,
+                                  sizeof(cmd->response));
+#endif
+  return cmd->result;
+}
+
+uint32_t TlclCommandPoll(TlclCommand* cmd) {
+  return CommandReceive(cmd, 0);
+}
+
+uint32_t TlclCommandWait(TlclCommand* cmd) {
+  uint32_t result = CommandReceive(cmd, TLCL_COMMAND_TIMEOUT_MS);
+
+  if (result != TPM_E_COMMAND_PENDING)
+    return result;
+
+  VBDEBUG(("TPM: command 0x%x timed out\n", TpmCommandCode(cmd->request)));
+  cmd->result = TPM_E_COMMAND_TIMEOUT;
+  cmd->state = TLCL_COMMAND_DONE;
+  return cmd->result;
+}
+
 /* Sends a command and returns the error code. */
 static uint32_t Send(const uint8_t* command) {
   uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
@@ -180,6 +262,15 @@ uint32_t TlclContinueSelfTest(void) {
                                 response, sizeof(response));
 }
 
+uint32_t TlclContinueSelfTestStart(TlclCommand* cmd) {
+  VBDEBUG(("TPM: Continue self test (split)\n"));
+  Memcpy(cmd->request, tpm_continueselftest_cmd.buffer,
+         sizeof(tpm_continueselftest_cmd.buffer));
+  /* As in TlclContinueSelfTest(), don't retry. */
+  cmd->no_retry = 1;
+  return TlclCommandSubmit(cmd);
+}
+
 uint32_t TlclDefineSpace(uint32_t index, uint32_t perm, uint32_t size) {
   struct s_tpm_nv_definespace_cmd cmd;
   VBDEBUG(("TPM: TlclDefineSpace(0x%x, 0x%x, %d)\n", index, perm, size));
@@ -230,6 +321,33 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length) {
   return result;
 }
 
+uint32_t TlclReadStart(TlclCommand* cmd, uint32_t index, uint32_t length) {
+  VBDEBUG(("TPM: TlclReadStart(0x%x, %d)\n", index, length));
+  Memcpy(cmd->request, tpm_nv_read_cmd.buffer,
+         sizeof(tpm_nv_read_cmd.buffer));
+  ToTpmUint32(cmd->request + tpm_nv_read_cmd.index, index);
+  ToTpmUint32(cmd->request + tpm_nv_read_cmd.length, length);
+  cmd->no_retry = 0;
+  return TlclCommandSubmit(cmd);
+}
+
+uint32_t TlclReadFinish(TlclCommand* cmd, void* data, uint32_t length) {
+  uint32_t result_length;
+  uint32_t result;
+
+  result = TlclCommandWait(cmd);
+  if (result == TPM_SUCCESS && length > 0) {
+    uint8_t* nv_read_cursor = cmd->response + kTpmResponseHeaderLength;
+    FromTpmUint32(nv_read_cursor, &result_length);
+    nv_read_cursor += sizeof(uint32_t);
+    if (result_length > length)
+      result_length = length;
+    Memcpy(data, nv_read_cursor, result_length);
+  }
+
+  return result;
+}
+
 uint32_t TlclPCRRead(uint32_t index, void* data, uint32_t length) {
   struct s_tpm_pcr_read_cmd cmd;
   uint8_t response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
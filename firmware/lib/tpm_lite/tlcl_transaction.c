@@ -0,0 +1,263 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* NVRAM transactions on top of the TPM lite library.
+ *
+ * Each TPM command costs milliseconds on the slower TPM buses, so rather than
+ * sending every NV read, write and lock as the caller asks for it, these
+ * functions queue them up and, at commit time, leave out the ones whose
+ * effect is already known.
+ */
+
+#include "sysincludes.h"
+
+#include "tlcl.h"
+#include "utility.h"
+
+/* Finds what we know about the space at [index].  If there's no entry for it
+ * and [create] is set, makes one, evicting the oldest unlocked entry if
+ * needed.  Locked entries are kept, since forgetting a lock would let the
+ * cache answer for a space the TPM would refuse; if every entry is locked,
+ * returns NULL. */
+static TlclTransactionSpace* FindSpace(TlclTransaction* txn, uint32_t index,
+                                       int create) {
+  TlclTransactionSpace* space;
+  int i;
+
+  for (i = 0; i < txn->num_spaces; i++) {
+    if (txn->spaces[i].index == index)
+      return txn->spaces + i;
+  }
+  if (!create)
+    return NULL;
+
+  if (txn->num_spaces == TLCL_TXN_MAX_SPACES) {
+    for (i = 0; i < txn->num_spaces; i++) {
+      if (!txn->spaces[i].read_locked && !txn->spaces[i].write_locked)
+        break;
+    }
+    if (i == txn->num_spaces)
+      return NULL;
+    for (i++; i < txn->num_spaces; i++)
+      txn->spaces[i - 1] = txn->spaces[i];
+    txn->num_spaces--;
+  }
+  space = txn->spaces + txn->num_spaces++;
+  Memset(space, 0, sizeof(*space));
+  space->index = index;
+  return space;
+}
+
+/* Records that the first [length] bytes of the space at [index] hold
+ * [data]. */
+static void Remember(TlclTransaction* txn, uint32_t index, const void* data,
+                     uint32_t length) {
+  TlclTransactionSpace* space;
+
+  if (length > TLCL_TXN_MAX_DATA) {
+    TlclTransactionForget(txn, index);
+    return;
+  }
+  space = FindSpace(txn, index, 1);
+  if (!space)
+    return;
+  Memcpy(space->data, data, length);
+  if (length > space->length)
+    space->length = length;
+}
+
+static uint32_t CommitRead(TlclTransaction* txn, TlclTransactionOp* op) {
+  TlclTransactionSpace* space = FindSpace(txn, op->index, 0);
+  uint32_t result;
+
+  /* The TPM refuses reads of a read-locked space, so let it answer those */
+  if (space && !space->read_locked && op->length &&
+      op->length <= space->length) {
+    Memcpy(op->read_data, space->data, op->length);
+    txn->commands_saved++;
+    return TPM_SUCCESS;
+  }
+
+  txn->commands_sent++;
+  result = TlclRead(op->index, op->read_data, op->length);
+  if (result == TPM_SUCCESS)
+    Remember(txn, op->index, op->read_data, op->length);
+  return result;
+}
+
+static uint32_t CommitWrite(TlclTransaction* txn, int op_num) {
+  TlclTransactionOp* op = txn->ops + op_num;
+  TlclTransactionSpace* space = FindSpace(txn, op->index, 0);
+  uint32_t result;
+  int i;
+
+  /* The TPM refuses writes to a locked space, so let it answer those */
+  if (txn->global_locked || (space && space->write_locked))
+    goto send;
+
+  /* Skip writing what's already there */
+  if (space && op->length && op->length <= space->length &&
+      !SafeMemcmp(space->data, op->write_data, op->length)) {
+    txn->commands_saved++;
+    return TPM_SUCCESS;
+  }
+
+  /* Skip writes which a later one in this commit completely overwrites,
+   * unless something may look at or lock the space in between. */
+  for (i = op_num + 1; i < txn->num_ops; i++) {
+    TlclTransactionOp* later = txn->ops + i;
+    if (later->type == TLCL_TXN_GLOBAL_LOCK)
+      break;
+    if (later->index != op->index)
+      continue;
+    if (later->type != TLCL_TXN_WRITE)
+      break;
+    if (op->length && later->length >= op->length) {
+      txn->commands_saved++;
+      return TPM_SUCCESS;
+    }
+  }
+
+send:
+  txn->commands_sent++;
+  result = TlclWrite(op->index, op->write_data, op->length);
+  if (result == TPM_SUCCESS)
+    Remember(txn, op->index, op->write_data, op->length);
+  return result;
+}
+
+static uint32_t CommitLock(TlclTransaction* txn, TlclTransactionOp* op) {
+  TlclTransactionSpace* space = NULL;
+  int* locked = NULL;
+  uint32_t result;
+
+  if (op->type == TLCL_TXN_GLOBAL_LOCK) {
+    locked = &txn->global_locked;
+  } else {
+    /* If there's no room to record the lock, just send it */
+    space = FindSpace(txn, op->index, 1);
+    if (space)
+      locked = (op->type == TLCL_TXN_READ_LOCK ?
+                &space->read_locked : &space->write_locked);
+  }
+
+  if (locked && *locked) {
+    txn->commands_saved++;
+    return TPM_SUCCESS;
+  }
+
+  txn->commands_sent++;
+  if (op->type == TLCL_TXN_GLOBAL_LOCK)
+    result = TlclSetGlobalLock();
+  else if (op->type == TLCL_TXN_READ_LOCK)
+    result = TlclReadLock(op->index);
+  else
+    result = TlclWriteLock(op->index);
+  if (result == TPM_SUCCESS && locked)
+    *locked = 1;
+  return result;
+}
+
+/* Adds an operation to the queue, committing the queue first if it's
+ * full. */
+static uint32_t Queue(TlclTransaction* txn, int type, uint32_t index,
+                      uint32_t length, TlclTransactionOp** op_ptr) {
+  TlclTransactionOp* op;
+
+  if (txn->num_ops == TLCL_TXN_MAX_OPS) {
+    uint32_t result = TlclTransactionCommit(txn);
+    if (result != TPM_SUCCESS)
+      return result;
+  }
+
+  op = txn->ops + txn->num_ops++;
+  Memset(op, 0, sizeof(*op));
+  op->type = type;
+  op->index = index;
+  op->length = length;
+  if (op_ptr)
+    *op_ptr = op;
+  return TPM_SUCCESS;
+}
+
+void TlclTransactionInit(TlclTransaction* txn) {
+  Memset(txn, 0, sizeof(*txn));
+}
+
+uint32_t TlclTransactionRead(TlclTransaction* txn, uint32_t index,
+                             void* data, uint32_t length) {
+  TlclTransactionOp* op;
+  uint32_t result = Queue(txn, TLCL_TXN_READ, index, length, &op);
+
+  if (result == TPM_SUCCESS)
+    op->read_data = data;
+  return result;
+}
+
+uint32_t TlclTransactionWrite(TlclTransaction* txn, uint32_t index,
+                              const void* data, uint32_t length) {
+  TlclTransactionOp* op;
+  uint32_t result;
+
+  if (length > TLCL_TXN_MAX_DATA) {
+    /* Too big to queue, so do it now, in order. */
+    result = TlclTransactionCommit(txn);
+    if (result != TPM_SUCCESS)
+      return result;
+    TlclTransactionForget(txn, index);
+    txn->commands_sent++;
+    return TlclWrite(index, data, length);
+  }
+
+  result = Queue(txn, TLCL_TXN_WRITE, index, length, &op);
+  if (result == TPM_SUCCESS)
+    Memcpy(op->write_data, data, length);
+  return result;
+}
+
+uint32_t TlclTransactionReadLock(TlclTransaction* txn, uint32_t index) {
+  return Queue(txn, TLCL_TXN_READ_LOCK, index, 0, NULL);
+}
+
+uint32_t TlclTransactionWriteLock(TlclTransaction* txn, uint32_t index) {
+  return Queue(txn, TLCL_TXN_WRITE_LOCK, index, 0, NULL);
+}
+
+uint32_t TlclTransactionSetGlobalLock(TlclTransaction* txn) {
+  return Queue(txn, TLCL_TXN_GLOBAL_LOCK, TPM_NV_INDEX0, 0, NULL);
+}
+
+uint32_t TlclTransactionCommit(TlclTransaction* txn) {
+  uint32_t result = TPM_SUCCESS;
+  int i;
+
+  for (i = 0; i < txn->num_ops && result == TPM_SUCCESS; i++) {
+    TlclTransactionOp* op = txn->ops + i;
+    if (op->type == TLCL_TXN_READ)
+      result = CommitRead(txn, op);
+    else if (op->type == TLCL_TXN_WRITE)
+      result = CommitWrite(txn, i);
+    else
+      result = CommitLock(txn, op);
+  }
+  txn->num_ops = 0;
+
+  if (result != TPM_SUCCESS) {
+    /* We no longer know what the TPM holds */
+    for (i = 0; i < txn->num_spaces; i++)
+      txn->spaces[i].length = 0;
+  }
+
+  VBDEBUG(("TPM: transaction has sent %d commands, saved %d\n",
+           (int)txn->commands_sent, (int)txn->commands_saved));
+  return result;
+}
+
+void TlclTransactionForget(TlclTransaction* txn, uint32_t index) {
+  TlclTransactionSpace* space = FindSpace(txn, index, 0);
+
+  if (space)
+    space->length = 0;
+}
@@ -63,6 +63,7 @@ VbError_t VbSelectFirmware(VbCommonParams *cparams,
 		}
 
 		/* Update TPM if necessary */
+		VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_FIRMWARE_START, 0);
 		if (shared->fw_version_tpm_start < shared->fw_version_tpm) {
 			tpm_status =
 				RollbackFirmwareWrite(shared->fw_version_tpm);
@@ -77,6 +78,7 @@ VbError_t VbSelectFirmware(VbCommonParams *cparams,
 
 		/* Lock firmware versions in TPM */
 		tpm_status = RollbackFirmwareLock();
+		VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_FIRMWARE_END, 0);
 		if (0 != tpm_status) {
 			VBDEBUG(("Unable to lock firmware version in TPM.\n"));
 			VbNvSet(&vnc, VBNV_RECOVERY_REQUEST,
@@ -175,11 +175,13 @@ VbError_t VbInit(VbCommonParams *cparams, VbInitParams *iparams)
 		 * TPM space is initialized by this call, the virtual
 		 * dev-switch will be disabled by default)
 		 */
+		VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_SETUP_START, 0);
 		tpm_status = RollbackFirmwareSetup(recovery, is_hw_dev,
 						   disable_dev_request,
 						   clear_tpm_owner_request,
 						   /* two outputs on success */
 						   &is_virt_dev, &tpm_version);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_SETUP_END, 0);
 
 		if (0 != tpm_status) {
 			VBDEBUG(("Unable to setup TPM and read "
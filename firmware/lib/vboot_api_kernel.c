@@ -851,13 +851,17 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 
 	/* Do EC software sync if necessary */
 	if (shared->flags & VBSD_EC_SOFTWARE_SYNC) {
+		VbSharedDataAddTimestamp(shared, VBSD_TS_EC_SYNC_START, 0);
 		retval = VbEcSoftwareSync(cparams);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_EC_SYNC_END, 0);
 		if (retval != VBERROR_SUCCESS)
 			goto VbSelectAndLoadKernel_exit;
 	}
 
 	/* Read kernel version from the TPM.  Ignore errors in recovery mode. */
+	VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_KERNEL_READ_START, 0);
 	tpm_status = RollbackKernelRead(&shared->kernel_version_tpm);
+	VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_KERNEL_READ_END, 0);
 	if (0 != tpm_status) {
 		VBDEBUG(("Unable to get kernel versions from TPM\n"));
 		if (!shared->recovery_reason) {
@@ -962,8 +966,13 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 				 "advancing\n"));
 			if (shared->kernel_version_tpm >
 			    shared->kernel_version_tpm_start) {
+				VbSharedDataAddTimestamp(
+					shared, VBSD_TS_TPM_KERNEL_WRITE_START,
+					0);
 				tpm_status = RollbackKernelWrite(
 						shared->kernel_version_tpm);
+				VbSharedDataAddTimestamp(
+					shared, VBSD_TS_TPM_KERNEL_WRITE_END, 0);
 				if (0 != tpm_status) {
 					VBDEBUG(("Error writing kernel "
 						 "versions to TPM.\n"));
@@ -987,7 +996,9 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 	       sizeof(kparams->partition_guid));
 
 	/* Lock the kernel versions.  Ignore errors in recovery mode. */
+	VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_KERNEL_LOCK_START, 0);
 	tpm_status = RollbackKernelLock();
+	VbSharedDataAddTimestamp(shared, VBSD_TS_TPM_KERNEL_LOCK_END, 0);
 	if (0 != tpm_status) {
 		VBDEBUG(("Error locking kernel versions.\n"));
 		if (!shared->recovery_reason) {
@@ -8,6 +8,10 @@
 
 #include "sysincludes.h"
 
+#ifdef KEY_BLOCK_CACHE_LOCK
+#include <pthread.h>
+#endif
+
 #include "vboot_api.h"
 #include "vboot_common.h"
 #include "utility.h"
@@ -120,20 +124,32 @@ int PublicKeyCopy(VbPublicKey *dest, const VbPublicKey *src)
 	return 0;
 }
 
-RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
+/**
+ * Check that [key] has a valid algorithm and a key size which matches it.
+ * Returns 0 if so, 1 if error.
+ */
+static int PublicKeyCheckSize(const VbPublicKey *key)
 {
-	RSAPublicKey *rsa;
 	uint64_t key_size;
 
 	if (kNumAlgorithms <= key->algorithm) {
 		VBDEBUG(("Invalid algorithm.\n"));
-		return NULL;
+		return 1;
 	}
 	if (!RSAProcessedKeySize(key->algorithm, &key_size) ||
 	    key_size != key->key_size) {
 		VBDEBUG(("Wrong key size for algorithm\n"));
-		return NULL;
+		return 1;
 	}
+	return 0;
+}
+
+RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
+{
+	RSAPublicKey *rsa;
+
+	if (PublicKeyCheckSize(key))
+		return NULL;
 
 	rsa = RSAPublicKeyFromBuf(GetPublicKeyDataC(key), key->key_size);
 	if (!rsa)
@@ -143,8 +159,29 @@ RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
 	return rsa;
 }
 
-int VerifyData(const uint8_t *data, uint64_t size, const VbSignature *sig,
-               const RSAPublicKey *key)
+RSAPublicKey *PublicKeyToRSAView(const VbPublicKey *key,
+				 RSAPublicKey *storage)
+{
+	RSAPublicKey *rsa;
+
+	if (PublicKeyCheckSize(key))
+		return NULL;
+
+	rsa = RSAPublicKeyView(storage, GetPublicKeyDataC(key),
+			       key->key_size);
+	if (!rsa)
+		return NULL;
+
+	rsa->algorithm = (unsigned int)key->algorithm;
+	return rsa;
+}
+
+/**
+ * Check that [sig] is the right size for [key] and covers no more than [size]
+ * bytes of data.  Returns 0 if so.
+ */
+static int VerifyDataPrecheck(uint64_t size, const VbSignature *sig,
+			      const RSAPublicKey *key)
 {
 	if (sig->sig_size != siglen_map[key->algorithm]) {
 		VBDEBUG(("Wrong signature size for algorithm.\n"));
@@ -154,6 +191,14 @@ int VerifyData(const uint8_t *data, uint64_t size, const VbSignature *sig,
 		VBDEBUG(("Data buffer smaller than length of signed data.\n"));
 		return 1;
 	}
+	return 0;
+}
+
+int VerifyData(const uint8_t *data, uint64_t size, const VbSignature *sig,
+               const RSAPublicKey *key)
+{
+	if (VerifyDataPrecheck(size, sig, key))
+		return 1;
 
 	if (!RSAVerifyBinary_f(NULL, key, data, sig->data_size,
 			       GetSignatureDataC(sig), key->algorithm))
@@ -178,12 +223,15 @@ int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
 	return 0;
 }
 
-int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
-                   const VbPublicKey *key, int hash_only)
+/**
+ * Sanity checks on a key block before its hash or signature is checked.
+ * Returns VBOOT_SUCCESS if the block is worth checking.
+ */
+static int KeyBlockPrecheck(const VbKeyBlockHeader *block, uint64_t size,
+			    const VbPublicKey *key, int hash_only)
 {
 	const VbSignature *sig;
 
-	/* Sanity checks before attempting signature of data */
 	if(size < sizeof(VbKeyBlockHeader)) {
 		VBDEBUG(("Not enough space for key block header.\n"));
 		return VBOOT_KEY_BLOCK_INVALID;
@@ -205,19 +253,8 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		return VBOOT_PUBLIC_KEY_INVALID;
 	}
 
-	/*
-	 * Check signature or hash, depending on the hash_only parameter. Note
-	 * that we don't require a key even if the keyblock has a signature,
-	 * because the caller may not care if the keyblock itself is signed
-	 * (for example, booting a Google-signed kernel in developer mode).
-	 */
 	if (hash_only) {
-		/* Check hash */
-		uint8_t *header_checksum = NULL;
-		int rv;
-
 		sig = &block->key_block_checksum;
-
 		if (VerifySignatureInside(block, block->key_block_size, sig)) {
 			VBDEBUG(("Key block hash off end of block\n"));
 			return VBOOT_KEY_BLOCK_INVALID;
@@ -226,12 +263,307 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 			VBDEBUG(("Wrong hash size for key block.\n"));
 			return VBOOT_KEY_BLOCK_INVALID;
 		}
-
-		/* Make sure advertised signature data sizes are sane. */
-		if (block->key_block_size < sig->data_size) {
-			VBDEBUG(("Signature calculated past end of block\n"));
+	} else {
+		sig = &block->key_block_signature;
+		if (VerifySignatureInside(block, block->key_block_size, sig)) {
+			VBDEBUG(("Key block signature off end of block\n"));
 			return VBOOT_KEY_BLOCK_INVALID;
 		}
+	}
+
+	return VBOOT_SUCCESS;
+}
+
+/**
+ * Make sure the advertised signed data size of key block [block] is sane.
+ * Returns VBOOT_SUCCESS if so.
+ */
+static int KeyBlockCheckDataSize(const VbKeyBlockHeader *block,
+				 const VbSignature *sig)
+{
+	if (block->key_block_size < sig->data_size) {
+		VBDEBUG(("Signature calculated past end of block\n"));
+		return VBOOT_KEY_BLOCK_INVALID;
+	}
+	return VBOOT_SUCCESS;
+}
+
+/**
+ * Checks on a key block after its hash or signature [sig] has been verified.
+ * Returns VBOOT_SUCCESS if the block is good.
+ */
+static int KeyBlockPostcheck(const VbKeyBlockHeader *block,
+			     const VbSignature *sig)
+{
+	/* Verify we signed enough data */
+	if (sig->data_size < sizeof(VbKeyBlockHeader)) {
+		VBDEBUG(("Didn't sign enough data\n"));
+		return VBOOT_KEY_BLOCK_INVALID;
+	}
+
+	/* Verify data key is inside the block and inside signed data */
+	if (VerifyPublicKeyInside(block, block->key_block_size,
+				  &block->data_key)) {
+		VBDEBUG(("Data key off end of key block\n"));
+		return VBOOT_KEY_BLOCK_INVALID;
+	}
+	if (VerifyPublicKeyInside(block, sig->data_size, &block->data_key)) {
+		VBDEBUG(("Data key off end of signed data\n"));
+		return VBOOT_KEY_BLOCK_INVALID;
+	}
+
+	return VBOOT_SUCCESS;
+}
+
+#ifndef KEY_BLOCK_CACHE_ENTRIES
+#define KEY_BLOCK_CACHE_ENTRIES 8
+#endif
+
+/* A key block whose signature has been verified with a public key */
+typedef struct KeyBlockCacheEntry {
+	uint8_t key_digest[SHA256_DIGEST_SIZE];
+	uint8_t block_digest[SHA256_DIGEST_SIZE];
+	uint32_t last_used;  /* 0 if the entry is empty */
+} KeyBlockCacheEntry;
+
+static KeyBlockCacheEntry key_block_cache[KEY_BLOCK_CACHE_ENTRIES];
+static VbKeyBlockCacheStats key_block_cache_stats;
+static uint32_t key_block_cache_clock;
+static int key_block_cache_enabled;
+
+/*
+ * Host builds verify key blocks from several threads at once (see
+ * vboot_kernel_parallel.c), so the cache state is kept under a lock there.
+ * Firmware is single-threaded and needs none.
+ */
+#ifdef KEY_BLOCK_CACHE_LOCK
+static pthread_mutex_t key_block_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define KeyBlockCacheLock() pthread_mutex_lock(&key_block_cache_lock)
+#define KeyBlockCacheUnlock() pthread_mutex_unlock(&key_block_cache_lock)
+#else
+#define KeyBlockCacheLock()
+#define KeyBlockCacheUnlock()
+#endif
+
+/**
+ * Digest the parts of a public key which affect signature checks.
+ */
+static void KeyBlockCacheKeyDigest(const VbPublicKey *key, uint8_t *digest)
+{
+	SHA256_CTX ctx;
+
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, (const uint8_t *)&key->algorithm,
+		      sizeof(key->algorithm));
+	SHA256_update(&ctx, GetPublicKeyDataC(key), (uint32_t)key->key_size);
+	Memcpy(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
+}
+
+/**
+ * Digest the signed data of a key block and its signature [sig].  The block
+ * must have passed KeyBlockPrecheck() and KeyBlockCheckDataSize().
+ */
+static void KeyBlockCacheBlockDigest(const VbKeyBlockHeader *block,
+				     const VbSignature *sig, uint8_t *digest)
+{
+	SHA256_CTX ctx;
+
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, (const uint8_t *)block, (uint32_t)sig->data_size);
+	SHA256_update(&ctx, GetSignatureDataC(sig), (uint32_t)sig->sig_size);
+	Memcpy(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
+}
+
+/**
+ * Look up a key block in the cache.  Returns non-zero if the key block has
+ * already been verified with the key.
+ */
+static int KeyBlockCacheLookup(const uint8_t *key_digest,
+			       const uint8_t *block_digest)
+{
+	int found = 0;
+	int i;
+
+	KeyBlockCacheLock();
+	for (i = 0; i < KEY_BLOCK_CACHE_ENTRIES; i++) {
+		KeyBlockCacheEntry *e = key_block_cache + i;
+
+		if (e->last_used &&
+		    !SafeMemcmp(e->key_digest, key_digest,
+				SHA256_DIGEST_SIZE) &&
+		    !SafeMemcmp(e->block_digest, block_digest,
+				SHA256_DIGEST_SIZE)) {
+			e->last_used = ++key_block_cache_clock;
+			found = 1;
+			break;
+		}
+	}
+
+	if (found)
+		key_block_cache_stats.hits++;
+	else
+		key_block_cache_stats.misses++;
+	KeyBlockCacheUnlock();
+	return found;
+}
+
+/**
+ * Add a verified key block to the cache, replacing the least recently used
+ * entry if the cache is full.
+ */
+static void KeyBlockCacheInsert(const uint8_t *key_digest,
+				const uint8_t *block_digest)
+{
+	KeyBlockCacheEntry *e = key_block_cache;
+	int i;
+
+	KeyBlockCacheLock();
+
+	/*
+	 * A batch may verify several copies of the same block, and another
+	 * thread may have added this block since we looked it up.
+	 */
+	for (i = 0; i < KEY_BLOCK_CACHE_ENTRIES; i++) {
+		if (key_block_cache[i].last_used &&
+		    !SafeMemcmp(key_block_cache[i].key_digest, key_digest,
+				SHA256_DIGEST_SIZE) &&
+		    !SafeMemcmp(key_block_cache[i].block_digest, block_digest,
+				SHA256_DIGEST_SIZE)) {
+			key_block_cache[i].last_used = ++key_block_cache_clock;
+			KeyBlockCacheUnlock();
+			return;
+		}
+	}
+
+	for (i = 1; i < KEY_BLOCK_CACHE_ENTRIES && e->last_used; i++) {
+		if (key_block_cache[i].last_used < e->last_used)
+			e = key_block_cache + i;
+	}
+	if (e->last_used)
+		key_block_cache_stats.evictions++;
+
+	Memcpy(e->key_digest, key_digest, SHA256_DIGEST_SIZE);
+	Memcpy(e->block_digest, block_digest, SHA256_DIGEST_SIZE);
+	e->last_used = ++key_block_cache_clock;
+	key_block_cache_stats.insertions++;
+	KeyBlockCacheUnlock();
+}
+
+void KeyBlockCacheEnable(int enable)
+{
+	KeyBlockCacheLock();
+	Memset(key_block_cache, 0, sizeof(key_block_cache));
+	Memset(&key_block_cache_stats, 0, sizeof(key_block_cache_stats));
+	key_block_cache_clock = 0;
+	key_block_cache_enabled = enable;
+	KeyBlockCacheUnlock();
+}
+
+int KeyBlockCacheIsEnabled(void)
+{
+	int enabled;
+
+	KeyBlockCacheLock();
+	enabled = key_block_cache_enabled;
+	KeyBlockCacheUnlock();
+	return enabled;
+}
+
+void KeyBlockCacheInvalidate(const VbPublicKey *key)
+{
+	uint8_t key_digest[SHA256_DIGEST_SIZE];
+	int i;
+
+	if (key)
+		KeyBlockCacheKeyDigest(key, key_digest);
+
+	KeyBlockCacheLock();
+	for (i = 0; i < KEY_BLOCK_CACHE_ENTRIES; i++) {
+		KeyBlockCacheEntry *e = key_block_cache + i;
+
+		if (!e->last_used)
+			continue;
+		if (key && SafeMemcmp(e->key_digest, key_digest,
+				      SHA256_DIGEST_SIZE))
+			continue;
+		Memset(e, 0, sizeof(*e));
+		key_block_cache_stats.invalidations++;
+	}
+	KeyBlockCacheUnlock();
+}
+
+void KeyBlockCacheGetStats(VbKeyBlockCacheStats *stats)
+{
+	KeyBlockCacheLock();
+	Memcpy(stats, &key_block_cache_stats, sizeof(*stats));
+	KeyBlockCacheUnlock();
+}
+
+/**
+ * Checks the signature on a key block which has passed KeyBlockPrecheck(),
+ * using [rsa], which was parsed from [key].  Returns VBOOT_SUCCESS if the
+ * block is good.
+ */
+static int KeyBlockVerifySignature(const VbKeyBlockHeader *block,
+				   uint64_t size, const VbPublicKey *key,
+				   const RSAPublicKey *rsa)
+{
+	const VbSignature *sig = &block->key_block_signature;
+	uint8_t key_digest[SHA256_DIGEST_SIZE];
+	uint8_t block_digest[SHA256_DIGEST_SIZE];
+	int use_cache = KeyBlockCacheIsEnabled();
+	int rv;
+
+	rv = KeyBlockCheckDataSize(block, sig);
+	if (rv)
+		return rv;
+
+	if (use_cache) {
+		KeyBlockCacheKeyDigest(key, key_digest);
+		KeyBlockCacheBlockDigest(block, sig, block_digest);
+		if (KeyBlockCacheLookup(key_digest, block_digest)) {
+			VBDEBUG(("Key block signature already checked.\n"));
+			return KeyBlockPostcheck(block, sig);
+		}
+	}
+
+	VBDEBUG(("Checking key block signature...\n"));
+	if (VerifyData((const uint8_t *)block, size, sig, rsa)) {
+		VBDEBUG(("Invalid key block signature.\n"));
+		return VBOOT_KEY_BLOCK_SIGNATURE;
+	}
+
+	if (use_cache)
+		KeyBlockCacheInsert(key_digest, block_digest);
+
+	return KeyBlockPostcheck(block, sig);
+}
+
+int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
+                   const VbPublicKey *key, int hash_only)
+{
+	const VbSignature *sig;
+	int rv;
+
+	/* Sanity checks before attempting signature of data */
+	rv = KeyBlockPrecheck(block, size, key, hash_only);
+	if (rv)
+		return rv;
+
+	/*
+	 * Check signature or hash, depending on the hash_only parameter. Note
+	 * that we don't require a key even if the keyblock has a signature,
+	 * because the caller may not care if the keyblock itself is signed
+	 * (for example, booting a Google-signed kernel in developer mode).
+	 */
+	if (hash_only) {
+		/* Check hash */
+		uint8_t *header_checksum = NULL;
+
+		sig = &block->key_block_checksum;
+		rv = KeyBlockCheckDataSize(block, sig);
+		if (rv)
+			return rv;
 
 		VBDEBUG(("Checking key block hash only...\n"));
 		header_checksum = DigestBuf((const uint8_t *)block,
@@ -246,57 +578,168 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		}
 	} else {
 		/* Check signature */
+		RSAPublicKey rsa_view;
 		RSAPublicKey *rsa;
-		int rv;
-
-		sig = &block->key_block_signature;
 
-		if (VerifySignatureInside(block, block->key_block_size, sig)) {
-			VBDEBUG(("Key block signature off end of block\n"));
-			return VBOOT_KEY_BLOCK_INVALID;
-		}
-
-		rsa = PublicKeyToRSA(key);
+		rsa = PublicKeyToRSAView(key, &rsa_view);
 		if (!rsa) {
 			VBDEBUG(("Invalid public key\n"));
 			return VBOOT_PUBLIC_KEY_INVALID;
 		}
+		rv = KeyBlockVerifySignature(block, size, key, rsa);
+		RSAPublicKeyFree(rsa);
+		return rv;
+	}
 
-		/* Make sure advertised signature data sizes are sane. */
-		if (block->key_block_size < sig->data_size) {
-			VBDEBUG(("Signature calculated past end of block\n"));
-			RSAPublicKeyFree(rsa);
-			return VBOOT_KEY_BLOCK_INVALID;
+	return KeyBlockPostcheck(block, sig);
+}
+
+int KeyBlockVerifyWithRSA(const VbKeyBlockHeader *block, uint64_t size,
+			  const VbPublicKey *key, const RSAPublicKey *rsa)
+{
+	int rv;
+
+	rv = KeyBlockPrecheck(block, size, key, 0);
+	if (rv)
+		return rv;
+	if (!rsa) {
+		VBDEBUG(("Missing required public key.\n"));
+		return VBOOT_PUBLIC_KEY_INVALID;
+	}
+	return KeyBlockVerifySignature(block, size, key, rsa);
+}
+
+int KeyBlockVerifyBatch(const VbKeyBlockHeader * const *blocks,
+			const uint64_t *sizes, int count,
+			const VbPublicKey *key, int hash_only, int *results)
+{
+	RSAPublicKey rsa_view;
+	RSAPublicKey *rsa = NULL;
+	RSAVerifyContext ctx;
+	uint32_t *workbuf = NULL;
+	uint8_t key_digest[SHA256_DIGEST_SIZE];
+	uint8_t (*block_digests)[SHA256_DIGEST_SIZE] = NULL;
+	DigestBatchItem *items;
+	int *item_block;
+	int num_items = 0;
+	int num_good = 0;
+	int i, n;
+
+	if (count <= 0)
+		return 0;
+
+	items = VbExMalloc(count * sizeof(DigestBatchItem));
+	item_block = VbExMalloc(count * sizeof(int));
+
+	/* The public key is parsed once and shared by every block. */
+	if (!hash_only && key) {
+		rsa = PublicKeyToRSAView(key, &rsa_view);
+		if (rsa) {
+			workbuf = VbExMalloc(RSA_VERIFY_WORKBUF_SIZE(rsa->len));
+			RSAVerifyContextInit(&ctx, rsa, workbuf,
+					     RSA_VERIFY_WORKBUF_SIZE(rsa->len));
+			if (KeyBlockCacheIsEnabled()) {
+				KeyBlockCacheKeyDigest(key, key_digest);
+				block_digests = VbExMalloc(
+					count * SHA256_DIGEST_SIZE);
+			}
 		}
+	}
 
-		VBDEBUG(("Checking key block signature...\n"));
-		rv = VerifyData((const uint8_t *)block, size, sig, rsa);
-		RSAPublicKeyFree(rsa);
-		if (rv) {
+	/* Run the same checks as KeyBlockVerify(), up to hashing. */
+	for (i = 0; i < count; i++) {
+		const VbKeyBlockHeader *block = blocks[i];
+		const VbSignature *sig;
+
+		results[i] = KeyBlockPrecheck(block, sizes[i], key, hash_only);
+		if (results[i])
+			continue;
+
+		if (hash_only) {
+			sig = &block->key_block_checksum;
+		} else {
+			sig = &block->key_block_signature;
+			if (!rsa) {
+				VBDEBUG(("Invalid public key\n"));
+				results[i] = VBOOT_PUBLIC_KEY_INVALID;
+				continue;
+			}
+		}
+
+		results[i] = KeyBlockCheckDataSize(block, sig);
+		if (results[i])
+			continue;
+
+		if (!hash_only && VerifyDataPrecheck(sizes[i], sig, rsa)) {
 			VBDEBUG(("Invalid key block signature.\n"));
-			return VBOOT_KEY_BLOCK_SIGNATURE;
+			results[i] = VBOOT_KEY_BLOCK_SIGNATURE;
+			continue;
 		}
-	}
 
-	/* Verify we signed enough data */
-	if (sig->data_size < sizeof(VbKeyBlockHeader)) {
-		VBDEBUG(("Didn't sign enough data\n"));
-		return VBOOT_KEY_BLOCK_INVALID;
-	}
+		if (block_digests) {
+			KeyBlockCacheBlockDigest(block, sig, block_digests[i]);
+			if (KeyBlockCacheLookup(key_digest, block_digests[i])) {
+				results[i] = KeyBlockPostcheck(block, sig);
+				continue;
+			}
+		}
 
-	/* Verify data key is inside the block and inside signed data */
-	if (VerifyPublicKeyInside(block, block->key_block_size,
-				  &block->data_key)) {
-		VBDEBUG(("Data key off end of key block\n"));
-		return VBOOT_KEY_BLOCK_INVALID;
+		items[num_items].data = (const uint8_t *)block;
+		items[num_items].len = sig->data_size;
+		items[num_items].sig_algorithm =
+			hash_only ? SHA512_DIGEST_ALGORITHM : rsa->algorithm;
+		item_block[num_items++] = i;
+	}
+
+	/* Hash all the blocks together, then check each hash or signature. */
+	DigestBatch(items, num_items);
+
+	for (n = 0; n < num_items; n++) {
+		const VbKeyBlockHeader *block = blocks[item_block[n]];
+		const VbSignature *sig;
+		int *rv = &results[item_block[n]];
+
+		if (hash_only) {
+			sig = &block->key_block_checksum;
+			if (SafeMemcmp(items[n].digest, GetSignatureDataC(sig),
+				       SHA512_DIGEST_SIZE)) {
+				VBDEBUG(("Invalid key block hash.\n"));
+				*rv = VBOOT_KEY_BLOCK_HASH;
+				continue;
+			}
+		} else {
+			sig = &block->key_block_signature;
+			if (!RSAVerifyWithContext(&ctx, GetSignatureDataC(sig),
+						  sig->sig_size,
+						  rsa->algorithm,
+						  items[n].digest)) {
+				VBDEBUG(("Invalid key block signature.\n"));
+				*rv = VBOOT_KEY_BLOCK_SIGNATURE;
+				continue;
+			}
+			if (block_digests)
+				KeyBlockCacheInsert(key_digest,
+						    block_digests[item_block[n]]);
+		}
+
+		*rv = KeyBlockPostcheck(block, sig);
 	}
-	if (VerifyPublicKeyInside(block, sig->data_size, &block->data_key)) {
-		VBDEBUG(("Data key off end of signed data\n"));
-		return VBOOT_KEY_BLOCK_INVALID;
+
+	for (i = 0; i < count; i++) {
+		if (results[i] == VBOOT_SUCCESS)
+			num_good++;
 	}
 
-	/* Success */
-	return VBOOT_SUCCESS;
+	if (block_digests)
+		VbExFree(block_digests);
+	if (rsa) {
+		RSAVerifyContextFree(&ctx);
+		VbExFree(workbuf);
+		RSAPublicKeyFree(rsa);
+	}
+	VbExFree(item_block);
+	VbExFree(items);
+	return num_good;
 }
 
 int VerifyFirmwarePreamble(const VbFirmwarePreambleHeader *preamble,
@@ -385,12 +828,15 @@ uint32_t VbGetFirmwarePreambleFlags(const VbFirmwarePreambleHeader *preamble)
 	return preamble->flags;
 }
 
-int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
-                         uint64_t size, const RSAPublicKey *key)
+/**
+ * Sanity checks on a kernel preamble before its signature is checked.
+ * Returns VBOOT_SUCCESS if the preamble is worth checking.
+ */
+static int KernelPreamblePrecheck(const VbKernelPreambleHeader *preamble,
+				  uint64_t size)
 {
 	const VbSignature *sig = &preamble->preamble_signature;
 
-	/* Sanity checks before attempting signature of data */
 	if(size < sizeof(VbKernelPreambleHeader)) {
 		VBDEBUG(("Not enough data for preamble header.\n"));
 		return VBOOT_PREAMBLE_INVALID;
@@ -410,10 +856,17 @@ int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 		VBDEBUG(("Preamble signature off end of preamble\n"));
 		return VBOOT_PREAMBLE_INVALID;
 	}
-	if (VerifyData((const uint8_t *)preamble, size, sig, key)) {
-		VBDEBUG(("Preamble signature validation failed\n"));
-		return VBOOT_PREAMBLE_SIGNATURE;
-	}
+
+	return VBOOT_SUCCESS;
+}
+
+/**
+ * Checks on a kernel preamble after its signature has been verified.
+ * Returns VBOOT_SUCCESS if the preamble is good.
+ */
+static int KernelPreamblePostcheck(const VbKernelPreambleHeader *preamble)
+{
+	const VbSignature *sig = &preamble->preamble_signature;
 
 	/* Verify we signed enough data */
 	if (sig->data_size < sizeof(VbKernelPreambleHeader)) {
@@ -428,10 +881,102 @@ int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 		return VBOOT_PREAMBLE_INVALID;
 	}
 
-	/* Success */
 	return VBOOT_SUCCESS;
 }
 
+int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
+                         uint64_t size, const RSAPublicKey *key)
+{
+	const VbSignature *sig = &preamble->preamble_signature;
+	int rv;
+
+	/* Sanity checks before attempting signature of data */
+	rv = KernelPreamblePrecheck(preamble, size);
+	if (rv)
+		return rv;
+
+	if (VerifyData((const uint8_t *)preamble, size, sig, key)) {
+		VBDEBUG(("Preamble signature validation failed\n"));
+		return VBOOT_PREAMBLE_SIGNATURE;
+	}
+
+	return KernelPreamblePostcheck(preamble);
+}
+
+int VerifyKernelPreambleBatch(const VbKernelPreambleHeader * const *preambles,
+			      const uint64_t *sizes, int count,
+			      const RSAPublicKey *key, int *results)
+{
+	RSAVerifyContext ctx;
+	uint32_t *workbuf;
+	DigestBatchItem *items;
+	int *item_preamble;
+	int num_items = 0;
+	int num_good = 0;
+	int i, n;
+
+	if (count <= 0)
+		return 0;
+
+	items = VbExMalloc(count * sizeof(DigestBatchItem));
+	item_preamble = VbExMalloc(count * sizeof(int));
+	workbuf = VbExMalloc(RSA_VERIFY_WORKBUF_SIZE(key->len));
+	RSAVerifyContextInit(&ctx, key, workbuf,
+			     RSA_VERIFY_WORKBUF_SIZE(key->len));
+
+	/* Run the same checks as VerifyKernelPreamble(), up to hashing. */
+	for (i = 0; i < count; i++) {
+		const VbSignature *sig = &preambles[i]->preamble_signature;
+
+		results[i] = KernelPreamblePrecheck(preambles[i], sizes[i]);
+		if (results[i])
+			continue;
+
+		if (key->algorithm >= (unsigned int)kNumAlgorithms ||
+		    VerifyDataPrecheck(sizes[i], sig, key)) {
+			VBDEBUG(("Preamble signature validation failed\n"));
+			results[i] = VBOOT_PREAMBLE_SIGNATURE;
+			continue;
+		}
+
+		items[num_items].data = (const uint8_t *)preambles[i];
+		items[num_items].len = sig->data_size;
+		items[num_items].sig_algorithm = key->algorithm;
+		item_preamble[num_items++] = i;
+	}
+
+	/* Hash all the preambles together, then check each signature. */
+	DigestBatch(items, num_items);
+
+	for (n = 0; n < num_items; n++) {
+		const VbKernelPreambleHeader *preamble =
+			preambles[item_preamble[n]];
+		const VbSignature *sig = &preamble->preamble_signature;
+		int *rv = &results[item_preamble[n]];
+
+		if (!RSAVerifyWithContext(&ctx, GetSignatureDataC(sig),
+					  sig->sig_size, key->algorithm,
+					  items[n].digest)) {
+			VBDEBUG(("Preamble signature validation failed\n"));
+			*rv = VBOOT_PREAMBLE_SIGNATURE;
+			continue;
+		}
+
+		*rv = KernelPreamblePostcheck(preamble);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (results[i] == VBOOT_SUCCESS)
+			num_good++;
+	}
+
+	RSAVerifyContextFree(&ctx);
+	VbExFree(workbuf);
+	VbExFree(item_preamble);
+	VbExFree(items);
+	return num_good;
+}
+
 uint64_t VbSharedDataReserve(VbSharedDataHeader *header, uint64_t size)
 {
 	uint64_t offs = header->data_used;
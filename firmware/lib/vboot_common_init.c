@@ -43,3 +43,18 @@ int VbSharedDataInit(VbSharedDataHeader *header, uint64_t size)
 	/* Success */
 	return VBOOT_SUCCESS;
 }
+
+void VbSharedDataAddTimestamp(VbSharedDataHeader *header, uint32_t event,
+			      uint32_t data)
+{
+	VbSharedDataTimestamp *ts;
+
+	if (!header || header->struct_version < 3)
+		return;
+
+	ts = header->timestamps +
+		(header->timestamp_count++ & (VBSD_MAX_TIMESTAMPS - 1));
+	ts->timer = VbExGetTimer();
+	ts->event = event;
+	ts->data = data;
+}
@@ -18,6 +18,9 @@
 static uint32_t disp_current_screen = VB_SCREEN_BLANK;
 static uint32_t disp_width = 0, disp_height = 0;
 
+/* Bitmap block data, once VbDisplayScreenFromGBB() has found it */
+static uint8_t *bmpfv;
+
 VbError_t VbGetLocalizationCount(VbCommonParams *cparams, uint32_t *count)
 {
 	GoogleBinaryBlockHeader *gbb =
@@ -36,7 +39,8 @@ VbError_t VbGetLocalizationCount(VbCommonParams *cparams, uint32_t *count)
 
 	/* Sanity-check the bitmap block header */
 	hdr = (BmpBlockHeader *)(((uint8_t *)gbb) + gbb->bmpfv_offset);
-	if ((0 != Memcmp(hdr->signature, BMPBLOCK_SIGNATURE,
+	if (gbb->bmpfv_size < sizeof(BmpBlockHeader) ||
+	    (0 != Memcmp(hdr->signature, BMPBLOCK_SIGNATURE,
 			 BMPBLOCK_SIGNATURE_SIZE)) ||
 	    (hdr->major_version > BMPBLOCK_MAJOR_VERSION) ||
 	    ((hdr->major_version == BMPBLOCK_MAJOR_VERSION) &&
@@ -164,6 +168,42 @@ void VbRenderTextAtPos(const char *text, int right_to_left,
 	}
 }
 
+/*
+ * Check that a font blob of [size] bytes has at least one glyph, and that all
+ * its glyphs fit, so VbFindFontGlyph() can walk it safely.  Returns 0 if ok.
+ */
+static int VbCheckFontData(const uint8_t *data, uint32_t size)
+{
+	const FontArrayHeader *fonthdr = (const FontArrayHeader *)data;
+	const FontArrayEntryHeader *entry;
+	uint64_t offset = sizeof(FontArrayHeader);
+	uint32_t i;
+
+	if (size < sizeof(FontArrayHeader) || !fonthdr->num_entries)
+		return 1;
+
+	for (i = 0; i < fonthdr->num_entries; i++) {
+		if (offset + sizeof(FontArrayEntryHeader) > size)
+			return 1;
+		entry = (const FontArrayEntryHeader *)(data + offset);
+		offset += sizeof(FontArrayEntryHeader);
+		if (entry->info.original_size > entry->info.compressed_size ||
+		    offset + entry->info.compressed_size > size)
+			return 1;
+		offset += entry->info.compressed_size;
+	}
+	return 0;
+}
+
+void VbDisplayFreeBmpfv(void)
+{
+#ifdef COPY_BMP_DATA
+	if (bmpfv)
+		VbExFree(bmpfv);
+#endif
+	bmpfv = NULL;
+}
+
 #define OUTBUF_LEN 128
 
 VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
@@ -171,7 +211,6 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 {
 	GoogleBinaryBlockHeader *gbb =
 		(GoogleBinaryBlockHeader *)cparams->gbb_data;
-	static uint8_t *bmpfv;
 	void *fullimage = NULL;
 	BmpBlockHeader *hdr;
 	ScreenLayout *layout;
@@ -180,7 +219,8 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 	uint32_t localization = 0;
 	VbError_t retval = VBERROR_UNKNOWN;   /* Assume error until proven ok */
 	uint32_t inoutsize;
-	uint32_t offset;
+	uint32_t datasize;
+	uint64_t offset;
 	uint32_t i;
 	VbFont_t *font;
 	const char *text_to_show;
@@ -210,7 +250,8 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 
 	/* Sanity-check the bitmap block header */
 	hdr = (BmpBlockHeader *)bmpfv;
-	if ((0 != Memcmp(hdr->signature, BMPBLOCK_SIGNATURE,
+	if (gbb->bmpfv_size < sizeof(BmpBlockHeader) ||
+	    (0 != Memcmp(hdr->signature, BMPBLOCK_SIGNATURE,
 			 BMPBLOCK_SIGNATURE_SIZE)) ||
 	    (hdr->major_version > BMPBLOCK_MAJOR_VERSION) ||
 	    ((hdr->major_version == BMPBLOCK_MAJOR_VERSION) &&
@@ -283,9 +324,15 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 	 * locale + correct screen.
 	 */
 	offset = sizeof(BmpBlockHeader) +
-		localization * hdr->number_of_screenlayouts *
+		(uint64_t)localization * hdr->number_of_screenlayouts *
 			sizeof(ScreenLayout) +
 		screen_index * sizeof(ScreenLayout);
+	if (offset + sizeof(ScreenLayout) > gbb->bmpfv_size) {
+		VBDEBUG(("VbDisplayScreenFromGBB(): "
+			 "screen layout outside the bitmap block\n"));
+		retval = VBERROR_INVALID_BMPFV;
+		goto VbDisplayScreenFromGBB_exit;
+	}
 	layout = (ScreenLayout *)(bmpfv + offset);
 
 	/* Display all bitmaps for the image */
@@ -293,15 +340,32 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 		if (!layout->images[i].image_info_offset)
 			continue;
 
+		/* The image info and the image data must be in the block */
 		offset = layout->images[i].image_info_offset;
+		if (offset + sizeof(ImageInfo) > gbb->bmpfv_size) {
+			retval = VBERROR_INVALID_BMPFV;
+			goto VbDisplayScreenFromGBB_exit;
+		}
 		image_info = (ImageInfo *)(bmpfv + offset);
-		fullimage = bmpfv + offset + sizeof(ImageInfo);
+		offset += sizeof(ImageInfo);
+		if (image_info->compression != COMPRESS_NONE)
+			datasize = image_info->compressed_size;
+		else
+			datasize = image_info->original_size;
+		if (offset + datasize > gbb->bmpfv_size) {
+			VBDEBUG(("VbDisplayScreenFromGBB(): "
+				 "image data outside the bitmap block\n"));
+			retval = VBERROR_INVALID_BMPFV;
+			goto VbDisplayScreenFromGBB_exit;
+		}
+
+		fullimage = bmpfv + offset;
 		inoutsize = image_info->original_size;
 		if (inoutsize &&
 		    image_info->compression != COMPRESS_NONE) {
 			fullimage = VbExMalloc(inoutsize);
 			retval = VbExDecompress(
-					bmpfv + offset + sizeof(ImageInfo),
+					bmpfv + offset,
 					image_info->compressed_size,
 					image_info->compression,
 					fullimage, &inoutsize);
@@ -323,6 +387,12 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 			 * The uncompressed blob is our font structure. Cache
 			 * it as needed.
 			 */
+			if (VbCheckFontData(fullimage, inoutsize)) {
+				VBDEBUG(("VbDisplayScreenFromGBB(): "
+					 "invalid font\n"));
+				retval = VBERROR_INVALID_BMPFV;
+				break;
+			}
 			font = VbInternalizeFontData(fullimage);
 
 			/* TODO: handle text in general here */
@@ -340,6 +410,7 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 					  layout->images[i].y, font);
 
 			VbDoneWithFontForNow(font);
+			retval = VBERROR_SUCCESS;
 			break;
 
 		default:
@@ -349,7 +420,8 @@ VbError_t VbDisplayScreenFromGBB(VbCommonParams *cparams, uint32_t screen,
 			retval = VBERROR_INVALID_GBB;
 		}
 
-		if (COMPRESS_NONE != image_info->compression)
+		/* Only free the image if it was decompressed */
+		if (fullimage != bmpfv + offset)
 			VbExFree(fullimage);
 
 		if (VBERROR_SUCCESS != retval)
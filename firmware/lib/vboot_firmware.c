@@ -61,6 +61,12 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 
 	VBDEBUG(("LoadFirmware started...\n"));
 
+#ifdef KEY_BLOCK_CACHE
+	/* Slots A and B are usually signed with the same key block */
+	if (!KeyBlockCacheIsEnabled())
+		KeyBlockCacheEnable(1);
+#endif
+
 	/* Must have a root key from the GBB */
 	if (!gbb) {
 		VBDEBUG(("No GBB\n"));
@@ -91,11 +97,13 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 		VbKeyBlockHeader *key_block;
 		uint32_t vblock_size;
 		VbFirmwarePreambleHeader *preamble;
+		RSAPublicKey data_key_view;
 		RSAPublicKey *data_key;
 		uint64_t key_version;
 		uint32_t combined_version;
 		uint8_t *body_digest;
 		uint8_t *check_result;
+		int rv;
 
 		/* If try B count is non-zero try firmware B first */
 		index = (try_b_count ? 1 - i : i);
@@ -132,8 +140,12 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 		}
 
 		/* Verify the key block */
-		if ((0 != KeyBlockVerify(key_block, vblock_size,
-					 root_key, 0))) {
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LF_KEYBLOCK_START,
+					 index);
+		rv = KeyBlockVerify(key_block, vblock_size, root_key, 0);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LF_KEYBLOCK_END,
+					 index);
+		if (0 != rv) {
 			VBDEBUG(("Key block verification failed.\n"));
 			*check_result = VBSD_LF_CHECK_VERIFY_KEYBLOCK;
 			continue;
@@ -160,7 +172,8 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 		}
 
 		/* Get key for preamble/data verification from the key block. */
-		data_key = PublicKeyToRSA(&key_block->data_key);
+		data_key = PublicKeyToRSAView(&key_block->data_key,
+					      &data_key_view);
 		if (!data_key) {
 			VBDEBUG(("Unable to parse data key.\n"));
 			*check_result = VBSD_LF_CHECK_DATA_KEY_PARSE;
@@ -170,10 +183,15 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 		/* Verify the preamble, which follows the key block. */
 		preamble = (VbFirmwarePreambleHeader *)
 			((uint8_t *)key_block + key_block->key_block_size);
-		if ((0 != VerifyFirmwarePreamble(
-					preamble,
-					vblock_size - key_block->key_block_size,
-					data_key))) {
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LF_PREAMBLE_START,
+					 index);
+		rv = VerifyFirmwarePreamble(preamble,
+					    vblock_size -
+					    key_block->key_block_size,
+					    data_key);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LF_PREAMBLE_END,
+					 index);
+		if (0 != rv) {
 			VBDEBUG(("Preamble verfication failed.\n"));
 			*check_result = VBSD_LF_CHECK_VERIFY_PREAMBLE;
 			RSAPublicKeyFree(data_key);
@@ -223,9 +241,9 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 			shared->flags |= VBSD_LF_USE_RO_NORMAL;
 
 		} else {
-			VbError_t rv;
-
 			/* Read the firmware data */
+			VbSharedDataAddTimestamp(shared, VBSD_TS_LF_BODY_START,
+						 index);
 			DigestInit(&lfi->body_digest_context,
 				   data_key->algorithm);
 			lfi->body_size_accum = 0;
@@ -252,9 +270,11 @@ int LoadFirmware(VbCommonParams *cparams, VbSelectFirmwareParams *fparams,
 
 			/* Verify firmware data */
 			body_digest = DigestFinal(&lfi->body_digest_context);
-			if (0 != VerifyDigest(body_digest,
-					      &preamble->body_signature,
-					      data_key)) {
+			rv = VerifyDigest(body_digest,
+					  &preamble->body_signature, data_key);
+			VbSharedDataAddTimestamp(shared, VBSD_TS_LF_BODY_END,
+						 index);
+			if (0 != rv) {
 				VBDEBUG(("FW body verification failed.\n"));
 				*check_result = VBSD_LF_CHECK_VERIFY_BODY;
 				RSAPublicKeyFree(data_key);
@@ -18,6 +18,9 @@
 #include "vboot_kernel.h"
 
 #define KBUF_SIZE 65536  /* Bytes to read at start of kernel partition */
+#ifndef KBODY_CHUNK_SIZE
+#define KBODY_CHUNK_SIZE 262144  /* Bytes of kernel body to read at once */
+#endif
 #define LOWEST_TPM_VERSION 0xffffffff
 
 typedef enum BootMode {
@@ -32,114 +35,329 @@ typedef enum BootMode {
  * The sector_bytes and drive_sectors fields should be filled on input.  The
  * primary and secondary header and entries are filled on output.
  *
+ * All four live in one buffer, laid out in the same order as on disk, so
+ * that each header and its entries can be read with a single I/O:
+ *
+ *   primary header | primary entries | secondary entries | secondary header
+ *
  * Returns 0 if successful, 1 if error.
  */
 int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 {
 	uint64_t entries_sectors = TOTAL_ENTRIES_SIZE / gptdata->sector_bytes;
+	uint8_t *arena;
 
-	/* No data to be written yet */
+	/* No data to be written yet, and no kernel index built */
 	gptdata->modified = 0;
-
-	/* Allocate all buffers */
-	gptdata->primary_header = (uint8_t *)VbExMalloc(gptdata->sector_bytes);
-	gptdata->secondary_header =
-		(uint8_t *)VbExMalloc(gptdata->sector_bytes);
-	gptdata->primary_entries = (uint8_t *)VbExMalloc(TOTAL_ENTRIES_SIZE);
-	gptdata->secondary_entries = (uint8_t *)VbExMalloc(TOTAL_ENTRIES_SIZE);
-
-	if (gptdata->primary_header == NULL ||
-	    gptdata->secondary_header == NULL ||
-	    gptdata->primary_entries == NULL ||
-	    gptdata->secondary_entries == NULL)
+	Memset(&gptdata->kernel_index, 0, sizeof(gptdata->kernel_index));
+
+	/* Allocate one buffer for everything */
+	arena = (uint8_t *)VbExMalloc(2 * (gptdata->sector_bytes +
+					   TOTAL_ENTRIES_SIZE));
+	gptdata->primary_header = arena;
+	if (!arena) {
+		gptdata->primary_entries = NULL;
+		gptdata->secondary_entries = NULL;
+		gptdata->secondary_header = NULL;
 		return 1;
+	}
+	gptdata->primary_entries = arena + gptdata->sector_bytes;
+	gptdata->secondary_entries =
+		gptdata->primary_entries + TOTAL_ENTRIES_SIZE;
+	gptdata->secondary_header =
+		gptdata->secondary_entries + TOTAL_ENTRIES_SIZE;
 
-	/* Read data from the drive, skipping the protective MBR */
-	if (0 != VbExDiskRead(disk_handle, 1, 1, gptdata->primary_header))
-		return 1;
-	if (0 != VbExDiskRead(disk_handle, 2, entries_sectors,
-			      gptdata->primary_entries))
+	/*
+	 * Read data from the drive, skipping the protective MBR.  Each entry
+	 * array is next to its header on disk.
+	 */
+	if (0 != VbExDiskRead(disk_handle, 1, 1 + entries_sectors,
+			      gptdata->primary_header))
 		return 1;
 	if (0 != VbExDiskRead(disk_handle,
 			      gptdata->drive_sectors - entries_sectors - 1,
-			      entries_sectors, gptdata->secondary_entries))
-		return 1;
-	if (0 != VbExDiskRead(disk_handle, gptdata->drive_sectors - 1, 1,
-			      gptdata->secondary_header))
+			      entries_sectors + 1, gptdata->secondary_entries))
 		return 1;
 
 	return 0;
 }
 
 /**
- * Write any changes for the GPT data back to the drive, then free the buffers.
+ * Write any changes for the GPT data back to the drive, then free the buffers
+ * and the kernel index built by GptInit().
+ *
+ * A header and its entries are written with a single I/O when both have
+ * changed.
  *
  * Returns 0 if successful, 1 if error.
  */
 int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 {
-	int legacy = 0;
+	GptHeader *h = (GptHeader *)(gptdata->primary_header);
 	uint64_t entries_sectors = TOTAL_ENTRIES_SIZE / gptdata->sector_bytes;
+	uint64_t start, count;
+	uint8_t *buf;
+	int modified = gptdata->modified;
+	int rv = 0;
+
+	GptFree(gptdata);
+	if (!gptdata->primary_header)
+		return 0;
+
+	if (!Memcmp(h->signature, GPT_HEADER_SIGNATURE2,
+		    GPT_HEADER_SIGNATURE_SIZE)) {
+		if (modified & GPT_MODIFIED_HEADER1)
+			VBDEBUG(("Not updating GPT header 1: "
+				 "legacy mode is enabled.\n"));
+		if (modified & GPT_MODIFIED_ENTRIES1)
+			VBDEBUG(("Not updating GPT entries 1: "
+				 "legacy mode is enabled.\n"));
+		modified &= ~(GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1);
+	}
 
-	if (gptdata->primary_header) {
-		GptHeader *h = (GptHeader *)(gptdata->primary_header);
-		legacy = !Memcmp(h->signature, GPT_HEADER_SIGNATURE2,
-				 GPT_HEADER_SIGNATURE_SIZE);
-		if (gptdata->modified & GPT_MODIFIED_HEADER1) {
-			if (legacy) {
-				VBDEBUG(("Not updating GPT header 1: "
-					 "legacy mode is enabled.\n"));
-			} else {
-				VBDEBUG(("Updating GPT header 1\n"));
-				if (0 != VbExDiskWrite(disk_handle, 1, 1,
-						       gptdata->primary_header))
-					return 1;
-			}
+	/* Primary header at sector 1, followed by its entries */
+	if (modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1)) {
+		start = 1;
+		count = 1 + entries_sectors;
+		buf = gptdata->primary_header;
+		if (!(modified & GPT_MODIFIED_HEADER1)) {
+			start++;
+			count--;
+			buf = gptdata->primary_entries;
+		} else if (!(modified & GPT_MODIFIED_ENTRIES1)) {
+			count = 1;
 		}
-		VbExFree(gptdata->primary_header);
+		VBDEBUG(("Updating GPT %s 1\n",
+			 count == 1 ? "header" :
+			 buf == gptdata->primary_entries ? "entries" :
+			 "header and entries"));
+		if (0 != VbExDiskWrite(disk_handle, start, count, buf))
+			rv = 1;
 	}
 
-	if (gptdata->primary_entries) {
-		if (gptdata->modified & GPT_MODIFIED_ENTRIES1) {
-			if (legacy) {
-				VBDEBUG(("Not updating GPT entries 1: "
-					 "legacy mode is enabled.\n"));
-			} else {
-				VBDEBUG(("Updating GPT entries 1\n"));
-				if (0 != VbExDiskWrite(disk_handle, 2,
-						entries_sectors,
-						gptdata->primary_entries))
-					return 1;
-			}
+	/* Secondary entries, followed by their header in the last sector */
+	if (!rv && (modified & (GPT_MODIFIED_HEADER2 |
+				GPT_MODIFIED_ENTRIES2))) {
+		start = gptdata->drive_sectors - entries_sectors - 1;
+		count = entries_sectors + 1;
+		buf = gptdata->secondary_entries;
+		if (!(modified & GPT_MODIFIED_ENTRIES2)) {
+			start += entries_sectors;
+			count = 1;
+			buf = gptdata->secondary_header;
+		} else if (!(modified & GPT_MODIFIED_HEADER2)) {
+			count--;
 		}
-		VbExFree(gptdata->primary_entries);
+		VBDEBUG(("Updating GPT %s 2\n",
+			 count == 1 ? "header" :
+			 count == entries_sectors ? "entries" :
+			 "header and entries"));
+		if (0 != VbExDiskWrite(disk_handle, start, count, buf))
+			rv = 1;
 	}
 
-	if (gptdata->secondary_entries) {
-		if (gptdata->modified & GPT_MODIFIED_ENTRIES2) {
-			VBDEBUG(("Updating GPT header 2\n"));
-			if (0 != VbExDiskWrite(disk_handle,
-				gptdata->drive_sectors - entries_sectors - 1,
-				entries_sectors, gptdata->secondary_entries))
-				return 1;
-		}
-		VbExFree(gptdata->secondary_entries);
+	/* All four buffers share the allocation made by AllocAndReadGptData */
+	VbExFree(gptdata->primary_header);
+	gptdata->primary_header = NULL;
+	gptdata->primary_entries = NULL;
+	gptdata->secondary_entries = NULL;
+	gptdata->secondary_header = NULL;
+
+	return rv;
+}
+
+/**
+ * Find the precheck results for the partition at [part_start] of [part_size]
+ * sectors, if LoadKernelPrecheck() was run.  Returns NULL if none.
+ */
+static const KernelPartPrecheck *FindPrecheck(
+		const KernelPartPrecheck *checks, int count,
+		uint64_t part_start, uint64_t part_size)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (checks[i].part_start == part_start &&
+		    checks[i].part_size == part_size)
+			return checks + i;
+	}
+	return NULL;
+}
+
+#if !defined(CONFIG_SANDBOX)
+/**
+ * KeyBlockVerify(), using the result from [pre] if there is one.
+ */
+static int CheckKeyBlock(const KernelPartPrecheck *pre,
+			 const VbKeyBlockHeader *block, uint64_t size,
+			 const VbPublicKey *key, int hash_only)
+{
+	if (pre)
+		return (hash_only ? pre->key_block_hash_result :
+			pre->key_block_sig_result);
+	return KeyBlockVerify(block, size, key, hash_only);
+}
+
+/**
+ * VerifyKernelPreamble(), using the result from [pre] if there is one.
+ */
+static int CheckPreamble(const KernelPartPrecheck *pre,
+			 const VbKernelPreambleHeader *preamble,
+			 uint64_t size, const RSAPublicKey *key)
+{
+	if (pre && pre->preamble_checked)
+		return pre->preamble_result;
+	return VerifyKernelPreamble(preamble, size, key);
+}
+
+/**
+ * Start reading [sector_count] sectors from [lba_start] into [buffer].  Uses
+ * an asynchronous read if [*async] is non-zero, and clears [*async] if the
+ * firmware turns out not to support them, falling back to a synchronous read.
+ *
+ * Returns 0 if successful, 1 if error.
+ */
+static int StartBodyRead(VbExDiskHandle_t disk_handle, uint64_t lba_start,
+			 uint64_t sector_count, void *buffer, int *async)
+{
+	if (*async) {
+		VbError_t rv = VbExDiskReadAsync(disk_handle, lba_start,
+						 sector_count, buffer);
+		if (VBERROR_SUCCESS == rv)
+			return 0;
+		if (VBERROR_NO_ASYNC_DISK_READ != rv)
+			return 1;
+
+		VBDEBUG(("Async disk reads not supported.\n"));
+		*async = 0;
 	}
 
-	if (gptdata->secondary_header) {
-		if (gptdata->modified & GPT_MODIFIED_HEADER2) {
-			VBDEBUG(("Updating GPT entries 2\n"));
-			if (0 != VbExDiskWrite(disk_handle,
-					       gptdata->drive_sectors - 1, 1,
-					       gptdata->secondary_header))
-				return 1;
+	return (0 == VbExDiskRead(disk_handle, lba_start, sector_count,
+				  buffer) ? 0 : 1);
+}
+
+/**
+ * Read the kernel body of [body_sectors] sectors, starting at [lba_start],
+ * into params->kernel_buffer and verify it against signature [sig] using
+ * [key].
+ *
+ * The body is read in chunks of KBODY_CHUNK_SIZE bytes and each chunk is
+ * hashed as soon as it arrives.  If the firmware supports asynchronous reads,
+ * the next chunk is read while the previous one is being hashed, so hashing
+ * costs little more than the disk read itself.
+ *
+ * The time spent waiting for reads and hashing is recorded in the shared
+ * data as VBSD_TS_LK_BODY_READ and VBSD_TS_LK_BODY_HASH.
+ *
+ * Returns 0 if successful, or the VBSD_LKP_CHECK_* reason for failure.
+ */
+static uint8_t LoadKernelBody(LoadKernelParams *params, uint64_t lba_start,
+			      uint64_t body_sectors, const VbSignature *sig,
+			      const RSAPublicKey *key)
+{
+	VbSharedDataHeader *shared =
+		(VbSharedDataHeader *)params->shared_data_blob;
+	uint8_t *buffer = (uint8_t *)params->kernel_buffer;
+	uint64_t blba = params->bytes_per_lba;
+	uint64_t chunk_sectors = KBODY_CHUNK_SIZE / blba;
+	uint64_t data_left = sig->data_size;
+	uint64_t read_sectors = 0;  /* Sectors whose read has finished */
+	uint64_t pending = 0;  /* Sectors in the read currently in flight */
+	uint64_t read_ticks = 0, hash_ticks = 0;
+	uint64_t start;
+	DigestContext ctx;
+	uint8_t *digest;
+	int async = 1;
+	int rv;
+
+	if (sig->data_size > params->kernel_buffer_size) {
+		VBDEBUG(("Data buffer smaller than length of signed data.\n"));
+		return VBSD_LKP_CHECK_VERIFY_DATA;
+	}
+	if (0 == chunk_sectors)
+		chunk_sectors = 1;
+
+	DigestInit(&ctx, key->algorithm);
+
+	while (read_sectors < body_sectors) {
+		uint64_t chunk_start = read_sectors;
+		uint64_t chunk_bytes;
+
+		/* Start reading this chunk, unless that's already under way */
+		if (!pending) {
+			pending = body_sectors - read_sectors;
+			if (pending > chunk_sectors)
+				pending = chunk_sectors;
+			start = VbExGetTimer();
+			rv = StartBodyRead(params->disk_handle,
+					   lba_start + read_sectors, pending,
+					   buffer + read_sectors * blba,
+					   &async);
+			read_ticks += VbExGetTimer() - start;
+			if (rv)
+				break;
 		}
-		VbExFree(gptdata->secondary_header);
+		if (async) {
+			start = VbExGetTimer();
+			rv = VbExDiskReadWait(params->disk_handle);
+			read_ticks += VbExGetTimer() - start;
+			if (VBERROR_SUCCESS != rv)
+				break;
+		}
+		read_sectors += pending;
+		pending = 0;
+
+		/* Get the next chunk on its way before hashing this one */
+		if (read_sectors < body_sectors) {
+			pending = body_sectors - read_sectors;
+			if (pending > chunk_sectors)
+				pending = chunk_sectors;
+			start = VbExGetTimer();
+			rv = StartBodyRead(params->disk_handle,
+					   lba_start + read_sectors, pending,
+					   buffer + read_sectors * blba,
+					   &async);
+			read_ticks += VbExGetTimer() - start;
+			if (rv)
+				break;
+		}
+
+		/* Only hash the signed part of the body */
+		chunk_bytes = (read_sectors - chunk_start) * blba;
+		if (chunk_bytes > data_left)
+			chunk_bytes = data_left;
+		start = VbExGetTimer();
+		DigestUpdate(&ctx, buffer + chunk_start * blba,
+			     (uint32_t)chunk_bytes);
+		hash_ticks += VbExGetTimer() - start;
+		data_left -= chunk_bytes;
+	}
+
+	start = VbExGetTimer();
+	digest = DigestFinal(&ctx);
+	if (read_sectors < body_sectors) {
+		VBDEBUG(("Unable to read kernel data.\n"));
+		VbExFree(digest);
+		return VBSD_LKP_CHECK_READ_DATA;
+	}
+
+	rv = VerifyDigest(digest, sig, key);
+	VbExFree(digest);
+	hash_ticks += VbExGetTimer() - start;
+	VbSharedDataAddTimestamp(shared, VBSD_TS_LK_BODY_READ,
+				 read_ticks < 0xFFFFFFFF ?
+				 (uint32_t)read_ticks : 0xFFFFFFFF);
+	VbSharedDataAddTimestamp(shared, VBSD_TS_LK_BODY_HASH,
+				 hash_ticks < 0xFFFFFFFF ?
+				 (uint32_t)hash_ticks : 0xFFFFFFFF);
+	if (0 != rv) {
+		VBDEBUG(("Kernel data verification failed.\n"));
+		return VBSD_LKP_CHECK_VERIFY_DATA;
 	}
 
-	/* Success */
 	return 0;
 }
+#endif
 
 VbError_t LoadKernel(LoadKernelParams *params)
 {
@@ -162,6 +380,8 @@ VbError_t LoadKernel(LoadKernelParams *params)
 	int rec_switch, dev_switch;
 	BootMode boot_mode;
 	uint32_t require_official_os = 0;
+	KernelPartPrecheck *prechecks = NULL;
+	int precheck_count = 0;
 
 	VbError_t retval = VBERROR_UNKNOWN;
 	int recovery = VBNV_RECOVERY_LK_UNSPECIFIED;
@@ -179,6 +399,12 @@ VbError_t LoadKernel(LoadKernelParams *params)
 	params->bootloader_address = 0;
 	params->bootloader_size = 0;
 
+#ifdef KEY_BLOCK_CACHE
+	/* Kernel partitions A and B usually share a key block */
+	if (!KeyBlockCacheIsEnabled())
+		KeyBlockCacheEnable(1);
+#endif
+
 	/* Calculate switch positions and boot mode */
 	rec_switch = (BOOT_FLAG_RECOVERY & params->boot_flags ? 1 : 0);
 	dev_switch = (BOOT_FLAG_DEVELOPER & params->boot_flags ? 1 : 0);
@@ -225,6 +451,7 @@ VbError_t LoadKernel(LoadKernelParams *params)
 	/* Read GPT data */
 	gpt.sector_bytes = (uint32_t)blba;
 	gpt.drive_sectors = params->ending_lba + 1;
+	VbSharedDataAddTimestamp(shared, VBSD_TS_LK_GPT_READ_START, 0);
 	if (0 != AllocAndReadGptData(params->disk_handle, &gpt)) {
 		VBDEBUG(("Unable to read GPT data\n"));
 		shcall->check_result = VBSD_LKC_CHECK_GPT_READ_ERROR;
@@ -237,25 +464,44 @@ VbError_t LoadKernel(LoadKernelParams *params)
 		shcall->check_result = VBSD_LKC_CHECK_GPT_PARSE_ERROR;
 		goto bad_gpt;
 	}
+	VbSharedDataAddTimestamp(shared, VBSD_TS_LK_GPT_READ_END, 0);
 
 	/* Allocate kernel header buffers */
 	kbuf = (uint8_t*)VbExMalloc(KBUF_SIZE);
 	if (!kbuf)
 		goto bad_gpt;
 
+#if defined(PARALLEL_KERNEL_CHECK)
+	/*
+	 * Read and check all the kernel headers at once.  The loop below
+	 * still makes every decision in the same order, using these results
+	 * in place of its own reads and checks.
+	 */
+	if (params->header_check_threads > 1)
+		precheck_count = LoadKernelPrecheck(
+				params->disk_handle, &gpt, KBUF_SIZE,
+				kernel_subkey, params->header_check_threads,
+				&prechecks);
+#endif
+
         /* Loop over candidate kernel partitions */
         while (GPT_SUCCESS ==
 	       GptNextKernelEntry(&gpt, &part_start, &part_size)) {
 		VbSharedDataKernelPart *shpart = NULL;
+		const KernelPartPrecheck *pre;
+		VbError_t read_result;
 		VbKeyBlockHeader *key_block;
 		VbKernelPreambleHeader *preamble;
+		RSAPublicKey data_key_view;
 		RSAPublicKey *data_key = NULL;
 		uint64_t key_version;
 		uint32_t combined_version;
 		uint64_t body_offset;
 		uint64_t body_offset_sectors;
 		uint64_t body_sectors;
+		uint8_t body_check;
 		int key_block_valid = 1;
+		int rv;
 
 		VBDEBUG(("Found kernel entry at %" PRIu64 " size %" PRIu64 "\n",
 			 part_start, part_size));
@@ -287,8 +533,18 @@ VbError_t LoadKernel(LoadKernelParams *params)
 			goto bad_kernel;
 		}
 
-		if (0 != VbExDiskRead(params->disk_handle, part_start,
-				      kbuf_sectors, kbuf)) {
+		pre = FindPrecheck(prechecks, precheck_count, part_start,
+				   part_size);
+		if (pre) {
+			read_result = pre->read_result;
+			if (VBERROR_SUCCESS == read_result)
+				Memcpy(kbuf, pre->kbuf, KBUF_SIZE);
+		} else {
+			read_result = VbExDiskRead(params->disk_handle,
+						   part_start, kbuf_sectors,
+						   kbuf);
+		}
+		if (VBERROR_SUCCESS != read_result) {
 			VBDEBUG(("Unable to read start of partition.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_READ_START;
 			goto bad_kernel;
@@ -300,6 +556,7 @@ VbError_t LoadKernel(LoadKernelParams *params)
 		body_offset = body_offset;
 		body_offset_sectors = body_offset_sectors;
 		body_sectors = body_sectors;
+		body_check = body_check;
 		kernel_subkey = kernel_subkey;
 		key_block = key_block;
 		key_version = key_version;
@@ -307,8 +564,12 @@ VbError_t LoadKernel(LoadKernelParams *params)
 #else
 		/* Verify the key block. */
 		key_block = (VbKeyBlockHeader*)kbuf;
-		if (0 != KeyBlockVerify(key_block, KBUF_SIZE,
-					kernel_subkey, 0)) {
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_KEYBLOCK_START,
+					 shpart->gpt_index);
+		rv = CheckKeyBlock(pre, key_block, KBUF_SIZE, kernel_subkey, 0);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_KEYBLOCK_END,
+					 shpart->gpt_index);
+		if (0 != rv) {
 			VBDEBUG(("Verifying key block signature failed.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_KEY_BLOCK_SIG;
 			key_block_valid = 0;
@@ -332,8 +593,8 @@ VbError_t LoadKernel(LoadKernelParams *params)
 			 * Allow the kernel if the SHA-512 hash of the key
 			 * block is valid.
 			 */
-			if (0 != KeyBlockVerify(key_block, KBUF_SIZE,
-						kernel_subkey, 1)) {
+			if (0 != CheckKeyBlock(pre, key_block, KBUF_SIZE,
+					       kernel_subkey, 1)) {
 				VBDEBUG(("Verifying key block hash failed.\n"));
 				shpart->check_result =
 					VBSD_LKP_CHECK_KEY_BLOCK_HASH;
@@ -386,7 +647,8 @@ VbError_t LoadKernel(LoadKernelParams *params)
 		}
 
 		/* Get key for preamble/data verification from the key block. */
-		data_key = PublicKeyToRSA(&key_block->data_key);
+		data_key = PublicKeyToRSAView(&key_block->data_key,
+					      &data_key_view);
 		if (!data_key) {
 			VBDEBUG(("Data key bad.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
@@ -396,10 +658,14 @@ VbError_t LoadKernel(LoadKernelParams *params)
 		/* Verify the preamble, which follows the key block */
 		preamble = (VbKernelPreambleHeader *)
 			(kbuf + key_block->key_block_size);
-		if ((0 != VerifyKernelPreamble(
-					preamble,
-					KBUF_SIZE - key_block->key_block_size,
-					data_key))) {
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_PREAMBLE_START,
+					 shpart->gpt_index);
+		rv = CheckPreamble(pre, preamble,
+				   KBUF_SIZE - key_block->key_block_size,
+				   data_key);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_PREAMBLE_END,
+					 shpart->gpt_index);
+		if (0 != rv) {
 			VBDEBUG(("Preamble verification failed.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_VERIFY_PREAMBLE;
 			goto bad_kernel;
@@ -444,8 +710,11 @@ VbError_t LoadKernel(LoadKernelParams *params)
 		 * one; we only needed to look at the versions to check for
 		 * rollback.  So skip to the next kernel preamble.
 		 */
-		if (-1 != good_partition)
+		if (-1 != good_partition) {
+			RSAPublicKeyFree(data_key);
+			data_key = NULL;
 			continue;
+		}
 
 		/* Verify kernel body starts at multiple of sector size. */
 		body_offset = key_block->key_block_size +
@@ -483,21 +752,18 @@ VbError_t LoadKernel(LoadKernelParams *params)
 			goto bad_kernel;
 		}
 
-		/* Read the kernel data */
-		if (0 != VbExDiskRead(params->disk_handle,
-				      part_start + body_offset_sectors,
-				      body_sectors, params->kernel_buffer)) {
-			VBDEBUG(("Unable to read kernel data.\n"));
-			shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
-			goto bad_kernel;
-		}
-
-		/* Verify kernel data */
-		if (0 != VerifyData((const uint8_t *)params->kernel_buffer,
-				    params->kernel_buffer_size,
-				    &preamble->body_signature, data_key)) {
-			VBDEBUG(("Kernel data verification failed.\n"));
-			shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+		/* Read and verify the kernel data */
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_BODY_START,
+					 shpart->gpt_index);
+		body_check = LoadKernelBody(params,
+					    part_start + body_offset_sectors,
+					    body_sectors,
+					    &preamble->body_signature,
+					    data_key);
+		VbSharedDataAddTimestamp(shared, VBSD_TS_LK_BODY_END,
+					 shpart->gpt_index);
+		if (0 != body_check) {
+			shpart->check_result = body_check;
 			goto bad_kernel;
 		}
 
@@ -580,6 +846,9 @@ VbError_t LoadKernel(LoadKernelParams *params)
 	/* Free kernel buffer */
 	if (kbuf)
 		VbExFree(kbuf);
+#if defined(PARALLEL_KERNEL_CHECK)
+	LoadKernelPrecheckFree(prechecks, precheck_count);
+#endif
 
 	/* Write and free GPT data */
 	WriteAndFreeGptData(params->disk_handle, &gpt);
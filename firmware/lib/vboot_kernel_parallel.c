@@ -0,0 +1,177 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Checking the headers of all candidate kernel partitions at once, using a
+ * pool of threads.  This is only built into host (userspace) versions of the
+ * library, for image validators which want to look at every kernel on a
+ * disk; firmware checks partitions one at a time in LoadKernel().
+ */
+
+#include "sysincludes.h"
+
+#include <pthread.h>
+
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "load_kernel_fw.h"
+#include "utility.h"
+#include "vboot_api.h"
+#include "vboot_common.h"
+#include "vboot_kernel.h"
+
+/* Work shared by the threads */
+typedef struct PrecheckPool {
+	VbExDiskHandle_t disk_handle;
+	uint64_t sector_bytes;
+	uint64_t kbuf_size;
+	const VbPublicKey *kernel_subkey;
+	KernelPartPrecheck *checks;
+	int count;
+	int next;  /* Next partition to check; protected by [lock] */
+	pthread_mutex_t lock;
+} PrecheckPool;
+
+/**
+ * Read and check the headers of one partition.  Does the same reads and
+ * checks as LoadKernel(), but checks both the key block signature and hash
+ * and the preamble regardless of the boot mode, and leaves deciding which
+ * results matter to LoadKernel().
+ */
+static void PrecheckPartition(const PrecheckPool *pool, KernelPartPrecheck *c)
+{
+	VbKeyBlockHeader *key_block;
+	VbKernelPreambleHeader *preamble;
+	RSAPublicKey data_key_view;
+	RSAPublicKey *data_key;
+
+	/* LoadKernel() rejects partitions too small to hold the headers */
+	if (c->part_size < pool->kbuf_size / pool->sector_bytes)
+		return;
+
+	c->kbuf = (uint8_t *)VbExMalloc(pool->kbuf_size);
+	c->read_result = VbExDiskRead(pool->disk_handle, c->part_start,
+				      pool->kbuf_size / pool->sector_bytes,
+				      c->kbuf);
+	if (VBERROR_SUCCESS != c->read_result)
+		return;
+
+	key_block = (VbKeyBlockHeader *)c->kbuf;
+	c->key_block_sig_result = KeyBlockVerify(key_block, pool->kbuf_size,
+						 pool->kernel_subkey, 0);
+	c->key_block_hash_result = KeyBlockVerify(key_block, pool->kbuf_size,
+						  pool->kernel_subkey, 1);
+	if (c->key_block_sig_result && c->key_block_hash_result)
+		return;
+
+	data_key = PublicKeyToRSAView(&key_block->data_key,
+				      &data_key_view);
+	if (!data_key)
+		return;
+
+	preamble = (VbKernelPreambleHeader *)
+		(c->kbuf + key_block->key_block_size);
+	c->preamble_result = VerifyKernelPreamble(
+			preamble, pool->kbuf_size - key_block->key_block_size,
+			data_key);
+	c->preamble_checked = 1;
+	RSAPublicKeyFree(data_key);
+}
+
+static void *PrecheckThread(void *arg)
+{
+	PrecheckPool *pool = (PrecheckPool *)arg;
+	int i;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->count)
+			break;
+		PrecheckPartition(pool, pool->checks + i);
+	}
+	return NULL;
+}
+
+int LoadKernelPrecheck(VbExDiskHandle_t disk_handle, const GptData *gpt,
+		       uint64_t kbuf_size, const VbPublicKey *kernel_subkey,
+		       int num_threads, KernelPartPrecheck **checks_ptr)
+{
+	PrecheckPool pool;
+	pthread_t *threads;
+	int num_started = 0;
+	GptData scan;
+	uint64_t part_start, part_size;
+	int count = 0;
+	int i;
+
+	*checks_ptr = NULL;
+
+	/*
+	 * Find the partitions in the order LoadKernel() will look at them,
+	 * using a copy of the GPT state so the caller's scan isn't disturbed.
+	 */
+	scan = *gpt;
+	while (GPT_SUCCESS ==
+	       GptNextKernelEntry(&scan, &part_start, &part_size))
+		count++;
+	if (!count)
+		return 0;
+
+	Memset(&pool, 0, sizeof(pool));
+	pool.disk_handle = disk_handle;
+	pool.sector_bytes = gpt->sector_bytes;
+	pool.kbuf_size = kbuf_size;
+	pool.kernel_subkey = kernel_subkey;
+	pool.checks = (KernelPartPrecheck *)
+		VbExMalloc(count * sizeof(KernelPartPrecheck));
+	Memset(pool.checks, 0, count * sizeof(KernelPartPrecheck));
+
+	scan = *gpt;
+	while (pool.count < count && GPT_SUCCESS ==
+	       GptNextKernelEntry(&scan, &part_start, &part_size)) {
+		pool.checks[pool.count].part_start = part_start;
+		pool.checks[pool.count].part_size = part_size;
+		pool.count++;
+	}
+	pthread_mutex_init(&pool.lock, NULL);
+
+	if (num_threads > pool.count)
+		num_threads = pool.count;
+	threads = (pthread_t *)VbExMalloc(num_threads * sizeof(pthread_t));
+	/* This thread does its share too, so start one fewer */
+	for (i = 0; i < num_threads - 1; i++) {
+		if (pthread_create(threads + num_started, NULL,
+				   PrecheckThread, &pool))
+			break;
+		num_started++;
+	}
+
+	PrecheckThread(&pool);
+
+	for (i = 0; i < num_started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+	VbExFree(threads);
+
+	VBDEBUG(("Prechecked %d kernel partitions with %d threads\n",
+		 pool.count, num_started + 1));
+	*checks_ptr = pool.checks;
+	return pool.count;
+}
+
+void LoadKernelPrecheckFree(KernelPartPrecheck *checks, int count)
+{
+	int i;
+
+	if (!checks)
+		return;
+
+	for (i = 0; i < count; i++) {
+		if (checks[i].kbuf)
+			VbExFree(checks[i].kbuf);
+	}
+	VbExFree(checks);
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Profiling and response caching in the userspace TPM stub.  These are only
+ * available in host builds; see firmware/stub/tpm_lite_stub.c.
+ */
+
+#ifndef VBOOT_REFERENCE_TPM_LITE_STUB_H_
+#define VBOOT_REFERENCE_TPM_LITE_STUB_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Number of latency histogram buckets.  Bucket i counts commands which took
+ * less than 2^i microseconds (and at least 2^(i-1)); the last bucket also
+ * counts everything slower. */
+#define TPM_PROFILE_BUCKETS 24
+
+/* Maximum number of different command ordinals profiled */
+#define TPM_PROFILE_MAX_COMMANDS 32
+
+typedef struct TpmCommandProfile {
+	uint32_t ordinal;
+	uint32_t count;		/* Commands sent to the TPM */
+	uint32_t errors;	/* ...of which failed to get a response */
+	uint32_t cached;	/* Commands answered from the cache instead */
+	uint64_t total_us;
+	uint64_t min_us;
+	uint64_t max_us;
+	uint32_t histogram[TPM_PROFILE_BUCKETS];
+} TpmCommandProfile;
+
+/**
+ * Return the number of different commands profiled so far, and the profile
+ * of the [index]th of them (in the order first seen), or NULL if [index] is
+ * out of range.
+ */
+int TpmProfileCount(void);
+const TpmCommandProfile *TpmProfileGet(int index);
+
+/**
+ * Forget all profiling data collected so far.
+ */
+void TpmProfileReset(void);
+
+/**
+ * Print the profile to [f], as JSON if [json] is non-zero, else as text.
+ *
+ * If the TPM_PROFILE environment variable is "text" or "json" when the TPM
+ * is initialized, the profile is printed to stderr that way at exit.
+ */
+void TpmProfilePrint(FILE *f, int json);
+
+/**
+ * Enable or disable the response cache.  When enabled, responses to
+ * read-only queries (capabilities and flags, PCR and NV reads) are
+ * remembered and the same request is answered from memory until a command
+ * which may change TPM state is sent.  Disabling the cache empties it.
+ *
+ * The cache only sees this process's commands, so it's off by default; it
+ * can also be turned on by setting the TPM_CACHE environment variable to 1
+ * before the TPM is initialized.
+ */
+void TpmCacheEnable(int enable);
+
+/**
+ * Empty the response cache.
+ */
+void TpmCacheFlush(void);
+
+#endif  /* VBOOT_REFERENCE_TPM_LITE_STUB_H_ */
@@ -11,11 +11,13 @@
 #define _STUB_IMPLEMENTATION_
 #include "tlcl.h"
 #include "tlcl_internal.h"
+#include "tpm_lite_stub.h"
 #include "utility.h"
 #include "vboot_api.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +34,17 @@
 #define OPEN_RETRY_DELAY_NS (10 * 1000 * 1000)
 #define OPEN_RETRY_MAX_NUM  500
 
+/* Ordinals (from the TPM 1.2 spec, part 2) of the read-only queries whose
+ * responses may be cached. */
+#define TPM_ORD_PCR_READ       0x15
+#define TPM_ORD_GET_CAPABILITY 0x65
+#define TPM_ORD_NV_READ_VALUE  0xcf
+
+/* Size of the response cache.  The queries we cache are all small. */
+#define CACHE_ENTRIES      8
+#define CACHE_MAX_REQUEST  32
+#define CACHE_MAX_RESPONSE TPM_LARGE_ENOUGH_COMMAND_SIZE
+
 /* TODO: these functions should pass errors back rather than returning void */
 /* TODO: if the only callers to these are just wrappers, should just
  * remove the wrappers and call us directly. */
@@ -44,6 +57,30 @@ static int tpm_fd = -1;
  */
 static int exit_on_failure = 1;
 
+/* Per-command profiles, in the order the commands were first seen.
+ */
+static TpmCommandProfile profiles[TPM_PROFILE_MAX_COMMANDS];
+static int num_profiles;
+/* How to print the profile at exit: 1 = JSON, 0 = text, -1 = don't.
+ */
+static int profile_at_exit = -1;
+
+/* Ordinal and start time of the split-phase command in progress.
+ */
+static uint32_t pending_ordinal;
+static uint64_t pending_start_us;
+
+typedef struct CacheEntry {
+  uint32_t request_length;  /* 0 if the entry is unused */
+  uint8_t request[CACHE_MAX_REQUEST];
+  uint32_t response_length;
+  uint8_t response[CACHE_MAX_RESPONSE];
+} CacheEntry;
+
+static int cache_enabled;
+static CacheEntry cache[CACHE_ENTRIES];
+static int cache_next;  /* The entry to replace next */
+
 /* Similar to VbExError, only handle the non-exit case.
  */
 static VbError_t DoError(VbError_t result, const char* format, ...) {
@@ -74,6 +111,201 @@ __attribute__((unused)) static void PrintBytes(const uint8_t* a, int n) {
 }
 
 
+/* Returns a monotonic time in microseconds.
+ */
+static uint64_t NowUs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+/* Gets the ordinal of a TPM command, or 0 if the command is too short to
+ * have one.
+ */
+static uint32_t TpmOrdinal(const uint8_t* request, uint32_t request_length) {
+  uint32_t ordinal;
+  if (request_length < kTpmRequestHeaderLength)
+    return 0;
+  FromTpmUint32(request + sizeof(uint16_t) + sizeof(uint32_t), &ordinal);
+  return ordinal;
+}
+
+
+/* Finds the profile for [ordinal], adding one if needed.  Returns NULL if
+ * there's no room for another.
+ */
+static TpmCommandProfile* FindProfile(uint32_t ordinal) {
+  TpmCommandProfile* p;
+  int i;
+
+  for (i = 0; i < num_profiles; i++) {
+    if (profiles[i].ordinal == ordinal)
+      return profiles + i;
+  }
+  if (num_profiles == TPM_PROFILE_MAX_COMMANDS)
+    return NULL;
+  p = profiles + num_profiles++;
+  Memset(p, 0, sizeof(*p));
+  p->ordinal = ordinal;
+  return p;
+}
+
+
+/* Records that the command [ordinal] took [us] microseconds on the TPM.
+ */
+static void ProfileCommand(uint32_t ordinal, uint64_t us, int failed) {
+  TpmCommandProfile* p = FindProfile(ordinal);
+  int bucket = 0;
+
+  if (!p)
+    return;
+  if (!p->count || us < p->min_us)
+    p->min_us = us;
+  if (us > p->max_us)
+    p->max_us = us;
+  p->count++;
+  p->total_us += us;
+  if (failed)
+    p->errors++;
+  while (bucket < TPM_PROFILE_BUCKETS - 1 && us >= (1ULL << bucket))
+    bucket++;
+  p->histogram[bucket]++;
+}
+
+
+/* Returns non-zero if the command [ordinal] only reads TPM state, so its
+ * response can be cached.
+ */
+static int IsCacheable(uint32_t ordinal) {
+  return (ordinal == TPM_ORD_GET_CAPABILITY ||
+          ordinal == TPM_ORD_PCR_READ ||
+          ordinal == TPM_ORD_NV_READ_VALUE);
+}
+
+
+/* Looks up the cached response to a request.  Returns NULL if none.
+ */
+static const CacheEntry* CacheLookup(const uint8_t* request,
+                                     uint32_t request_length) {
+  int i;
+  for (i = 0; i < CACHE_ENTRIES; i++) {
+    if (cache[i].request_length == request_length &&
+        !Memcmp(cache[i].request, request, request_length))
+      return cache + i;
+  }
+  return NULL;
+}
+
+
+/* Remembers the response to a request, if it succeeded and fits.
+ */
+static void CacheStore(const uint8_t* request, uint32_t request_length,
+                       const uint8_t* response, uint32_t response_length) {
+  CacheEntry* e;
+  uint32_t code;
+
+  if (request_length > CACHE_MAX_REQUEST ||
+      response_length > CACHE_MAX_RESPONSE ||
+      response_length < kTpmResponseHeaderLength)
+    return;
+  FromTpmUint32(response + sizeof(uint16_t) + sizeof(uint32_t), &code);
+  if (code != TPM_SUCCESS)
+    return;
+
+  e = cache + cache_next;
+  cache_next = (cache_next + 1) % CACHE_ENTRIES;
+  e->request_length = request_length;
+  Memcpy(e->request, request, request_length);
+  e->response_length = response_length;
+  Memcpy(e->response, response, response_length);
+}
+
+
+static void PrintProfileAtExit(void) {
+  if (profile_at_exit >= 0)
+    TpmProfilePrint(stderr, profile_at_exit);
+}
+
+
+int TpmProfileCount(void) {
+  return num_profiles;
+}
+
+
+const TpmCommandProfile* TpmProfileGet(int index) {
+  if (index < 0 || index >= num_profiles)
+    return NULL;
+  return profiles + index;
+}
+
+
+void TpmProfileReset(void) {
+  num_profiles = 0;
+}
+
+
+void TpmProfilePrint(FILE* f, int json) {
+  int i, j;
+
+  if (json)
+    fprintf(f, "{\"commands\": [");
+  else
+    fprintf(f, "TPM command profile (%d commands):\n", num_profiles);
+
+  for (i = 0; i < num_profiles; i++) {
+    const TpmCommandProfile* p = profiles + i;
+    uint64_t avg_us = p->count ? p->total_us / p->count : 0;
+
+    if (json) {
+      fprintf(f, "%s\n  {\"ordinal\": %u, \"count\": %u, \"errors\": %u, "
+              "\"cached\": %u, \"total_us\": %llu, \"min_us\": %llu, "
+              "\"max_us\": %llu, \"histogram\": [",
+              i ? "," : "", p->ordinal, p->count, p->errors, p->cached,
+              (unsigned long long)p->total_us,
+              (unsigned long long)p->min_us,
+              (unsigned long long)p->max_us);
+      for (j = 0; j < TPM_PROFILE_BUCKETS; j++)
+        fprintf(f, "%s%u", j ? ", " : "", p->histogram[j]);
+      fprintf(f, "]}");
+      continue;
+    }
+
+    fprintf(f, "  0x%08x: %u sent, %u failed, %u cached",
+            p->ordinal, p->count, p->errors, p->cached);
+    if (p->count)
+      fprintf(f, ", min %llu us, avg %llu us, max %llu us",
+              (unsigned long long)p->min_us, (unsigned long long)avg_us,
+              (unsigned long long)p->max_us);
+    fprintf(f, "\n");
+    for (j = 0; j < TPM_PROFILE_BUCKETS; j++) {
+      if (!p->histogram[j])
+        continue;
+      if (j < TPM_PROFILE_BUCKETS - 1)
+        fprintf(f, "    < %llu us: %u\n", 1ULL << j, p->histogram[j]);
+      else
+        fprintf(f, "    >= %llu us: %u\n", 1ULL << (j - 1), p->histogram[j]);
+    }
+  }
+
+  if (json)
+    fprintf(f, "\n]}\n");
+}
+
+
+void TpmCacheEnable(int enable) {
+  cache_enabled = enable;
+  if (!enable)
+    TpmCacheFlush();
+}
+
+
+void TpmCacheFlush(void) {
+  Memset(cache, 0, sizeof(cache));
+  cache_next = 0;
+}
+
+
 /* Executes a command on the TPM.
  */
 static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
@@ -134,9 +366,25 @@ static inline int TpmResponseSize(const uint8_t* buffer) {
 
 
 VbError_t VbExTpmInit(void) {
+  static int registered_atexit;
   char *no_exit = getenv("TPM_NO_EXIT");
+  char *profile = getenv("TPM_PROFILE");
+  char *use_cache = getenv("TPM_CACHE");
+
   if (no_exit)
     exit_on_failure = !atoi(no_exit);
+  if (profile) {
+    if (!strcmp(profile, "json"))
+      profile_at_exit = 1;
+    else if (!strcmp(profile, "text"))
+      profile_at_exit = 0;
+    if (profile_at_exit >= 0 && !registered_atexit) {
+      atexit(PrintProfileAtExit);
+      registered_atexit = 1;
+    }
+  }
+  if (use_cache)
+    TpmCacheEnable(atoi(use_cache));
   return VbExTpmOpen();
 }
 
@@ -208,13 +456,35 @@ VbError_t VbExTpmSendReceive(const uint8_t* request, uint32_t request_length,
   int tag, response_tag;
 #endif
   VbError_t result;
+  uint32_t ordinal = TpmOrdinal(request, request_length);
+  uint64_t before, after;
+
+  if (cache_enabled) {
+    if (IsCacheable(ordinal)) {
+      const CacheEntry* e = CacheLookup(request, request_length);
+      if (e && e->response_length <= *response_length) {
+        TpmCommandProfile* p = FindProfile(ordinal);
+        if (p)
+          p->cached++;
+        Memcpy(response, e->response, e->response_length);
+        *response_length = e->response_length;
+        return VBERROR_SUCCESS;
+      }
+    } else {
+      /* This may change what the cached queries would return */
+      TpmCacheFlush();
+    }
+  }
 
-  struct timeval before, after;
-  gettimeofday(&before, NULL);
+  before = NowUs();
   result = TpmExecute(request, request_length, response, response_length);
+  after = NowUs();
+  ProfileCommand(ordinal, after - before, result != VBERROR_SUCCESS);
   if (result != VBERROR_SUCCESS)
     return result;
-  gettimeofday(&after, NULL);
+
+  if (cache_enabled && IsCacheable(ordinal))
+    CacheStore(request, request_length, response, *response_length);
 
 #ifdef VBOOT_DEBUG
   {
@@ -226,9 +496,7 @@ VbError_t VbExTpmSendReceive(const uint8_t* request, uint32_t request_length,
     VBDEBUG(("response (%d bytes): ", y));
     PrintBytes(response, 10);
     PrintBytes(response + 10, y - 10);
-    VBDEBUG(("execution time: %dms\n",
-            (int) ((after.tv_sec - before.tv_sec) * 1000 +
-                   (after.tv_usec - before.tv_usec) / 1000)));
+    VBDEBUG(("execution time: %dms\n", (int) ((after - before) / 1000)));
   }
 #endif
 
@@ -248,3 +516,63 @@ VbError_t VbExTpmSendReceive(const uint8_t* request, uint32_t request_length,
 
   return VBERROR_SUCCESS;
 }
+
+
+VbError_t VbExTpmSendRequest(const uint8_t* request, uint32_t request_length) {
+  int n;
+
+  if (request_length <= 0) {
+    return DoError(TPM_E_INPUT_TOO_SMALL,
+                   "invalid command length %d for command 0x%x\n",
+                   request_length, request[9]);
+  } else if (tpm_fd < 0) {
+    return DoError(TPM_E_NO_DEVICE,
+                   "the TPM device was not opened.  " \
+                   "Forgot to call TlclLibInit?\n");
+  }
+  pending_ordinal = TpmOrdinal(request, request_length);
+  if (cache_enabled && !IsCacheable(pending_ordinal))
+    TpmCacheFlush();
+  pending_start_us = NowUs();
+  n = write(tpm_fd, request, request_length);
+  if (n != request_length) {
+    ProfileCommand(pending_ordinal, NowUs() - pending_start_us, 1);
+    return DoError(TPM_E_WRITE_FAILURE,
+                   "write failure to TPM device: %s\n", strerror(errno));
+  }
+  return VBERROR_SUCCESS;
+}
+
+
+VbError_t VbExTpmGetResponse(uint8_t* response, uint32_t* response_length,
+                             uint32_t timeout_ms) {
+  uint8_t buf[TPM_MAX_COMMAND_SIZE];
+  struct pollfd pfd;
+  int n;
+
+  /* The driver makes the device readable once the TPM has answered. */
+  pfd.fd = tpm_fd;
+  pfd.events = POLLIN;
+  do {
+    pfd.revents = 0;
+    n = poll(&pfd, 1, timeout_ms);
+  } while (n < 0 && errno == EINTR);
+  if (n == 0)
+    return VBERROR_TPM_RESPONSE_PENDING;
+
+  n = read(tpm_fd, buf, sizeof(buf));
+  ProfileCommand(pending_ordinal, NowUs() - pending_start_us,
+                 n <= 0 || n > *response_length);
+  if (n == 0) {
+    return DoError(TPM_E_READ_EMPTY, "null read from TPM device\n");
+  } else if (n < 0) {
+    return DoError(TPM_E_READ_FAILURE, "read failure from TPM device: %s\n",
+                   strerror(errno));
+  } else if (n > *response_length) {
+    return DoError(TPM_E_RESPONSE_TOO_LARGE,
+                   "TPM response too long for output buffer\n");
+  }
+  *response_length = n;
+  Memcpy(response, buf, n);
+  return VBERROR_SUCCESS;
+}
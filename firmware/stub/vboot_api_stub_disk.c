@@ -38,6 +38,17 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 }
 
 
+VbError_t VbExDiskReadAsync(VbExDiskHandle_t handle, uint64_t lba_start,
+                            uint64_t lba_count, void* buffer) {
+  return VBERROR_NO_ASYNC_DISK_READ;
+}
+
+
+VbError_t VbExDiskReadWait(VbExDiskHandle_t handle) {
+  return VBERROR_SUCCESS;
+}
+
+
 VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
                         uint64_t lba_count, const void* buffer) {
   return VBERROR_SUCCESS;
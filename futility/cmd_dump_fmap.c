@@ -16,7 +16,9 @@
 #include <unistd.h>
 
 #include "fmap.h"
+#include "fmap_layout.h"
 #include "futility.h"
+#include "image_scan.h"
 
 enum { FMT_NORMAL, FMT_PRETTY, FMT_FLASHROM, FMT_HUMAN };
 
@@ -112,44 +114,9 @@ static int dump_fmap(const void *ptr, int argc, char *argv[])
 /****************************************************************************/
 /* Stuff for human-readable form */
 
-typedef struct dup_s {
-  char *name;
-  struct dup_s *next;
-} dupe_t;
-
-typedef struct node_s {
-  char *name;
-  uint32_t start;
-  uint32_t size;
-  uint32_t end;
-  struct node_s *parent;
-  int num_children;
-  struct node_s **child;
-  dupe_t *alias;
-} node_t;
-
-static node_t *all_nodes;
-
-static void sort_nodes(int num, node_t *ary[])
-{
-  int i, j;
-  node_t *tmp;
-
-  /* bubble-sort is quick enough with only a few entries */
-  for (i = 0; i < num; i++) {
-    for (j = i + 1; j < num; j++) {
-      if (ary[j]->start > ary[i]->start) {
-        tmp = ary[i];
-        ary[i] = ary[j];
-        ary[j] = tmp;
-      }
-    }
-  }
-}
-
-
-static void line(int indent, char *name,
-                 uint32_t start, uint32_t end, uint32_t size, char *append)
+static void line(int indent, const char *name,
+                 uint32_t start, uint32_t end, uint32_t size,
+                 const char *append)
 {
   int i;
   for (i = 0; i < indent; i++)
@@ -158,193 +125,76 @@ static void line(int indent, char *name,
          append ? append : "");
 }
 
-static int gapcount;
-static void empty(int indent, uint32_t start, uint32_t end, char *name)
+static void empty(int indent, const FmapLayoutGap *gap, const char *name)
 {
   char buf[80];
   if (opt_gaps) {
     sprintf(buf, "  // gap in %s", name);
-    line(indent + 1, "", start, end, end - start, buf);
+    line(indent + 1, "", gap->start, gap->end, gap->end - gap->start, buf);
   }
-  gapcount++;
 }
 
-static void show(node_t *p, int indent, int show_first)
+/* Show the highest areas first, with each gap just above the child below it */
+static void show(const FmapLayoutNode *p, int indent, int show_first)
 {
   int i;
-  dupe_t *alias;
+  int g = p->num_gaps - 1;
   if (show_first) {
     line(indent, p->name, p->start, p->end, p->size, 0);
-    for (alias = p->alias; alias; alias = alias->next)
-      line(indent, alias->name, p->start, p->end, p->size, "  // DUPLICATE");
-  }
-  sort_nodes(p->num_children, p->child);
-  for (i = 0; i < p->num_children; i++) {
-      if (i == 0 && p->end != p->child[i]->end)
-        empty(indent, p->child[i]->end, p->end, p->name);
-      show(p->child[i], indent + show_first, 1);
-      if (i < p->num_children - 1 && p->child[i]->start != p->child[i+1]->end)
-        empty(indent, p->child[i+1]->end, p->child[i]->start, p->name);
-      if (i == p->num_children - 1 && p->child[i]->start != p->start)
-        empty(indent, p->start, p->child[i]->start, p->name);
+    for (i = 0; i < p->num_dupes; i++)
+      line(indent, p->dupes[i]->name, p->start, p->end, p->size,
+           "  // DUPLICATE");
   }
-}
-
-static int overlaps(int i, int j)
-{
-  node_t *a = all_nodes + i;
-  node_t *b = all_nodes + j;
-
-  return ((a->start < b->start) && (b->start < a->end) &&
-          (b->start < a->end) && (a->end < b->end));
-}
-
-static int encloses(int i, int j)
-{
-  node_t *a = all_nodes + i;
-  node_t *b = all_nodes + j;
-
-  return ((a->start <= b->start) &&
-          (a->end >= b->end));
-}
-
-static int duplicates(int i, int j)
-{
-  node_t *a = all_nodes + i;
-  node_t *b = all_nodes + j;
-
-  return ((a->start == b->start) &&
-          (a->end == b->end));
-}
-
-static void add_dupe(int i, int j, int numnodes)
-{
-  int k;
-  dupe_t *alias;
-
-  alias = (dupe_t *)malloc(sizeof(dupe_t));
-  alias->name = all_nodes[j].name;
-  alias->next = all_nodes[i].alias;
-  all_nodes[i].alias = alias;
-  for (k = j; k < numnodes; k++ )
-    all_nodes[k] = all_nodes[k + 1];
-}
-
-static void add_child(node_t *p, int n)
-{
-  int i;
-  if (p->num_children && !p->child) {
-    p->child = (struct node_s **)calloc(p->num_children, sizeof(node_t *));
-    if (!p->child) {
-      perror("calloc failed");
-      exit(1);
-    }
+  for (i = p->num_children - 1; i >= 0; i--) {
+    if (g >= 0 && p->gaps[g].below == i)
+      empty(indent, p->gaps + g--, p->name);
+    show(p->children[i], indent + show_first, 1);
   }
-  for (i = 0; i < p->num_children; i++)
-    if (!p->child[i]) {
-      p->child[i] = all_nodes + n;
-      return;
-    }
+  if (g >= 0)
+    empty(indent, p->gaps + g, p->name);
 }
 
 static int human_fmap(void *p)
 {
-  FmapHeader *fmh;
-  FmapAreaHeader *ah;
-  int i, j, errorcnt=0;
-  int numnodes;
-
-  fmh = (FmapHeader *)p;
-  ah = (FmapAreaHeader *)(fmh + 1);
-
-  /* The challenge here is to generate a directed graph from the
-   * arbitrarily-ordered FMAP entries, and then to prune it until it's as
-   * simple (and deep) as possible. Overlapping regions are not allowed.
-   * Duplicate regions are okay, but may require special handling. */
-
-  /* Convert the FMAP info into our format. */
-  numnodes = fmh->fmap_nareas;
-
-  /* plus one for the all-enclosing "root" */
-  all_nodes = (node_t *)calloc(numnodes+1, sizeof(node_t));
-  if (!all_nodes) {
-    perror("calloc failed");
-    exit(1);
-  }
-  for (i = 0; i < numnodes; i++) {
-    char buf[FMAP_NAMELEN+1];
-    strncpy(buf, ah[i].area_name, FMAP_NAMELEN);
-    buf[FMAP_NAMELEN] = '\0';
-    if (!(all_nodes[i].name = strdup(buf))) {
-      perror("strdup failed");
-      exit(1);
-    }
-    all_nodes[i].start = ah[i].area_offset;
-    all_nodes[i].size = ah[i].area_size;
-    all_nodes[i].end = ah[i].area_offset + ah[i].area_size;
-  }
-  /* Now add the root node */
-  all_nodes[numnodes].name = strdup("-entire flash-");
-  all_nodes[numnodes].start = fmh->fmap_base;
-  all_nodes[numnodes].size = fmh->fmap_size;
-  all_nodes[numnodes].end = fmh->fmap_base + fmh->fmap_size;
-
-
-  /* First, coalesce any duplicates */
-  for (i = 0; i < numnodes; i++) {
-    for (j = i + 1; j < numnodes; j++) {
-      if (duplicates(i, j)) {
-        add_dupe(i, j, numnodes);
-        numnodes--;
-      }
-    }
+  FmapLayout layout;
+  const FmapLayoutOverlap *o;
+  int i, errorcnt=0;
+
+  /* The layout library works out the tree of areas, each inside the
+   * smallest one enclosing it. Overlapping regions are not allowed.
+   * Duplicate regions are okay, and are shown with the first of them. */
+  if (0 != FmapLayoutBuild((const FmapHeader *)p, &layout)) {
+    fprintf(stderr, "%s: can't build FMAP layout: out of memory\n",
+            progname);
+    FmapLayoutFree(&layout);
+    return 1;
   }
 
-  /* Each node should have at most one parent, which is the smallest enclosing
-   * node. Duplicate nodes "enclose" each other, but if there's already a
-   * relationship in one direction, we won't create another. */
-  for (i = 0; i < numnodes; i++) {
-    /* Find the smallest parent, which might be the root node. */
-    int k = numnodes;
-    for (j = 0; j < numnodes; j++) {    /* full O(N^2), not triangular */
-      if (i == j)
-        continue;
-      if (overlaps(i, j)) {
-        printf("ERROR: %s and %s overlap\n",
-               all_nodes[i].name, all_nodes[j].name);
-        printf("  %s: 0x%x - 0x%x\n", all_nodes[i].name,
-               all_nodes[i].start, all_nodes[i].end);
-        printf("  %s: 0x%x - 0x%x\n", all_nodes[j].name,
-               all_nodes[j].start, all_nodes[j].end);
-        if (opt_overlap < 2) {
-          printf("Use more -h args to ignore this error\n");
-          errorcnt++;
-        }
-        continue;
-      }
-      if (encloses(j, i) && all_nodes[j].size < all_nodes[k].size)
-        k = j;
+  for (i = 0; i < layout.num_overlaps; i++) {
+    o = layout.overlaps + i;
+    printf("ERROR: %s and %s overlap\n", o->first->name, o->second->name);
+    printf("  %s: 0x%x - 0x%x\n", o->first->name,
+           o->first->start, o->first->end);
+    printf("  %s: 0x%x - 0x%x\n", o->second->name,
+           o->second->start, o->second->end);
+    if (opt_overlap < 2) {
+      printf("Use more -h args to ignore this error\n");
+      errorcnt++;
     }
-    all_nodes[i].parent = all_nodes + k;
   }
-  if (errorcnt)
+  if (errorcnt) {
+    FmapLayoutFree(&layout);
     return 1;
-
-  /* Force those deadbeat parents to recognize their children */
-  for (i = 0; i < numnodes; i++)        /* how many */
-    if (all_nodes[i].parent)
-      all_nodes[i].parent->num_children++;
-  for (i = 0; i < numnodes; i++)        /* here they are */
-    if (all_nodes[i].parent)
-      add_child(all_nodes[i].parent, i);
+  }
 
   /* Ready to go */
   printf("# name                     start       end         size\n");
-  show(all_nodes + numnodes, 0, opt_gaps);
+  show(layout.root, 0, opt_gaps);
 
-  if (gapcount && !opt_gaps)
+  if (layout.num_gaps && !opt_gaps)
     printf("\nWARNING: unused regions found. Use -H to see them\n");
 
+  FmapLayoutFree(&layout);
   return 0;
 }
 
@@ -357,6 +207,8 @@ static int do_dump_fmap(int argc, char *argv[])
   int errorcnt = 0;
   struct stat sb;
   int fd;
+  ImageScan scan;
+  int64_t fmap_offset;
   const char *fmap;
   int retval = 1;
 
@@ -447,8 +299,19 @@ static int do_dump_fmap(int argc, char *argv[])
   }
   close(fd);                            /* done with this now */
 
-  fmap = FmapFind((char*) base_of_rom, sb.st_size);
-  if (fmap) {
+  if (0 != ScanImage(base_of_rom, sb.st_size, &scan)) {
+    fprintf(stderr, "%s: can't scan %s: out of memory\n",
+            progname,
+            argv[optind]);
+    FreeImageScan(&scan);
+    munmap(base_of_rom, sb.st_size);
+    return 1;
+  }
+  fmap_offset = ImageScanFirst(&scan, IMAGE_SIG_FMAP, 1);
+  FreeImageScan(&scan);
+
+  if (fmap_offset >= 0) {
+    fmap = (char*) base_of_rom + fmap_offset;
     switch (opt_format) {
     case FMT_HUMAN:
       retval = human_fmap((void *)fmap);
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Verify many signed kernel and firmware images in one process.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "futility.h"
+#include "host_common.h"
+#include "vboot_common.h"
+
+/* The kernel key block and preamble are in this much of the image */
+#define KERNEL_HEADER_SIZE 65536
+
+/* Longest manifest line we'll take */
+#define MAX_LINE 4096
+
+enum { IMAGE_KERNEL, IMAGE_FIRMWARE };
+static const char * const image_type_name[] = { "kernel", "firmware" };
+
+/* A public key, read and parsed once however many images it's used for.  The
+ * verify threads share it read-only. */
+typedef struct {
+  char *filename;
+  VbPublicKey *key;
+  RSAPublicKey *rsa;
+} key_entry_t;
+
+/* One image to verify, and what happened when we did */
+typedef struct {
+  int type;
+  int line;
+  char *image;                          /* kernel or firmware vblock */
+  char *fv;                             /* firmware body */
+  const VbPublicKey *sign_key;          /* NULL to check the hash only */
+  const RSAPublicKey *sign_rsa;         /* [sign_key], parsed */
+  const char *sign_key_file;
+
+  /* Results */
+  const char *error;                    /* NULL if it verified */
+  uint64_t key_block_flags;
+  uint64_t data_key_version;
+  uint64_t version;                     /* kernel or firmware version */
+  uint64_t body_size;
+  uint64_t usecs;
+} image_t;
+
+typedef struct {
+  image_t *images;
+  int count;
+  int next;                             /* protected by [lock] */
+  pthread_mutex_t lock;
+} pool_t;
+
+static key_entry_t *keys;
+static int num_keys;
+
+/* Returns the key in [filename], reading and parsing it if that hasn't been
+ * done yet, or NULL if error. */
+static const key_entry_t *get_key(const char *filename)
+{
+  key_entry_t *new_keys;
+  VbPublicKey *key;
+  RSAPublicKey *rsa;
+  int i;
+
+  for (i = 0; i < num_keys; i++)
+    if (!strcmp(keys[i].filename, filename))
+      return keys + i;
+
+  key = PublicKeyRead(filename);
+  if (!key)
+    return NULL;
+  rsa = PublicKeyToRSA(key);
+  if (!rsa) {
+    free(key);
+    return NULL;
+  }
+
+  new_keys = realloc(keys, (num_keys + 1) * sizeof(*keys));
+  if (!new_keys) {
+    fprintf(stderr, "Can't allocate key list: %s\n", strerror(errno));
+    RSAPublicKeyFree(rsa);
+    free(key);
+    return NULL;
+  }
+  keys = new_keys;
+  keys[num_keys].filename = strdup(filename);
+  if (!keys[num_keys].filename) {
+    fprintf(stderr, "Can't allocate key list: %s\n", strerror(errno));
+    RSAPublicKeyFree(rsa);
+    free(key);
+    return NULL;
+  }
+  keys[num_keys].key = key;
+  keys[num_keys].rsa = rsa;
+  return keys + num_keys++;
+}
+
+static uint64_t now_usecs(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Checks the key block at the start of [buf] with the image's signing key,
+ * which was parsed when the manifest was read, or its hash if it doesn't have
+ * one, and returns the RSA view of the data
+ * key in it.  Sets img->error and returns NULL if error. */
+static RSAPublicKey *check_key_block(image_t *img, uint8_t *buf,
+                                     uint64_t size, RSAPublicKey *view)
+{
+  VbKeyBlockHeader *key_block = (VbKeyBlockHeader *)buf;
+  RSAPublicKey *rsa;
+  int rv;
+
+  if (img->sign_key)
+    rv = KeyBlockVerifyWithRSA(key_block, size, img->sign_key, img->sign_rsa);
+  else
+    rv = KeyBlockVerify(key_block, size, NULL, 1);
+  if (rv) {
+    img->error = "key block";
+    return NULL;
+  }
+  img->key_block_flags = key_block->key_block_flags;
+  img->data_key_version = key_block->data_key.key_version;
+
+  rsa = PublicKeyToRSAView(&key_block->data_key, view);
+  if (!rsa)
+    img->error = "data key";
+  return rsa;
+}
+
+static void verify_kernel(image_t *img)
+{
+  VbKernelPreambleHeader *preamble;
+  VbKeyBlockHeader *key_block;
+  RSAPublicKey view;
+  RSAPublicKey *rsa;
+  uint8_t *buf;
+  uint64_t size, len, now;
+  ssize_t n;
+  int fd;
+
+  fd = open(img->image, O_RDONLY);
+  if (fd < 0) {
+    img->error = "open";
+    return;
+  }
+  size = FdSize(fd);
+  len = size < KERNEL_HEADER_SIZE ? size : KERNEL_HEADER_SIZE;
+  buf = malloc(KERNEL_HEADER_SIZE);
+  if (!buf) {
+    img->error = "malloc";
+    close(fd);
+    return;
+  }
+  n = pread(fd, buf, len, 0);
+  if (!len || n != len) {
+    img->error = "read";
+    goto done;
+  }
+
+  rsa = check_key_block(img, buf, len, &view);
+  if (!rsa)
+    goto done;
+  key_block = (VbKeyBlockHeader *)buf;
+  now = key_block->key_block_size;
+
+  preamble = (VbKernelPreambleHeader *)(buf + now);
+  if (VerifyKernelPreamble(preamble, len - now, rsa)) {
+    img->error = "preamble";
+    RSAPublicKeyFree(rsa);
+    goto done;
+  }
+  img->version = preamble->kernel_version;
+  img->body_size = preamble->body_signature.data_size;
+  now += preamble->preamble_size;
+
+  if (VerifyDataInFile(fd, now, size - now, &preamble->body_signature, rsa))
+    img->error = "body";
+  RSAPublicKeyFree(rsa);
+
+done:
+  free(buf);
+  close(fd);
+}
+
+static void verify_firmware(image_t *img)
+{
+  VbFirmwarePreambleHeader *preamble;
+  VbKeyBlockHeader *key_block;
+  RSAPublicKey view;
+  RSAPublicKey *rsa;
+  uint8_t *blob;
+  uint64_t blob_size, now;
+  int fd;
+
+  blob = ReadFile(img->image, &blob_size);
+  if (!blob) {
+    img->error = "read";
+    return;
+  }
+
+  rsa = check_key_block(img, blob, blob_size, &view);
+  if (!rsa)
+    goto done;
+  key_block = (VbKeyBlockHeader *)blob;
+  now = key_block->key_block_size;
+
+  preamble = (VbFirmwarePreambleHeader *)(blob + now);
+  if (VerifyFirmwarePreamble(preamble, blob_size - now, rsa)) {
+    img->error = "preamble";
+    RSAPublicKeyFree(rsa);
+    goto done;
+  }
+  img->version = preamble->firmware_version;
+  img->body_size = preamble->body_signature.data_size;
+
+  /* Same as vbutil_firmware: the RO normal path has no body to check */
+  if (!(VbGetFirmwarePreambleFlags(preamble) &
+        VB_FIRMWARE_PREAMBLE_USE_RO_NORMAL)) {
+    fd = open(img->fv, O_RDONLY);
+    if (fd < 0) {
+      img->error = "open";
+    } else {
+      if (VerifyDataInFile(fd, 0, FdSize(fd), &preamble->body_signature,
+                           rsa))
+        img->error = "body";
+      close(fd);
+    }
+  }
+  RSAPublicKeyFree(rsa);
+
+done:
+  free(blob);
+}
+
+static void *verify_thread(void *arg)
+{
+  pool_t *pool = (pool_t *)arg;
+  image_t *img;
+  uint64_t start;
+  int i;
+
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (i >= pool->count)
+      break;
+
+    img = pool->images + i;
+    start = now_usecs();
+    if (img->type == IMAGE_KERNEL)
+      verify_kernel(img);
+    else
+      verify_firmware(img);
+    img->usecs = now_usecs() - start;
+  }
+  return NULL;
+}
+
+/* Print [str] as a JSON string */
+static void print_json_string(FILE *fp, const char *str)
+{
+  const unsigned char *s;
+
+  if (!str) {
+    fputs("null", fp);
+    return;
+  }
+  fputc('"', fp);
+  for (s = (const unsigned char *)str; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(fp, "\\%c", *s);
+    else if (*s < 0x20)
+      fprintf(fp, "\\u%04x", *s);
+    else
+      fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+
+static void print_result(FILE *fp, const image_t *img)
+{
+  fputs("{\"image\": ", fp);
+  print_json_string(fp, img->image);
+  fprintf(fp, ", \"line\": %d, \"type\": \"%s\"", img->line,
+          image_type_name[img->type]);
+  if (img->fv) {
+    fputs(", \"fv\": ", fp);
+    print_json_string(fp, img->fv);
+  }
+  fputs(", \"signpubkey\": ", fp);
+  print_json_string(fp, img->sign_key_file);
+  fprintf(fp, ", \"result\": \"%s\"", img->error ? "fail" : "ok");
+  fputs(", \"error\": ", fp);
+  print_json_string(fp, img->error);
+  fprintf(fp, ", \"key_block_flags\": %" PRIu64
+          ", \"data_key_version\": %" PRIu64
+          ", \"version\": %" PRIu64
+          ", \"body_size\": %" PRIu64
+          ", \"usecs\": %" PRIu64 "}\n",
+          img->key_block_flags, img->data_key_version, img->version,
+          img->body_size, img->usecs);
+}
+
+/* Adds the images listed in the manifest to [images].  Each line is one of
+ *
+ *   kernel   IMAGE SIGNPUBKEY
+ *   firmware VBLOCK FV SIGNPUBKEY
+ *
+ * where a SIGNPUBKEY of "-" means to check the key block hash only.  Blank
+ * lines and everything after a '#' are ignored.  Returns the number of
+ * images, or -1 if error. */
+static int read_manifest(const char *filename, image_t **images)
+{
+  char line[MAX_LINE];
+  char *word[5];
+  char *s;
+  FILE *fp;
+  const key_entry_t *key;
+  image_t *new_images;
+  image_t *img;
+  int count = 0;
+  int lineno = 0;
+  int nwords;
+  int want;
+
+  if (!strcmp(filename, "-"))
+    fp = stdin;
+  else
+    fp = fopen(filename, "r");
+  if (!fp) {
+    fprintf(stderr, "Can't open %s: %s\n", filename, strerror(errno));
+    return -1;
+  }
+
+  *images = NULL;
+  while (fgets(line, sizeof(line), fp)) {
+    lineno++;
+    s = strchr(line, '#');
+    if (s)
+      *s = '\0';
+
+    nwords = 0;
+    for (s = strtok(line, " \t\r\n"); s && nwords < 5;
+         s = strtok(NULL, " \t\r\n"))
+      word[nwords++] = s;
+    if (!nwords)
+      continue;
+
+    new_images = realloc(*images, (count + 1) * sizeof(image_t));
+    if (!new_images) {
+      fprintf(stderr, "%s:%d: can't allocate image list: %s\n",
+              filename, lineno, strerror(errno));
+      goto bad;
+    }
+    *images = new_images;
+    img = *images + count;
+    memset(img, 0, sizeof(*img));
+    img->line = lineno;
+
+    if (!strcmp(word[0], "kernel")) {
+      img->type = IMAGE_KERNEL;
+      want = 3;
+    } else if (!strcmp(word[0], "firmware")) {
+      img->type = IMAGE_FIRMWARE;
+      want = 4;
+    } else {
+      fprintf(stderr, "%s:%d: unknown image type \"%s\"\n",
+              filename, lineno, word[0]);
+      goto bad;
+    }
+    if (nwords != want) {
+      fprintf(stderr, "%s:%d: %s needs %d arguments\n",
+              filename, lineno, word[0], want - 1);
+      goto bad;
+    }
+
+    img->image = strdup(word[1]);
+    if (img->type == IMAGE_FIRMWARE)
+      img->fv = strdup(word[2]);
+    if (!img->image || (img->type == IMAGE_FIRMWARE && !img->fv)) {
+      fprintf(stderr, "%s:%d: can't allocate image list: %s\n",
+              filename, lineno, strerror(errno));
+      goto bad;
+    }
+    if (strcmp(word[want - 1], "-")) {
+      img->sign_key_file = strdup(word[want - 1]);
+      if (!img->sign_key_file) {
+        fprintf(stderr, "%s:%d: can't allocate image list: %s\n",
+                filename, lineno, strerror(errno));
+        goto bad;
+      }
+      key = get_key(img->sign_key_file);
+      if (!key) {
+        fprintf(stderr, "%s:%d: can't read public key %s\n",
+                filename, lineno, img->sign_key_file);
+        goto bad;
+      }
+      img->sign_key = key->key;
+      img->sign_rsa = key->rsa;
+    }
+    count++;
+  }
+
+  if (fp != stdin)
+    fclose(fp);
+  return count;
+
+bad:
+  if (fp != stdin)
+    fclose(fp);
+  return -1;
+}
+
+static const char usage[] = "\n"
+  "Usage:  futility %s [OPTIONS] MANIFEST\n"
+  "\n"
+  "Verifies every kernel and firmware image listed in MANIFEST (or on\n"
+  "stdin, if MANIFEST is \"-\"), one per line, as\n"
+  "\n"
+  "  kernel   IMAGE SIGNPUBKEY\n"
+  "  firmware VBLOCK FV SIGNPUBKEY\n"
+  "\n"
+  "A SIGNPUBKEY of \"-\" checks only the key block hash.  Each public key\n"
+  "is read and parsed once, however many images use it.\n"
+  "\n"
+  "One JSON object is printed per image, in manifest order.  The exit\n"
+  "status is 0 if every image verified, 1 if any didn't, and 2 for bad\n"
+  "arguments or manifest.\n"
+  "\n"
+  "Options:\n"
+  "  -j, --threads NUM     Verify NUM images at once (default: one per CPU)\n"
+  "\n";
+
+static const struct option long_opts[] = {
+  {"threads", 1, NULL, 'j'},
+  {"help", 0, NULL, 'h'},
+  {NULL, 0, NULL, 0},
+};
+
+static int do_verify_batch(int argc, char *argv[])
+{
+  pool_t pool;
+  pthread_t *threads;
+  int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_started = 0;
+  int failed = 0;
+  char *e;
+  int i;
+
+  opterr = 0;
+  while ((i = getopt_long(argc, argv, ":j:h", long_opts, NULL)) != -1) {
+    switch (i) {
+    case 'j':
+      num_threads = strtol(optarg, &e, 0);
+      if (!*optarg || *e || num_threads < 1) {
+        fprintf(stderr, "Invalid --threads \"%s\"\n", optarg);
+        return 2;
+      }
+      break;
+    case 'h':
+      printf(usage, argv[0]);
+      return 0;
+    default:
+      fprintf(stderr, "Invalid option\n");
+      fprintf(stderr, usage, argv[0]);
+      return 2;
+    }
+  }
+  if (optind + 1 != argc) {
+    fprintf(stderr, usage, argv[0]);
+    return 2;
+  }
+
+  memset(&pool, 0, sizeof(pool));
+  pool.count = read_manifest(argv[optind], &pool.images);
+  if (pool.count < 0)
+    return 2;
+
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > pool.count)
+    num_threads = pool.count;
+  pthread_mutex_init(&pool.lock, NULL);
+  threads = calloc(num_threads, sizeof(pthread_t));
+  if (!threads)
+    num_threads = 1;                    /* Just verify on this thread */
+  /* This thread does its share too, so start one fewer */
+  for (i = 0; i < num_threads - 1; i++) {
+    if (pthread_create(threads + num_started, NULL, verify_thread, &pool))
+      break;
+    num_started++;
+  }
+  verify_thread(&pool);
+  for (i = 0; i < num_started; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&pool.lock);
+  free(threads);
+
+  for (i = 0; i < pool.count; i++) {
+    print_result(stdout, pool.images + i);
+    if (pool.images[i].error)
+      failed = 1;
+  }
+  return failed;
+}
+
+DECLARE_FUTIL_COMMAND(verify_batch, do_verify_batch,
+                      "verify many kernel and firmware images at once");
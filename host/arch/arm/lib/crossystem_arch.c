@@ -503,6 +503,52 @@ VbSharedDataHeader *VbSharedDataRead(void) {
   return (VbSharedDataHeader *)block;
 }
 
+/* Switches with GPIOs */
+typedef enum ArmSwitch {
+  SWITCH_DEVELOPER = 0,
+  SWITCH_RECOVERY,
+  SWITCH_WRITE_PROTECT,
+  SWITCH_COUNT
+} ArmSwitch;
+
+/* Switch positions read so far; see VbDiscardArchPropertySnapshot() */
+static int switch_read[SWITCH_COUNT];
+static int switch_value[SWITCH_COUNT];
+
+void VbDiscardArchPropertySnapshot(void) {
+  memset(switch_read, 0, sizeof(switch_read));
+}
+
+/* Read a switch's GPIO, the first time it's needed. */
+static int VbGetSwitch(ArmSwitch sw) {
+  int value = -1;
+
+  if (switch_read[sw])
+    return switch_value[sw];
+
+  switch (sw) {
+    case SWITCH_DEVELOPER:
+      value = VbGetVarGpio("developer-switch");
+      break;
+    case SWITCH_RECOVERY:
+      value = VbGetVarGpio("recovery-switch");
+      break;
+    case SWITCH_WRITE_PROTECT:
+      /* Try finding the GPIO through the chromeos_arm platform device
+       * first. */
+      value = VbGetPlatformGpioStatus("write-protect");
+      if (value == -1)
+        value = VbGetVarGpio("write-protect-switch");
+      break;
+    default:
+      break;
+  }
+
+  switch_value[sw] = value;
+  switch_read[sw] = 1;
+  return value;
+}
+
 int VbGetArchPropertyInt(const char* name) {
   if (!strcasecmp(name, "fmap_base")) {
     return ReadFdtInt("fmap-offset");
@@ -512,16 +558,11 @@ int VbGetArchPropertyInt(const char* name) {
     if ((flags != -1) && (flags & VBSD_HONOR_VIRT_DEV_SWITCH))
       return VbGetSystemPropertyInt("devsw_boot");
 
-    return VbGetVarGpio("developer-switch");
+    return VbGetSwitch(SWITCH_DEVELOPER);
   } else if (!strcasecmp(name, "recoverysw_cur")) {
-    return VbGetVarGpio("recovery-switch");
+    return VbGetSwitch(SWITCH_RECOVERY);
   } else if (!strcasecmp(name, "wpsw_cur")) {
-    int value;
-    /* Try finding the GPIO through the chromeos_arm platform device first. */
-    value = VbGetPlatformGpioStatus("write-protect");
-    if (value != -1)
-      return value;
-    return VbGetVarGpio("write-protect-switch");
+    return VbGetSwitch(SWITCH_WRITE_PROTECT);
   } else if (!strcasecmp(name, "recoverysw_ec_boot"))
     /* TODO: read correct value using ectool */
     return 0;
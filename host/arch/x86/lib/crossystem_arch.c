@@ -109,6 +109,72 @@ const PlatformFamily platform_family_array[] = {
   {0, 0, 0}
 };
 
+/* ACPI values which can't change while the OS is running */
+typedef enum AcpiIntField {
+  ACPI_INT_BINF0 = 0,
+  ACPI_INT_BINF1,
+  ACPI_INT_BINF2,
+  ACPI_INT_BINF3,
+  ACPI_INT_BINF4,
+  ACPI_INT_CHNV,
+  ACPI_INT_CHSW,
+  ACPI_INT_FMAP,
+  ACPI_INT_VBNV0,
+  ACPI_INT_VBNV1,
+  ACPI_INT_COUNT
+} AcpiIntField;
+
+/* Files for AcpiIntField values, indexed by field */
+static const char* const acpi_int_paths[ACPI_INT_COUNT] = {
+  ACPI_BINF_PATH ".0",
+  ACPI_BINF_PATH ".1",
+  ACPI_BINF_PATH ".2",
+  ACPI_BINF_PATH ".3",
+  ACPI_BINF_PATH ".4",
+  ACPI_CHNV_PATH,
+  ACPI_CHSW_PATH,
+  ACPI_FMAP_PATH,
+  ACPI_VBNV_PATH ".0",
+  ACPI_VBNV_PATH ".1",
+};
+
+/* Values read so far; see VbDiscardArchPropertySnapshot() */
+static int acpi_int_read[ACPI_INT_COUNT];
+static int acpi_int_value[ACPI_INT_COUNT];
+static int gpio_read[GPIO_SIGNAL_TYPE_WP + 1];
+static int gpio_value[GPIO_SIGNAL_TYPE_WP + 1];
+
+
+void VbDiscardArchPropertySnapshot(void) {
+  Memset(acpi_int_read, 0, sizeof(acpi_int_read));
+  Memset(gpio_read, 0, sizeof(gpio_read));
+}
+
+
+/* Read an ACPI integer, from sysfs the first time it's needed.
+ *
+ * Returns the value, or -1 if error. */
+static int ReadAcpiInt(AcpiIntField field) {
+  if (!acpi_int_read[field]) {
+    acpi_int_value[field] = ReadFileInt(acpi_int_paths[field]);
+    acpi_int_read[field] = 1;
+  }
+  return acpi_int_value[field];
+}
+
+
+/* Read bits from an ACPI integer, like ReadFileBit().
+ *
+ * Returns 1 if any of the bits in the mask are set, 0 if not, or -1 if
+ * error. */
+static int ReadAcpiBit(AcpiIntField field, int bitmask) {
+  int value = ReadAcpiInt(field);
+  if (value == -1)
+    return -1;
+  return (value & bitmask ? 1 : 0);
+}
+
+
 static void VbFixCmosChecksum(FILE* file) {
   int fd = fileno(file);
   ioctl(fd, NVRAM_SETCKS);
@@ -167,10 +233,10 @@ int VbReadNvStorage(VbNvContext* vnc) {
   int offs;
 
   /* Get the byte offset from VBNV */
-  offs = ReadFileInt(ACPI_VBNV_PATH ".0");
+  offs = ReadAcpiInt(ACPI_INT_VBNV0);
   if (offs == -1)
     return -1;
-  if (VBNV_BLOCK_SIZE > ReadFileInt(ACPI_VBNV_PATH ".1"))
+  if (VBNV_BLOCK_SIZE > ReadAcpiInt(ACPI_INT_VBNV1))
     return -1;  /* NV storage block is too small */
 
   if (0 != VbCmosRead(offs, VBNV_BLOCK_SIZE, vnc->raw))
@@ -187,10 +253,10 @@ int VbWriteNvStorage(VbNvContext* vnc) {
     return 0;  /* Nothing changed, so no need to write */
 
   /* Get the byte offset from VBNV */
-  offs = ReadFileInt(ACPI_VBNV_PATH ".0");
+  offs = ReadAcpiInt(ACPI_INT_VBNV0);
   if (offs == -1)
     return -1;
-  if (VBNV_BLOCK_SIZE > ReadFileInt(ACPI_VBNV_PATH ".1"))
+  if (VBNV_BLOCK_SIZE > ReadAcpiInt(ACPI_INT_VBNV1))
     return -1;  /* NV storage block is too small */
 
   if (0 != VbCmosWrite(offs, VBNV_BLOCK_SIZE, vnc->raw))
@@ -312,6 +378,8 @@ VbSharedDataHeader* VbSharedDataRead(void) {
    * Check supported old versions first. */
   if (1 == sh->struct_version)
     expect_size = VB_SHARED_DATA_HEADER_SIZE_V1;
+  else if (2 == sh->struct_version)
+    expect_size = VB_SHARED_DATA_HEADER_SIZE_V2;
   else {
     /* There'd better be enough data for the current header size. */
     expect_size = sizeof(VbSharedDataHeader);
@@ -336,7 +404,7 @@ static int VbGetCmosRebootField(uint8_t mask) {
   uint8_t nvbyte;
 
   /* Get the byte offset from CHNV */
-  chnv = ReadFileInt(ACPI_CHNV_PATH);
+  chnv = ReadAcpiInt(ACPI_INT_CHNV);
   if (chnv == -1)
     return -1;
 
@@ -357,7 +425,7 @@ static int VbSetCmosRebootField(uint8_t mask, int value) {
   uint8_t nvbyte;
 
   /* Get the byte offset from CHNV */
-  chnv = ReadFileInt(ACPI_CHNV_PATH);
+  chnv = ReadAcpiInt(ACPI_INT_CHNV);
   if (chnv == -1)
     return -1;
 
@@ -385,7 +453,7 @@ static int VbSetCmosRebootField(uint8_t mask, int value) {
 static const char* VbReadMainFwType(char* dest, int size) {
 
   /* Try reading type from BINF.3 */
-  switch(ReadFileInt(ACPI_BINF_PATH ".3")) {
+  switch(ReadAcpiInt(ACPI_INT_BINF3)) {
     case BINF3_NETBOOT:
       return StrCopy(dest, "netboot", size);
     case BINF3_RECOVERY:
@@ -399,7 +467,7 @@ static const char* VbReadMainFwType(char* dest, int size) {
   }
 
   /* Fall back to BINF.0 for legacy systems like Mario. */
-  switch(ReadFileInt(ACPI_BINF_PATH ".0")) {
+  switch(ReadAcpiInt(ACPI_INT_BINF0)) {
     case -1:
       /* Both BINF.0 and BINF.3 are missing, so this isn't Chrome OS
        * firmware. */
@@ -429,12 +497,12 @@ static int VbGetRecoveryReason(void) {
   int value = -1;
 
   /* Try reading type from BINF.4 */
-  value = ReadFileInt(ACPI_BINF_PATH ".4");
+  value = ReadAcpiInt(ACPI_INT_BINF4);
   if (-1 != value)
     return value;
 
   /* Fall back to BINF.0 for legacy systems like Mario. */
-  switch(ReadFileInt(ACPI_BINF_PATH ".0")) {
+  switch(ReadAcpiInt(ACPI_INT_BINF0)) {
     case BINF0_NORMAL:
     case BINF0_DEVELOPER:
       return VBNV_RECOVERY_NOT_REQUESTED;
@@ -587,12 +655,22 @@ static int ReadGpio(int signal_type) {
 }
 
 
+/* Like ReadGpio(), but only reads each signal type once. */
+static int ReadGpioCached(int signal_type) {
+  if (!gpio_read[signal_type]) {
+    gpio_value[signal_type] = ReadGpio(signal_type);
+    gpio_read[signal_type] = 1;
+  }
+  return gpio_value[signal_type];
+}
+
+
 int VbGetArchPropertyInt(const char* name) {
   int value = -1;
 
   /* Values from ACPI */
   if (!strcasecmp(name,"fmap_base"))
-    value = ReadFileInt(ACPI_FMAP_PATH);
+    value = ReadAcpiInt(ACPI_INT_FMAP);
 
   /* Switch positions */
   if (!strcasecmp(name,"devsw_cur")) {
@@ -601,15 +679,15 @@ int VbGetArchPropertyInt(const char* name) {
     if ((flags != -1) && (flags & VBSD_HONOR_VIRT_DEV_SWITCH))
       value = VbGetSystemPropertyInt("devsw_boot");
     else
-      value = ReadGpio(GPIO_SIGNAL_TYPE_DEV);
+      value = ReadGpioCached(GPIO_SIGNAL_TYPE_DEV);
   } else if (!strcasecmp(name,"recoverysw_cur")) {
-    value = ReadGpio(GPIO_SIGNAL_TYPE_RECOVERY);
+    value = ReadGpioCached(GPIO_SIGNAL_TYPE_RECOVERY);
   } else if (!strcasecmp(name,"wpsw_cur")) {
-    value = ReadGpio(GPIO_SIGNAL_TYPE_WP);
+    value = ReadGpioCached(GPIO_SIGNAL_TYPE_WP);
     if (-1 != value && FwidStartsWith("Mario."))
       value = 1 - value;  /* Mario reports this backwards */
   } else if (!strcasecmp(name,"recoverysw_ec_boot")) {
-    value = ReadFileBit(ACPI_CHSW_PATH, CHSW_RECOVERY_EC_BOOT);
+    value = ReadAcpiBit(ACPI_INT_CHSW, CHSW_RECOVERY_EC_BOOT);
   }
 
   /* Fields for old systems which don't have VbSharedData */
@@ -617,11 +695,11 @@ int VbGetArchPropertyInt(const char* name) {
     if (!strcasecmp(name,"recovery_reason")) {
       value = VbGetRecoveryReason();
     } else if (!strcasecmp(name,"devsw_boot")) {
-      value = ReadFileBit(ACPI_CHSW_PATH, CHSW_DEV_BOOT);
+      value = ReadAcpiBit(ACPI_INT_CHSW, CHSW_DEV_BOOT);
     } else if (!strcasecmp(name,"recoverysw_boot")) {
-      value = ReadFileBit(ACPI_CHSW_PATH, CHSW_RECOVERY_BOOT);
+      value = ReadAcpiBit(ACPI_INT_CHSW, CHSW_RECOVERY_BOOT);
     } else if (!strcasecmp(name,"wpsw_boot")) {
-      value = ReadFileBit(ACPI_CHSW_PATH, CHSW_WP_BOOT);
+      value = ReadAcpiBit(ACPI_INT_CHSW, CHSW_WP_BOOT);
       if (-1 != value && FwidStartsWith("Mario."))
         value = 1 - value;  /* Mario reports this backwards */
     }
@@ -630,9 +708,9 @@ int VbGetArchPropertyInt(const char* name) {
   /* Saved memory is at a fixed location for all H2C BIOS.  If the CHSW
    * path exists in sysfs, it's a H2C BIOS. */
   if (!strcasecmp(name,"savedmem_base")) {
-    return (-1 == ReadFileInt(ACPI_CHSW_PATH) ? -1 : 0x00F00000);
+    return (-1 == ReadAcpiInt(ACPI_INT_CHSW) ? -1 : 0x00F00000);
   } else if (!strcasecmp(name,"savedmem_size")) {
-    return (-1 == ReadFileInt(ACPI_CHSW_PATH) ? -1 : 0x00100000);
+    return (-1 == ReadAcpiInt(ACPI_INT_CHSW) ? -1 : 0x00100000);
   }
 
   /* NV storage values.  If unable to get from NV storage, fall back to the
@@ -680,7 +758,7 @@ const char* VbGetArchPropertyString(const char* name, char* dest, int size) {
   } else if (!strcasecmp(name,"ro_fwid")) {
     return ReadFileString(dest, size, ACPI_BASE_PATH "/FRID");
   } else if (!strcasecmp(name,"mainfw_act")) {
-    switch(ReadFileInt(ACPI_BINF_PATH ".1")) {
+    switch(ReadAcpiInt(ACPI_INT_BINF1)) {
       case 0:
         return StrCopy(dest, "recovery", size);
       case 1:
@@ -693,7 +771,7 @@ const char* VbGetArchPropertyString(const char* name, char* dest, int size) {
   } else if (!strcasecmp(name,"mainfw_type")) {
     return VbReadMainFwType(dest, size);
   } else if (!strcasecmp(name,"ecfw_act")) {
-    switch(ReadFileInt(ACPI_BINF_PATH ".2")) {
+    switch(ReadAcpiInt(ACPI_INT_BINF2)) {
       case 0:
         return StrCopy(dest, "RO", size);
       case 1:
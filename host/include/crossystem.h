@@ -28,4 +28,30 @@ int VbSetSystemPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetSystemPropertyString(const char* name, const char* value);
 
+/* Properties are read from a per-process snapshot of NV storage,
+ * VbSharedData and the firmware's other tables, which is loaded as needed
+ * and then kept.  Discard it, so the next read goes back to the hardware.
+ * Only long-running callers which need to see changes made by other
+ * processes have to call this.  Any transaction in progress is aborted. */
+void VbDiscardSystemPropertySnapshot(void);
+
+/* Begin a transaction on the properties kept in NV storage.  Locks NV
+ * storage against other processes and reads it once.  Until the
+ * transaction ends, setting those properties only changes the copy in
+ * memory.  Outside a transaction, each change is read and written back on
+ * its own.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbBeginSystemPropertyTransaction(void);
+
+/* End the transaction, writing NV storage back once if anything changed,
+ * and release the lock.  If writes_avoided is non-NULL, stores the number
+ * of NV storage writes saved over making the changes one at a time.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbCommitSystemPropertyTransaction(int* writes_avoided);
+
+/* End the transaction without writing back any of its changes. */
+void VbAbortSystemPropertyTransaction(void);
+
 #endif  /* VBOOT_REFERENCE__CROSSYSTEM_H_ */
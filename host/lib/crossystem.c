@@ -3,8 +3,11 @@
  * found in the LICENSE file.
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -22,12 +25,16 @@
 /* Filename for kernel command line */
 #define KERNEL_CMDLINE_PATH "/proc/cmdline"
 
+/* Lock file serializing NV storage transactions between processes */
+#define NV_LOCK_PATH "/run/lock/vboot_nvstorage.lock"
+
 /* Fields that GetVdatString() can get */
 typedef enum VdatStringField {
   VDAT_STRING_TIMERS = 0,           /* Timer values */
   VDAT_STRING_LOAD_FIRMWARE_DEBUG,  /* LoadFirmware() debug information */
   VDAT_STRING_LOAD_KERNEL_DEBUG,    /* LoadKernel() debug information */
-  VDAT_STRING_MAINFW_ACT            /* Active main firmware */
+  VDAT_STRING_MAINFW_ACT,           /* Active main firmware */
+  VDAT_STRING_TIMESTAMPS            /* Boot event timestamps */
 } VdatStringField;
 
 
@@ -68,15 +75,163 @@ int FwidStartsWith(const char *start) {
 }
 
 
+/* Snapshot of the data sources behind the properties.  Each source is read
+ * the first time a property needs it, then reused for the rest of the
+ * process; crossystem reads dozens of properties per run and none of them
+ * change under it.  Writes go through to the hardware and update the
+ * snapshot. */
+typedef enum SnapshotState {
+  SNAPSHOT_UNREAD = 0,  /* Not read yet */
+  SNAPSHOT_VALID,       /* Read successfully */
+  SNAPSHOT_FAILED       /* Read failed; don't try again */
+} SnapshotState;
+
+static struct {
+  SnapshotState nv_state;
+  VbNvContext nv;
+  SnapshotState vdat_state;
+  VbSharedDataHeader* vdat;
+} snapshot;
+
+/* NV storage transaction.  While one is active, NV storage changes are
+ * made to the snapshot, then written back once at the end. */
+static struct {
+  int active;   /* Non-zero if a transaction is active */
+  int lock_fd;  /* Lock file descriptor, or -1 if not locked */
+  int changes;  /* Number of changes which modified the NV block */
+} nv_transaction = {0, -1, 0};
+
+
+void VbDiscardSystemPropertySnapshot(void) {
+  VbAbortSystemPropertyTransaction();
+  free(snapshot.vdat);
+  Memset(&snapshot, 0, sizeof(snapshot));
+  VbDiscardArchPropertySnapshot();
+}
+
+
+/* Return the NV storage snapshot, reading it if needed, or NULL if error. */
+static const VbNvContext* GetNvSnapshot(void) {
+  if (SNAPSHOT_UNREAD == snapshot.nv_state) {
+    if (0 == VbReadNvStorage(&snapshot.nv))
+      snapshot.nv_state = SNAPSHOT_VALID;
+    else
+      snapshot.nv_state = SNAPSHOT_FAILED;
+  }
+  return (SNAPSHOT_VALID == snapshot.nv_state ? &snapshot.nv : NULL);
+}
+
+
+/* Return the VbSharedData snapshot, reading it if needed, or NULL if
+ * error. */
+static const VbSharedDataHeader* GetVdatSnapshot(void) {
+  if (SNAPSHOT_UNREAD == snapshot.vdat_state) {
+    snapshot.vdat = VbSharedDataRead();
+    snapshot.vdat_state = (snapshot.vdat ? SNAPSHOT_VALID : SNAPSHOT_FAILED);
+  }
+  return snapshot.vdat;
+}
+
+
+/* Lock an NV storage transaction against other processes.  Returns the
+ * lock file descriptor to pass to UnlockNv().  If the lock file can't be
+ * opened, returns -1 and the caller carries on without the lock. */
+static int LockNv(void) {
+  int fd = open(NV_LOCK_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+  if (fd < 0)
+    return -1;
+  while (0 != flock(fd, LOCK_EX)) {
+    if (EINTR != errno) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+
+static void UnlockNv(int fd) {
+  /* Closing the file releases the lock */
+  if (fd >= 0)
+    close(fd);
+}
+
+
+static void EndNvTransaction(void) {
+  UnlockNv(nv_transaction.lock_fd);
+  nv_transaction.active = 0;
+  nv_transaction.lock_fd = -1;
+  nv_transaction.changes = 0;
+}
+
+
+int VbBeginSystemPropertyTransaction(void) {
+  if (nv_transaction.active)
+    return -1;
+
+  nv_transaction.lock_fd = LockNv();
+
+  /* Read NV storage again under the lock, in case another process changed
+   * it since the snapshot was taken. */
+  snapshot.nv_state = SNAPSHOT_UNREAD;
+  if (!GetNvSnapshot()) {
+    EndNvTransaction();
+    return -1;
+  }
+
+  nv_transaction.active = 1;
+  return 0;
+}
+
+
+int VbCommitSystemPropertyTransaction(int* writes_avoided) {
+  int retval = 0;
+
+  if (!nv_transaction.active)
+    return -1;
+
+  if (nv_transaction.changes) {
+    snapshot.nv.raw_changed = 1;
+    if (0 != VbWriteNvStorage(&snapshot.nv)) {
+      /* Not sure what made it to the hardware, so read it again next time */
+      snapshot.nv_state = SNAPSHOT_UNREAD;
+      retval = -1;
+    }
+    snapshot.nv.raw_changed = 0;
+  }
+
+  /* Each change would have been a write of its own */
+  if (writes_avoided)
+    *writes_avoided = (nv_transaction.changes > 1 ?
+                       nv_transaction.changes - 1 : 0);
+
+  EndNvTransaction();
+  return retval;
+}
+
+
+void VbAbortSystemPropertyTransaction(void) {
+  if (!nv_transaction.active)
+    return;
+
+  /* Drop the uncommitted changes */
+  snapshot.nv_state = SNAPSHOT_UNREAD;
+  EndNvTransaction();
+}
+
+
 int VbGetNvStorage(VbNvParam param) {
+  const VbNvContext* nv = GetNvSnapshot();
   VbNvContext vnc;
   uint32_t value;
   int retval;
 
-  /* TODO: locking around NV access */
-
-  if (0 != VbReadNvStorage(&vnc))
+  if (!nv)
     return -1;
+
+  /* Work on a copy, so the snapshot keeps the block as it was read */
+  Memcpy(&vnc, nv, sizeof(vnc));
   if (0 != VbNvSetup(&vnc))
     return -1;
   retval = VbNvGet(&vnc, param, &value);
@@ -87,39 +242,50 @@ int VbGetNvStorage(VbNvParam param) {
 
   /* TODO: If vnc.raw_changed, attempt to reopen NVRAM for write and
    * save the new defaults.  If we're able to, log. */
-  /* TODO: release lock */
 
   return (int)value;
 }
 
 
-int VbSetNvStorage(VbNvParam param, int value) {
+/* Set an NV storage parameter in the snapshot, as part of the current
+ * transaction.  Returns 0 if success, -1 if error. */
+static int SetNvInTransaction(VbNvParam param, int value) {
+  const VbNvContext* nv = GetNvSnapshot();
   VbNvContext vnc;
-  int retval = -1;
   int i;
 
-  if (0 != VbReadNvStorage(&vnc))
+  if (!nv)
     return -1;
+  Memcpy(&vnc, nv, sizeof(vnc));
 
   if (0 != VbNvSetup(&vnc))
-    goto VbSetNvCleanup;
+    return -1;
   i = VbNvSet(&vnc, param, (uint32_t)value);
   if (0 != VbNvTeardown(&vnc))
-    goto VbSetNvCleanup;
+    return -1;
   if (0 != i)
-    goto VbSetNvCleanup;
+    return -1;
 
   if (vnc.raw_changed) {
-    if (0 != VbWriteNvStorage(&vnc))
-      goto VbSetNvCleanup;
+    Memcpy(snapshot.nv.raw, vnc.raw, sizeof(vnc.raw));
+    nv_transaction.changes++;
   }
+  return 0;
+}
 
-  /* Success */
-  retval = 0;
 
-VbSetNvCleanup:
-  /* TODO: release lock */
-  return retval;
+int VbSetNvStorage(VbNvParam param, int value) {
+  if (nv_transaction.active)
+    return SetNvInTransaction(param, value);
+
+  /* Outside a transaction, each change is a transaction of its own */
+  if (0 != VbBeginSystemPropertyTransaction())
+    return -1;
+  if (0 != SetNvInTransaction(param, value)) {
+    VbAbortSystemPropertyTransaction();
+    return -1;
+  }
+  return VbCommitSystemPropertyTransaction(NULL);
 }
 
 
@@ -268,9 +434,97 @@ LoadKernelDebugExit:
 }
 
 
+/* Names of the VBSD_TS_* boot events, indexed by event */
+static const char* const timestamp_event_names[] = {
+  "none",
+  "tpm_setup_start",
+  "tpm_setup_end",
+  "lf_keyblock_start",
+  "lf_keyblock_end",
+  "lf_preamble_start",
+  "lf_preamble_end",
+  "lf_body_start",
+  "lf_body_end",
+  "tpm_firmware_start",
+  "tpm_firmware_end",
+  "ec_sync_start",
+  "ec_sync_end",
+  "tpm_kernel_read_start",
+  "tpm_kernel_read_end",
+  "lk_gpt_read_start",
+  "lk_gpt_read_end",
+  "lk_keyblock_start",
+  "lk_keyblock_end",
+  "lk_preamble_start",
+  "lk_preamble_end",
+  "lk_body_start",
+  "lk_body_read",
+  "lk_body_hash",
+  "lk_body_end",
+  "tpm_kernel_write_start",
+  "tpm_kernel_write_end",
+  "tpm_kernel_lock_start",
+  "tpm_kernel_lock_end",
+};
+
+/* Print the boot event timestamps, oldest first, one per line:
+ *   TIMER +TICKS_SINCE_PREVIOUS EVENT DATA */
+char* GetVdatTimestamps(char* dest, int size, const VbSharedDataHeader* sh) {
+  int used = 0;
+  int first = 0;
+  uint64_t prev = 0;
+  int i;
+
+  if (sh->struct_version < 3)
+    return NULL;
+
+  /* Make sure we have space for truncation warning */
+  if (size < strlen(TRUNCATED) + 1)
+    return NULL;
+  size -= strlen(TRUNCATED) + 1;
+
+  used += snprintf(dest + used, size - used, "Timestamps recorded=%u\n",
+                   sh->timestamp_count);
+  if (used > size)
+    goto TimestampsExit;
+
+  /* Only the last ones are kept */
+  if (sh->timestamp_count > VBSD_MAX_TIMESTAMPS)
+    first = sh->timestamp_count - VBSD_MAX_TIMESTAMPS;
+
+  for (i = first; i < sh->timestamp_count; i++) {
+    const VbSharedDataTimestamp* ts =
+        sh->timestamps + (i & (VBSD_MAX_TIMESTAMPS - 1));
+    char unknown[32];
+    const char* name = unknown;
+
+    if (ts->event < ARRAY_SIZE(timestamp_event_names))
+      name = timestamp_event_names[ts->event];
+    else
+      snprintf(unknown, sizeof(unknown), "event_%u", ts->event);
+
+    used += snprintf(dest + used, size - used,
+                     "%" PRIu64 " +%" PRIu64 " %s %u\n",
+                     ts->timer, i > first ? ts->timer - prev : 0,
+                     name, ts->data);
+    if (used > size)
+      goto TimestampsExit;
+    prev = ts->timer;
+  }
+
+TimestampsExit:
+
+  /* Warn if data was truncated; we left space for this above. */
+  if (used > size)
+    strcat(dest, TRUNCATED);
+
+  return dest;
+}
+
+
 char* GetVdatString(char* dest, int size, VdatStringField field)
 {
-  VbSharedDataHeader* sh = VbSharedDataRead();
+  const VbSharedDataHeader* sh = GetVdatSnapshot();
   char* value = dest;
 
   if (!sh)
@@ -298,6 +552,10 @@ char* GetVdatString(char* dest, int size, VdatStringField field)
       value = GetVdatLoadKernelDebug(dest, size, sh);
       break;
 
+    case VDAT_STRING_TIMESTAMPS:
+      value = GetVdatTimestamps(dest, size, sh);
+      break;
+
     case VDAT_STRING_MAINFW_ACT:
       switch(sh->firmware_index) {
         case 0:
@@ -319,13 +577,12 @@ char* GetVdatString(char* dest, int size, VdatStringField field)
       break;
   }
 
-  free(sh);
   return value;
 }
 
 
 int GetVdatInt(VdatIntField field) {
-  VbSharedDataHeader* sh = VbSharedDataRead();
+  const VbSharedDataHeader* sh = GetVdatSnapshot();
   int value = -1;
 
   if (!sh)
@@ -381,7 +638,6 @@ int GetVdatInt(VdatIntField field) {
     }
   }
 
-  free(sh);
   return value;
 }
 
@@ -390,103 +646,210 @@ int VbSharedDataVersion(void) {
   return GetVdatInt(VDAT_INT_HEADER_VERSION);
 }
 
+/* Flags for Property */
+#define PROP_ARCH        0x01  /* Arch-specific code may provide the value */
+#define PROP_WRITABLE    0x02  /* Can be set */
+#define PROP_CLEAR_ONLY  0x04  /* Can only be set to 0 */
+
+/* Where a property's value comes from, when the arch-specific code doesn't
+ * provide it */
+typedef enum PropertySource {
+  PROP_SRC_NONE = 0,     /* Arch-specific code only */
+  PROP_SRC_NV,           /* NV storage; param is a VbNvParam */
+  PROP_SRC_VDAT_INT,     /* VbSharedData; param is a VdatIntField */
+  PROP_SRC_VDAT_STRING,  /* VbSharedData; param is a VdatStringField */
+  PROP_SRC_OTHER         /* Handled case by case; param is a PropertyId */
+} PropertySource;
+
+/* Properties with PROP_SRC_OTHER */
+typedef enum PropertyId {
+  PROP_ID_CROS_DEBUG = 0,
+  PROP_ID_DDR_TYPE,
+  PROP_ID_FWUPDATE_TRIES,
+  PROP_ID_KERNKEY_VFY
+} PropertyId;
+
+typedef struct Property {
+  const char* name;       /* Property name */
+  int flags;              /* Flags (see above) */
+  PropertySource source;  /* Where the value comes from */
+  int param;              /* Field within the source */
+} Property;
+
+/* Every property known to crossystem, arch-specific ones included */
+static const Property properties[] = {
+  {"arch", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"clear_tpm_owner_done", PROP_WRITABLE | PROP_CLEAR_ONLY, PROP_SRC_NV,
+   VBNV_CLEAR_TPM_OWNER_DONE},
+  {"clear_tpm_owner_request", PROP_WRITABLE, PROP_SRC_NV,
+   VBNV_CLEAR_TPM_OWNER_REQUEST},
+  {"cros_debug", 0, PROP_SRC_OTHER, PROP_ID_CROS_DEBUG},
+  {"dbg_reset", PROP_ARCH | PROP_WRITABLE, PROP_SRC_NV,
+   VBNV_DEBUG_RESET_MODE},
+  {"ddr_type", PROP_ARCH, PROP_SRC_OTHER, PROP_ID_DDR_TYPE},
+  {"dev_boot_legacy", PROP_WRITABLE, PROP_SRC_NV, VBNV_DEV_BOOT_LEGACY},
+  {"dev_boot_signed_only", PROP_WRITABLE, PROP_SRC_NV,
+   VBNV_DEV_BOOT_SIGNED_ONLY},
+  {"dev_boot_usb", PROP_WRITABLE, PROP_SRC_NV, VBNV_DEV_BOOT_USB},
+  {"devsw_boot", PROP_ARCH, PROP_SRC_VDAT_INT, VDAT_INT_DEVSW_BOOT},
+  {"devsw_cur", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"devsw_virtual", 0, PROP_SRC_VDAT_INT, VDAT_INT_DEVSW_VIRTUAL},
+  {"disable_dev_request", PROP_WRITABLE, PROP_SRC_NV,
+   VBNV_DISABLE_DEV_REQUEST},
+  {"ecfw_act", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"fmap_base", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"fwb_tries", PROP_ARCH | PROP_WRITABLE, PROP_SRC_NV, VBNV_TRY_B_COUNT},
+  {"fwid", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"fwupdate_tries", PROP_ARCH | PROP_WRITABLE, PROP_SRC_OTHER,
+   PROP_ID_FWUPDATE_TRIES},
+  {"hwid", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"kern_nv", 0, PROP_SRC_NV, VBNV_KERNEL_FIELD},
+  {"kernkey_vfy", 0, PROP_SRC_OTHER, PROP_ID_KERNKEY_VFY},
+  {"loc_idx", PROP_WRITABLE, PROP_SRC_NV, VBNV_LOCALIZATION_INDEX},
+  {"mainfw_act", PROP_ARCH, PROP_SRC_VDAT_STRING, VDAT_STRING_MAINFW_ACT},
+  {"mainfw_type", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"nvram_cleared", PROP_WRITABLE | PROP_CLEAR_ONLY, PROP_SRC_NV,
+   VBNV_KERNEL_SETTINGS_RESET},
+  {"oprom_needed", PROP_WRITABLE, PROP_SRC_NV, VBNV_OPROM_NEEDED},
+  {"platform_family", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"recovery_reason", PROP_ARCH, PROP_SRC_VDAT_INT, VDAT_INT_RECOVERY_REASON},
+  {"recovery_request", PROP_ARCH | PROP_WRITABLE, PROP_SRC_NV,
+   VBNV_RECOVERY_REQUEST},
+  {"recovery_subcode", PROP_WRITABLE, PROP_SRC_NV, VBNV_RECOVERY_SUBCODE},
+  {"recoverysw_boot", PROP_ARCH, PROP_SRC_VDAT_INT, VDAT_INT_RECSW_BOOT},
+  {"recoverysw_cur", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"recoverysw_ec_boot", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"ro_fwid", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"savedmem_base", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"savedmem_size", PROP_ARCH, PROP_SRC_NONE, 0},
+  {"sw_wpsw_boot", 0, PROP_SRC_VDAT_INT, VDAT_INT_SW_WPSW_BOOT},
+  {"tpm_fwver", 0, PROP_SRC_VDAT_INT, VDAT_INT_FW_VERSION_TPM},
+  {"tpm_kernver", 0, PROP_SRC_VDAT_INT, VDAT_INT_KERNEL_VERSION_TPM},
+  {"tried_fwb", 0, PROP_SRC_VDAT_INT, VDAT_INT_TRIED_FIRMWARE_B},
+  {"vdat_flags", 0, PROP_SRC_VDAT_INT, VDAT_INT_FLAGS},
+  {"vdat_lfdebug", 0, PROP_SRC_VDAT_STRING, VDAT_STRING_LOAD_FIRMWARE_DEBUG},
+  {"vdat_lkdebug", 0, PROP_SRC_VDAT_STRING, VDAT_STRING_LOAD_KERNEL_DEBUG},
+  {"vdat_timers", 0, PROP_SRC_VDAT_STRING, VDAT_STRING_TIMERS},
+  {"vdat_timestamps", 0, PROP_SRC_VDAT_STRING, VDAT_STRING_TIMESTAMPS},
+  {"wpsw_boot", PROP_ARCH, PROP_SRC_VDAT_INT, VDAT_INT_HW_WPSW_BOOT},
+  {"wpsw_cur", PROP_ARCH, PROP_SRC_NONE, 0},
+};
+
+/* Open-addressed hash of properties[] by case-insensitive name, built on
+ * first use.  Must be a power of 2, and at least twice the number of
+ * properties to keep the probe chains short. */
+#define PROPERTY_HASH_SIZE 128
+static const Property* property_hash[PROPERTY_HASH_SIZE];
+
+/* FNV-1a hash of the lower-cased name */
+static uint32_t PropertyNameHash(const char* name) {
+  uint32_t hash = 2166136261U;
+
+  for (; *name; name++) {
+    hash ^= (uint8_t)tolower((unsigned char)*name);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+
+/* Find a property by name, ignoring case.
+ *
+ * Returns the property, or NULL if no match. */
+static const Property* FindProperty(const char* name) {
+  static int hash_built;
+  const Property* p;
+  uint32_t i;
+
+  if (!hash_built) {
+    for (p = properties; p < properties + ARRAY_SIZE(properties); p++) {
+      for (i = PropertyNameHash(p->name);
+           property_hash[i & (PROPERTY_HASH_SIZE - 1)]; i++)
+        ;
+      property_hash[i & (PROPERTY_HASH_SIZE - 1)] = p;
+    }
+    hash_built = 1;
+  }
+
+  if (!name)
+    return NULL;
+
+  for (i = PropertyNameHash(name);
+       (p = property_hash[i & (PROPERTY_HASH_SIZE - 1)]); i++) {
+    if (!strcasecmp(p->name, name))
+      return p;
+  }
+  return NULL;
+}
+
+
 int VbGetSystemPropertyInt(const char* name) {
-  int value = -1;
+  const Property* p = FindProperty(name);
+  int value;
+
+  if (!p)
+    return -1;
 
   /* Check architecture-dependent properties first */
-  value = VbGetArchPropertyInt(name);
-  if (-1 != value)
-    return value;
-
-  /* NV storage values */
-  else if (!strcasecmp(name,"kern_nv")) {
-    value = VbGetNvStorage(VBNV_KERNEL_FIELD);
-  } else if (!strcasecmp(name,"nvram_cleared")) {
-    value = VbGetNvStorage(VBNV_KERNEL_SETTINGS_RESET);
-  } else if (!strcasecmp(name,"recovery_request")) {
-    value = VbGetNvStorage(VBNV_RECOVERY_REQUEST);
-  } else if (!strcasecmp(name,"dbg_reset")) {
-    value = VbGetNvStorage(VBNV_DEBUG_RESET_MODE);
-  } else if (!strcasecmp(name,"disable_dev_request")) {
-    value = VbGetNvStorage(VBNV_DISABLE_DEV_REQUEST);
-  } else if (!strcasecmp(name,"clear_tpm_owner_request")) {
-    value = VbGetNvStorage(VBNV_CLEAR_TPM_OWNER_REQUEST);
-  } else if (!strcasecmp(name,"clear_tpm_owner_done")) {
-    value = VbGetNvStorage(VBNV_CLEAR_TPM_OWNER_DONE);
-  } else if (!strcasecmp(name,"fwb_tries")) {
-    value = VbGetNvStorage(VBNV_TRY_B_COUNT);
-  } else if (!strcasecmp(name,"fwupdate_tries")) {
-    value = VbGetNvStorage(VBNV_KERNEL_FIELD);
-    if (value != -1)
-      value &= KERN_NV_FWUPDATE_TRIES_MASK;
-  } else if (!strcasecmp(name,"loc_idx")) {
-    value = VbGetNvStorage(VBNV_LOCALIZATION_INDEX);
-  } else if (!strcasecmp(name,"dev_boot_usb")) {
-    value = VbGetNvStorage(VBNV_DEV_BOOT_USB);
-  } else if (!strcasecmp(name,"dev_boot_legacy")) {
-    value = VbGetNvStorage(VBNV_DEV_BOOT_LEGACY);
-  } else if (!strcasecmp(name,"dev_boot_signed_only")) {
-    value = VbGetNvStorage(VBNV_DEV_BOOT_SIGNED_ONLY);
-  } else if (!strcasecmp(name,"oprom_needed")) {
-    value = VbGetNvStorage(VBNV_OPROM_NEEDED);
-  } else if (!strcasecmp(name,"recovery_subcode")) {
-    value = VbGetNvStorage(VBNV_RECOVERY_SUBCODE);
+  if (p->flags & PROP_ARCH) {
+    value = VbGetArchPropertyInt(name);
+    if (-1 != value)
+      return value;
   }
-  /* Other parameters */
-  else if (!strcasecmp(name,"cros_debug")) {
-    value = VbGetCrosDebug();
-  } else if (!strcasecmp(name,"devsw_boot")) {
-    value = GetVdatInt(VDAT_INT_DEVSW_BOOT);
-  } else if (!strcasecmp(name,"devsw_virtual")) {
-    value = GetVdatInt(VDAT_INT_DEVSW_VIRTUAL);
-  } else if (!strcasecmp(name, "recoverysw_boot")) {
-    value = GetVdatInt(VDAT_INT_RECSW_BOOT);
-  } else if (!strcasecmp(name, "wpsw_boot")) {
-    value = GetVdatInt(VDAT_INT_HW_WPSW_BOOT);
-  } else if (!strcasecmp(name, "sw_wpsw_boot")) {
-    value = GetVdatInt(VDAT_INT_SW_WPSW_BOOT);
-  } else if (!strcasecmp(name,"vdat_flags")) {
-    value = GetVdatInt(VDAT_INT_FLAGS);
-  } else if (!strcasecmp(name,"tpm_fwver")) {
-    value = GetVdatInt(VDAT_INT_FW_VERSION_TPM);
-  } else if (!strcasecmp(name,"tpm_kernver")) {
-    value = GetVdatInt(VDAT_INT_KERNEL_VERSION_TPM);
-  } else if (!strcasecmp(name,"tried_fwb")) {
-    value = GetVdatInt(VDAT_INT_TRIED_FIRMWARE_B);
-  } else if (!strcasecmp(name,"recovery_reason")) {
-    value = GetVdatInt(VDAT_INT_RECOVERY_REASON);
+
+  switch (p->source) {
+    case PROP_SRC_NV:
+      return VbGetNvStorage(p->param);
+    case PROP_SRC_VDAT_INT:
+      return GetVdatInt(p->param);
+    case PROP_SRC_OTHER:
+      if (PROP_ID_CROS_DEBUG == p->param)
+        return VbGetCrosDebug();
+      if (PROP_ID_FWUPDATE_TRIES == p->param) {
+        value = VbGetNvStorage(VBNV_KERNEL_FIELD);
+        if (value != -1)
+          value &= KERN_NV_FWUPDATE_TRIES_MASK;
+        return value;
+      }
+      break;
+    default:
+      break;
   }
 
-  return value;
+  return -1;
 }
 
 
 const char* VbGetSystemPropertyString(const char* name, char* dest, int size) {
   static const char unknown_string[] = "unknown";
+  const Property* p = FindProperty(name);
+
+  if (!p)
+    return NULL;
 
   /* Check architecture-dependent properties first */
-  if (VbGetArchPropertyString(name, dest, size))
+  if ((p->flags & PROP_ARCH) && VbGetArchPropertyString(name, dest, size))
     return dest;
 
-  if (!strcasecmp(name,"kernkey_vfy")) {
-    switch(GetVdatInt(VDAT_INT_KERNEL_KEY_VERIFIED)) {
-      case 0:
-        return "hash";
-      case 1:
-        return "sig";
-      default:
-        return NULL;
-    }
-  } else if (!strcasecmp(name, "mainfw_act")) {
-    return GetVdatString(dest, size, VDAT_STRING_MAINFW_ACT);
-  } else if (!strcasecmp(name, "vdat_timers")) {
-    return GetVdatString(dest, size, VDAT_STRING_TIMERS);
-  } else if (!strcasecmp(name, "vdat_lfdebug")) {
-    return GetVdatString(dest, size, VDAT_STRING_LOAD_FIRMWARE_DEBUG);
-  } else if (!strcasecmp(name, "vdat_lkdebug")) {
-    return GetVdatString(dest, size, VDAT_STRING_LOAD_KERNEL_DEBUG);
-  } else if (!strcasecmp(name, "ddr_type")) {
-    return unknown_string;
+  switch (p->source) {
+    case PROP_SRC_VDAT_STRING:
+      return GetVdatString(dest, size, p->param);
+    case PROP_SRC_OTHER:
+      if (PROP_ID_KERNKEY_VFY == p->param) {
+        switch(GetVdatInt(VDAT_INT_KERNEL_KEY_VERIFIED)) {
+          case 0:
+            return "hash";
+          case 1:
+            return "sig";
+          default:
+            return NULL;
+        }
+      }
+      if (PROP_ID_DDR_TYPE == p->param)
+        return unknown_string;
+      break;
+    default:
+      break;
   }
 
   return NULL;
@@ -494,47 +857,36 @@ const char* VbGetSystemPropertyString(const char* name, char* dest, int size) {
 
 
 int VbSetSystemPropertyInt(const char* name, int value) {
-  /* Check architecture-dependent properties first */
+  const Property* p = FindProperty(name);
+  int kern_nv;
+
+  if (!p || !(p->flags & PROP_WRITABLE))
+    return -1;
 
-  if (0 == VbSetArchPropertyInt(name, value))
+  /* Check architecture-dependent properties first */
+  if ((p->flags & PROP_ARCH) && 0 == VbSetArchPropertyInt(name, value))
     return 0;
 
-  /* NV storage values */
-  if (!strcasecmp(name,"nvram_cleared")) {
-    /* Can only clear this flag; it's set inside the NV storage library. */
-    return VbSetNvStorage(VBNV_KERNEL_SETTINGS_RESET, 0);
-  } else if (!strcasecmp(name,"recovery_request")) {
-    return VbSetNvStorage(VBNV_RECOVERY_REQUEST, value);
-  } else if (!strcasecmp(name,"recovery_subcode")) {
-    return VbSetNvStorage(VBNV_RECOVERY_SUBCODE, value);
-  } else if (!strcasecmp(name,"dbg_reset")) {
-    return VbSetNvStorage(VBNV_DEBUG_RESET_MODE, value);
-  } else if (!strcasecmp(name,"disable_dev_request")) {
-    return VbSetNvStorage(VBNV_DISABLE_DEV_REQUEST, value);
-  } else if (!strcasecmp(name,"clear_tpm_owner_request")) {
-    return VbSetNvStorage(VBNV_CLEAR_TPM_OWNER_REQUEST, value);
-  } else if (!strcasecmp(name,"clear_tpm_owner_done")) {
-    /* Can only clear this flag; it's set by firmware. */
-    return VbSetNvStorage(VBNV_CLEAR_TPM_OWNER_DONE, 0);
-  } else if (!strcasecmp(name,"fwb_tries")) {
-    return VbSetNvStorage(VBNV_TRY_B_COUNT, value);
-  } else if (!strcasecmp(name,"fwupdate_tries")) {
-    int kern_nv = VbGetNvStorage(VBNV_KERNEL_FIELD);
-    if (kern_nv == -1)
-      return -1;
-    kern_nv &= ~KERN_NV_FWUPDATE_TRIES_MASK;
-    kern_nv |= (value & KERN_NV_FWUPDATE_TRIES_MASK);
-    return VbSetNvStorage(VBNV_KERNEL_FIELD, kern_nv);
-  } else if (!strcasecmp(name,"loc_idx")) {
-    return VbSetNvStorage(VBNV_LOCALIZATION_INDEX, value);
-  } else if (!strcasecmp(name,"dev_boot_usb")) {
-    return VbSetNvStorage(VBNV_DEV_BOOT_USB, value);
-  } else if (!strcasecmp(name,"dev_boot_legacy")) {
-    return VbSetNvStorage(VBNV_DEV_BOOT_LEGACY, value);
-  } else if (!strcasecmp(name,"dev_boot_signed_only")) {
-    return VbSetNvStorage(VBNV_DEV_BOOT_SIGNED_ONLY, value);
-  } else if (!strcasecmp(name,"oprom_needed")) {
-    return VbSetNvStorage(VBNV_OPROM_NEEDED, value);
+  /* Flags set by firmware or inside the NV storage library can only be
+   * cleared. */
+  if (p->flags & PROP_CLEAR_ONLY)
+    value = 0;
+
+  switch (p->source) {
+    case PROP_SRC_NV:
+      return VbSetNvStorage(p->param, value);
+    case PROP_SRC_OTHER:
+      if (PROP_ID_FWUPDATE_TRIES == p->param) {
+        kern_nv = VbGetNvStorage(VBNV_KERNEL_FIELD);
+        if (kern_nv == -1)
+          return -1;
+        kern_nv &= ~KERN_NV_FWUPDATE_TRIES_MASK;
+        kern_nv |= (value & KERN_NV_FWUPDATE_TRIES_MASK);
+        return VbSetNvStorage(VBNV_KERNEL_FIELD, kern_nv);
+      }
+      break;
+    default:
+      break;
   }
 
   return -1;
@@ -542,6 +894,10 @@ int VbSetSystemPropertyInt(const char* name, int value) {
 
 
 int VbSetSystemPropertyString(const char* name, const char* value) {
+  const Property* p = FindProperty(name);
+
   /* Chain to architecture-dependent properties */
+  if (!p || !(p->flags & PROP_ARCH))
+    return -1;
   return VbSetArchPropertyString(name, value);
 }
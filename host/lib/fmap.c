@@ -12,8 +12,8 @@
 const char* FmapFind(const char* ptr, size_t size)
 {
   size_t i;
-  for (i=0; i<size; i += FMAP_SEARCH_STRIDE) {
-    if (0 == strncmp(ptr, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
+  for (i=0; i + FMAP_SIGNATURE_SIZE <= size; i += FMAP_SEARCH_STRIDE) {
+    if (0 == memcmp(ptr, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
       return ptr;
     ptr += FMAP_SEARCH_STRIDE;
   }
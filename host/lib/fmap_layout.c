@@ -0,0 +1,262 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for working out how the areas of an FMAP nest inside each
+ * other.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmap.h"
+#include "fmap_layout.h"
+
+static const char root_name[] = "-entire flash-";
+
+static int Encloses(const FmapLayoutNode* a, const FmapLayoutNode* b) {
+  return a->start <= b->start && a->end >= b->end;
+}
+
+
+static int Overlaps(const FmapLayoutNode* a, const FmapLayoutNode* b) {
+  return a->start < b->start && b->start < a->end && a->end < b->end;
+}
+
+
+/* Increasing start, then decreasing end, so every area comes after the
+ * areas which enclose it.  Duplicates are ordered by area index. */
+static int CompareNodes(const void* a, const void* b) {
+  const FmapLayoutNode* x = *(FmapLayoutNode* const*)a;
+  const FmapLayoutNode* y = *(FmapLayoutNode* const*)b;
+
+  if (x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+  if (x->end != y->end)
+    return x->end > y->end ? -1 : 1;
+  return x->area - y->area;
+}
+
+
+static int CompareOverlaps(const void* a, const void* b) {
+  const FmapLayoutOverlap* x = (const FmapLayoutOverlap*)a;
+  const FmapLayoutOverlap* y = (const FmapLayoutOverlap*)b;
+
+  if (x->first->area != y->first->area)
+    return x->first->area - y->first->area;
+  return x->second->area - y->second->area;
+}
+
+
+static int AddOverlap(FmapLayout* layout, int* alloc,
+                      const FmapLayoutNode* first,
+                      const FmapLayoutNode* second) {
+  FmapLayoutOverlap* newbuf;
+
+  if (layout->num_overlaps == *alloc) {
+    *alloc = *alloc ? *alloc * 2 : 4;
+    newbuf = realloc(layout->overlaps, *alloc * sizeof(*newbuf));
+    if (!newbuf)
+      return 1;
+    layout->overlaps = newbuf;
+  }
+  layout->overlaps[layout->num_overlaps].first = first;
+  layout->overlaps[layout->num_overlaps].second = second;
+  layout->num_overlaps++;
+  return 0;
+}
+
+
+static void AddGap(FmapLayoutNode* node, uint32_t start, uint32_t end,
+                   int below) {
+  node->gaps[node->num_gaps].start = start;
+  node->gaps[node->num_gaps].end = end;
+  node->gaps[node->num_gaps].below = below;
+  node->num_gaps++;
+}
+
+
+int FmapLayoutBuild(const FmapHeader* fmh, FmapLayout* layout) {
+  const FmapAreaHeader* ah = (const FmapAreaHeader*)(fmh + 1);
+  int num_areas = fmh->fmap_nareas;
+  FmapLayoutNode** sorted = NULL;
+  FmapLayoutNode** open = NULL;
+  FmapLayoutNode* root;
+  FmapLayoutNode* node;
+  FmapLayoutNode* prev = NULL;
+  FmapLayoutNode* best;
+  FmapLayoutGap* gaps;
+  FmapLayoutNode** ptrs;
+  int num_open = 0;
+  int overlaps_alloc = 0;
+  int retval = 1;
+  int i, j, k;
+
+  memset(layout, 0, sizeof(*layout));
+  layout->num_areas = num_areas;
+
+  /* Each area is at most one node's child or duplicate, and each node has at
+   * most one gap more than it has children. */
+  layout->nodes = calloc(num_areas + 1, sizeof(FmapLayoutNode));
+  layout->node_ptrs = calloc(num_areas + 1, sizeof(FmapLayoutNode*));
+  layout->gap_pool = calloc(2 * num_areas + 1, sizeof(FmapLayoutGap));
+  sorted = calloc(num_areas + 1, sizeof(FmapLayoutNode*));
+  open = calloc(num_areas + 1, sizeof(FmapLayoutNode*));
+  if (!layout->nodes || !layout->node_ptrs || !layout->gap_pool ||
+      !sorted || !open)
+    goto out;
+
+  for (i = 0; i < num_areas; i++) {
+    node = layout->nodes + i;
+    memcpy(node->name, ah[i].area_name, FMAP_NAMELEN);
+    node->start = ah[i].area_offset;
+    node->size = ah[i].area_size;
+    node->end = node->start + node->size;
+    node->area = i;
+    sorted[i] = node;
+  }
+  root = layout->root = layout->nodes + num_areas;
+  memcpy(root->name, root_name, sizeof(root_name));
+  root->start = fmh->fmap_base;
+  root->size = fmh->fmap_size;
+  root->end = root->start + root->size;
+  root->area = -1;
+
+  qsort(sorted, num_areas, sizeof(*sorted), CompareNodes);
+
+  /* Sweep up through the areas, keeping track of the ones which are still
+   * open at each start.  In a well-formed FMAP those are just the areas which
+   * enclose it, so there are only a few to compare with. */
+  for (i = 0; i < num_areas; i++) {
+    node = sorted[i];
+
+    if (prev && prev->start == node->start && prev->end == node->end) {
+      node->dupe_of = prev->dupe_of ? prev->dupe_of : prev;
+      node->dupe_of->num_dupes++;
+      continue;
+    }
+    prev = node;
+
+    for (j = k = 0; j < num_open; j++) {
+      if (open[j]->end >= node->start)
+        open[k++] = open[j];
+    }
+    num_open = k;
+
+    /* The parent is the smallest enclosing area, or the root if there isn't
+     * one smaller than the flash. */
+    best = NULL;
+    for (j = 0; j < num_open; j++) {
+      if (Overlaps(open[j], node)) {
+        if (0 != AddOverlap(layout, &overlaps_alloc, open[j], node))
+          goto out;
+        continue;
+      }
+      if (Encloses(open[j], node) && open[j]->size < root->size &&
+          (!best || open[j]->size < best->size ||
+           (open[j]->size == best->size && open[j]->area < best->area)))
+        best = open[j];
+    }
+    node->parent = best ? best : root;
+    node->parent->num_children++;
+    open[num_open++] = node;
+  }
+
+  /* Hand out the arrays, then fill them in sorted order */
+  ptrs = layout->node_ptrs;
+  for (i = 0; i <= num_areas; i++) {
+    node = layout->nodes + i;
+    node->children = ptrs;
+    ptrs += node->num_children;
+    node->num_children = 0;
+    node->dupes = ptrs;
+    ptrs += node->num_dupes;
+    node->num_dupes = 0;
+  }
+  for (i = 0; i < num_areas; i++) {
+    node = sorted[i];
+    if (node->dupe_of)
+      node->dupe_of->dupes[node->dupe_of->num_dupes++] = node;
+    else
+      node->parent->children[node->parent->num_children++] = node;
+  }
+
+  gaps = layout->gap_pool;
+  for (i = 0; i <= num_areas; i++) {
+    FmapLayoutNode** c;
+
+    node = layout->nodes + i;
+    k = node->num_children;
+    if (!k)
+      continue;
+    c = node->children;
+    node->gaps = gaps;
+    if (c[0]->start != node->start)
+      AddGap(node, node->start, c[0]->start, -1);
+    for (j = 0; j < k - 1; j++) {
+      if (c[j]->end != c[j + 1]->start)
+        AddGap(node, c[j]->end, c[j + 1]->start, j);
+    }
+    if (c[k - 1]->end != node->end)
+      AddGap(node, c[k - 1]->end, node->end, k - 1);
+    gaps += node->num_gaps;
+    layout->num_gaps += node->num_gaps;
+  }
+
+  if (layout->num_overlaps)
+    qsort(layout->overlaps, layout->num_overlaps, sizeof(FmapLayoutOverlap),
+          CompareOverlaps);
+  retval = 0;
+
+ out:
+  free(sorted);
+  free(open);
+  return retval;
+}
+
+
+void FmapLayoutFree(FmapLayout* layout) {
+  free(layout->nodes);
+  free(layout->node_ptrs);
+  free(layout->gap_pool);
+  free(layout->overlaps);
+  memset(layout, 0, sizeof(*layout));
+}
+
+
+const FmapLayoutNode* FmapLayoutFind(const FmapLayout* layout,
+                                     const char* name) {
+  int i;
+
+  for (i = 0; i < layout->num_areas; i++) {
+    if (!strcmp(layout->nodes[i].name, name))
+      return layout->nodes + i;
+  }
+  return NULL;
+}
+
+
+const FmapLayoutNode* FmapLayoutNodeAt(const FmapLayout* layout,
+                                       uint32_t offset) {
+  const FmapLayoutNode* node = layout->root;
+  int lo, hi, mid;
+
+  if (!node || offset < node->start || offset >= node->end)
+    return NULL;
+
+  for (;;) {
+    /* Last child starting at or below the offset */
+    lo = 0;
+    hi = node->num_children;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (node->children[mid]->start <= offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (!lo || offset >= node->children[lo - 1]->end)
+      return node;
+    node = node->children[lo - 1];
+  }
+}
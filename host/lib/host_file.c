@@ -0,0 +1,115 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for getting at the contents of files.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>  /* For BLKGETSIZE64 */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_file.h"
+
+/* How much ReadFromFd() reads at first, when it can't tell the size */
+#define READ_CHUNK_SIZE (64 * 1024)
+
+uint64_t FdSize(int fd) {
+  struct stat sb;
+  uint64_t size = 0;
+
+  if (0 != fstat(fd, &sb))
+    return 0;
+  if (S_ISREG(sb.st_mode))
+    return sb.st_size;
+  /* fstat() says block devices are empty, so ask the driver */
+  if (S_ISBLK(sb.st_mode) && 0 == ioctl(fd, BLKGETSIZE64, &size))
+    return size;
+  return 0;
+}
+
+
+uint8_t* ReadFromFd(int fd, uint64_t size_hint, uint64_t* size_ptr) {
+  uint64_t alloc = size_hint ? size_hint + 1 : READ_CHUNK_SIZE;
+  uint64_t size = 0;
+  uint8_t* buf = malloc(alloc);
+  uint8_t* newbuf;
+  ssize_t n;
+
+  while (buf) {
+    if (size == alloc) {
+      alloc *= 2;
+      newbuf = realloc(buf, alloc);
+      if (!newbuf)
+        break;
+      buf = newbuf;
+    }
+    n = read(fd, buf + size, alloc - size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      break;
+    if (n == 0) {
+      *size_ptr = size;
+      return buf;
+    }
+    size += n;
+  }
+
+  free(buf);
+  return NULL;
+}
+
+
+int MapFile(const char* filename, MappedFile* file) {
+  uint64_t size;
+  void* ptr;
+  int saved_errno;
+  int fd;
+
+  memset(file, 0, sizeof(*file));
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return 1;
+
+  size = FdSize(fd);
+  if (size && size == (size_t)size) {
+    ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr != MAP_FAILED) {
+      close(fd);
+      file->data = ptr;
+      file->size = size;
+      file->mapped = 1;
+      return 0;
+    }
+  }
+
+  /* Pipes and such can't be mapped, so read them instead */
+  file->data = ReadFromFd(fd, size, &file->size);
+  if (!file->data)
+    goto fail;
+  close(fd);
+  return 0;
+
+fail:
+  saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return 1;
+}
+
+
+void UnmapFile(MappedFile* file) {
+  if (file->mapped)
+    munmap((void*)file->data, file->size);
+  else
+    free((void*)file->data);
+  memset(file, 0, sizeof(*file));
+}
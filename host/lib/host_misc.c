@@ -7,9 +7,11 @@
 
 /* TODO: change all 'return 0', 'return 1' into meaningful return codes */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "cryptolib.h"
@@ -25,34 +27,25 @@ char* StrCopy(char* dest, const char* src, int dest_size) {
 
 
 uint8_t* ReadFile(const char* filename, uint64_t* sizeptr) {
-  FILE* f;
+  struct stat sb;
   uint8_t* buf;
   uint64_t size;
+  int fd;
 
-  f = fopen(filename, "rb");
-  if (!f) {
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     VBDEBUG(("Unable to open file %s\n", filename));
     return NULL;
   }
 
-  fseek(f, 0, SEEK_END);
-  size = ftell(f);
-  rewind(f);
-
-  buf = malloc(size);
-  if (!buf) {
-    fclose(f);
-    return NULL;
-  }
-
-  if(1 != fread(buf, size, 1, f)) {
+  buf = ReadFromFd(fd, fstat(fd, &sb) ? 0 : sb.st_size, &size);
+  close(fd);
+  if (!buf || !size) {
     VBDEBUG(("Unable to read from file %s\n", filename));
-    fclose(f);
     free(buf);
     return NULL;
   }
 
-  fclose(f);
   if (sizeptr)
     *sizeptr = size;
   return buf;
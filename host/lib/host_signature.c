@@ -12,6 +12,9 @@
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>  /* For PRIu64 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -21,6 +24,7 @@
 #include "cryptolib.h"
 #include "file_keys.h"
 #include "host_common.h"
+#include "host_signature.h"
 #include "vboot_common.h"
 
 
@@ -106,8 +110,24 @@ VbSignature* CalculateHash(const uint8_t* data, uint64_t size,
 
 VbSignature* CalculateSignature(const uint8_t* data, uint64_t size,
                                 const VbPrivateKey* key) {
-
   uint8_t* digest;
+  VbSignature* sig;
+
+  /* Calculate the digest */
+  /* TODO: rename param 3 of DigestBuf to hash_type */
+  digest = DigestBuf(data, size, hash_type_map[key->algorithm]);
+  if (!digest)
+    return NULL;
+
+  sig = CalculateSignatureFromDigest(digest, size, key);
+  free(digest);
+  return sig;
+}
+
+
+VbSignature* CalculateSignatureFromDigest(const uint8_t* digest,
+                                          uint64_t size,
+                                          const VbPrivateKey* key) {
   int digest_size = hash_size_map[key->algorithm];
 
   const uint8_t* digestinfo = hash_digestinfo_map[key->algorithm];
@@ -119,21 +139,12 @@ VbSignature* CalculateSignature(const uint8_t* data, uint64_t size,
   VbSignature* sig;
   int rv;
 
-  /* Calculate the digest */
-  /* TODO: rename param 3 of DigestBuf to hash_type */
-  digest = DigestBuf(data, size, hash_type_map[key->algorithm]);
-  if (!digest)
-    return NULL;
-
   /* Prepend the digest info to the digest */
   signature_digest = malloc(signature_digest_len);
-  if (!signature_digest) {
-    free(digest);
+  if (!signature_digest)
     return NULL;
-  }
   Memcpy(signature_digest, digestinfo, digestinfo_size);
   Memcpy(signature_digest + digestinfo_size, digest, digest_size);
-  free(digest);
 
   /* Allocate output signature */
   sig = SignatureAlloc(siglen_map[key->algorithm], size);
@@ -305,3 +316,52 @@ VbSignature* CalculateSignature_external(const uint8_t* data, uint64_t size,
   /* Return the signature */
   return sig;
 }
+
+
+int VerifyDataInFile(int fd, uint64_t offset, uint64_t size,
+                     const VbSignature* sig, const RSAPublicKey* key) {
+  DigestContext ctx;
+  uint8_t* buf;
+  uint8_t* digest;
+  uint64_t done = 0;
+  int rv;
+
+  if (sig->data_size > size) {
+    VBDEBUG(("File smaller than length of signed data.\n"));
+    return 1;
+  }
+
+  buf = (uint8_t*)malloc(VERIFY_CHUNK_SIZE);
+  if (!buf)
+    return 1;
+
+  /* Only a hint, so it doesn't matter if it fails */
+  posix_fadvise(fd, offset, sig->data_size, POSIX_FADV_SEQUENTIAL);
+
+  DigestInit(&ctx, key->algorithm);
+  while (done < sig->data_size) {
+    uint64_t len = sig->data_size - done;
+    ssize_t n;
+
+    if (len > VERIFY_CHUNK_SIZE)
+      len = VERIFY_CHUNK_SIZE;
+    n = pread(fd, buf, len, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      VBDEBUG(("VerifyDataInFile(): read failed at offset %" PRIu64 "\n",
+               offset + done));
+      free(buf);
+      free(DigestFinal(&ctx));
+      return 1;
+    }
+    DigestUpdate(&ctx, buf, (uint32_t)n);
+    done += n;
+  }
+  free(buf);
+
+  digest = DigestFinal(&ctx);
+  rv = VerifyDigest(digest, sig, key);
+  free(digest);
+  return rv;
+}
@@ -0,0 +1,129 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for finding the known structures in a firmware or disk
+ * image in one pass.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmpblk_header.h"
+#include "fmap.h"
+#include "gbb_header.h"
+#include "image_scan.h"
+#include "mtdlib.h"
+#include "vboot_struct.h"
+
+/* Every signature starts with one of these bytes */
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+#define FIRST_UNDERSCORE ('_' * ONES)  /* __FMAP__ */
+#define FIRST_DOLLAR     ('$' * ONES)  /* $GBB, $BMP */
+#define FIRST_C          ('C' * ONES)  /* CHROMEOS, CrOSPart */
+
+/* Non-zero if any byte of [v] is zero */
+#define HAS_ZERO_BYTE(v) (((v) - ONES) & ~(v) & HIGHS)
+
+static int AddOffset(ImageScan* scan, ImageSignature sig, uint64_t offset) {
+  uint64_t* newbuf;
+
+  if (scan->count[sig] == scan->alloc[sig]) {
+    scan->alloc[sig] = scan->alloc[sig] ? scan->alloc[sig] * 2 : 4;
+    newbuf = realloc(scan->offsets[sig],
+                     scan->alloc[sig] * sizeof(*newbuf));
+    if (!newbuf)
+      return 1;
+    scan->offsets[sig] = newbuf;
+  }
+  scan->offsets[sig][scan->count[sig]++] = offset;
+  return 0;
+}
+
+
+/* Check for each signature which starts with the byte at [offset].
+ *
+ * Returns 0 if success, non-zero if error. */
+static int CheckOffset(const uint8_t* data, uint64_t size, uint64_t offset,
+                       ImageScan* scan) {
+  const uint8_t* p = data + offset;
+  uint64_t left = size - offset;
+
+  switch (*p) {
+    case '_':
+      if (0 == offset % FMAP_SEARCH_STRIDE && left >= FMAP_SIGNATURE_SIZE &&
+          0 == memcmp(p, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
+        return AddOffset(scan, IMAGE_SIG_FMAP, offset);
+      break;
+    case '$':
+      if (left >= GBB_SIGNATURE_SIZE &&
+          0 == memcmp(p, GBB_SIGNATURE, GBB_SIGNATURE_SIZE))
+        return AddOffset(scan, IMAGE_SIG_GBB, offset);
+      if (left >= BMPBLOCK_SIGNATURE_SIZE &&
+          0 == memcmp(p, BMPBLOCK_SIGNATURE, BMPBLOCK_SIGNATURE_SIZE))
+        return AddOffset(scan, IMAGE_SIG_BMPBLOCK, offset);
+      break;
+    case 'C':
+      if (left >= KEY_BLOCK_MAGIC_SIZE &&
+          0 == memcmp(p, KEY_BLOCK_MAGIC, KEY_BLOCK_MAGIC_SIZE))
+        return AddOffset(scan, IMAGE_SIG_KEYBLOCK, offset);
+      if (left >= sizeof(MTD_DRIVE_SIGNATURE) - 1 &&
+          0 == memcmp(p, MTD_DRIVE_SIGNATURE, sizeof(MTD_DRIVE_SIGNATURE) - 1))
+        return AddOffset(scan, IMAGE_SIG_MTD, offset);
+      break;
+  }
+  return 0;
+}
+
+
+int ScanImage(const uint8_t* data, uint64_t size, ImageScan* scan) {
+  uint64_t offset = 0;
+  uint64_t word;
+  int i;
+
+  memset(scan, 0, sizeof(*scan));
+
+  /* Look at 8 bytes at a time, and only byte by byte where a signature
+   * might start; most words in an image can't hold one. */
+  for (; offset + sizeof(word) <= size; offset += sizeof(word)) {
+    memcpy(&word, data + offset, sizeof(word));
+    if (!HAS_ZERO_BYTE(word ^ FIRST_UNDERSCORE) &&
+        !HAS_ZERO_BYTE(word ^ FIRST_DOLLAR) &&
+        !HAS_ZERO_BYTE(word ^ FIRST_C))
+      continue;
+    for (i = 0; i < sizeof(word); i++) {
+      if (0 != CheckOffset(data, size, offset + i, scan))
+        return 1;
+    }
+  }
+
+  /* Any bytes left over */
+  for (; offset < size; offset++) {
+    if (0 != CheckOffset(data, size, offset, scan))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+void FreeImageScan(ImageScan* scan) {
+  int i;
+
+  for (i = 0; i < IMAGE_SIG_COUNT; i++)
+    free(scan->offsets[i]);
+  memset(scan, 0, sizeof(*scan));
+}
+
+
+int64_t ImageScanFirst(const ImageScan* scan, ImageSignature sig,
+                       uint64_t align) {
+  size_t i;
+
+  for (i = 0; i < scan->count[sig]; i++) {
+    if (0 == scan->offsets[sig][i] % align)
+      return (int64_t)scan->offsets[sig][i];
+  }
+  return -1;
+}
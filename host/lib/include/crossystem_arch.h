@@ -88,4 +88,9 @@ int VbSetArchPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetArchPropertyString(const char* name, const char* value);
 
+/* Discard any firmware values the architecture-specific code has kept
+ * since it first read them, so they're read again next time they're
+ * needed. */
+void VbDiscardArchPropertySnapshot(void);
+
 #endif  /* VBOOT_REFERENCE__CROSSYSTEM_ARCH_H_ */
@@ -0,0 +1,95 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for working out how the areas of an FMAP nest inside each
+ * other.
+ */
+
+#ifndef VBOOT_REFERENCE_FMAP_LAYOUT_H_
+#define VBOOT_REFERENCE_FMAP_LAYOUT_H_
+
+#include <stdint.h>
+
+#include "fmap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* An unused range inside an area, between its children */
+typedef struct FmapLayoutGap {
+  uint32_t start;
+  uint32_t end;
+  int below;        /* Index of the child just below the gap, or -1 */
+} FmapLayoutGap;
+
+typedef struct FmapLayoutNode {
+  char name[FMAP_NAMELEN + 1];
+  uint32_t start;
+  uint32_t size;
+  uint32_t end;                      /* start + size */
+  int area;                          /* FMAP area index, or -1 for the root */
+
+  /* Smallest enclosing node, which may be the root.  NULL for the root and
+   * for duplicates. */
+  struct FmapLayoutNode* parent;
+  struct FmapLayoutNode** children;  /* In increasing order of start */
+  int num_children;
+  FmapLayoutGap* gaps;               /* In increasing order of start */
+  int num_gaps;
+
+  /* Areas with exactly the same range are coalesced into the one with the
+   * lowest index.  The others point to it with [dupe_of] and are otherwise
+   * left out of the tree. */
+  struct FmapLayoutNode* dupe_of;
+  struct FmapLayoutNode** dupes;     /* In increasing order of area */
+  int num_dupes;
+} FmapLayoutNode;
+
+/* A pair of areas which overlap without either one enclosing the other */
+typedef struct FmapLayoutOverlap {
+  const FmapLayoutNode* first;       /* The one which starts lower */
+  const FmapLayoutNode* second;
+} FmapLayoutOverlap;
+
+typedef struct FmapLayout {
+  FmapLayoutNode* nodes;             /* One per area, then the root */
+  int num_areas;
+  FmapLayoutNode* root;              /* Covers the whole flash */
+  FmapLayoutOverlap* overlaps;       /* In increasing order of area */
+  int num_overlaps;
+  int num_gaps;                      /* Total over all nodes */
+
+  /* Storage for the per-node arrays */
+  FmapLayoutNode** node_ptrs;
+  FmapLayoutGap* gap_pool;
+} FmapLayout;
+
+/* Build the layout tree for the FMAP at [fmh].  This takes O(n log n) for n
+ * areas, plus the cost of comparing each area with the areas open at its
+ * start, which is the nesting depth for a well-formed FMAP.  Overlapping
+ * areas are recorded, not rejected; each area's parent is then its smallest
+ * enclosing area with the overlapping ones left out.  Release [layout] with
+ * FmapLayoutFree(), even on error.
+ *
+ * Returns 0 if success, non-zero if error (out of memory). */
+int FmapLayoutBuild(const FmapHeader* fmh, FmapLayout* layout);
+
+/* Release the memory used by a layout. */
+void FmapLayoutFree(FmapLayout* layout);
+
+/* Return the node for the area named [name], or NULL if there isn't one. */
+const FmapLayoutNode* FmapLayoutFind(const FmapLayout* layout,
+                                     const char* name);
+
+/* Return the smallest node containing [offset], which may be the root, or
+ * NULL if the offset is outside the flash. */
+const FmapLayoutNode* FmapLayoutNodeAt(const FmapLayout* layout,
+                                       uint32_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* VBOOT_REFERENCE_FMAP_LAYOUT_H_ */
@@ -15,6 +15,7 @@
 #define _STUB_IMPLEMENTATION_
 
 #include "cryptolib.h"
+#include "host_file.h"
 #include "host_key.h"
 #include "host_keyblock.h"
 #include "host_misc.h"
@@ -0,0 +1,50 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for getting at the contents of files.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_FILE_H_
+#define VBOOT_REFERENCE_HOST_FILE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A file's contents, mapped read-only if the file can be mapped, or else
+ * read into memory. */
+typedef struct MappedFile {
+  const uint8_t* data;
+  uint64_t size;
+  int mapped;  /* Non-zero if [data] is mmap()ed rather than malloc()ed */
+} MappedFile;
+
+/* Map the contents of [filename] into [file].  Regular files and block
+ * devices are mapped without copying; pipes and anything else which can't be
+ * mapped are read into a buffer instead.  Release [file] with UnmapFile().
+ *
+ * Returns 0 if success, non-zero if error (with errno set). */
+int MapFile(const char* filename, MappedFile* file);
+
+/* Release a file mapped by MapFile(). */
+void UnmapFile(MappedFile* file);
+
+/* Return the size of the regular file or block device open as [fd], or 0 if
+ * it's something else (a pipe, say) or the size can't be found. */
+uint64_t FdSize(int fd);
+
+/* Read everything left in [fd] into a new buffer, storing its size in
+ * [size].  [size_hint] is how much there probably is, or 0 if unknown.  Works
+ * on pipes and other files which can't seek.
+ *
+ * Returns the buffer, which the caller must free(), or NULL if error. */
+uint8_t* ReadFromFd(int fd, uint64_t size_hint, uint64_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* VBOOT_REFERENCE_HOST_FILE_H_ */
@@ -17,6 +17,7 @@
 char* StrCopy(char* dest, const char* src, int dest_size);
 
 /* Read data from [filename].  Store the size of returned data in [size].
+ * This copies the whole file; use MapFile() if it only needs to be looked at.
  *
  * Returns the data buffer, which the caller must Free(), or NULL if
  * error. */
@@ -50,6 +50,16 @@ VbSignature* CalculateHash(const uint8_t* data, uint64_t size,
 VbSignature* CalculateSignature(const uint8_t* data, uint64_t size,
                                 const VbPrivateKey* key);
 
+/* Calculates a signature for [size] bytes of data whose digest, from
+ * DigestFinal() with the key's algorithm, is [digest].  This lets the data be
+ * hashed a piece at a time.
+ * Caller owns the returned pointer, and must free it with Free().
+ *
+ * Returns NULL on error. */
+VbSignature* CalculateSignatureFromDigest(const uint8_t* digest,
+                                          uint64_t size,
+                                          const VbPrivateKey* key);
+
 /* Calculates a signature for the data using the specified key and
  * an external program.
  * Caller owns the returned pointer, and must free it with Free().
@@ -60,4 +70,16 @@ VbSignature* CalculateSignature_external(const uint8_t* data, uint64_t size,
                                          uint64_t key_algorithm,
                                          const char* external_signer);
 
+/* How much of a file VerifyDataInFile() reads at a time */
+#define VERIFY_CHUNK_SIZE (1 << 20)
+
+/* Verifies the signature [sig] on the data at [offset] in the open file [fd],
+ * where the file has [size] bytes available starting at [offset].  The data
+ * is read and hashed VERIFY_CHUNK_SIZE bytes at a time, so memory use doesn't
+ * depend on how much of it there is.
+ *
+ * Returns 0 if the signature is valid, non-zero if error. */
+int VerifyDataInFile(int fd, uint64_t offset, uint64_t size,
+                     const VbSignature* sig, const RSAPublicKey* key);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
@@ -0,0 +1,54 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host functions for finding the known structures in a firmware or disk
+ * image in one pass.
+ */
+
+#ifndef VBOOT_REFERENCE_IMAGE_SCAN_H_
+#define VBOOT_REFERENCE_IMAGE_SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Kinds of structure ScanImage() looks for */
+typedef enum ImageSignature {
+  IMAGE_SIG_FMAP = 0,   /* "__FMAP__", only at FMAP_SEARCH_STRIDE offsets */
+  IMAGE_SIG_GBB,        /* "$GBB" */
+  IMAGE_SIG_BMPBLOCK,   /* "$BMP" */
+  IMAGE_SIG_KEYBLOCK,   /* "CHROMEOS" */
+  IMAGE_SIG_MTD,        /* "CrOSPart" */
+  IMAGE_SIG_COUNT
+} ImageSignature;
+
+/* Offsets of every signature found in an image, by kind */
+typedef struct ImageScan {
+  uint64_t* offsets[IMAGE_SIG_COUNT];  /* Offsets, in increasing order */
+  size_t count[IMAGE_SIG_COUNT];       /* Number of offsets */
+  size_t alloc[IMAGE_SIG_COUNT];       /* Space allocated for offsets */
+} ImageScan;
+
+/* Find every signature in the [size] bytes at [data], in one pass.  Release
+ * [scan] with FreeImageScan(), even on error.
+ *
+ * Returns 0 if success, non-zero if error (out of memory). */
+int ScanImage(const uint8_t* data, uint64_t size, ImageScan* scan);
+
+/* Release the offsets found by ScanImage(). */
+void FreeImageScan(ImageScan* scan);
+
+/* Return the offset of the first signature of kind [sig] at a multiple of
+ * [align] bytes, or -1 if there isn't one. */
+int64_t ImageScanFirst(const ImageScan* scan, ImageSignature sig,
+                       uint64_t align);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* VBOOT_REFERENCE_IMAGE_SCAN_H_ */
@@ -115,6 +115,7 @@ static GptData *GetEmptyGptData(void)
 	static uint8_t secondary_header[MAX_SECTOR_SIZE];
 	static uint8_t secondary_entries[PARTITION_ENTRIES_SIZE];
 
+	GptFree(&gpt);
 	Memset(&gpt, 0, sizeof(gpt));
 	gpt.primary_header = primary_header;
 	gpt.primary_entries = primary_entries;
@@ -130,6 +131,7 @@ static GptData *GetEmptyGptData(void)
 
 static MtdData *GetEmptyMtdData() {
 	static MtdData mtd;
+	MtdFree(&mtd);
 	Memset(&mtd, 0, sizeof(mtd));
 	mtd.current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	return &mtd;
@@ -363,6 +365,7 @@ static int ParameterTests(void)
 static int HeaderCrcTest(void)
 {
 	GptData *gpt = GetEmptyGptData();
+	MtdData *mtd = GetEmptyMtdData();
 	GptHeader *h1 = (GptHeader *)gpt->primary_header;
 
 	BuildTestGptData(gpt);
@@ -383,6 +386,13 @@ static int HeaderCrcTest(void)
 	gpt->primary_header[h1->size] ^= 0x5a;
 	EXPECT(HeaderCrc(h1) == h1->header_crc32);
 
+	/* MTD header size is checked before the CRC is calculated over it */
+	BuildTestMtdData(mtd);
+	mtd->primary.size = 0xffffffff;
+	EXPECT(GPT_ERROR_INVALID_HEADERS == MtdSanityCheck(mtd));
+	mtd->primary.size = sizeof(mtd->primary) + 1;
+	EXPECT(GPT_ERROR_INVALID_HEADERS == MtdSanityCheck(mtd));
+
 	return TEST_OK;
 }
 
@@ -1370,6 +1380,145 @@ static int GetNextTriesTest(void)
 	return TEST_OK;
 }
 
+/* A partition table for testing the kernel index directly */
+typedef struct {
+	int kernel, priority, successful, tries;
+} TestPart;
+
+static TestPart test_parts[8];
+
+static int TestIsKernel(void *table, uint32_t i)
+{
+	return ((TestPart *)table)[i].kernel;
+}
+
+static int TestGetPriority(void *table, uint32_t i)
+{
+	return ((TestPart *)table)[i].priority;
+}
+
+static int TestGetTries(void *table, uint32_t i)
+{
+	return ((TestPart *)table)[i].tries;
+}
+
+static int TestGetSuccessful(void *table, uint32_t i)
+{
+	return ((TestPart *)table)[i].successful;
+}
+
+static void TestSetPriority(void *table, uint32_t i, int priority)
+{
+	((TestPart *)table)[i].priority = priority;
+}
+
+static void TestSetTries(void *table, uint32_t i, int tries)
+{
+	((TestPart *)table)[i].tries = tries;
+}
+
+static const PartitionTableOps test_ops = {
+	TestIsKernel,
+	TestGetPriority,
+	TestGetTries,
+	TestGetSuccessful,
+	TestSetPriority,
+	TestSetTries,
+};
+
+static void BuildTestParts(void)
+{
+	static const TestPart parts[8] = {
+		{1, 2, 1, 0},
+		{0, 9, 1, 0},	/* Not a kernel */
+		{1, 5, 0, 1},
+		{1, 5, 1, 0},
+		{1, 0, 1, 0},	/* Priority 0 */
+		{1, 7, 0, 0},	/* Out of tries */
+		{1, 1, 0, 3},
+		{0, 0, 0, 0},
+	};
+	Memcpy(test_parts, parts, sizeof(parts));
+}
+
+static int KernelIndexTest(void)
+{
+	KernelIndex ki;
+	int current, modified;
+
+	/* Bootable kernels, by priority then entry number */
+	Memset(&ki, 0, sizeof(ki));
+	BuildTestParts();
+	KernelIndexBuild(&ki, &test_ops, test_parts, 8, 0);
+	EXPECT(4 == ki.count);
+	EXPECT(2 == ki.entry[0]);
+	EXPECT(3 == ki.entry[1]);
+	EXPECT(0 == ki.entry[2]);
+	EXPECT(6 == ki.entry[3]);
+
+	KernelIndexBuild(&ki, &test_ops, test_parts, 8,
+			 KERNEL_INDEX_PRIORITY_ZERO);
+	EXPECT(5 == ki.count);
+	EXPECT(6 == ki.entry[3]);
+	EXPECT(4 == ki.entry[4]);
+
+	KernelIndexBuild(&ki, &test_ops, test_parts, 8, KERNEL_INDEX_ALL);
+	EXPECT(6 == ki.count);
+	EXPECT(5 == ki.entry[0]);
+	EXPECT(2 == ki.entry[1]);
+	EXPECT(4 == ki.entry[5]);
+
+	/* Only looks at the entries it's told to */
+	KernelIndexBuild(&ki, &test_ops, test_parts, 3, 0);
+	EXPECT(2 == ki.count);
+
+	/* Entries which stop being bootable are skipped */
+	KernelIndexBuild(&ki, &test_ops, test_parts, 8, 0);
+	EXPECT(GPT_SUCCESS == KernelIndexNext(&ki, &test_ops, test_parts,
+					      &current));
+	EXPECT(2 == current);
+	test_parts[3].priority = 0;
+	EXPECT(GPT_SUCCESS == KernelIndexNext(&ki, &test_ops, test_parts,
+					      &current));
+	EXPECT(0 == current);
+
+	/* Using up the last try marks it bad */
+	EXPECT(GPT_SUCCESS == KernelIndexNext(&ki, &test_ops, test_parts,
+					      &current));
+	EXPECT(6 == current);
+	modified = 0;
+	EXPECT(GPT_SUCCESS == KernelEntryUpdate(&test_ops, test_parts,
+						current, GPT_UPDATE_ENTRY_TRY,
+						&modified));
+	EXPECT(1 == modified);
+	EXPECT(2 == test_parts[6].tries);
+	test_parts[6].tries = 1;
+	EXPECT(GPT_SUCCESS == KernelEntryUpdate(&test_ops, test_parts,
+						current, GPT_UPDATE_ENTRY_TRY,
+						&modified));
+	EXPECT(0 == test_parts[6].tries);
+	EXPECT(0 == test_parts[6].priority);
+
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       KernelIndexNext(&ki, &test_ops, test_parts, &current));
+	EXPECT(CGPT_KERNEL_ENTRY_NOT_FOUND == current);
+	EXPECT(GPT_ERROR_INVALID_UPDATE_TYPE ==
+	       KernelEntryUpdate(&test_ops, test_parts, current,
+				 GPT_UPDATE_ENTRY_BAD, &modified));
+
+	/* An empty table needs no entries; freeing leaves an empty index */
+	KernelIndexBuild(&ki, &test_ops, test_parts, 0, 0);
+	EXPECT(NULL == ki.entry);
+	EXPECT(0 == ki.count);
+	KernelIndexBuild(&ki, &test_ops, test_parts, 8, 0);
+	KernelIndexFree(&ki);
+	EXPECT(NULL == ki.entry);
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       KernelIndexNext(&ki, &test_ops, test_parts, &current));
+
+	return TEST_OK;
+}
+
 static int MtdGetNextNormalTest(void)
 {
 	MtdData *mtd = GetEmptyMtdData();
@@ -1782,6 +1931,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextNormalTest), },
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
+		{ TEST_CASE(KernelIndexTest), },
 		{ TEST_CASE(MtdGetNextNormalTest), },
 		{ TEST_CASE(MtdGetNextPrioTest), },
 		{ TEST_CASE(MtdGetNextTriesTest), },
@@ -1791,6 +1941,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(MtdUpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+		{ TEST_CASE(TestCrc32Update), },
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 	};
@@ -46,3 +46,58 @@ int TestCrc32TestVectors() {
   }
   return TEST_OK;
 }
+
+/* Reference CRC32, one bit at a time. */
+static uint32_t SlowCrc32(const uint8_t *buf, uint32_t len) {
+  uint32_t value = ~0U;
+  int i;
+
+  while (len--) {
+    value ^= *buf++;
+    for (i = 0; i < 8; i++)
+      value = (value >> 1) ^ (0xEDB88320U & -(value & 1));
+  }
+  return ~value;
+}
+
+#define CRC_BUF_LEN (16384 + 64)
+
+int TestCrc32Update() {
+  static uint8_t buf[CRC_BUF_LEN];
+  uint32_t len, split, offset;
+  int impl;
+  int i;
+
+  for (i = 0; i < CRC_BUF_LEN; i++)
+    buf[i] = (uint8_t)(i * 131 + (i >> 8));
+
+  /* Every implementation matches the reference, at any alignment and length,
+   * and however the input is split. */
+  for (impl = 0; impl < Crc32ImplCount(); impl++) {
+    if (!Crc32ImplSupported(impl))
+      continue;
+    EXPECT(Crc32ImplSelect(impl) == 0);
+
+    for (offset = 0; offset < 8; offset++) {
+      for (len = 0; len < 300; len++)
+        EXPECT(Crc32(buf + offset, len) == SlowCrc32(buf + offset, len));
+      len = 16384;
+      EXPECT(Crc32(buf + offset, len) == SlowCrc32(buf + offset, len));
+    }
+
+    len = 16384 + 17;
+    for (split = 0; split < len; split += 1021) {
+      uint32_t crc = Crc32Update(0, buf, split);
+      crc = Crc32Update(crc, buf + split, len - split);
+      EXPECT(crc == Crc32(buf, len));
+    }
+  }
+
+  EXPECT(Crc32ImplName(0) != NULL);
+  EXPECT(Crc32ImplName(Crc32ImplCount()) == NULL);
+  EXPECT(Crc32ImplSupported(-1) == 0);
+  EXPECT(Crc32ImplSelect(Crc32ImplCount()) == 1);
+  EXPECT(Crc32ImplSelect(-1) == 0);
+
+  return TEST_OK;
+}
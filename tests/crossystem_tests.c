@@ -0,0 +1,167 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the NV storage handling in the crossystem library.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "crossystem.h"
+#include "crossystem_arch.h"
+#include "test_common.h"
+#include "vboot_nvstorage.h"
+
+/* Mock data */
+static uint8_t mock_nv[VBNV_BLOCK_SIZE];
+static int mock_reads;
+static int mock_writes;
+static int mock_read_retval;
+static int mock_write_retval;
+
+/* Reset mock data (for use before each test) */
+static void ResetMocks(void)
+{
+	VbNvContext vnc;
+
+	/* Start with a valid block of defaults */
+	memset(&vnc, 0, sizeof(vnc));
+	VbNvSetup(&vnc);
+	VbNvTeardown(&vnc);
+	memcpy(mock_nv, vnc.raw, sizeof(mock_nv));
+
+	mock_reads = 0;
+	mock_writes = 0;
+	mock_read_retval = 0;
+	mock_write_retval = 0;
+
+	VbDiscardSystemPropertySnapshot();
+}
+
+/* Mocks */
+int VbReadNvStorage(VbNvContext *vnc)
+{
+	mock_reads++;
+	if (mock_read_retval)
+		return mock_read_retval;
+	memcpy(vnc->raw, mock_nv, sizeof(mock_nv));
+	return 0;
+}
+
+int VbWriteNvStorage(VbNvContext *vnc)
+{
+	if (!vnc->raw_changed)
+		return 0;
+	mock_writes++;
+	if (mock_write_retval)
+		return mock_write_retval;
+	memcpy(mock_nv, vnc->raw, sizeof(mock_nv));
+	return 0;
+}
+
+/* Tests */
+static void SingleSetTest(void)
+{
+	ResetMocks();
+	TEST_EQ(VbSetSystemPropertyInt("dev_boot_usb", 1), 0, "Set one");
+	TEST_EQ(mock_reads, 1, "  read once");
+	TEST_EQ(mock_writes, 1, "  written once");
+	TEST_EQ(VbGetSystemPropertyInt("dev_boot_usb"), 1, "  get");
+	TEST_EQ(VbGetSystemPropertyInt("DEV_BOOT_USB"), 1, "  get any case");
+	TEST_EQ(mock_reads, 1, "  gets use the snapshot");
+
+	TEST_EQ(VbSetSystemPropertyInt("dev_boot_usb", 1), 0, "Set same");
+	TEST_EQ(mock_reads, 2, "  read again under the lock");
+	TEST_EQ(mock_writes, 1, "  not written");
+
+	ResetMocks();
+	mock_read_retval = -1;
+	TEST_EQ(VbSetSystemPropertyInt("dev_boot_usb", 1), -1,
+		"Set read failure");
+	TEST_EQ(VbGetSystemPropertyInt("dev_boot_usb"), -1, "  get fails");
+	TEST_EQ(mock_writes, 0, "  not written");
+
+	ResetMocks();
+	mock_write_retval = -1;
+	TEST_EQ(VbSetSystemPropertyInt("dev_boot_usb", 1), -1,
+		"Set write failure");
+	mock_write_retval = 0;
+	TEST_EQ(VbGetSystemPropertyInt("dev_boot_usb"), 0,
+		"  get reads again");
+	TEST_EQ(mock_reads, 2, "  read count");
+
+	ResetMocks();
+	TEST_EQ(VbSetSystemPropertyInt("kern_nv", 1), -1, "Set read-only");
+	TEST_EQ(VbSetSystemPropertyInt("no_such_property", 1), -1,
+		"Set unknown");
+	TEST_EQ(mock_writes, 0, "  not written");
+}
+
+static void TransactionTest(void)
+{
+	int avoided = -1;
+
+	ResetMocks();
+	TEST_EQ(VbBeginSystemPropertyTransaction(), 0, "Begin");
+	TEST_EQ(VbBeginSystemPropertyTransaction(), -1, "  not twice");
+	TEST_EQ(VbSetSystemPropertyInt("dev_boot_usb", 1), 0, "  set 1");
+	TEST_EQ(VbSetSystemPropertyInt("loc_idx", 3), 0, "  set 2");
+	TEST_EQ(VbSetSystemPropertyInt("oprom_needed", 1), 0, "  set 3");
+	TEST_EQ(VbSetSystemPropertyInt("fwupdate_tries", 2), 0, "  set 4");
+	TEST_EQ(VbSetSystemPropertyInt("loc_idx", 3), 0, "  set same");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 3, "  get pending");
+	TEST_EQ(VbGetSystemPropertyInt("fwupdate_tries"), 2,
+		"  get pending kern_nv field");
+	TEST_EQ(mock_writes, 0, "  nothing written yet");
+	TEST_EQ(VbCommitSystemPropertyTransaction(&avoided), 0, "Commit");
+	TEST_EQ(avoided, 3, "  writes avoided");
+	TEST_EQ(mock_reads, 1, "  read once");
+	TEST_EQ(mock_writes, 1, "  written once");
+	TEST_EQ(VbCommitSystemPropertyTransaction(NULL), -1, "  not twice");
+
+	/* Check what made it to the hardware */
+	VbDiscardSystemPropertySnapshot();
+	TEST_EQ(VbGetSystemPropertyInt("dev_boot_usb"), 1, "  value 1");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 3, "  value 2");
+	TEST_EQ(VbGetSystemPropertyInt("oprom_needed"), 1, "  value 3");
+	TEST_EQ(VbGetSystemPropertyInt("kern_nv"), 2, "  value 4");
+
+	/* No changes, no write */
+	ResetMocks();
+	TEST_EQ(VbBeginSystemPropertyTransaction(), 0, "Begin no changes");
+	TEST_EQ(VbCommitSystemPropertyTransaction(&avoided), 0, "  commit");
+	TEST_EQ(avoided, 0, "  writes avoided");
+	TEST_EQ(mock_writes, 0, "  not written");
+
+	ResetMocks();
+	TEST_EQ(VbBeginSystemPropertyTransaction(), 0, "Begin abort");
+	TEST_EQ(VbSetSystemPropertyInt("loc_idx", 5), 0, "  set");
+	VbAbortSystemPropertyTransaction();
+	TEST_EQ(mock_writes, 0, "  not written");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 0, "  change dropped");
+
+	ResetMocks();
+	mock_read_retval = -1;
+	TEST_EQ(VbBeginSystemPropertyTransaction(), -1, "Begin read failure");
+	mock_read_retval = 0;
+	TEST_EQ(VbBeginSystemPropertyTransaction(), 0, "  begin again");
+	VbAbortSystemPropertyTransaction();
+
+	ResetMocks();
+	mock_write_retval = -1;
+	TEST_EQ(VbBeginSystemPropertyTransaction(), 0, "Begin write failure");
+	TEST_EQ(VbSetSystemPropertyInt("loc_idx", 5), 0, "  set");
+	TEST_EQ(VbCommitSystemPropertyTransaction(NULL), -1, "  commit fails");
+	TEST_EQ(VbGetSystemPropertyInt("loc_idx"), 0, "  get reads again");
+	TEST_EQ(mock_reads, 2, "  read count");
+}
+
+int main(void)
+{
+	SingleSetTest();
+	TransactionTest();
+
+	return gTestSuccess ? 0 : 255;
+}
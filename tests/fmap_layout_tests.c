@@ -0,0 +1,178 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the FMAP layout library.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fmap.h"
+#include "fmap_layout.h"
+#include "test_common.h"
+
+#define MAX_AREAS 600
+
+static struct {
+	FmapHeader h;
+	FmapAreaHeader a[MAX_AREAS];
+} __attribute__((packed)) fmap;
+
+static void ResetFmap(uint32_t size)
+{
+	memset(&fmap, 0, sizeof(fmap));
+	memcpy(fmap.h.fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	fmap.h.fmap_size = size;
+}
+
+static void AddArea(const char *name, uint32_t offset, uint32_t size)
+{
+	FmapAreaHeader *ah = fmap.a + fmap.h.fmap_nareas++;
+
+	ah->area_offset = offset;
+	ah->area_size = size;
+	strncpy(ah->area_name, name, FMAP_NAMELEN);
+}
+
+static void TreeTest(void)
+{
+	FmapLayout layout;
+	const FmapLayoutNode *ro, *rw, *n;
+
+	/* Deliberately out of order */
+	ResetFmap(0x10000);
+	AddArea("RW_B", 0xc000, 0x2000);
+	AddArea("RO", 0, 0x8000);
+	AddArea("FMAP", 0x1000, 0x800);
+	AddArea("RW", 0x8000, 0x8000);
+	AddArea("RW_A", 0x8000, 0x2000);
+	AddArea("GBB", 0x2000, 0x6000);
+	AddArea("EMPTY", 0x2000, 0);
+	AddArea("RO_COPY", 0, 0x8000);
+	AddArea("RO_COPY2", 0, 0x8000);
+
+	TEST_EQ(FmapLayoutBuild(&fmap.h, &layout), 0, "Build");
+	TEST_EQ(layout.num_overlaps, 0, "  no overlaps");
+	TEST_EQ(strcmp(layout.root->name, "-entire flash-"), 0, "  root");
+	TEST_EQ(layout.root->num_children, 2, "  root children");
+
+	ro = FmapLayoutFind(&layout, "RO");
+	rw = FmapLayoutFind(&layout, "RW");
+	TEST_PTR_EQ(layout.root->children[0], ro, "  RO first");
+	TEST_PTR_EQ(layout.root->children[1], rw, "  RW second");
+	TEST_PTR_EQ(FmapLayoutFind(&layout, "NOPE"), NULL, "  find missing");
+
+	TEST_EQ(ro->num_dupes, 2, "  RO dupes");
+	TEST_EQ(strcmp(ro->dupes[0]->name, "RO_COPY"), 0, "  dupe 0");
+	TEST_EQ(strcmp(ro->dupes[1]->name, "RO_COPY2"), 0, "  dupe 1");
+	TEST_PTR_EQ(ro->dupes[1]->dupe_of, ro, "  dupe of");
+	TEST_PTR_EQ(ro->dupes[1]->parent, NULL, "  dupe not in tree");
+
+	/* An empty area still leaves the rest of its parent as a gap */
+	n = FmapLayoutFind(&layout, "GBB");
+	TEST_PTR_EQ(FmapLayoutFind(&layout, "EMPTY")->parent, n,
+		    "  empty area in GBB");
+	TEST_EQ(n->num_gaps, 1, "  GBB gaps");
+	TEST_EQ(n->gaps[0].start, 0x2000, "  gap start");
+	TEST_EQ(n->gaps[0].end, 0x8000, "  gap end");
+	TEST_EQ(ro->num_children, 2, "  RO children");
+
+	/* RO: [0,0x1000) below FMAP, [0x1800,0x2000) between FMAP and GBB */
+	TEST_EQ(ro->num_gaps, 2, "  RO gaps");
+	TEST_EQ(ro->gaps[0].start, 0, "  gap 0 start");
+	TEST_EQ(ro->gaps[0].end, 0x1000, "  gap 0 end");
+	TEST_EQ(ro->gaps[0].below, -1, "  gap 0 below");
+	TEST_EQ(ro->gaps[1].start, 0x1800, "  gap 1 start");
+	TEST_EQ(ro->gaps[1].below, 0, "  gap 1 below");
+
+	/* RW: between RW_A and RW_B, and above RW_B */
+	TEST_EQ(rw->num_gaps, 2, "  RW gaps");
+	TEST_EQ(rw->gaps[0].start, 0xa000, "  gap 0 start");
+	TEST_EQ(rw->gaps[1].start, 0xe000, "  gap 1 start");
+	TEST_EQ(rw->gaps[1].end, 0x10000, "  gap 1 end");
+	TEST_EQ(rw->gaps[1].below, 1, "  gap 1 below");
+	TEST_EQ(layout.num_gaps, 5, "  total gaps");
+
+	TEST_PTR_EQ(FmapLayoutNodeAt(&layout, 0x1234),
+		    FmapLayoutFind(&layout, "FMAP"), "Node at FMAP");
+	TEST_PTR_EQ(FmapLayoutNodeAt(&layout, 0x1900), ro, "  in gap");
+	TEST_PTR_EQ(FmapLayoutNodeAt(&layout, 0xdfff),
+		    FmapLayoutFind(&layout, "RW_B"), "  last byte");
+	TEST_PTR_EQ(FmapLayoutNodeAt(&layout, 0x10000), NULL, "  outside");
+
+	FmapLayoutFree(&layout);
+	TEST_PTR_EQ(layout.nodes, NULL, "Free");
+}
+
+static void OverlapTest(void)
+{
+	FmapLayout layout;
+
+	ResetFmap(0x1000);
+	AddArea("C", 0x300, 0x500);
+	AddArea("A", 0, 0x400);
+	AddArea("B", 0x200, 0x400);
+	AddArea("ALL", 0, 0x1000);
+
+	TEST_EQ(FmapLayoutBuild(&fmap.h, &layout), 0, "Overlaps");
+	TEST_EQ(layout.num_overlaps, 3, "  count");
+	TEST_EQ(strcmp(layout.overlaps[0].first->name, "A"), 0, "  0 first");
+	TEST_EQ(strcmp(layout.overlaps[0].second->name, "C"), 0, "  0 second");
+	TEST_EQ(strcmp(layout.overlaps[1].first->name, "A"), 0, "  1 first");
+	TEST_EQ(strcmp(layout.overlaps[1].second->name, "B"), 0, "  1 second");
+	TEST_EQ(strcmp(layout.overlaps[2].first->name, "B"), 0, "  2 first");
+	TEST_EQ(strcmp(layout.overlaps[2].second->name, "C"), 0, "  2 second");
+
+	/* An area as big as the flash doesn't adopt the others */
+	TEST_EQ(layout.root->num_children, 4, "  all under root");
+	TEST_EQ(FmapLayoutFind(&layout, "ALL")->num_children, 0,
+		"  not under ALL");
+	FmapLayoutFree(&layout);
+}
+
+static void ManyAreasTest(void)
+{
+	FmapLayout layout;
+	char name[FMAP_NAMELEN];
+	int i;
+
+	/* Slots of four sub-areas each, listed backwards */
+	ResetFmap(MAX_AREAS / 5 * 0x1000);
+	for (i = MAX_AREAS / 5 - 1; i >= 0; i--) {
+		sprintf(name, "SLOT_%d", i);
+		AddArea(name, i * 0x1000, 0x1000);
+		sprintf(name, "SLOT_%d_A", i);
+		AddArea(name, i * 0x1000, 0x400);
+		sprintf(name, "SLOT_%d_B", i);
+		AddArea(name, i * 0x1000 + 0x400, 0x400);
+		sprintf(name, "SLOT_%d_C", i);
+		AddArea(name, i * 0x1000 + 0x800, 0x400);
+		sprintf(name, "SLOT_%d_D", i);
+		AddArea(name, i * 0x1000 + 0xc00, 0x400);
+	}
+
+	TEST_EQ(FmapLayoutBuild(&fmap.h, &layout), 0, "Many areas");
+	TEST_EQ(layout.num_overlaps, 0, "  no overlaps");
+	TEST_EQ(layout.num_gaps, 0, "  no gaps");
+	TEST_EQ(layout.root->num_children, MAX_AREAS / 5, "  slots");
+	for (i = 0; i < layout.root->num_children; i++) {
+		if (layout.root->children[i]->num_children != 4 ||
+		    layout.root->children[i]->start != i * 0x1000)
+			break;
+	}
+	TEST_EQ(i, MAX_AREAS / 5, "  slot contents");
+	TEST_EQ(strcmp(FmapLayoutNodeAt(&layout, 0x7b00)->name, "SLOT_7_C"),
+		0, "  node at");
+	FmapLayoutFree(&layout);
+}
+
+int main(void)
+{
+	TreeTest();
+	OverlapTest();
+	ManyAreasTest();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -33,7 +33,8 @@ export SCRIPTDIR
 export OUTDIR
 
 # These are the scripts to run. Binaries are invoked directly by the Makefile.
-TESTS="${SCRIPTDIR}/test_dump_fmap.sh"
+TESTS="${SCRIPTDIR}/test_dump_fmap.sh
+${SCRIPTDIR}/test_verify_batch.sh"
 
 
 # Get ready...
@@ -0,0 +1,54 @@
+#!/bin/bash -eu
+# Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$OUTDIR/$me.tmp"
+
+DATADIR="${SCRIPTDIR}/../preamble_tests/data"
+V2DIR="${SCRIPTDIR}/../preamble_tests/preamble_v2x"
+
+# Good and bad images, with keys shared between them.
+cat > "$TMP.manifest" <<EOF
+# type   image(s)                        signpubkey
+kernel   $V2DIR/kern_4_4.vblock           $DATADIR/root_4.vbpubk
+kernel   $V2DIR/kern_7_11.vblock          $DATADIR/root_11.vbpubk
+kernel   $V2DIR/kern_4_7.vblock           $DATADIR/root_4.vbpubk
+kernel   $V2DIR/kern_11_4.vblock          -
+firmware $V2DIR/fw_4_4.vblock $DATADIR/FWDATA   $DATADIR/root_4.vbpubk
+firmware $V2DIR/fw_7_4.vblock $DATADIR/KERNDATA $DATADIR/root_4.vbpubk
+EOF
+
+# One of them fails, so the whole batch does.
+if "$FUTILITY" verify_batch -j 3 "$TMP.manifest" > "$TMP" ; then
+  echo Wait, that was supposed to fail. 1>&2
+  exit 1
+fi
+
+[ "$(wc -l < "$TMP")" = 6 ]
+result() {
+  sed -n "${1}p" "$TMP" | grep -o '"result": "[a-z]*", "error": [^,]*'
+}
+[ "$(result 1)" = '"result": "ok", "error": null' ]
+[ "$(result 2)" = '"result": "ok", "error": null' ]
+[ "$(result 3)" = '"result": "fail", "error": "key block"' ]
+[ "$(result 4)" = '"result": "ok", "error": null' ]
+[ "$(result 5)" = '"result": "ok", "error": null' ]
+[ "$(result 6)" = '"result": "fail", "error": "body"' ]
+grep -q '"image": "'"$V2DIR"'/fw_4_4.vblock", "line": 6, "type": "firmware"' "$TMP"
+
+# Same thing from stdin on one thread, without the bad ones.
+sed -e '/kern_4_7/d' -e '/KERNDATA/d' "$TMP.manifest" |
+  "$FUTILITY" verify_batch --threads 1 - > "$TMP"
+[ "$(grep -c '"result": "ok"' "$TMP")" = 4 ]
+
+# Bad manifests
+echo "kernel $V2DIR/kern_4_4.vblock" |
+  if "$FUTILITY" verify_batch - ; then false; fi
+echo "bogus $V2DIR/kern_4_4.vblock -" |
+  if "$FUTILITY" verify_batch - ; then false; fi
+echo "kernel $V2DIR/kern_4_4.vblock /no/such/key" |
+  if "$FUTILITY" verify_batch - ; then false; fi
+
+rm -f "$TMP" "$TMP.manifest"
@@ -0,0 +1,176 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host file access functions.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "file_keys.h"
+#include "host_common.h"
+#include "test_common.h"
+
+/* Bigger than the first read from a pipe, so the buffer has to grow */
+#define DATA_SIZE (200 * 1024 + 7)
+
+static uint8_t data[DATA_SIZE];
+static char dir[] = "/tmp/host_file_tests.XXXXXX";
+static char file_name[64];
+static char empty_name[64];
+static char fifo_name[64];
+
+/* Start a child process which writes [data] into the fifo, then exits */
+static pid_t FillFifo(void)
+{
+	pid_t pid = fork();
+	FILE *f;
+
+	if (pid)
+		return pid;
+
+	f = fopen(fifo_name, "wb");
+	if (!f || 1 != fwrite(data, DATA_SIZE, 1, f))
+		_exit(1);
+	fclose(f);
+	_exit(0);
+}
+
+static int WaitForChild(pid_t pid)
+{
+	int status;
+
+	if (pid < 0 || waitpid(pid, &status, 0) != pid)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void FdSizeTest(void)
+{
+	int fd;
+
+	fd = open(file_name, O_RDONLY);
+	TEST_EQ((int)FdSize(fd), DATA_SIZE, "FdSize() regular file");
+	close(fd);
+
+	fd = open(empty_name, O_RDONLY);
+	TEST_EQ((int)FdSize(fd), 0, "FdSize() empty file");
+	close(fd);
+
+	/* Nothing's writing, so don't wait for a writer */
+	fd = open(fifo_name, O_RDONLY | O_NONBLOCK);
+	TEST_EQ((int)FdSize(fd), 0, "FdSize() fifo");
+	close(fd);
+
+	TEST_EQ((int)FdSize(-1), 0, "FdSize() bad fd");
+}
+
+static void MapFileTest(void)
+{
+	MappedFile file;
+	pid_t pid;
+
+	TEST_EQ(MapFile(file_name, &file), 0, "MapFile() regular file");
+	TEST_EQ(file.mapped, 1, "  mapped");
+	TEST_EQ((int)file.size, DATA_SIZE, "  size");
+	TEST_EQ(memcmp(file.data, data, DATA_SIZE), 0, "  data");
+	UnmapFile(&file);
+	TEST_PTR_EQ(file.data, NULL, "UnmapFile() clears data");
+	TEST_EQ((int)file.size, 0, "UnmapFile() clears size");
+
+	TEST_EQ(MapFile(empty_name, &file), 0, "MapFile() empty file");
+	TEST_EQ((int)file.size, 0, "  size");
+	UnmapFile(&file);
+
+	errno = 0;
+	TEST_NEQ(MapFile("/no/such/file", &file), 0, "MapFile() missing");
+	TEST_EQ(errno, ENOENT, "  errno");
+	TEST_PTR_EQ(file.data, NULL, "  data");
+
+	pid = FillFifo();
+	TEST_EQ(MapFile(fifo_name, &file), 0, "MapFile() fifo");
+	TEST_EQ(WaitForChild(pid), 0, "  writer");
+	TEST_EQ(file.mapped, 0, "  read, not mapped");
+	TEST_EQ((int)file.size, DATA_SIZE, "  size");
+	TEST_EQ(memcmp(file.data, data, DATA_SIZE), 0, "  data");
+	UnmapFile(&file);
+}
+
+static void ReadFileTest(void)
+{
+	uint8_t *buf;
+	uint64_t size = 0;
+	pid_t pid;
+
+	buf = ReadFile(file_name, &size);
+	TEST_PTR_NEQ(buf, NULL, "ReadFile() regular file");
+	TEST_EQ((int)size, DATA_SIZE, "  size");
+	TEST_EQ(memcmp(buf, data, DATA_SIZE), 0, "  data");
+	free(buf);
+
+	TEST_PTR_EQ(ReadFile(empty_name, &size), NULL, "ReadFile() empty file");
+	TEST_PTR_EQ(ReadFile("/no/such/file", &size), NULL,
+		    "ReadFile() missing");
+
+	/* Pipes can't seek, so the size isn't known up front */
+	size = 0;
+	pid = FillFifo();
+	buf = ReadFile(fifo_name, &size);
+	TEST_EQ(WaitForChild(pid), 0, "ReadFile() fifo writer");
+	TEST_PTR_NEQ(buf, NULL, "ReadFile() fifo");
+	TEST_EQ((int)size, DATA_SIZE, "  size");
+	if (buf)
+		TEST_EQ(memcmp(buf, data, DATA_SIZE), 0, "  data");
+	free(buf);
+
+	size = 0;
+	buf = BufferFromFile(file_name, &size);
+	TEST_PTR_NEQ(buf, NULL, "BufferFromFile()");
+	TEST_EQ((int)size, DATA_SIZE, "  size");
+	free(buf);
+	TEST_PTR_EQ(BufferFromFile("/no/such/file", &size), NULL,
+		    "BufferFromFile() missing");
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *f;
+	int i;
+
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	if (!mkdtemp(dir)) {
+		fprintf(stderr, "Can't make a temp dir\n");
+		return 255;
+	}
+	snprintf(file_name, sizeof(file_name), "%s/file", dir);
+	snprintf(empty_name, sizeof(empty_name), "%s/empty", dir);
+	snprintf(fifo_name, sizeof(fifo_name), "%s/fifo", dir);
+	f = fopen(empty_name, "wb");
+	if (!f || fclose(f) || WriteFile(file_name, data, DATA_SIZE) ||
+	    mkfifo(fifo_name, 0600)) {
+		fprintf(stderr, "Can't make test files\n");
+		return 255;
+	}
+
+	FdSizeTest();
+	MapFileTest();
+	ReadFileTest();
+
+	unlink(file_name);
+	unlink(empty_name);
+	unlink(fifo_name);
+	rmdir(dir);
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,107 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the image signature scanner.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "image_scan.h"
+#include "test_common.h"
+
+#define IMAGE_SIZE (64 * 1024 + 5)
+
+static uint8_t image[IMAGE_SIZE];
+
+static void Put(uint64_t offset, const char *sig)
+{
+	memcpy(image + offset, sig, strlen(sig));
+}
+
+static void ScanTest(void)
+{
+	ImageScan scan;
+
+	/* Near misses everywhere, so most words need a closer look */
+	memset(image, 'C', IMAGE_SIZE);
+	Put(0, "CHROMEOS");
+	Put(0x1000, "__FMAP__");
+	Put(0x2002, "__FMAP__");  /* Not on a 4-byte stride */
+	Put(0x3001, "$GBB");
+	Put(0x4000, "$BMP");
+	Put(0x4005, "$BM");
+	Put(0x5003, "CrOSPart");
+	Put(0x6000, "CHROMEO");
+	Put(0x7000, "CHROMEOS");
+	Put(IMAGE_SIZE - 4, "$GBB");  /* In the bytes after the last word */
+	Put(IMAGE_SIZE - 12, "CrOSPar");
+
+	TEST_EQ(ScanImage(image, IMAGE_SIZE, &scan), 0, "ScanImage()");
+	TEST_EQ((int)scan.count[IMAGE_SIG_FMAP], 1, "  FMAP count");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_FMAP][0], 0x1000, "  FMAP");
+	TEST_EQ((int)scan.count[IMAGE_SIG_GBB], 2, "  GBB count");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_GBB][0], 0x3001, "  GBB 0");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_GBB][1], IMAGE_SIZE - 4, "  GBB 1");
+	TEST_EQ((int)scan.count[IMAGE_SIG_BMPBLOCK], 1, "  BMPBLOCK count");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_BMPBLOCK][0], 0x4000,
+		"  BMPBLOCK");
+	TEST_EQ((int)scan.count[IMAGE_SIG_KEYBLOCK], 2, "  keyblock count");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_KEYBLOCK][0], 0, "  keyblock 0");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_KEYBLOCK][1], 0x7000,
+		"  keyblock 1");
+	TEST_EQ((int)scan.count[IMAGE_SIG_MTD], 1, "  MTD count");
+	TEST_EQ((int)scan.offsets[IMAGE_SIG_MTD][0], 0x5003, "  MTD");
+
+	TEST_EQ((int)ImageScanFirst(&scan, IMAGE_SIG_KEYBLOCK, 1), 0,
+		"ImageScanFirst()");
+	TEST_EQ((int)ImageScanFirst(&scan, IMAGE_SIG_GBB, 512), -1,
+		"  none aligned");
+	TEST_EQ((int)ImageScanFirst(&scan, IMAGE_SIG_MTD, 1), 0x5003,
+		"  MTD");
+
+	FreeImageScan(&scan);
+	TEST_EQ((int)scan.count[IMAGE_SIG_GBB], 0, "FreeImageScan()");
+	TEST_PTR_EQ(scan.offsets[IMAGE_SIG_GBB], NULL, "  offsets");
+	TEST_EQ((int)ImageScanFirst(&scan, IMAGE_SIG_GBB, 1), -1, "  first");
+
+	/* Signatures which overlap the end of the image don't count */
+	TEST_EQ(ScanImage(image, 0x1004, &scan), 0, "Truncated image");
+	TEST_EQ((int)scan.count[IMAGE_SIG_FMAP], 0, "  FMAP count");
+	TEST_EQ((int)scan.count[IMAGE_SIG_KEYBLOCK], 1, "  keyblock count");
+	FreeImageScan(&scan);
+
+	TEST_EQ(ScanImage(image, 0, &scan), 0, "Empty image");
+	TEST_EQ((int)scan.count[IMAGE_SIG_KEYBLOCK], 0, "  keyblock count");
+	FreeImageScan(&scan);
+}
+
+static void ManyHitsTest(void)
+{
+	ImageScan scan;
+	int i;
+
+	/* Enough to make the offset arrays grow several times */
+	memset(image, 0, IMAGE_SIZE);
+	for (i = 0; i < 1000; i++)
+		Put(i * 16, "$GBB");
+
+	TEST_EQ(ScanImage(image, IMAGE_SIZE, &scan), 0, "Many hits");
+	TEST_EQ((int)scan.count[IMAGE_SIG_GBB], 1000, "  count");
+	for (i = 0; i < 1000; i++) {
+		if (scan.offsets[IMAGE_SIG_GBB][i] != i * 16)
+			break;
+	}
+	TEST_EQ(i, 1000, "  offsets in order");
+	FreeImageScan(&scan);
+}
+
+int main(void)
+{
+	ScanTest();
+	ManyHitsTest();
+
+	return gTestSuccess ? 0 : 255;
+}
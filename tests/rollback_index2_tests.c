@@ -13,6 +13,7 @@
 #define _STUB_IMPLEMENTATION_  /* So we can use memset() ourselves */
 
 #include "crc8.h"
+#include "host_common.h"
 #include "rollback_index.h"
 #include "test_common.h"
 #include "tlcl.h"
@@ -54,6 +55,7 @@ static TPM_PERMANENT_FLAGS mock_pflags;
 static RollbackSpaceFirmware mock_rsf;
 static RollbackSpaceKernel mock_rsk;
 static uint32_t mock_permissions;
+static int mock_pending;  /* Polls before a split-phase command finishes */
 
 /* Reset the variables for the Tlcl mock functions. */
 static void ResetMocks(int fail_on_call, uint32_t fail_with_err)
@@ -70,6 +72,7 @@ static void ResetMocks(int fail_on_call, uint32_t fail_with_err)
 	Memset(&mock_rsf, 0, sizeof(mock_rsf));
 	Memset(&mock_rsk, 0, sizeof(mock_rsk));
 	mock_permissions = 0;
+	mock_pending = 0;
 }
 
 /****************************************************************************/
@@ -142,6 +145,54 @@ uint32_t TlclRead(uint32_t index, void* data, uint32_t length)
 	return (++mock_count == fail_at_count) ? fail_with_error : TPM_SUCCESS;
 }
 
+/*
+ * Split-phase commands log the same as their blocking versions, and stay
+ * pending for mock_pending polls.
+ */
+uint32_t TlclReadStart(TlclCommand *cmd, uint32_t index, uint32_t length)
+{
+	TEST_EQ(length <= sizeof(cmd->response), 1, "TlclReadStart size");
+	cmd->result = TlclRead(index, cmd->response, length);
+	cmd->state = mock_pending ? TLCL_COMMAND_PENDING : TLCL_COMMAND_DONE;
+	return TPM_SUCCESS;
+}
+
+uint32_t TlclReadFinish(TlclCommand *cmd, void *data, uint32_t length)
+{
+	TEST_EQ(cmd->state, TLCL_COMMAND_DONE, "TlclReadFinish done");
+	Memcpy(data, cmd->response, length);
+	return cmd->result;
+}
+
+uint32_t TlclContinueSelfTestStart(TlclCommand *cmd)
+{
+	cmd->result = TlclContinueSelfTest();
+	cmd->state = mock_pending ? TLCL_COMMAND_PENDING : TLCL_COMMAND_DONE;
+	return TPM_SUCCESS;
+}
+
+uint32_t TlclCommandPoll(TlclCommand *cmd)
+{
+	if (cmd->state == TLCL_COMMAND_PENDING) {
+		mock_cnext += sprintf(mock_cnext, "TlclCommandPoll()\n");
+		if (--mock_pending > 0)
+			return TPM_E_COMMAND_PENDING;
+		cmd->state = TLCL_COMMAND_DONE;
+	}
+	return cmd->result;
+}
+
+uint32_t TlclCommandWait(TlclCommand *cmd)
+{
+	uint32_t result;
+
+	mock_cnext += sprintf(mock_cnext, "TlclCommandWait()\n");
+	do {
+		result = TlclCommandPoll(cmd);
+	} while (result == TPM_E_COMMAND_PENDING);
+	return result;
+}
+
 uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length)
 {
 	mock_cnext += sprintf(mock_cnext, "TlclWrite(0x%x, %d)\n",
@@ -747,6 +798,61 @@ static void SetupTpmTest(void)
 		FLAG_VIRTUAL_DEV_MODE_ON | FLAG_LAST_BOOT_DEVELOPER,
 		"virtual dev sets last boot");
 
+	/* Split-phase setup returns while the firmware space read is pending */
+	{
+		SetupTPMState state;
+
+		ResetMocks(0, 0);
+		mock_pending = 3;
+		mock_rsf.fw_versions = 0x12345678;
+		TEST_EQ(SetupTPMStart(&state, 0, 0, 0, 0, &rsf),
+			TPM_E_COMMAND_PENDING, "SetupTPMStart() pending");
+		TEST_EQ(SetupTPMResume(&state), TPM_E_COMMAND_PENDING,
+			"SetupTPMResume() pending");
+		TEST_EQ(SetupTPMResume(&state), 0, "SetupTPMResume() done");
+		TEST_EQ(SetupTPMResume(&state), 0, "SetupTPMResume() again");
+		TEST_EQ(rsf.fw_versions, 0x12345678, "SetupTPMResume() rsf");
+		TEST_STR_EQ(mock_calls,
+			    "TlclLibInit()\n"
+			    "TlclStartup()\n"
+			    "TlclAssertPhysicalPresence()\n"
+			    "TlclGetPermanentFlags()\n"
+			    "TlclRead(0x1007, 10)\n"
+			    "TlclCommandPoll()\n"
+			    "TlclCommandPoll()\n"
+			    "TlclCommandPoll()\n",
+			    "tlcl calls");
+
+		/* Errors before the read don't leave it pending */
+		ResetMocks(1, TPM_E_IOERROR);
+		mock_pending = 3;
+		TEST_EQ(SetupTPMStart(&state, 0, 0, 0, 0, &rsf),
+			TPM_E_IOERROR, "SetupTPMStart() error");
+		TEST_EQ(SetupTPMResume(&state), TPM_E_IOERROR,
+			"SetupTPMResume() error");
+
+		/* A noisy split-phase read falls back to blocking reads */
+		ResetMocks(0, 0);
+		mock_pending = 2;
+		mock_rsf.struct_version = 2;
+		mock_rsf.crc8 = Crc8(&mock_rsf,
+				     offsetof(RollbackSpaceFirmware, crc8));
+		noise_on[0] = 1;
+		TEST_EQ(SetupTPMStart(&state, 0, 0, 0, 0, &rsf),
+			TPM_E_COMMAND_PENDING, "SetupTPMStart() noisy");
+		TEST_EQ(SetupTPMResume(&state), 0, "SetupTPMResume() noisy");
+		TEST_STR_EQ(mock_calls,
+			    "TlclLibInit()\n"
+			    "TlclStartup()\n"
+			    "TlclAssertPhysicalPresence()\n"
+			    "TlclGetPermanentFlags()\n"
+			    "TlclRead(0x1007, 10)\n"
+			    "TlclCommandPoll()\n"
+			    "TlclCommandPoll()\n"
+			    "TlclRead(0x1007, 10)\n",
+			    "tlcl calls");
+	}
+
 	/*
 	 * Note: SetupTPM() recovery_mode parameter sets a global flag in
 	 * rollback_index.c; this is tested along with RollbackKernelLock()
@@ -827,6 +933,52 @@ static void RollbackFirmwareTest(void)
 		    "TlclSetDeactivated(0)\n",
 		    "tlcl calls");
 
+	/* Split-phase setup */
+	{
+		RollbackFirmwareSetupState state;
+
+		ResetMocks(0, 0);
+		mock_pending = 3;
+		mock_rsf.fw_versions = 0x12345678;
+		mock_rsf.flags = FLAG_VIRTUAL_DEV_MODE_ON;
+		dev_mode = 0;
+		version = 123;
+		TEST_EQ(RollbackFirmwareSetupStart(&state, 0, 0, 0, 0),
+			TPM_E_COMMAND_PENDING,
+			"RollbackFirmwareSetupStart() pending");
+		TEST_EQ(RollbackFirmwareSetupResume(&state, &dev_mode,
+						    &version),
+			TPM_E_COMMAND_PENDING,
+			"RollbackFirmwareSetupResume() pending");
+		TEST_EQ(version, 0, "RollbackFirmwareSetupResume() no version");
+		TEST_EQ(RollbackFirmwareSetupResume(&state, &dev_mode,
+						    &version),
+			0, "RollbackFirmwareSetupResume() done");
+		TEST_EQ(version, 0x12345678,
+			"RollbackFirmwareSetupResume() version");
+		TEST_EQ(dev_mode, 1, "RollbackFirmwareSetupResume() virt dev");
+	}
+
+	/* The blocking version waits for a split-phase read */
+	ResetMocks(0, 0);
+	mock_pending = 3;
+	mock_rsf.fw_versions = 0x12345678;
+	version = 123;
+	TEST_EQ(RollbackFirmwareSetup(0, 0, 0, 0, &dev_mode, &version),
+		0, "RollbackFirmwareSetup() pending");
+	TEST_EQ(version, 0x12345678, "RollbackFirmwareSetup() pending version");
+	TEST_STR_EQ(mock_calls,
+		    "TlclLibInit()\n"
+		    "TlclStartup()\n"
+		    "TlclAssertPhysicalPresence()\n"
+		    "TlclGetPermanentFlags()\n"
+		    "TlclRead(0x1007, 10)\n"
+		    "TlclCommandPoll()\n"
+		    "TlclCommandPoll()\n"
+		    "TlclCommandWait()\n"
+		    "TlclCommandPoll()\n",
+		    "tlcl calls");
+
 	/* Test write */
 	ResetMocks(0, 0);
 	TEST_EQ(RollbackFirmwareWrite(0xBEAD1234), 0,
@@ -974,6 +1126,53 @@ static void RollbackS3ResumeTest(void)
 		"RollbackS3Resume() other error");
 }
 
+/**
+ * Verify a key block while RollbackFirmwareSetupStart()/Resume() waits on the
+ * TPM, as firmware does to overlap the firmware space read with its own work.
+ */
+static void RollbackFirmwareOverlapTest(const char *keys_dir)
+{
+	char filename[1024];
+	VbPrivateKey *private_key;
+	VbPublicKey *public_key;
+	VbKeyBlockHeader *key_block;
+	RollbackFirmwareSetupState state;
+	uint32_t version = 123;
+	uint32_t result;
+	int dev_mode = 0;
+	int checks = 0;
+
+	sprintf(filename, "%s/key_rsa2048.sha256.vbprivk", keys_dir);
+	private_key = PrivateKeyRead(filename);
+	sprintf(filename, "%s/key_rsa2048.sha256.vbpubk", keys_dir);
+	public_key = PublicKeyRead(filename);
+	TEST_PTR_NEQ(private_key, NULL, "Overlap private key");
+	TEST_PTR_NEQ(public_key, NULL, "Overlap public key");
+	if (!private_key || !public_key)
+		return;
+	key_block = KeyBlockCreate(public_key, private_key, 0);
+
+	ResetMocks(0, 0);
+	mock_pending = 3;
+	mock_rsf.fw_versions = 0x12345678;
+	result = RollbackFirmwareSetupStart(&state, 0, 0, 0, 0);
+	TEST_EQ(result, TPM_E_COMMAND_PENDING, "Overlap setup pending");
+	while (result == TPM_E_COMMAND_PENDING) {
+		if (!KeyBlockVerify(key_block, key_block->key_block_size,
+				    public_key, 0))
+			checks++;
+		result = RollbackFirmwareSetupResume(&state, &dev_mode,
+						     &version);
+	}
+	TEST_EQ(result, 0, "Overlap setup done");
+	TEST_EQ(checks, 2, "Overlap key blocks verified while pending");
+	TEST_EQ(version, 0x12345678, "Overlap version");
+
+	free(key_block);
+	free(public_key);
+	PrivateKeyFree(private_key);
+}
+
 int main(int argc, char* argv[])
 {
 	CrcTestFirmware();
@@ -985,5 +1184,9 @@ int main(int argc, char* argv[])
 	RollbackKernelTest();
 	RollbackS3ResumeTest();
 
+	/* Tests which need real keys */
+	if (argc > 1)
+		RollbackFirmwareOverlapTest(argv[1]);
+
 	return gTestSuccess ? 0 : 255;
 }
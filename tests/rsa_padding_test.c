@@ -49,6 +49,18 @@ static void TestRSAVerify(RSAPublicKey* key) {
   TEST_EQ(RSAVerify(key, signatures[0], RSA1024NUMBYTES, 3,
                     test_message_sha1_hash), 0, "RSAVerify() wrong alg");
 
+  /* Both limb sizes must give the same answer */
+  if (key->n64) {
+    uint64_t* n64 = key->n64;
+    key->n64 = NULL;
+    TEST_EQ(RSAVerify(key, signatures[0], RSA1024NUMBYTES, 0,
+                      test_message_sha1_hash), 1, "RSAVerify() 32-bit limbs");
+    TEST_EQ(RSAVerify(key, signatures[1], RSA1024NUMBYTES, 0,
+                      test_message_sha1_hash), 0,
+            "RSAVerify() 32-bit limbs bad sig");
+    key->n64 = n64;
+  }
+
   /* Corrupt the signature near start and end */
   Memcpy(sig, signatures[0], RSA1024NUMBYTES);
   sig[3] ^= 0x42;
@@ -61,6 +73,52 @@ static void TestRSAVerify(RSAPublicKey* key) {
           "RSAVerify() bad sig end");
 }
 
+/* Test verifying with a reusable context */
+static void TestRSAVerifyContext(RSAPublicKey* key) {
+  RSAVerifyContext ctx;
+  uint32_t workbuf[RSA_MAX_VERIFY_WORKBUF_SIZE / sizeof(uint32_t)];
+  uint8_t sig[RSA1024NUMBYTES];
+  int i;
+
+  TEST_EQ(RSAVerifyContextInit(&ctx, key, workbuf,
+                               RSA_VERIFY_WORKBUF_SIZE(key->len) - 1), 0,
+          "RSAVerifyContextInit() workbuf too small");
+  TEST_EQ(RSAVerifyContextInit(&ctx, NULL, workbuf, sizeof(workbuf)), 0,
+          "RSAVerifyContextInit() no key");
+  TEST_EQ(RSAVerifyWithContext(&ctx, signatures[0], RSA1024NUMBYTES, 0,
+                               test_message_sha1_hash), 0,
+          "RSAVerifyWithContext() uninitialized");
+  TEST_EQ(RSAVerifyContextInit(&ctx, key, workbuf,
+                               RSA_VERIFY_WORKBUF_SIZE(key->len)), 1,
+          "RSAVerifyContextInit() good");
+
+  /* Results must not depend on what earlier calls left in the work buffer */
+  for (i = 0; i < 2; i++) {
+    TEST_EQ(RSAVerifyWithContext(&ctx, signatures[0], RSA1024NUMBYTES, 0,
+                                 test_message_sha1_hash), 1,
+            "RSAVerifyWithContext() good");
+    TEST_EQ(RSAVerifyWithContext(&ctx, signatures[1], RSA1024NUMBYTES, 0,
+                                 test_message_sha1_hash), 0,
+            "RSAVerifyWithContext() invalid sig");
+  }
+  TEST_EQ(RSAVerifyWithContext(&ctx, signatures[0], RSA1024NUMBYTES - 1, 0,
+                               test_message_sha1_hash), 0,
+          "RSAVerifyWithContext() sig len");
+  TEST_EQ(RSAVerifyWithContext(&ctx, signatures[0], RSA1024NUMBYTES, 3,
+                               test_message_sha1_hash), 0,
+          "RSAVerifyWithContext() wrong alg");
+
+  Memcpy(sig, signatures[0], RSA1024NUMBYTES);
+  sig[RSA1024NUMBYTES - 3] ^= 0x56;
+  TEST_EQ(RSAVerifyWithContext(&ctx, sig, RSA1024NUMBYTES, 0,
+                               test_message_sha1_hash), 0,
+          "RSAVerifyWithContext() bad sig end");
+
+  /* Context doesn't own the key, so this must leave it intact */
+  RSAVerifyContextFree(&ctx);
+  TEST_PTR_NEQ(key->n, NULL, "RSAVerifyContextFree() leaves key");
+}
+
 
 int main(int argc, char* argv[]) {
   int error = 0;
@@ -80,6 +138,7 @@ int main(int argc, char* argv[]) {
   /* Run tests */
   TestSignatures(key);
   TestRSAVerify(key);
+  TestRSAVerifyContext(key);
 
   /* Clean up and exit */
   RSAPublicKeyFree(key);
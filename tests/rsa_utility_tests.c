@@ -65,6 +65,8 @@ static void TestUtils(void) {
   /* New key fields */
   TEST_PTR_EQ(key->n, NULL, "New key no n");
   TEST_PTR_EQ(key->rr, NULL, "New key no rr");
+  TEST_PTR_EQ(key->n64, NULL, "New key no n64");
+  TEST_PTR_EQ(key->rr64, NULL, "New key no rr64");
   TEST_EQ(key->len, 0, "New key len");
   TEST_EQ(key->algorithm, kNumAlgorithms, "New key no algorithm");
   /* Free key */
@@ -127,6 +129,74 @@ static void TestKeyFromBuffer(void) {
   free(buf);
 }
 
+/* Test key views of a buffer */
+static void TestKeyView(void) {
+  RSAPublicKey view;
+  RSAPublicKey* key;
+  uint8_t* alloc;
+  uint8_t* buf;
+  uint32_t key_len;
+  int offset;
+  int i;
+
+  alloc = malloc(8 + 2 * RSA8192NUMBYTES + 8);
+
+  for (i = 0; i < 4; i++) {
+    key_len = RSA1024NUMBYTES << i;
+    for (offset = 0; offset < 8; offset += 4) {
+      int j;
+
+      buf = alloc + offset;
+      for (j = 0; j < 8 + 2 * key_len; j++)
+        buf[j] = (uint8_t)(j * 7 + 1);
+      *(uint32_t*)buf = key_len / sizeof(uint32_t);
+      *(uint32_t*)(buf + 4) = 0xF00D2345;
+
+      key = RSAPublicKeyFromBuf(buf, 8 + key_len * 2);
+      TEST_PTR_EQ(RSAPublicKeyView(&view, buf, 8 + key_len * 2), &view,
+                  "RSAPublicKeyView() ptr");
+      TEST_EQ(view.len, key->len, "RSAPublicKeyView() len");
+      TEST_EQ(view.n0inv, 0xF00D2345, "RSAPublicKeyView() n0inv");
+      TEST_EQ(Memcmp(view.n, key->n, key_len), 0, "RSAPublicKeyView() n");
+      TEST_EQ(Memcmp(view.rr, key->rr, key_len), 0,
+              "RSAPublicKeyView() rr");
+      TEST_EQ(view.flags & RSA_KEY_VIEW, RSA_KEY_VIEW,
+              "RSAPublicKeyView() flags");
+
+      /* Views use the buffer in place when they can */
+      if (!view.blob_copy)
+        TEST_PTR_EQ(view.n, buf + 8, "RSAPublicKeyView() no copy");
+      else
+        TEST_NEQ(offset, 0, "RSAPublicKeyView() copy only if misaligned");
+
+      /* 64-bit limbs, if any, match a parsed key */
+      if (key->n64 && view.n64) {
+        TEST_EQ(Memcmp(view.n64, key->n64, key_len), 0,
+                "RSAPublicKeyView() n64");
+        TEST_EQ(Memcmp(view.rr64, key->rr64, key_len), 0,
+                "RSAPublicKeyView() rr64");
+        TEST_EQ(view.n0inv64 == key->n0inv64, 1,
+                "RSAPublicKeyView() n0inv64");
+      }
+
+      /* Doesn't free the caller's storage */
+      RSAPublicKeyFree(&view);
+      RSAPublicKeyFree(key);
+
+      TEST_PTR_EQ(RSAPublicKeyView(&view, buf, 8 + key_len * 2 - 1), NULL,
+                  "RSAPublicKeyView() underflow");
+      TEST_PTR_EQ(RSAPublicKeyView(&view, buf, 8 + key_len * 2 + 1), NULL,
+                  "RSAPublicKeyView() overflow");
+      TEST_PTR_EQ(RSAPublicKeyView(&view, buf, 4), NULL,
+                  "RSAPublicKeyView() truncated");
+      *(uint32_t*)buf = key_len / sizeof(uint32_t) + 1;
+      TEST_PTR_EQ(RSAPublicKeyView(&view, buf, 8 + key_len * 2), NULL,
+                  "RSAPublicKeyView() invalid key length");
+    }
+  }
+  free(alloc);
+}
+
 /* Test verifying binary */
 static void TestVerifyBinary(void) {
   RSAPublicKey key;
@@ -209,6 +279,7 @@ int main(int argc, char* argv[]) {
   /* Run tests */
   TestUtils();
   TestKeyFromBuffer();
+  TestKeyView();
   TestVerifyBinary();
   TestVerifyBinaryWithDigest();
 
@@ -0,0 +1,142 @@
+#!/bin/bash -u
+#
+# Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Build a seed corpus for each of the vboot_fuzz_driver targets, then run a
+# short fuzzing session on each to make sure the parsers survive it.  Set
+# FUZZ_RUNS to change the number of mutated inputs per target.
+#
+# The corpus is left in ${BUILD}/fuzz_corpus/TARGET, for longer runs:
+#   vboot_fuzz_driver TARGET --runs 100000000 ${BUILD}/fuzz_corpus/TARGET
+
+# Load common constants and variables for tests.
+. "$(dirname "$0")/common.sh"
+
+FUZZ_DRIVER="${TEST_DIR}/vboot_fuzz_driver"
+CGPT="${BUILD_DIR}/cgpt/cgpt"
+CORPUS_DIR="${BUILD_DIR}/fuzz_corpus"
+RUNS=${FUZZ_RUNS:-20000}
+PREAMBLE_DIR="${SCRIPT_DIR}/preamble_tests"
+
+# Write the arguments as little-endian 32-bit words
+function le32 {
+  local v
+  for v in "$@"; do
+    printf "$(printf '\\x%02x' $((v & 255)) $((v >> 8 & 255)) \
+      $((v >> 16 & 255)) $((v >> 24 & 255)))"
+  done
+}
+
+# args: target prefix
+function gen_vblock_corpus {
+  local t="$1"
+  local f
+  mkdir -p "${CORPUS_DIR}/keyblock" "${CORPUS_DIR}/${t}_preamble"
+  for f in ${PREAMBLE_DIR}/preamble_v2x/$2_*.vblock; do
+    cp "$f" "${CORPUS_DIR}/${t}_preamble/"
+    cp "$f" "${CORPUS_DIR}/keyblock/"
+  done
+}
+
+function gen_gpt_corpus {
+  local dir="${CORPUS_DIR}/gpt"
+  local img
+  mkdir -p "$dir"
+
+  # Flags byte in the PMBR asks the driver to fix up CRCs after mutation
+  img="${dir}/empty"
+  rm -f "$img"
+  ${CGPT} create -c -s 128 "$img"
+  printf "\\x01" | dd of="$img" conv=notrunc status=none
+
+  img="${dir}/kernels"
+  cp "${dir}/empty" "$img"
+  ${CGPT} add -b 34 -s 20 -t kernel -l KERN-A -S 0 -T 15 -P 15 "$img"
+  ${CGPT} add -b 54 -s 20 -t kernel -l KERN-B -S 1 -T 0 -P 9 "$img"
+  ${CGPT} add -b 74 -s 20 -t rootfs -l ROOT-A "$img"
+
+  # Only the primary GPT is good
+  img="${dir}/primary_only"
+  cp "${dir}/kernels" "$img"
+  dd if=/dev/zero of="$img" bs=512 seek=127 count=1 conv=notrunc status=none
+}
+
+function gen_mtd_corpus {
+  local dir="${CORPUS_DIR}/mtd"
+  # Partition flags: type << 9 | successful << 8 | tries << 4 | priority
+  local kern_try=$(( (1 << 9) | (15 << 4) | 15 ))
+  local kern_ok=$(( (1 << 9) | (1 << 8) | 9 ))
+  local rootfs=$(( 3 << 9 ))
+  mkdir -p "$dir"
+
+  # Flags byte, then the layout with a zero CRC for the driver to fill in
+  { printf "\\x01CrOSPart"; le32 0 280 64 8191
+    le32 64 127 ${kern_try} 0
+    le32 128 191 ${kern_ok} 0
+    le32 192 8191 ${rootfs} 0
+    head -c $((13 * 16)) /dev/zero
+  } > "${dir}/kernels"
+  { printf "\\x01CrOSPart"; le32 0 280 64 8191
+    head -c $((16 * 16)) /dev/zero
+  } > "${dir}/empty"
+}
+
+function gen_bmpblock_corpus {
+  local dir="${CORPUS_DIR}/bmpblock"
+  mkdir -p "$dir"
+  cat > "${dir}/font.yaml" <<EOF
+bmpblock: 2.0
+images:
+  text: ${SCRIPT_DIR}/bitmaps/Word.bmp
+  \$HWID: ${SCRIPT_DIR}/bitmaps/FontFile.bin
+screens:
+  scr_1:
+    - [45, 45, text]
+    - [45, 400, \$HWID]
+  scr_2:
+    - [45, 400, \$HWID]
+localizations:
+  - [scr_1, scr_2]
+  - [scr_2, scr_1]
+EOF
+  ${UTIL_DIR}/bmpblk_utility -z 0 -c "${dir}/font.yaml" "${dir}/font.bin" \
+    > /dev/null
+  rm -f "${dir}/font.yaml"
+}
+
+rm -rf "${CORPUS_DIR}"
+gen_vblock_corpus fw fw
+gen_vblock_corpus kernel kern
+gen_gpt_corpus
+gen_mtd_corpus
+gen_bmpblock_corpus
+
+# Key blocks and images made by gen_fuzz_test_cases.sh, if it's been run
+if [ -d "${BUILD_DIR}/fuzz_testcases" ]; then
+  cp "${BUILD_DIR}"/fuzz_testcases/*.keyblock "${CORPUS_DIR}/keyblock/"
+  cp "${BUILD_DIR}/fuzz_testcases/firmware.vblock" \
+    "${CORPUS_DIR}/fw_preamble/"
+  cp "${BUILD_DIR}/fuzz_testcases/kernel.vblock.image" \
+    "${CORPUS_DIR}/kernel_preamble/"
+fi
+
+errs=0
+for t in keyblock fw_preamble kernel_preamble gpt mtd bmpblock; do
+  key=
+  if [ "$t" = "keyblock" ]; then
+    key="--key ${PREAMBLE_DIR}/data/root_4.vbpubk"
+  fi
+  if ! ${FUZZ_DRIVER} $t $key --runs ${RUNS} \
+      --crash "${CORPUS_DIR}/crash-$t" "${CORPUS_DIR}/$t"; then
+    echo -e "${COL_RED}fuzz target $t failed;" \
+      "input is in ${CORPUS_DIR}/crash-$t${COL_STOP}" 1>&2
+    errs=$((errs + 1))
+  fi
+done
+
+if [ "$errs" -ne 0 ]; then
+  error "$errs fuzz targets failed"
+fi
+happy "All fuzz targets survived ${RUNS} runs"
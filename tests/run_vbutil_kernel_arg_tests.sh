@@ -190,6 +190,20 @@ else
   echo -e "${COL_GREEN}PASSED${COL_STOP}"
 fi
 
+# A kernel partition inside a disk image has to be found by scanning.
+diskfile="${TMPDIR}/disk.bin"
+dd if=/dev/zero bs=512 count=64 of="${diskfile}" 2>/dev/null
+cat "${USB_KERN}" >> "${diskfile}"
+inimage=$("${UTIL_DIR}/dump_kernel_config" "${diskfile}")
+echo -n "check disk image kernel config ..."
+: $(( tests++ ))
+if [ "$orig" != "$inimage" ]; then
+  echo -e "${COL_RED}FAILED${COL_STOP}"
+  : $(( errs++ ))
+else
+  echo -e "${COL_GREEN}PASSED${COL_STOP}"
+fi
+
 # Summary
 ME=$(basename "$0")
 if [ "$errs" -ne 0 ]; then
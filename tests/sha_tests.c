@@ -5,6 +5,7 @@
 
 /* FIPS 180-2 Tests for message digest functions. */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -79,20 +80,117 @@ int SHA512_tests(void) {
   return success;
 }
 
+/* Compare DigestBatch() against DigestBuf() on a mix of algorithms and
+ * lengths around the block and padding boundaries. */
+#define NUM_BATCH_ITEMS 61
+int DigestBatch_tests(void) {
+  DigestBatchItem items[NUM_BATCH_ITEMS];
+  uint8_t data[600];
+  uint8_t* digest;
+  int i, success = 1;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)(i * 7 + 3);
+
+  for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+    items[i].data = data + i;
+    items[i].len = (i * 37) % (sizeof(data) - NUM_BATCH_ITEMS);
+    if (i % 5 == 0)
+      items[i].len = 55 + (i % 3);  /* SHA-256 padding boundary */
+    if (i % 7 == 0)
+      items[i].len = 111 + (i % 3);  /* SHA-512 padding boundary */
+    items[i].sig_algorithm = i % kNumAlgorithms;
+  }
+  DigestBatch(items, NUM_BATCH_ITEMS);
+
+  for (i = 0; i < NUM_BATCH_ITEMS; i++) {
+    digest = DigestBuf(items[i].data, items[i].len, items[i].sig_algorithm);
+    if (memcmp(digest, items[i].digest,
+               hash_size_map[items[i].sig_algorithm])) {
+      fprintf(stderr, "DigestBatch item %d FAILED\n", i);
+      success = 0;
+    }
+    free(digest);
+  }
+  if (success)
+    fprintf(stderr, "DigestBatch PASSED\n");
+  return success;
+}
+
+/* Hash the long message with SHA-256 and SHA-512 from several threads at
+ * once, before anything has picked the implementation, so they all race to
+ * make the automatic choice. */
+#define NUM_THREADS 8
+static void* FirstUseThread(void* arg) {
+  uint8_t sha256_digest[SHA256_DIGEST_SIZE];
+  uint8_t sha512_digest[SHA512_DIGEST_SIZE];
+  int* ok = (int*)arg;
+
+  internal_SHA256((uint8_t*)long_msg, strlen(long_msg), sha256_digest);
+  internal_SHA512((uint8_t*)long_msg, strlen(long_msg), sha512_digest);
+  *ok = (!memcmp(sha256_digest, sha256_results[2], SHA256_DIGEST_SIZE) &&
+         !memcmp(sha512_digest, sha512_results[2], SHA512_DIGEST_SIZE));
+  return NULL;
+}
+
+int FirstUse_tests(void) {
+  pthread_t threads[NUM_THREADS];
+  int started[NUM_THREADS];
+  int ok[NUM_THREADS];
+  int i, success = 1;
+
+  for (i = 0; i < NUM_THREADS; i++) {
+    ok[i] = 0;
+    started[i] = !pthread_create(threads + i, NULL, FirstUseThread, ok + i);
+    if (!started[i])
+      FirstUseThread(ok + i);
+  }
+  for (i = 0; i < NUM_THREADS; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+  }
+  for (i = 0; i < NUM_THREADS; i++) {
+    if (!ok[i]) {
+      fprintf(stderr, "First use thread %d FAILED\n", i);
+      success = 0;
+    }
+  }
+  if (success)
+    fprintf(stderr, "First use from %d threads PASSED\n", NUM_THREADS);
+  return success;
+}
+
 int main(int argc, char* argv[]) {
-  int success = 1;
+  int i, success = 1;
   /* Initialize long_msg with 'a' x 1,000,000 */
   long_msg = (char *) malloc(1000001);
   memset(long_msg, 'a', 1000000);
   long_msg[1000000]=0;
 
-  if (!SHA1_tests())
+  if (!FirstUse_tests())
     success = 0;
-  if (!SHA256_tests())
-    success = 0;
-  if (!SHA512_tests())
+
+  if (!SHA1_tests())
     success = 0;
 
+  /* Run the SHA-256 and SHA-512 vectors on every implementation this CPU
+   * supports. */
+  for (i = 0; i < ShaImplCount(); i++) {
+    if (ShaImplSelect(i)) {
+      fprintf(stderr, "Skipping unsupported SHA implementation %s\n",
+              ShaImplName(i));
+      continue;
+    }
+    fprintf(stderr, "Testing SHA implementation %s\n", ShaImplName(i));
+    if (!SHA256_tests())
+      success = 0;
+    if (!SHA512_tests())
+      success = 0;
+    if (!DigestBatch_tests())
+      success = 0;
+  }
+  ShaImplSelect(-1);
+
   free(long_msg);
 
   return !success;
@@ -6,19 +6,22 @@
 #include "timer_utils.h"
 
 void StartTimer(ClockTimerState* ct) {
-  clock_gettime(CLOCK_REALTIME, &ct->start_time);
+  clock_gettime(CLOCK_MONOTONIC, &ct->start_time);
 }
 
 void StopTimer(ClockTimerState* ct) {
-  clock_gettime(CLOCK_REALTIME, &ct->end_time);
+  clock_gettime(CLOCK_MONOTONIC, &ct->end_time);
 }
 
-uint32_t GetDurationMsecs(ClockTimerState* ct) {
+uint64_t GetDurationNsecs(ClockTimerState* ct) {
   uint64_t start = ((uint64_t) ct->start_time.tv_sec * 1000000000 +
                     (uint64_t) ct->start_time.tv_nsec);
   uint64_t end = ((uint64_t) ct->end_time.tv_sec * 1000000000 +
                   (uint64_t) ct->end_time.tv_nsec);
-  uint64_t duration_msecs = (end - start) / 1000000U;  /* Nanoseconds ->
-                                                        * Milliseconds. */
-  return (uint32_t) duration_msecs;
+  return end - start;
+}
+
+uint32_t GetDurationMsecs(ClockTimerState* ct) {
+  return (uint32_t) (GetDurationNsecs(ct) / 1000000U);  /* Nanoseconds ->
+                                                         * Milliseconds. */
 }
@@ -13,6 +13,9 @@
 #include <tss/tcs.h>
 /* Don't use the vboot constants, since they conflict with the TCS lib */
 #define VBOOT_REFERENCE_TSS_CONSTANTS_H_
+/* vboot-local error codes, which the TCS lib doesn't have */
+#define TPM_E_COMMAND_PENDING ((uint32_t)0x0000500b)
+#define TPM_E_COMMAND_TIMEOUT ((uint32_t)0x0000500c)
 
 #include "host_common.h"
 #include "test_common.h"
@@ -40,6 +43,16 @@ struct srcall
 static struct srcall calls[MAXCALLS];
 static int ncalls;
 
+/* Mock data for split-phase transactions */
+static int mock_async;
+static int mock_pending;
+static uint8_t mock_async_response[TPM_LARGE_ENOUGH_COMMAND_SIZE];
+static uint32_t mock_async_response_length;
+static uint32_t mock_timeout_ms;
+
+/* mock_pending value for a TPM which never answers */
+#define MOCK_NO_ANSWER -1
+
 /**
  * Reset mock data (for use before each test)
  */
@@ -54,6 +67,10 @@ static void ResetMocks(void)
 	for (i = 0; i < MAXCALLS; i++)
 		calls[i].rsp = calls[i].rsp_buf;
 	ncalls = 0;
+
+	mock_async = 0;
+	mock_pending = 0;
+	mock_timeout_ms = 0;
 }
 
 /**
@@ -102,6 +119,38 @@ VbError_t VbExTpmSendReceive(const uint8_t *request, uint32_t request_length,
 	return c->retval;
 }
 
+/*
+ * Mocked split-phase transactions.  Unless mock_async is set, these report
+ * they aren't supported, so requests go through VbExTpmSendReceive().
+ * Otherwise the request is logged to calls[] and the response is held back
+ * for mock_pending polls.
+ */
+VbError_t VbExTpmSendRequest(const uint8_t *request, uint32_t request_length)
+{
+	if (!mock_async)
+		return VBERROR_NO_ASYNC_TPM;
+
+	mock_async_response_length = sizeof(mock_async_response);
+	return VbExTpmSendReceive(request, request_length, mock_async_response,
+				  &mock_async_response_length);
+}
+
+VbError_t VbExTpmGetResponse(uint8_t *response, uint32_t *response_length,
+			     uint32_t timeout_ms)
+{
+	mock_timeout_ms = timeout_ms;
+	if (mock_pending == MOCK_NO_ANSWER)
+		return VBERROR_TPM_RESPONSE_PENDING;
+	/* A blocking call waits out the pending polls */
+	if (mock_pending && !timeout_ms) {
+		mock_pending--;
+		return VBERROR_TPM_RESPONSE_PENDING;
+	}
+	memcpy(response, mock_async_response, mock_async_response_length);
+	*response_length = mock_async_response_length;
+	return VBERROR_SUCCESS;
+}
+
 /**
  * Test assorted tlcl functions
  */
@@ -339,6 +388,69 @@ static void RandomTest(void)
 	TEST_EQ(size, 0, "  size 0");
 }
 
+/**
+ * Test split-phase commands
+ */
+static void SplitPhaseTest(void)
+{
+	TlclCommand cmd;
+	uint8_t buf[4];
+
+	/* Without async support, the command runs when submitted */
+	ResetMocks();
+	TEST_EQ(TlclContinueSelfTestStart(&cmd), 0, "ContinueSelfTestStart");
+	TEST_EQ(ncalls, 1, "  sent");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_ContinueSelfTest, "  cmd");
+	TEST_EQ(TlclCommandPoll(&cmd), 0, "  poll");
+
+	ResetMocks();
+	SetResponse(0, TPM_E_IOERROR, 10);
+	TEST_EQ(TlclReadStart(&cmd, 1, 3), 0, "ReadStart sync");
+	TEST_EQ(calls[0].req_cmd, TPM_ORD_NV_ReadValue, "  cmd");
+	TEST_EQ(TlclReadFinish(&cmd, buf, 3), TPM_E_IOERROR, "  error");
+
+	/* With async support, poll until the response shows up */
+	ResetMocks();
+	mock_async = 1;
+	mock_pending = 2;
+	SetResponse(0, TPM_SUCCESS, 17);
+	ToTpmUint32(calls[0].rsp_buf + 10, 3);
+	memcpy(calls[0].rsp_buf + 14, "abc", 3);
+	TEST_EQ(TlclReadStart(&cmd, 1, 3), 0, "ReadStart async");
+	TEST_EQ(TlclCommandPoll(&cmd), TPM_E_COMMAND_PENDING, "  pending 1");
+	TEST_EQ(TlclCommandPoll(&cmd), TPM_E_COMMAND_PENDING, "  pending 2");
+	TEST_EQ(TlclReadFinish(&cmd, buf, 3), 0, "  finish");
+	TEST_EQ(memcmp(buf, "abc", 3), 0, "  data");
+	TEST_EQ(TlclCommandPoll(&cmd), 0, "  poll after finish");
+
+	/* Polling doesn't block, waiting blocks in the driver */
+	ResetMocks();
+	mock_async = 1;
+	mock_pending = 5;
+	TEST_EQ(TlclContinueSelfTestStart(&cmd), 0, "Wait start");
+	TEST_EQ(TlclCommandPoll(&cmd), TPM_E_COMMAND_PENDING, "  poll");
+	TEST_EQ(mock_timeout_ms, 0, "  poll timeout");
+	TEST_EQ(TlclCommandWait(&cmd), 0, "  wait");
+	TEST_EQ(mock_timeout_ms, TLCL_COMMAND_TIMEOUT_MS, "  wait timeout");
+
+	/* ...and gives up if the TPM never answers */
+	ResetMocks();
+	mock_async = 1;
+	mock_pending = MOCK_NO_ANSWER;
+	TEST_EQ(TlclContinueSelfTestStart(&cmd), 0, "Wait timeout start");
+	TEST_EQ(TlclCommandWait(&cmd), TPM_E_COMMAND_TIMEOUT, "  timeout");
+	TEST_EQ(mock_timeout_ms, TLCL_COMMAND_TIMEOUT_MS, "  wait timeout");
+	TEST_EQ(TlclCommandPoll(&cmd), TPM_E_COMMAND_TIMEOUT, "  poll");
+
+	/* Send failures are reported right away */
+	ResetMocks();
+	mock_async = 1;
+	calls[0].retval = VBERROR_SIMULATED;
+	TEST_EQ(TlclContinueSelfTestStart(&cmd), VBERROR_SIMULATED,
+		"ContinueSelfTestStart fail");
+	TEST_EQ(TlclCommandPoll(&cmd), VBERROR_SIMULATED, "  poll");
+}
+
 int main(void)
 {
 	TlclTest();
@@ -347,6 +459,7 @@ int main(void)
 	PcrTest();
 	FlagsTest();
 	RandomTest();
+	SplitPhaseTest();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,383 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for TPM NVRAM transactions
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _STUB_IMPLEMENTATION_  /* So we can use memset() ourselves */
+
+#include "test_common.h"
+#include "tlcl.h"
+#include "utility.h"
+
+/* Accumulated list of calls to mocked Tlcl functions */
+static char mock_calls[4096];
+static char *mock_cnext = mock_calls;
+
+/* Fail the Nth mocked call (1-based) with this error, if non-zero */
+static int fail_at_count;
+static uint32_t fail_with_error;
+static int mock_count;
+
+/* Backing store for the mocked spaces, indexed by space index */
+#define MOCK_SPACES 8
+#define MOCK_SPACE_SIZE 32
+static uint8_t mock_nv[MOCK_SPACES][MOCK_SPACE_SIZE];
+
+static void ResetMocks(int fail_on_call, uint32_t fail_with_err)
+{
+	*mock_calls = 0;
+	mock_cnext = mock_calls;
+	mock_count = 0;
+	fail_at_count = fail_on_call;
+	fail_with_error = fail_with_err;
+	memset(mock_nv, 0, sizeof(mock_nv));
+}
+
+static uint32_t MockResult(void)
+{
+	return (++mock_count == fail_at_count) ? fail_with_error : TPM_SUCCESS;
+}
+
+/* Mocks */
+
+uint32_t TlclRead(uint32_t index, void *data, uint32_t length)
+{
+	mock_cnext += sprintf(mock_cnext, "TlclRead(%d, %d)\n",
+			      index, length);
+	memcpy(data, mock_nv[index], length);
+	return MockResult();
+}
+
+uint32_t TlclWrite(uint32_t index, const void *data, uint32_t length)
+{
+	uint32_t result;
+
+	mock_cnext += sprintf(mock_cnext, "TlclWrite(%d, %d)\n",
+			      index, length);
+	result = MockResult();
+	if (result == TPM_SUCCESS)
+		memcpy(mock_nv[index], data, length);
+	return result;
+}
+
+uint32_t TlclReadLock(uint32_t index)
+{
+	mock_cnext += sprintf(mock_cnext, "TlclReadLock(%d)\n", index);
+	return MockResult();
+}
+
+uint32_t TlclWriteLock(uint32_t index)
+{
+	mock_cnext += sprintf(mock_cnext, "TlclWriteLock(%d)\n", index);
+	return MockResult();
+}
+
+uint32_t TlclSetGlobalLock(void)
+{
+	mock_cnext += sprintf(mock_cnext, "TlclSetGlobalLock()\n");
+	return MockResult();
+}
+
+/* Tests */
+
+static void ReadTest(void)
+{
+	TlclTransaction txn;
+	uint8_t buf[MOCK_SPACE_SIZE], buf2[MOCK_SPACE_SIZE];
+
+	/* Reads of the same space are only sent once */
+	ResetMocks(0, 0);
+	memcpy(mock_nv[1], "hello", 5);
+	TlclTransactionInit(&txn);
+	TEST_EQ(TlclTransactionRead(&txn, 1, buf, 5), 0, "Read queued");
+	TEST_EQ(TlclTransactionRead(&txn, 1, buf2, 3), 0, "Read 2 queued");
+	TEST_STR_EQ(mock_calls, "", "Nothing sent before commit");
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Commit reads");
+	TEST_EQ(memcmp(buf, "hello", 5), 0, "  data");
+	TEST_EQ(memcmp(buf2, "hel", 3), 0, "  data 2");
+	TEST_STR_EQ(mock_calls, "TlclRead(1, 5)\n", "  tlcl calls");
+	TEST_EQ(txn.commands_sent, 1, "  sent");
+	TEST_EQ(txn.commands_saved, 1, "  saved");
+
+	/* Remembered across commits, but not longer reads */
+	TlclTransactionRead(&txn, 1, buf, 5);
+	TlclTransactionRead(&txn, 1, buf, 6);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Commit reads again");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 5)\n"
+		    "TlclRead(1, 6)\n",
+		    "  tlcl calls");
+	TEST_EQ(txn.commands_saved, 2, "  saved");
+
+	/* Forget makes the next read go to the TPM */
+	TlclTransactionForget(&txn, 1);
+	TlclTransactionRead(&txn, 1, buf, 5);
+	TlclTransactionCommit(&txn);
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 5)\n"
+		    "TlclRead(1, 6)\n"
+		    "TlclRead(1, 5)\n",
+		    "Forget");
+
+	/* Errors stop the commit and forget everything */
+	ResetMocks(2, TPM_E_IOERROR);
+	TlclTransactionInit(&txn);
+	TlclTransactionRead(&txn, 1, buf, 5);
+	TlclTransactionRead(&txn, 2, buf, 5);
+	TlclTransactionRead(&txn, 3, buf, 5);
+	TEST_EQ(TlclTransactionCommit(&txn), TPM_E_IOERROR, "Commit error");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 5)\n"
+		    "TlclRead(2, 5)\n",
+		    "  tlcl calls");
+	TlclTransactionRead(&txn, 1, buf, 5);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Commit after error");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 5)\n"
+		    "TlclRead(2, 5)\n"
+		    "TlclRead(1, 5)\n",
+		    "  tlcl calls");
+}
+
+static void WriteTest(void)
+{
+	TlclTransaction txn;
+	uint8_t buf[MOCK_SPACE_SIZE];
+
+	/* Read after write comes from memory */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 1, "abcd", 4);
+	TlclTransactionRead(&txn, 1, buf, 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Write then read");
+	TEST_EQ(memcmp(buf, "abcd", 4), 0, "  data");
+	TEST_EQ(memcmp(mock_nv[1], "abcd", 4), 0, "  written");
+	TEST_STR_EQ(mock_calls, "TlclWrite(1, 4)\n", "  tlcl calls");
+
+	/* Writing the same thing again is skipped */
+	TlclTransactionWrite(&txn, 1, "abcd", 4);
+	TlclTransactionWrite(&txn, 1, "ab", 2);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Unchanged write");
+	TEST_STR_EQ(mock_calls, "TlclWrite(1, 4)\n", "  tlcl calls");
+	TEST_EQ(txn.commands_saved, 3, "  saved");
+
+	/* So is a write which is overwritten later in the same commit */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 1, "1111", 4);
+	TlclTransactionWrite(&txn, 2, "2222", 4);
+	TlclTransactionWrite(&txn, 1, "333333", 6);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Overwritten write");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(2, 4)\n"
+		    "TlclWrite(1, 6)\n",
+		    "  tlcl calls");
+	TEST_EQ(memcmp(mock_nv[1], "333333", 6), 0, "  written");
+
+	/* ...but not if it's only partly overwritten, or read in between */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 1, "1111", 4);
+	TlclTransactionWrite(&txn, 1, "22", 2);
+	TlclTransactionWrite(&txn, 2, "1111", 4);
+	TlclTransactionRead(&txn, 2, buf, 4);
+	TlclTransactionWrite(&txn, 2, "3333", 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Needed writes");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(1, 4)\n"
+		    "TlclWrite(1, 2)\n"
+		    "TlclWrite(2, 4)\n"
+		    "TlclWrite(2, 4)\n",
+		    "  tlcl calls");
+	TEST_EQ(memcmp(buf, "1111", 4), 0, "  read between");
+	TEST_EQ(memcmp(mock_nv[1], "2211", 4), 0, "  written 1");
+
+	/* ...or locked in between */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 1, "1111", 4);
+	TlclTransactionWriteLock(&txn, 1);
+	TlclTransactionWrite(&txn, 1, "2222", 4);
+	TlclTransactionCommit(&txn);
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(1, 4)\n"
+		    "TlclWriteLock(1)\n"
+		    "TlclWrite(1, 4)\n",
+		    "Write lock between writes");
+
+	/* After a failed write, the space contents are no longer known */
+	ResetMocks(2, TPM_E_MAXNVWRITES);
+	TlclTransactionInit(&txn);
+	TlclTransactionRead(&txn, 1, buf, 4);
+	TlclTransactionWrite(&txn, 1, "1111", 4);
+	TEST_EQ(TlclTransactionCommit(&txn), TPM_E_MAXNVWRITES,
+		"Write error");
+	TlclTransactionWrite(&txn, 1, "\0\0\0\0", 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Write after error");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 4)\n"
+		    "TlclWrite(1, 4)\n"
+		    "TlclWrite(1, 4)\n",
+		    "  tlcl calls");
+
+	/* Writes too big to remember go straight out */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionRead(&txn, 1, buf, 4);
+	TEST_EQ(TlclTransactionWrite(&txn, 1, "0123456789abcdefghij", 20), 0,
+		"Big write");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(1, 4)\n"
+		    "TlclWrite(1, 20)\n",
+		    "  tlcl calls");
+	TlclTransactionRead(&txn, 1, buf, 4);
+	TlclTransactionCommit(&txn);
+	TEST_EQ(memcmp(buf, "0123", 4), 0, "  read back from TPM");
+}
+
+static void LockTest(void)
+{
+	TlclTransaction txn;
+	uint8_t buf[MOCK_SPACE_SIZE];
+
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWriteLock(&txn, 1);
+	TlclTransactionReadLock(&txn, 1);
+	TlclTransactionWriteLock(&txn, 2);
+	TlclTransactionWriteLock(&txn, 1);
+	TlclTransactionReadLock(&txn, 1);
+	TlclTransactionSetGlobalLock(&txn);
+	TlclTransactionSetGlobalLock(&txn);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Locks");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWriteLock(1)\n"
+		    "TlclReadLock(1)\n"
+		    "TlclWriteLock(2)\n"
+		    "TlclSetGlobalLock()\n",
+		    "  tlcl calls");
+	TEST_EQ(txn.commands_sent, 4, "  sent");
+	TEST_EQ(txn.commands_saved, 3, "  saved");
+
+	/* Locked spaces aren't answered from memory, so the TPM can refuse */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 1, "abcd", 4);
+	TlclTransactionReadLock(&txn, 1);
+	TlclTransactionRead(&txn, 1, buf, 4);
+	TlclTransactionWriteLock(&txn, 1);
+	TlclTransactionWrite(&txn, 1, "abcd", 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Locked space");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(1, 4)\n"
+		    "TlclReadLock(1)\n"
+		    "TlclRead(1, 4)\n"
+		    "TlclWriteLock(1)\n"
+		    "TlclWrite(1, 4)\n",
+		    "  tlcl calls");
+
+	/* ...and after a global lock, writes go to the TPM too */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionWrite(&txn, 2, "abcd", 4);
+	TlclTransactionSetGlobalLock(&txn);
+	TlclTransactionWrite(&txn, 2, "abcd", 4);
+	TlclTransactionWrite(&txn, 2, "efgh", 4);
+	TlclTransactionRead(&txn, 2, buf, 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Global lock");
+	TEST_STR_EQ(mock_calls,
+		    "TlclWrite(2, 4)\n"
+		    "TlclSetGlobalLock()\n"
+		    "TlclWrite(2, 4)\n"
+		    "TlclWrite(2, 4)\n",
+		    "  tlcl calls");
+	TEST_EQ(memcmp(buf, "efgh", 4), 0, "  read from memory");
+
+	/* A failed lock is tried again */
+	ResetMocks(1, TPM_E_IOERROR);
+	TlclTransactionInit(&txn);
+	TlclTransactionSetGlobalLock(&txn);
+	TEST_EQ(TlclTransactionCommit(&txn), TPM_E_IOERROR, "Lock error");
+	TlclTransactionSetGlobalLock(&txn);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "Lock retry");
+	TEST_STR_EQ(mock_calls,
+		    "TlclSetGlobalLock()\n"
+		    "TlclSetGlobalLock()\n",
+		    "  tlcl calls");
+}
+
+static void QueueFullTest(void)
+{
+	TlclTransaction txn;
+	uint8_t buf[4];
+	int i;
+
+	/* A full queue is committed before adding more */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	for (i = 0; i < TLCL_TXN_MAX_OPS; i++)
+		TlclTransactionRead(&txn, i % 2, buf, 4);
+	TEST_STR_EQ(mock_calls, "", "Queue full");
+	TEST_EQ(TlclTransactionWriteLock(&txn, 1), 0, "Queue overflow");
+	TEST_EQ(txn.commands_sent, 2, "  sent");
+	TEST_EQ(txn.commands_saved, TLCL_TXN_MAX_OPS - 2, "  saved");
+	TEST_EQ(txn.num_ops, 1, "  queued");
+
+	ResetMocks(1, TPM_E_IOERROR);
+	TlclTransactionInit(&txn);
+	for (i = 0; i < TLCL_TXN_MAX_OPS; i++)
+		TlclTransactionRead(&txn, 1, buf, 4);
+	TEST_EQ(TlclTransactionWriteLock(&txn, 1), TPM_E_IOERROR,
+		"Queue overflow error");
+	TEST_EQ(txn.num_ops, 0, "  not queued");
+
+	/* Spaces beyond the ones remembered push out the oldest */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	for (i = 0; i <= TLCL_TXN_MAX_SPACES; i++)
+		TlclTransactionRead(&txn, i, buf, 4);
+	TlclTransactionRead(&txn, 0, buf, 4);
+	TlclTransactionCommit(&txn);
+	TEST_EQ(txn.commands_sent, TLCL_TXN_MAX_SPACES + 2, "Evict oldest");
+
+	/* ...but not locked ones, or the lock would be forgotten */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	TlclTransactionReadLock(&txn, 0);
+	for (i = 1; i <= TLCL_TXN_MAX_SPACES; i++)
+		TlclTransactionRead(&txn, i, buf, 4);
+	TlclTransactionReadLock(&txn, 0);
+	TlclTransactionCommit(&txn);
+	TEST_EQ(txn.commands_sent, TLCL_TXN_MAX_SPACES + 1, "Keep locked");
+	TEST_EQ(txn.spaces[0].index, 0, "  locked space kept");
+	TEST_EQ(txn.spaces[0].read_locked, 1, "  lock kept");
+
+	/* If every space is locked, locks are still sent and reads still work */
+	ResetMocks(0, 0);
+	TlclTransactionInit(&txn);
+	for (i = 0; i < TLCL_TXN_MAX_SPACES; i++)
+		TlclTransactionWriteLock(&txn, i);
+	TlclTransactionCommit(&txn);
+	TlclTransactionWriteLock(&txn, TLCL_TXN_MAX_SPACES);
+	TlclTransactionRead(&txn, TLCL_TXN_MAX_SPACES, buf, 4);
+	TEST_EQ(TlclTransactionCommit(&txn), 0, "All locked");
+	TEST_EQ(txn.commands_sent, TLCL_TXN_MAX_SPACES + 2, "  sent");
+	TEST_EQ(txn.num_spaces, TLCL_TXN_MAX_SPACES, "  spaces");
+}
+
+int main(void)
+{
+	ReadTest();
+	WriteTest();
+	LockTest();
+	QueueFullTest();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,277 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the profiler and response cache in the userspace TPM stub.  The
+ * TPM is faked with a pseudo-terminal: responses are queued on the master
+ * side before each command, and requests read back from it afterwards.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "test_common.h"
+#include "tlcl_internal.h"
+#include "tpm_lite_stub.h"
+#include "tss_constants.h"
+#include "vboot_api.h"
+
+#define ORD_GET_CAPABILITY 0x65
+#define ORD_NV_READ_VALUE 0xcf
+#define ORD_NV_WRITE_VALUE 0xcd
+
+#define MSG_SIZE 14
+
+static int master_fd = -1;
+static int slave_fd = -1;
+
+static int SetupFakeTpm(void)
+{
+	struct termios tio;
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) || unlockpt(master_fd))
+		return -1;
+
+	/* Pass bytes through untouched */
+	slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY);
+	if (slave_fd < 0 || tcgetattr(slave_fd, &tio))
+		return -1;
+	cfmakeraw(&tio);
+	if (tcsetattr(slave_fd, TCSANOW, &tio))
+		return -1;
+
+	setenv("TPM_DEVICE_PATH", ptsname(master_fd), 1);
+	setenv("TPM_NO_EXIT", "1", 1);
+	unsetenv("TPM_CACHE");
+	unsetenv("TPM_PROFILE");
+	return 0;
+}
+
+static void BuildMessage(uint8_t *buf, uint16_t tag, uint32_t code,
+			 uint32_t value)
+{
+	buf[0] = (uint8_t)(tag >> 8);
+	buf[1] = (uint8_t)tag;
+	ToTpmUint32(buf + 2, MSG_SIZE);
+	ToTpmUint32(buf + 6, code);
+	ToTpmUint32(buf + 10, value);
+}
+
+/*
+ * Send a command with the ordinal and argument, faking a TPM response of
+ * [response_code] and [response_value] if the command gets to the TPM.
+ * Returns the value from the response, or -1 if error.  [sent] is set to
+ * whether the command got to the TPM.
+ */
+static int Command(uint32_t ordinal, uint32_t arg, uint32_t response_code,
+		   uint32_t response_value, int *sent)
+{
+	uint8_t request[MSG_SIZE], response[TPM_MAX_COMMAND_SIZE];
+	uint8_t seen[TPM_MAX_COMMAND_SIZE];
+	uint32_t response_length = sizeof(response);
+	uint32_t value;
+	struct pollfd pfd;
+	int n;
+
+	BuildMessage(request, TPM_TAG_RQU_COMMAND, ordinal, arg);
+	BuildMessage(response, TPM_TAG_RSP_COMMAND, response_code,
+		     response_value);
+	if (write(master_fd, response, MSG_SIZE) != MSG_SIZE)
+		return -1;
+
+	if (VbExTpmSendReceive(request, MSG_SIZE, response, &response_length))
+		return -1;
+
+	/* See if the request got to the TPM */
+	pfd.fd = master_fd;
+	pfd.events = POLLIN;
+	*sent = (poll(&pfd, 1, 100) == 1);
+	if (*sent) {
+		n = read(master_fd, seen, sizeof(seen));
+		if (n != MSG_SIZE || memcmp(seen, request, MSG_SIZE))
+			return -1;
+	} else {
+		/* Take back the response nobody read */
+		tcflush(slave_fd, TCIFLUSH);
+	}
+
+	if (response_length != MSG_SIZE)
+		return -1;
+	FromTpmUint32(response + 10, &value);
+	return (int)value;
+}
+
+static const TpmCommandProfile *FindProfile(uint32_t ordinal)
+{
+	int i;
+
+	for (i = 0; i < TpmProfileCount(); i++) {
+		if (TpmProfileGet(i)->ordinal == ordinal)
+			return TpmProfileGet(i);
+	}
+	return NULL;
+}
+
+static void CacheTest(void)
+{
+	int sent;
+
+	TEST_EQ(VbExTpmInit(), 0, "TPM init");
+
+	/* Off by default */
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 11, &sent), 11, "No cache");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 12, &sent), 12,
+		"No cache again");
+	TEST_EQ(sent, 1, "  sent");
+
+	/* Repeated queries come from the cache */
+	TpmCacheEnable(1);
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 13, &sent), 13, "Query");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 14, &sent), 13,
+		"Query again");
+	TEST_EQ(sent, 0, "  cached");
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 5, 0, 15, &sent), 15,
+		"Different query");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_NV_READ_VALUE, 0x1007, 0, 16, &sent), 16,
+		"NV read");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_NV_READ_VALUE, 0x1007, 0, 17, &sent), 16,
+		"NV read again");
+	TEST_EQ(sent, 0, "  cached");
+
+	/* Errors aren't cached */
+	TEST_EQ(Command(ORD_NV_READ_VALUE, 0x1008, TPM_E_BADINDEX, 0, &sent),
+		0, "NV read error");
+	TEST_EQ(Command(ORD_NV_READ_VALUE, 0x1008, 0, 18, &sent), 18,
+		"NV read after error");
+	TEST_EQ(sent, 1, "  sent");
+
+	/* Anything else empties the cache */
+	TEST_EQ(Command(ORD_NV_WRITE_VALUE, 0x1007, 0, 0, &sent), 0,
+		"NV write");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_NV_READ_VALUE, 0x1007, 0, 19, &sent), 19,
+		"NV read after write");
+	TEST_EQ(sent, 1, "  sent");
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 20, &sent), 20,
+		"Query after write");
+	TEST_EQ(sent, 1, "  sent");
+
+	/* Disabling the cache empties it */
+	TpmCacheEnable(0);
+	TpmCacheEnable(1);
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 21, &sent), 21,
+		"Query after disable");
+	TEST_EQ(sent, 1, "  sent");
+	TpmCacheEnable(0);
+
+	/* Environment variable */
+	setenv("TPM_CACHE", "1", 1);
+	VbExTpmInit();
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 22, &sent), 22,
+		"TPM_CACHE query");
+	TEST_EQ(Command(ORD_GET_CAPABILITY, 4, 0, 23, &sent), 22,
+		"TPM_CACHE query again");
+	TEST_EQ(sent, 0, "  cached");
+	unsetenv("TPM_CACHE");
+	TpmCacheEnable(0);
+}
+
+static void ProfileTest(void)
+{
+	const char *json_start = "{\"commands\": [\n  {\"ordinal\": 205, ";
+	const char *text_start = "TPM command profile (2 commands):\n"
+		"  0x000000cd: 1 sent, 0 failed, 0 cached, min ";
+	const TpmCommandProfile *p;
+	uint8_t request[MSG_SIZE], response[TPM_MAX_COMMAND_SIZE];
+	uint32_t response_length = sizeof(response);
+	uint32_t total = 0;
+	char buf[4096];
+	FILE *f;
+	int sent, i, n;
+
+	/* Counts from CacheTest() */
+	p = FindProfile(ORD_GET_CAPABILITY);
+	TEST_PTR_NEQ(p, NULL, "GetCapability profiled");
+	TEST_EQ(p->count, 7, "  count");
+	TEST_EQ(p->cached, 2, "  cached");
+	TEST_EQ(p->errors, 0, "  errors");
+	for (i = 0; i < TPM_PROFILE_BUCKETS; i++)
+		total += p->histogram[i];
+	TEST_EQ(total, p->count, "  histogram");
+	TEST_TRUE(p->min_us <= p->max_us, "  min <= max");
+	TEST_TRUE(p->total_us >= p->max_us, "  total >= max");
+	p = FindProfile(ORD_NV_READ_VALUE);
+	TEST_PTR_NEQ(p, NULL, "NV read profiled");
+	TEST_EQ(p->count, 4, "  count");
+	TEST_EQ(p->cached, 1, "  cached");
+	TEST_EQ(TpmProfileCount(), 3, "Profile count");
+	TEST_PTR_EQ(TpmProfileGet(3), NULL, "Profile out of range");
+
+	/* Split-phase commands are profiled too */
+	TpmProfileReset();
+	TEST_EQ(TpmProfileCount(), 0, "Profile reset");
+	BuildMessage(request, TPM_TAG_RQU_COMMAND, ORD_NV_WRITE_VALUE, 0);
+	BuildMessage(response, TPM_TAG_RSP_COMMAND, 0, 0);
+	TEST_EQ(VbExTpmSendRequest(request, MSG_SIZE), 0, "Split request");
+	TEST_EQ(read(master_fd, buf, sizeof(buf)), MSG_SIZE, "  request seen");
+	TEST_EQ(VbExTpmGetResponse(response, &response_length, 0),
+		VBERROR_TPM_RESPONSE_PENDING, "  pending");
+	TEST_EQ(VbExTpmGetResponse(response, &response_length, 10),
+		VBERROR_TPM_RESPONSE_PENDING, "  wait times out");
+	TEST_EQ(write(master_fd, response, MSG_SIZE), MSG_SIZE, "  respond");
+	TEST_EQ(VbExTpmGetResponse(response, &response_length, 1000), 0,
+		"Split response");
+	p = FindProfile(ORD_NV_WRITE_VALUE);
+	TEST_PTR_NEQ(p, NULL, "Split command profiled");
+	TEST_EQ(p->count, 1, "  count");
+
+	/* Output formats */
+	Command(ORD_GET_CAPABILITY, 4, 0, 0, &sent);
+	f = tmpfile();
+	TpmProfilePrint(f, 1);
+	rewind(f);
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	buf[n] = 0;
+	fclose(f);
+	TEST_EQ(strncmp(buf, json_start, strlen(json_start)), 0,
+		"JSON profile");
+	TEST_PTR_NEQ(strstr(buf, "},\n  {\"ordinal\": 101, \"count\": 1, "),
+		     NULL, "  second command");
+	TEST_EQ(strcmp(buf + n - 4, "\n]}\n"), 0, "  end");
+
+	f = tmpfile();
+	TpmProfilePrint(f, 0);
+	rewind(f);
+	n = fread(buf, 1, sizeof(buf) - 1, f);
+	buf[n] = 0;
+	fclose(f);
+	TEST_EQ(strncmp(buf, text_start, strlen(text_start)), 0,
+		"Text profile");
+	TEST_PTR_NEQ(strstr(buf, "  0x00000065: 1 sent"), NULL,
+		     "  second command");
+}
+
+int main(void)
+{
+	if (SetupFakeTpm()) {
+		fprintf(stderr, "Can't make a fake TPM\n");
+		return 255;
+	}
+
+	CacheTest();
+	ProfileTest();
+	VbExTpmClose();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -140,7 +140,12 @@ static void VbSelectFirmwareTest(void) {
   ResetMocks();
   TestVbSf(0, 0, "Normal call");
   TEST_EQ(shared->timer_vb_select_firmware_enter, 21, "  time enter");
-  TEST_EQ(shared->timer_vb_select_firmware_exit, 43, "  time exit");
+  TEST_EQ(shared->timestamp_count, 2, "  timestamps");
+  TEST_EQ(shared->timestamps[0].event, VBSD_TS_TPM_FIRMWARE_START,
+          "  TPM firmware start");
+  TEST_EQ(shared->timestamps[1].event, VBSD_TS_TPM_FIRMWARE_END,
+          "  TPM firmware end");
+  TEST_EQ(shared->timer_vb_select_firmware_exit, 175, "  time exit");
   TEST_EQ(nv_write_called, 0, "  NV write not called since nothing changed");
   TEST_EQ(mock_stbms_got_flags, 0, "  SetTPMBootModeState() flags");
   TEST_EQ(mock_stbms_got_fw_flags, 0xABCDE0, "  fw keyblock flags");
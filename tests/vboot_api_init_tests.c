@@ -142,7 +142,14 @@ static void VbInitTest(void)
 	ResetMocks();
 	TestVbInit(0, 0, "Normal call");
 	TEST_EQ(shared->timer_vb_init_enter, 21, "  time enter");
-	TEST_EQ(shared->timer_vb_init_exit, 43, "  time exit");
+	TEST_EQ(shared->timestamp_count, 2, "  timestamps");
+	TEST_EQ(shared->timestamps[0].event, VBSD_TS_TPM_SETUP_START,
+		"  TPM setup start");
+	TEST_EQ(shared->timestamps[0].timer, 43, "  TPM setup start time");
+	TEST_EQ(shared->timestamps[1].event, VBSD_TS_TPM_SETUP_END,
+		"  TPM setup end");
+	TEST_EQ(shared->timestamps[1].timer, 87, "  TPM setup end time");
+	TEST_EQ(shared->timer_vb_init_exit, 175, "  time exit");
 	TEST_EQ(shared->flags, 0, "  shared flags");
 	TEST_EQ(iparams.out_flags, 0, "  out flags");
 	TEST_EQ(nv_write_called, 0,
@@ -0,0 +1,633 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmarks for signature verification, from the hash and RSA primitives
+ * up to whole LoadFirmware() and LoadKernel() calls on images built in memory
+ * with the test keys, for every algorithm.
+ *
+ * Each case is run a few times to warm up, then timed run by run.  Results go
+ * to stdout as "name_stat:value" lines, always in the same order, so the
+ * output from two builds can be diffed; a summary of each case goes to stderr,
+ * prefixed with "# ".
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "cryptolib.h"
+#include "gbb_header.h"
+#include "gpt.h"
+#include "host_common.h"
+#include "load_firmware_fw.h"
+#include "load_kernel_fw.h"
+#include "timer_utils.h"
+#include "vboot_api.h"
+#include "vboot_common.h"
+#include "vboot_nvstorage.h"
+#include "vboot_struct.h"
+
+#define DEFAULT_RUNS 100
+#define DEFAULT_WARMUP 3
+/* Stop timing a case after this long, if it has at least MIN_RUNS samples */
+#define DEFAULT_MAX_SECS 5
+#define MIN_RUNS 5
+
+#define KB 1024
+#define MB (1024 * 1024)
+#define MAX_DATA_SIZE (4 * MB)
+
+/* Kernel partition layout, as vbutil_kernel makes it */
+#define SECTOR_SIZE 512
+#define KERNEL_HEADER_SIZE 65536
+#define KERNEL_PART_LBA 64
+
+static const uint64_t hash_sizes[] = {4 * KB, 64 * KB, 1 * MB, 4 * MB};
+static const uint64_t data_sizes[] = {64 * KB, 1 * MB, 4 * MB};
+static const uint64_t firmware_sizes[] = {64 * KB, 1 * MB};
+static const uint64_t kernel_sizes[] = {1 * MB, 4 * MB};
+
+static const char * const hash_names[] = {"sha1", "sha256", "sha512"};
+
+/* Options */
+static int runs = DEFAULT_RUNS;
+static int warmup = DEFAULT_WARMUP;
+static int max_secs = DEFAULT_MAX_SECS;
+static const char *filter;
+static int quiet;
+
+static uint64_t *samples;
+
+/* Data which is hashed and signed; it's the firmware and kernel body too */
+static uint8_t *data;
+
+/*
+ * What the case being run works on.  Each set of cases fills in the fields
+ * it uses before calling Bench().
+ */
+static struct {
+	int algorithm;
+	uint64_t size;
+	RSAPublicKey *rsa_key;
+	VbPublicKey *key;
+	uint8_t *digest;
+	VbSignature *sig;
+	VbKeyBlockHeader *key_block;
+} bench;
+
+/* Firmware and disk images for LoadFirmware() and LoadKernel() */
+static uint8_t shared_data[VB_SHARED_DATA_REC_SIZE];
+static uint8_t *gbb;
+static VbCommonParams cparams;
+static VbSelectFirmwareParams fparams;
+static VbNvContext vnc;
+static uint8_t *disk;
+static uint64_t disk_sectors;
+static LoadKernelParams lkparams;
+
+/* Mocked firmware interfaces, for LoadFirmware() and LoadKernel() */
+
+VbError_t VbExHashFirmwareBody(VbCommonParams *cparams,
+			       uint32_t firmware_index)
+{
+	VbUpdateFirmwareBodyHash(cparams, data, (uint32_t)bench.size);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+		       uint64_t lba_count, void *buffer)
+{
+	if (lba_start > disk_sectors || lba_count > disk_sectors - lba_start)
+		return VBERROR_UNKNOWN;
+	memcpy(buffer, disk + lba_start * SECTOR_SIZE, lba_count * SECTOR_SIZE);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			uint64_t lba_count, const void *buffer)
+{
+	if (lba_start > disk_sectors || lba_count > disk_sectors - lba_start)
+		return VBERROR_UNKNOWN;
+	memcpy(disk + lba_start * SECTOR_SIZE, buffer, lba_count * SECTOR_SIZE);
+	return VBERROR_SUCCESS;
+}
+
+static int CompareSamples(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Run the case [func], which processes [bytes] bytes of data per run (or 0 if
+ * that doesn't mean anything for it) and returns 0 if successful.  Prints
+ * the median and 99th percentile times, and the throughput for the median.
+ *
+ * Returns 0 if successful, non-zero if any run failed.
+ */
+static int Bench(const char *name, uint64_t bytes, int (*func)(void))
+{
+	ClockTimerState ct, total;
+	uint64_t median, p99;
+	int n, i;
+
+	if (filter && !strstr(name, filter))
+		return 0;
+
+	for (i = 0; i < warmup; i++) {
+		if (func()) {
+			fprintf(stderr, "%s failed\n", name);
+			return 1;
+		}
+	}
+
+	StartTimer(&total);
+	for (n = 0; n < runs; n++) {
+		StartTimer(&ct);
+		i = func();
+		StopTimer(&ct);
+		if (i) {
+			fprintf(stderr, "%s failed\n", name);
+			return 1;
+		}
+		samples[n] = GetDurationNsecs(&ct);
+
+		/* Don't let the slow cases go on forever */
+		StopTimer(&total);
+		if (n + 1 >= MIN_RUNS &&
+		    GetDurationNsecs(&total) > max_secs * 1000000000ULL) {
+			n++;
+			break;
+		}
+	}
+
+	qsort(samples, n, sizeof(*samples), CompareSamples);
+	median = (n & 1) ? samples[n / 2] :
+		(samples[n / 2 - 1] + samples[n / 2]) / 2;
+	/* Nearest-rank; with fewer than 100 runs, this is the slowest */
+	p99 = samples[(n * 99 + 99) / 100 - 1];
+
+	printf("%s_median_ns:%llu\n", name, (unsigned long long)median);
+	printf("%s_p99_ns:%llu\n", name, (unsigned long long)p99);
+	if (bytes)
+		printf("%s_mbytes_per_sec:%.02f\n", name,
+		       median ? bytes * 1e9 / median / MB : 0.0);
+
+	if (!quiet)
+		fprintf(stderr, "# %-34s %4d runs  median %10.3f ms  "
+			"p99 %10.3f ms  min %10.3f ms  max %10.3f ms\n",
+			name, n, median / 1e6, p99 / 1e6, samples[0] / 1e6,
+			samples[n - 1] / 1e6);
+	return 0;
+}
+
+/* Format a size as used in case names: 4k, 1m */
+static const char *SizeName(uint64_t size)
+{
+	static char buf[16];
+
+	if (size >= MB)
+		snprintf(buf, sizeof(buf), "%dm", (int)(size / MB));
+	else
+		snprintf(buf, sizeof(buf), "%dk", (int)(size / KB));
+	return buf;
+}
+
+/* Format the key part of case names: rsa2048_sha256 */
+static const char *AlgName(int algorithm)
+{
+	static char buf[32];
+
+	snprintf(buf, sizeof(buf), "rsa%d_%s", siglen_map[algorithm] * 8,
+		 hash_names[algorithm % ARRAY_SIZE(hash_names)]);
+	return buf;
+}
+
+static int RunHash(void)
+{
+	uint8_t digest[SHA512_DIGEST_SIZE];
+
+	DigestBufNoAlloc(data, bench.size, bench.algorithm, digest);
+	return 0;
+}
+
+static int RunRSAVerify(void)
+{
+	return !RSAVerify(bench.rsa_key, GetSignatureDataC(bench.sig),
+			  bench.sig->sig_size, bench.algorithm, bench.digest);
+}
+
+static int RunVerifyData(void)
+{
+	return VerifyData(data, bench.size, bench.sig, bench.rsa_key);
+}
+
+static int RunKeyBlockVerify(void)
+{
+	return KeyBlockVerify(bench.key_block, bench.key_block->key_block_size,
+			      bench.key, 0);
+}
+
+static int RunKeyBlockVerifyHash(void)
+{
+	return KeyBlockVerify(bench.key_block, bench.key_block->key_block_size,
+			      NULL, 1);
+}
+
+static int RunLoadFirmware(void)
+{
+	VbSharedDataInit((VbSharedDataHeader *)shared_data,
+			 sizeof(shared_data));
+	Memset(&vnc, 0, sizeof(vnc));
+	VbNvSetup(&vnc);
+	cparams.shared_data_blob = shared_data;
+	cparams.shared_data_size = sizeof(shared_data);
+	return LoadFirmware(&cparams, &fparams, &vnc);
+}
+
+static int RunLoadKernel(void)
+{
+	static uint8_t *kernel_buffer;
+	VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
+
+	if (!kernel_buffer)
+		kernel_buffer = malloc(MAX_DATA_SIZE);
+
+	VbSharedDataInit(shared, sizeof(shared_data));
+	VbSharedDataSetKernelKey(shared, bench.key);
+	Memset(&vnc, 0, sizeof(vnc));
+	VbNvSetup(&vnc);
+
+	Memset(&lkparams, 0, sizeof(lkparams));
+	lkparams.shared_data_blob = shared_data;
+	lkparams.shared_data_size = sizeof(shared_data);
+	lkparams.gbb_data = gbb;
+	lkparams.gbb_size = cparams.gbb_size;
+	lkparams.bytes_per_lba = SECTOR_SIZE;
+	lkparams.ending_lba = disk_sectors - 1;
+	lkparams.kernel_buffer = kernel_buffer;
+	lkparams.kernel_buffer_size = MAX_DATA_SIZE;
+	lkparams.nv_context = &vnc;
+	return LoadKernel(&lkparams);
+}
+
+/*
+ * Make a GBB holding root key [key]; it's used for LoadFirmware(), and
+ * LoadKernel() needs one too.
+ */
+static void BuildGbb(const VbPublicKey *key)
+{
+	GoogleBinaryBlockHeader *h;
+	uint32_t size = sizeof(*h) + sizeof(*key) + key->key_size;
+
+	free(gbb);
+	gbb = calloc(1, size);
+	h = (GoogleBinaryBlockHeader *)gbb;
+	Memcpy(h->signature, GBB_SIGNATURE, GBB_SIGNATURE_SIZE);
+	h->major_version = GBB_MAJOR_VER;
+	h->minor_version = GBB_MINOR_VER;
+	h->header_size = GBB_HEADER_SIZE;
+	h->rootkey_offset = sizeof(*h);
+	h->rootkey_size = size - sizeof(*h);
+	PublicKeyInit((VbPublicKey *)(gbb + h->rootkey_offset),
+		      gbb + size - key->key_size, key->key_size);
+	PublicKeyCopy((VbPublicKey *)(gbb + h->rootkey_offset), key);
+
+	Memset(&cparams, 0, sizeof(cparams));
+	cparams.gbb_data = gbb;
+	cparams.gbb_size = size;
+}
+
+/*
+ * Make firmware A and B verification blocks for [bench.size] bytes of
+ * firmware, with every key in the chain being [key] / [private_key].
+ */
+static int BuildFirmware(const VbPublicKey *key,
+			 const VbPrivateKey *private_key)
+{
+	static uint8_t *vblock;
+	VbFirmwarePreambleHeader *preamble;
+	VbSignature *body_sig;
+
+	body_sig = CalculateSignature(data, bench.size, private_key);
+	if (!body_sig)
+		return 1;
+	preamble = CreateFirmwarePreamble(0, key, body_sig, private_key, 0);
+	free(body_sig);
+	if (!preamble)
+		return 1;
+
+	free(vblock);
+	vblock = malloc(bench.key_block->key_block_size +
+			preamble->preamble_size);
+	Memcpy(vblock, bench.key_block, bench.key_block->key_block_size);
+	Memcpy(vblock + bench.key_block->key_block_size, preamble,
+	       preamble->preamble_size);
+
+	Memset(&fparams, 0, sizeof(fparams));
+	fparams.verification_block_A = vblock;
+	fparams.verification_size_A = bench.key_block->key_block_size +
+		preamble->preamble_size;
+	fparams.verification_block_B = fparams.verification_block_A;
+	fparams.verification_size_B = fparams.verification_size_A;
+	free(preamble);
+	return 0;
+}
+
+/*
+ * Make a disk with a GPT and one kernel partition, holding [bench.size] bytes
+ * of kernel signed with [private_key], in [bench.key_block].
+ */
+static int BuildDisk(const VbPrivateKey *private_key)
+{
+	Guid chromeos_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+	uint64_t kb_size = bench.key_block->key_block_size;
+	uint64_t part_sectors =
+		(KERNEL_HEADER_SIZE + bench.size + SECTOR_SIZE - 1) /
+		SECTOR_SIZE;
+	VbKernelPreambleHeader *preamble;
+	VbSignature *body_sig;
+	GptHeader *header, *header2;
+	GptEntry *entries;
+	uint8_t *part;
+
+	body_sig = CalculateSignature(data, bench.size, private_key);
+	if (!body_sig)
+		return 1;
+	preamble = CreateKernelPreamble(0, 0x100000, 0x100000, 0, body_sig,
+					KERNEL_HEADER_SIZE - kb_size,
+					private_key);
+	free(body_sig);
+	if (!preamble)
+		return 1;
+
+	/* GPT, then the partition, then a gap the size of a GPT */
+	disk_sectors = KERNEL_PART_LBA * 2 + part_sectors;
+	free(disk);
+	disk = calloc(disk_sectors, SECTOR_SIZE);
+
+	part = disk + KERNEL_PART_LBA * SECTOR_SIZE;
+	Memcpy(part, bench.key_block, kb_size);
+	Memcpy(part + kb_size, preamble, preamble->preamble_size);
+	Memcpy(part + KERNEL_HEADER_SIZE, data, bench.size);
+	free(preamble);
+
+	header = (GptHeader *)(disk + SECTOR_SIZE);
+	entries = (GptEntry *)(disk + 2 * SECTOR_SIZE);
+	Memcpy(header->signature, GPT_HEADER_SIGNATURE,
+	       GPT_HEADER_SIGNATURE_SIZE);
+	header->revision = GPT_HEADER_REVISION;
+	header->size = sizeof(GptHeader);
+	header->my_lba = 1;
+	header->alternate_lba = disk_sectors - 1;
+	header->first_usable_lba = 2 + GPT_ENTRIES_SECTORS;
+	header->last_usable_lba = disk_sectors - 2 - GPT_ENTRIES_SECTORS;
+	header->entries_lba = 2;
+	header->number_of_entries = TOTAL_ENTRIES_SIZE / sizeof(GptEntry);
+	header->size_of_entry = sizeof(GptEntry);
+
+	Memcpy(&entries[0].type, &chromeos_kernel, sizeof(chromeos_kernel));
+	entries[0].unique.u.raw[0] = 1;
+	entries[0].starting_lba = KERNEL_PART_LBA;
+	entries[0].ending_lba = KERNEL_PART_LBA + part_sectors - 1;
+	/* Successful, so booting it doesn't change the GPT */
+	SetEntrySuccessful(&entries[0], 1);
+	SetEntryPriority(&entries[0], 1);
+	header->entries_crc32 = Crc32(entries, TOTAL_ENTRIES_SIZE);
+	header->header_crc32 = HeaderCrc(header);
+
+	/* Secondary GPT at the end of the disk */
+	header2 = (GptHeader *)(disk + (disk_sectors - 1) * SECTOR_SIZE);
+	Memcpy(header2, header, sizeof(GptHeader));
+	header2->my_lba = disk_sectors - 1;
+	header2->alternate_lba = 1;
+	header2->entries_lba = disk_sectors - 1 - GPT_ENTRIES_SECTORS;
+	Memcpy(disk + header2->entries_lba * SECTOR_SIZE, entries,
+	       TOTAL_ENTRIES_SIZE);
+	header2->header_crc32 = HeaderCrc(header2);
+	return 0;
+}
+
+static int BenchHashes(void)
+{
+	char name[64];
+	int errs = 0;
+	int i, j;
+
+	/* The first three algorithms cover the hashes */
+	for (i = 0; i < ARRAY_SIZE(hash_names); i++) {
+		bench.algorithm = i;
+		for (j = 0; j < ARRAY_SIZE(hash_sizes); j++) {
+			bench.size = hash_sizes[j];
+			snprintf(name, sizeof(name), "hash_%s_%s",
+				 hash_names[i], SizeName(bench.size));
+			errs += Bench(name, bench.size, RunHash);
+		}
+	}
+	return errs;
+}
+
+/* Run the cases which use [algorithm] */
+static int BenchAlgorithm(int algorithm, const char *keys_dir)
+{
+	char filename[1024];
+	char name[64];
+	VbPrivateKey *private_key;
+	uint64_t *n64;
+	int rsa_len = siglen_map[algorithm] * 8;
+	int errs = 0;
+	int i;
+
+	snprintf(filename, sizeof(filename), "%s/key_rsa%d.pem", keys_dir,
+		 rsa_len);
+	private_key = PrivateKeyReadPem(filename, algorithm);
+	if (!private_key) {
+		fprintf(stderr, "Error reading %s\n", filename);
+		return 1;
+	}
+	snprintf(filename, sizeof(filename), "%s/key_rsa%d.keyb", keys_dir,
+		 rsa_len);
+	bench.key = PublicKeyReadKeyb(filename, algorithm, 1);
+	if (!bench.key) {
+		fprintf(stderr, "Error reading %s\n", filename);
+		PrivateKeyFree(private_key);
+		return 1;
+	}
+	bench.rsa_key = PublicKeyToRSA(bench.key);
+	bench.algorithm = algorithm;
+
+	/* RSA alone, on the digest of a small buffer */
+	bench.size = 4 * KB;
+	bench.sig = CalculateSignature(data, bench.size, private_key);
+	bench.digest = DigestBuf(data, bench.size, algorithm);
+	snprintf(name, sizeof(name), "rsa_%s", AlgName(algorithm));
+	errs += Bench(name, 0, RunRSAVerify);
+
+	/*
+	 * Hide the 64-bit limbs, if the key has them, to time the 32-bit limb
+	 * code too.  The case is there either way, so outputs from builds with
+	 * and without RSA_64BIT_LIMBS still line up.
+	 */
+	n64 = bench.rsa_key->n64;
+	bench.rsa_key->n64 = NULL;
+	snprintf(name, sizeof(name), "rsa_%s_limb32", AlgName(algorithm));
+	errs += Bench(name, 0, RunRSAVerify);
+	bench.rsa_key->n64 = n64;
+	free(bench.digest);
+	free(bench.sig);
+
+	/* Hash and RSA */
+	for (i = 0; i < ARRAY_SIZE(data_sizes); i++) {
+		bench.size = data_sizes[i];
+		bench.sig = CalculateSignature(data, bench.size, private_key);
+		snprintf(name, sizeof(name), "verify_data_%s_%s",
+			 AlgName(algorithm), SizeName(bench.size));
+		errs += Bench(name, bench.size, RunVerifyData);
+		free(bench.sig);
+	}
+
+	/* The key block signs itself, like a self-signed kernel */
+	bench.key_block = KeyBlockCreate(bench.key, private_key,
+					 KEY_BLOCK_FLAG_DEVELOPER_0 |
+					 KEY_BLOCK_FLAG_RECOVERY_0);
+	snprintf(name, sizeof(name), "keyblock_%s", AlgName(algorithm));
+	errs += Bench(name, 0, RunKeyBlockVerify);
+	snprintf(name, sizeof(name), "keyblock_hash_%s", AlgName(algorithm));
+	errs += Bench(name, 0, RunKeyBlockVerifyHash);
+
+	/* Whole boot stages */
+	BuildGbb(bench.key);
+	for (i = 0; i < ARRAY_SIZE(firmware_sizes); i++) {
+		bench.size = firmware_sizes[i];
+		snprintf(name, sizeof(name), "load_firmware_%s_%s",
+			 AlgName(algorithm), SizeName(bench.size));
+		if (filter && !strstr(name, filter))
+			continue;
+		if (BuildFirmware(bench.key, private_key)) {
+			fprintf(stderr, "Can't build firmware for %s\n", name);
+			errs++;
+			continue;
+		}
+		errs += Bench(name, bench.size, RunLoadFirmware);
+	}
+	for (i = 0; i < ARRAY_SIZE(kernel_sizes); i++) {
+		bench.size = kernel_sizes[i];
+		snprintf(name, sizeof(name), "load_kernel_%s_%s",
+			 AlgName(algorithm), SizeName(bench.size));
+		if (filter && !strstr(name, filter))
+			continue;
+		if (BuildDisk(private_key)) {
+			fprintf(stderr, "Can't build disk for %s\n", name);
+			errs++;
+			continue;
+		}
+		errs += Bench(name, bench.size, RunLoadKernel);
+	}
+
+	free(bench.key_block);
+	RSAPublicKeyFree(bench.rsa_key);
+	free(bench.key);
+	PrivateKeyFree(private_key);
+	return errs;
+}
+
+static void PrintHelp(const char *progname)
+{
+	fprintf(stderr,
+		"Usage: %s [options] KEYS_DIR\n"
+		"\n"
+		"Times signature verification with the test keys in "
+		"KEYS_DIR.\n"
+		"\n"
+		"Options:\n"
+		"  --runs NUM       Timed runs of each case (default %d)\n"
+		"  --warmup NUM     Untimed runs first (default %d)\n"
+		"  --max_secs NUM   Stop timing a case after this long, if it "
+		"has\n"
+		"                     had %d runs (default %d)\n"
+		"  --filter STR     Only run cases whose names contain STR\n"
+		"  --quiet          No summary on stderr\n",
+		progname, DEFAULT_RUNS, DEFAULT_WARMUP, MIN_RUNS,
+		DEFAULT_MAX_SECS);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_opts[] = {
+		{"runs", 1, 0, 'r'},
+		{"warmup", 1, 0, 'w'},
+		{"max_secs", 1, 0, 'm'},
+		{"filter", 1, 0, 'f'},
+		{"quiet", 0, 0, 'q'},
+		{NULL, 0, 0, 0}
+	};
+	int errs = 0;
+	char *e;
+	int i;
+
+	while ((i = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (i) {
+		case 'r':
+			runs = strtol(optarg, &e, 0);
+			if (!*optarg || *e || runs < 1) {
+				fprintf(stderr, "Bad --runs\n");
+				return 1;
+			}
+			break;
+		case 'w':
+			warmup = strtol(optarg, &e, 0);
+			if (!*optarg || *e || warmup < 0) {
+				fprintf(stderr, "Bad --warmup\n");
+				return 1;
+			}
+			break;
+		case 'm':
+			max_secs = strtol(optarg, &e, 0);
+			if (!*optarg || *e || max_secs < 0) {
+				fprintf(stderr, "Bad --max_secs\n");
+				return 1;
+			}
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			PrintHelp(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		PrintHelp(argv[0]);
+		return 1;
+	}
+
+	samples = malloc(runs * sizeof(*samples));
+	data = malloc(MAX_DATA_SIZE);
+	if (!samples || !data) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < MAX_DATA_SIZE; i++)
+		data[i] = (uint8_t)(i * 7 + (i >> 8));
+
+	errs += BenchHashes();
+	for (i = 0; i < kNumAlgorithms; i++)
+		errs += BenchAlgorithm(i, argv[optind]);
+
+	free(gbb);
+	free(disk);
+	free(data);
+	free(samples);
+	return errs ? 1 : 0;
+}
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "cryptolib.h"
 #include "file_keys.h"
@@ -18,6 +19,7 @@
 
 static void VerifyPublicKeyToRSA(const VbPublicKey *orig_key)
 {
+	RSAPublicKey view;
 	RSAPublicKey *rsa;
 	VbPublicKey *key = PublicKeyAlloc(orig_key->key_size, 0, 0);
 
@@ -38,6 +40,25 @@ static void VerifyPublicKeyToRSA(const VbPublicKey *orig_key)
 			"PublicKeyToRSA() algorithm");
 		RSAPublicKeyFree(rsa);
 	}
+
+	PublicKeyCopy(key, orig_key);
+	key->algorithm = kNumAlgorithms;
+	TEST_PTR_EQ(PublicKeyToRSAView(key, &view), NULL,
+		    "PublicKeyToRSAView() invalid algorithm");
+
+	PublicKeyCopy(key, orig_key);
+	key->key_size -= 1;
+	TEST_PTR_EQ(PublicKeyToRSAView(key, &view), NULL,
+		    "PublicKeyToRSAView() invalid size");
+
+	rsa = PublicKeyToRSAView(orig_key, &view);
+	TEST_PTR_EQ(rsa, &view, "PublicKeyToRSAView() ok");
+	if (rsa) {
+		TEST_EQ((int)rsa->algorithm, (int)orig_key->algorithm,
+			"PublicKeyToRSAView() algorithm");
+		RSAPublicKeyFree(rsa);
+	}
+	free(key);
 }
 
 static void VerifyDataTest(const VbPublicKey *public_key,
@@ -76,6 +97,104 @@ static void VerifyDataTest(const VbPublicKey *public_key,
 	free(sig);
 }
 
+static void VerifyDataInFileTest(const VbPublicKey *public_key,
+				 const VbPrivateKey *private_key)
+{
+	/* Two whole chunks, after a header which isn't part of the body */
+	const uint64_t offset = 17;
+	const uint64_t body_size = 2 * VERIFY_CHUNK_SIZE;
+	uint8_t *file_data = malloc(offset + body_size);
+	VbSignature *sig;
+	RSAPublicKey *rsa;
+	FILE *f;
+	uint64_t i;
+	int fd;
+
+	for (i = 0; i < offset + body_size; i++)
+		file_data[i] = (uint8_t)(i * 13 + (i >> 12));
+
+	sig = CalculateSignature(file_data + offset, body_size, private_key);
+	rsa = PublicKeyToRSA(public_key);
+	f = tmpfile();
+	TEST_PTR_NEQ(sig, 0, "VerifyDataInFile() calculate signature");
+	TEST_PTR_NEQ(rsa, 0, "VerifyDataInFile() calculate rsa");
+	TEST_PTR_NEQ(f, 0, "VerifyDataInFile() tmpfile");
+	if (!sig || !rsa || !f ||
+	    1 != fwrite(file_data, offset + body_size, 1, f) || fflush(f))
+		goto done;
+	fd = fileno(f);
+
+	TEST_EQ(VerifyDataInFile(fd, offset, body_size, sig, rsa), 0,
+		"VerifyDataInFile() chunk boundary");
+	TEST_EQ(VerifyDataInFile(fd, offset, body_size + 1, sig, rsa), 0,
+		"VerifyDataInFile() trailing data");
+	TEST_EQ(VerifyDataInFile(fd, offset - 1, body_size + 1, sig, rsa), 1,
+		"VerifyDataInFile() wrong offset");
+
+	/* Short files */
+	TEST_EQ(VerifyDataInFile(fd, offset, body_size - 1, sig, rsa), 1,
+		"VerifyDataInFile() size too small");
+	TEST_EQ(ftruncate(fd, offset + VERIFY_CHUNK_SIZE + 5), 0,
+		"VerifyDataInFile() truncate");
+	TEST_EQ(VerifyDataInFile(fd, offset, body_size, sig, rsa), 1,
+		"VerifyDataInFile() file too short");
+
+	/* Read error */
+	TEST_EQ(VerifyDataInFile(-1, offset, body_size, sig, rsa), 1,
+		"VerifyDataInFile() read error");
+
+done:
+	if (f)
+		fclose(f);
+	RSAPublicKeyFree(rsa);
+	free(sig);
+	free(file_data);
+}
+
+static void VerifyDataViewTest(const VbPublicKey *public_key,
+			       const VbPrivateKey *private_key)
+{
+	const uint8_t test_data[] = "This is some test data to sign.";
+	const uint64_t test_size = sizeof(test_data);
+	uint64_t key_total = public_key->key_offset + public_key->key_size;
+	uint8_t *misaligned_buf = malloc(key_total + 1);
+	VbPublicKey *misaligned = (VbPublicKey *)(misaligned_buf + 1);
+	RSAPublicKey view;
+	RSAPublicKey *rsa;
+	VbSignature *sig;
+
+	sig = CalculateSignature(test_data, test_size, private_key);
+	TEST_PTR_NEQ(sig, 0, "VerifyData() view calculate signature");
+	if (!sig)
+		return;
+
+	/* A view of an aligned key points into it */
+	rsa = PublicKeyToRSAView(public_key, &view);
+	TEST_PTR_EQ(rsa, &view, "VerifyData() view");
+	TEST_PTR_EQ(view.n, GetPublicKeyDataC(public_key) + 8,
+		    "VerifyData() view uses key data");
+	TEST_PTR_EQ(view.blob_copy, NULL, "VerifyData() view no copy");
+	TEST_EQ(VerifyData(test_data, test_size, sig, rsa), 0,
+		"VerifyData() view ok");
+	GetSignatureData(sig)[0] ^= 0x5A;
+	TEST_EQ(VerifyData(test_data, test_size, sig, rsa), 1,
+		"VerifyData() view wrong sig");
+	GetSignatureData(sig)[0] ^= 0x5A;
+	RSAPublicKeyFree(rsa);
+
+	/* A view of a misaligned key uses an aligned copy */
+	memcpy(misaligned, public_key, key_total);
+	rsa = PublicKeyToRSAView(misaligned, &view);
+	TEST_PTR_EQ(rsa, &view, "VerifyData() misaligned view");
+	TEST_PTR_NEQ(view.blob_copy, NULL, "VerifyData() misaligned copy");
+	TEST_EQ(VerifyData(test_data, test_size, sig, rsa), 0,
+		"VerifyData() misaligned view ok");
+	RSAPublicKeyFree(rsa);
+
+	free(misaligned_buf);
+	free(sig);
+}
+
 static void VerifyDigestTest(const VbPublicKey *public_key,
                              const VbPrivateKey *private_key)
 {
@@ -209,6 +328,60 @@ static void VerifyKernelPreambleTest(const VbPublicKey *public_key,
 	free(hdr);
 }
 
+#define NUM_BATCH_PREAMBLES 5
+
+static void VerifyKernelPreambleBatchTest(const VbPublicKey *public_key,
+					  const VbPrivateKey *private_key)
+{
+	VbKernelPreambleHeader *hdr;
+	VbKernelPreambleHeader *h[NUM_BATCH_PREAMBLES];
+	const VbKernelPreambleHeader *preambles[NUM_BATCH_PREAMBLES];
+	uint64_t sizes[NUM_BATCH_PREAMBLES];
+	int results[NUM_BATCH_PREAMBLES];
+	RSAPublicKey *rsa;
+	unsigned hsize;
+	int i, same;
+
+	VbSignature *body_sig = SignatureAlloc(56, 78);
+
+	rsa = PublicKeyToRSA(public_key);
+	hdr = CreateKernelPreamble(0x1234, 0x100000, 0x300000, 0x4000, body_sig,
+				   0, private_key);
+	TEST_NEQ(hdr && rsa, 0, "VerifyKernelPreambleBatch() prerequisites");
+	if (!hdr)
+		return;
+	hsize = (unsigned) hdr->preamble_size;
+
+	/* A mix of good and bad preambles */
+	for (i = 0; i < NUM_BATCH_PREAMBLES; i++) {
+		h[i] = (VbKernelPreambleHeader *)malloc(hsize);
+		Memcpy(h[i], hdr, hsize);
+		preambles[i] = h[i];
+		sizes[i] = hsize;
+	}
+	h[1]->header_version_major++;
+	ReSignKernelPreamble(h[1], private_key);
+	GetSignatureData(&h[2]->body_signature)[0] ^= 0x34;
+	h[3]->preamble_signature.sig_size--;
+
+	TEST_EQ(VerifyKernelPreambleBatch(preambles, sizes, NUM_BATCH_PREAMBLES,
+					  rsa, results), 2,
+		"VerifyKernelPreambleBatch() good count");
+	same = 1;
+	for (i = 0; i < NUM_BATCH_PREAMBLES; i++) {
+		if (results[i] != VerifyKernelPreamble(preambles[i], sizes[i],
+						       rsa))
+			same = 0;
+	}
+	TEST_EQ(same, 1, "VerifyKernelPreambleBatch() matches single");
+
+	for (i = 0; i < NUM_BATCH_PREAMBLES; i++)
+		free(h[i]);
+	RSAPublicKeyFree(rsa);
+	free(hdr);
+	free(body_sig);
+}
+
 int test_algorithm(int key_algorithm, const char *keys_dir)
 {
 	char filename[1024];
@@ -235,8 +408,11 @@ int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	VerifyPublicKeyToRSA(public_key);
 	VerifyDataTest(public_key, private_key);
+	VerifyDataInFileTest(public_key, private_key);
+	VerifyDataViewTest(public_key, private_key);
 	VerifyDigestTest(public_key, private_key);
 	VerifyKernelPreambleTest(public_key, private_key);
+	VerifyKernelPreambleBatchTest(public_key, private_key);
 
 	if (public_key)
 		free(public_key);
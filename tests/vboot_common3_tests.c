@@ -5,6 +5,7 @@
  * Tests for firmware image library.
  */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -153,6 +154,290 @@ static void KeyBlockVerifyTest(const VbPublicKey *public_key,
 	free(hdr);
 }
 
+static void KeyBlockVerifyWithRSATest(const VbPublicKey *public_key,
+				      const VbPrivateKey *private_key,
+				      const VbPublicKey *data_key)
+{
+	VbKeyBlockHeader *hdr;
+	VbKeyBlockHeader *h;
+	RSAPublicKey *rsa;
+	unsigned hsize;
+
+	hdr = KeyBlockCreate(data_key, private_key, 0x1234);
+	rsa = PublicKeyToRSA(public_key);
+	TEST_NEQ((size_t)hdr, 0, "KeyBlockVerifyWithRSA() prerequisites");
+	TEST_NEQ((size_t)rsa, 0, "KeyBlockVerifyWithRSA() rsa");
+	if (!hdr || !rsa)
+		return;
+	hsize = (unsigned) hdr->key_block_size;
+	h = (VbKeyBlockHeader *)malloc(hsize);
+
+	TEST_EQ(KeyBlockVerifyWithRSA(hdr, hsize, public_key, rsa), 0,
+		"KeyBlockVerifyWithRSA() ok");
+	TEST_NEQ(KeyBlockVerifyWithRSA(hdr, hsize, public_key, NULL), 0,
+		 "KeyBlockVerifyWithRSA() missing rsa");
+	TEST_NEQ(KeyBlockVerifyWithRSA(hdr, hsize, NULL, rsa), 0,
+		 "KeyBlockVerifyWithRSA() missing key");
+	TEST_NEQ(KeyBlockVerifyWithRSA(hdr, hsize - 1, public_key, rsa), 0,
+		 "KeyBlockVerifyWithRSA() size--");
+
+	Memcpy(h, hdr, hsize);
+	GetPublicKeyData(&h->data_key)[0] ^= 0x34;
+	TEST_EQ(KeyBlockVerifyWithRSA(h, hsize, public_key, rsa),
+		VBOOT_KEY_BLOCK_SIGNATURE,
+		"KeyBlockVerifyWithRSA() sig mismatch");
+
+	free(h);
+	RSAPublicKeyFree(rsa);
+	free(hdr);
+}
+
+#define NUM_BATCH_BLOCKS 6
+
+static void KeyBlockVerifyBatchTest(const VbPublicKey *public_key,
+				    const VbPrivateKey *private_key,
+				    const VbPublicKey *data_key)
+{
+	VbKeyBlockHeader *hdr;
+	VbKeyBlockHeader *h[NUM_BATCH_BLOCKS];
+	const VbKeyBlockHeader *blocks[NUM_BATCH_BLOCKS];
+	uint64_t sizes[NUM_BATCH_BLOCKS];
+	int results[NUM_BATCH_BLOCKS];
+	VbPublicKey *bad_key;
+	unsigned hsize;
+	int hash_only;
+	int i, same;
+
+	hdr = KeyBlockCreate(data_key, private_key, 0x1234);
+	TEST_NEQ((size_t)hdr, 0, "KeyBlockVerifyBatch() prerequisites");
+	if (!hdr)
+		return;
+	hsize = (unsigned) hdr->key_block_size;
+
+	/* A mix of good and bad blocks */
+	for (i = 0; i < NUM_BATCH_BLOCKS; i++) {
+		h[i] = (VbKeyBlockHeader *)malloc(hsize);
+		Memcpy(h[i], hdr, hsize);
+		blocks[i] = h[i];
+		sizes[i] = hsize;
+	}
+	h[1]->magic[0] &= 0x12;
+	GetPublicKeyData(&h[2]->data_key)[0] ^= 0x34;
+	sizes[3] = hsize - 1;
+	h[4]->data_key.key_offset = hsize;
+	ReChecksumKeyBlock(h[4]);
+
+	for (hash_only = 0; hash_only < 2; hash_only++) {
+		TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, NUM_BATCH_BLOCKS,
+					    public_key, hash_only, results),
+			2, "KeyBlockVerifyBatch() good count");
+		same = 1;
+		for (i = 0; i < NUM_BATCH_BLOCKS; i++) {
+			if (results[i] != KeyBlockVerify(blocks[i], sizes[i],
+							 public_key,
+							 hash_only))
+				same = 0;
+		}
+		TEST_EQ(same, 1, "KeyBlockVerifyBatch() matches single");
+	}
+
+	TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, NUM_BATCH_BLOCKS, NULL, 0,
+				    results), 0,
+		"KeyBlockVerifyBatch() missing key");
+	TEST_EQ(results[0], VBOOT_PUBLIC_KEY_INVALID,
+		"KeyBlockVerifyBatch() missing key result");
+
+	bad_key = (VbPublicKey *)malloc(public_key->key_offset +
+					public_key->key_size);
+	Memcpy(bad_key, public_key, public_key->key_offset +
+	       public_key->key_size);
+	bad_key->key_size--;
+	TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, NUM_BATCH_BLOCKS, bad_key, 0,
+				    results), 0,
+		"KeyBlockVerifyBatch() bad key");
+	TEST_EQ(results[0], KeyBlockVerify(blocks[0], sizes[0], bad_key, 0),
+		"KeyBlockVerifyBatch() bad key result");
+	free(bad_key);
+
+	TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, 0, public_key, 0, results),
+		0, "KeyBlockVerifyBatch() empty");
+
+	for (i = 0; i < NUM_BATCH_BLOCKS; i++)
+		free(h[i]);
+	free(hdr);
+}
+
+#define CACHE_THREADS 4
+#define CACHE_THREAD_CHECKS 16
+
+/* Key block checked by each CacheThread() */
+struct cache_thread_arg {
+	const VbKeyBlockHeader *block;
+	const VbPublicKey *key;
+	int failures;
+};
+
+static void *CacheThread(void *ptr)
+{
+	struct cache_thread_arg *arg = (struct cache_thread_arg *)ptr;
+	int i;
+
+	for (i = 0; i < CACHE_THREAD_CHECKS; i++) {
+		if (KeyBlockVerify(arg->block, arg->block->key_block_size,
+				   arg->key, 0))
+			arg->failures++;
+	}
+	return NULL;
+}
+
+static void KeyBlockCacheTest(const VbPublicKey *public_key,
+			      const VbPrivateKey *private_key,
+			      const VbPublicKey *data_key)
+{
+	VbKeyBlockHeader *hdr;
+	VbKeyBlockHeader *h;
+	VbKeyBlockHeader *extra[9];
+	const VbKeyBlockHeader *blocks[NUM_BATCH_BLOCKS];
+	uint64_t sizes[NUM_BATCH_BLOCKS];
+	int results[NUM_BATCH_BLOCKS];
+	VbKeyBlockCacheStats stats;
+	unsigned hsize;
+	int i;
+
+	hdr = KeyBlockCreate(data_key, private_key, 0x1234);
+	TEST_NEQ((size_t)hdr, 0, "KeyBlockCache prerequisites");
+	if (!hdr)
+		return;
+	hsize = (unsigned) hdr->key_block_size;
+	h = (VbKeyBlockHeader *)malloc(hsize);
+
+	/* Second check of the same block hits */
+	KeyBlockCacheEnable(1);
+	TEST_EQ(KeyBlockVerify(hdr, hsize, public_key, 0), 0,
+		"KeyBlockCache first check");
+	TEST_EQ(KeyBlockVerify(hdr, hsize, public_key, 0), 0,
+		"KeyBlockCache second check");
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.misses, 1, "KeyBlockCache misses");
+	TEST_EQ(stats.hits, 1, "KeyBlockCache hits");
+	TEST_EQ(stats.insertions, 1, "KeyBlockCache insertions");
+
+	/* Hash-only checks don't use the cache */
+	TEST_EQ(KeyBlockVerify(hdr, hsize, NULL, 1), 0,
+		"KeyBlockCache hash only");
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits + stats.misses, 2, "KeyBlockCache hash only stats");
+
+	/* A cached block still gets its header checks */
+	TEST_EQ(KeyBlockVerify(hdr, hsize - 1, public_key, 0),
+		VBOOT_KEY_BLOCK_INVALID, "KeyBlockCache size--");
+
+	/* Changed data or signature misses, and fails the real check */
+	Memcpy(h, hdr, hsize);
+	h->key_block_flags ^= 1;
+	TEST_EQ(KeyBlockVerify(h, hsize, public_key, 0),
+		VBOOT_KEY_BLOCK_SIGNATURE, "KeyBlockCache changed data");
+	Memcpy(h, hdr, hsize);
+	GetSignatureData(&h->key_block_signature)[0] ^= 0x34;
+	TEST_EQ(KeyBlockVerify(h, hsize, public_key, 0),
+		VBOOT_KEY_BLOCK_SIGNATURE, "KeyBlockCache changed signature");
+
+	/* So does a different key */
+	TEST_NEQ(KeyBlockVerify(hdr, hsize, data_key, 0), 0,
+		 "KeyBlockCache different key");
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits, 1, "KeyBlockCache no false hits");
+	TEST_EQ(stats.insertions, 1, "KeyBlockCache bad blocks not added");
+
+	/* Invalidation */
+	KeyBlockCacheInvalidate(data_key);
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.invalidations, 0, "KeyBlockCache invalidate other key");
+	KeyBlockCacheInvalidate(public_key);
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.invalidations, 1, "KeyBlockCache invalidate key");
+	KeyBlockVerify(hdr, hsize, public_key, 0);
+	KeyBlockVerify(hdr, hsize, public_key, 0);
+	KeyBlockCacheInvalidate(NULL);
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.invalidations, 2, "KeyBlockCache invalidate all");
+	TEST_EQ(stats.hits, 2, "KeyBlockCache hit after reinsert");
+
+	/* The least recently used block is evicted when the cache is full */
+	KeyBlockCacheEnable(1);
+	for (i = 0; i < ARRAY_SIZE(extra); i++) {
+		extra[i] = KeyBlockCreate(data_key, private_key, i);
+		KeyBlockVerify(extra[i], extra[i]->key_block_size,
+			       public_key, 0);
+	}
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.insertions, ARRAY_SIZE(extra), "KeyBlockCache fill");
+	TEST_EQ(stats.evictions, 1, "KeyBlockCache evictions");
+	KeyBlockVerify(extra[ARRAY_SIZE(extra) - 1],
+		       extra[ARRAY_SIZE(extra) - 1]->key_block_size,
+		       public_key, 0);
+	KeyBlockVerify(extra[0], extra[0]->key_block_size, public_key, 0);
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits, 1, "KeyBlockCache LRU evicted");
+	for (i = 0; i < ARRAY_SIZE(extra); i++)
+		free(extra[i]);
+
+	/* Batches use the cache too */
+	KeyBlockCacheEnable(1);
+	for (i = 0; i < NUM_BATCH_BLOCKS; i++) {
+		blocks[i] = hdr;
+		sizes[i] = hsize;
+	}
+	blocks[1] = h;
+	TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, NUM_BATCH_BLOCKS,
+				    public_key, 0, results),
+		NUM_BATCH_BLOCKS - 1, "KeyBlockCache batch");
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.insertions, 1, "KeyBlockCache batch insertions");
+	TEST_EQ(KeyBlockVerifyBatch(blocks, sizes, NUM_BATCH_BLOCKS,
+				    public_key, 0, results),
+		NUM_BATCH_BLOCKS - 1, "KeyBlockCache batch again");
+	TEST_EQ(results[1], VBOOT_KEY_BLOCK_SIGNATURE,
+		"KeyBlockCache batch bad block");
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits, NUM_BATCH_BLOCKS - 1, "KeyBlockCache batch hits");
+
+	/* Several threads can share the cache */
+	KeyBlockCacheEnable(1);
+	{
+		pthread_t threads[CACHE_THREADS];
+		struct cache_thread_arg args[CACHE_THREADS];
+		int failures = 0;
+
+		for (i = 0; i < CACHE_THREADS; i++) {
+			args[i].block = hdr;
+			args[i].key = public_key;
+			args[i].failures = 0;
+			pthread_create(threads + i, NULL, CacheThread,
+				       args + i);
+		}
+		for (i = 0; i < CACHE_THREADS; i++) {
+			pthread_join(threads[i], NULL);
+			failures += args[i].failures;
+		}
+		TEST_EQ(failures, 0, "KeyBlockCache threads");
+	}
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits + stats.misses, CACHE_THREADS * CACHE_THREAD_CHECKS,
+		"KeyBlockCache threads stats");
+	TEST_EQ(stats.insertions, 1, "KeyBlockCache threads insertions");
+
+	/* Disabling clears everything */
+	KeyBlockCacheEnable(0);
+	KeyBlockVerify(hdr, hsize, public_key, 0);
+	KeyBlockCacheGetStats(&stats);
+	TEST_EQ(stats.hits + stats.misses + stats.insertions, 0,
+		"KeyBlockCache disabled");
+
+	free(h);
+	free(hdr);
+}
+
 static void ReSignFirmwarePreamble(VbFirmwarePreambleHeader *h,
                                    const VbPrivateKey *key)
 {
@@ -319,6 +604,12 @@ int test_permutation(int signing_key_algorithm, int data_key_algorithm,
 
 	KeyBlockVerifyTest(signing_public_key, signing_private_key,
 			   data_public_key);
+	KeyBlockVerifyWithRSATest(signing_public_key, signing_private_key,
+				  data_public_key);
+	KeyBlockVerifyBatchTest(signing_public_key, signing_private_key,
+				data_public_key);
+	KeyBlockCacheTest(signing_public_key, signing_private_key,
+			  data_public_key);
 	VerifyFirmwarePreambleTest(signing_public_key, signing_private_key,
 				   data_public_key);
 
@@ -40,8 +40,12 @@ static void StructPackingTest(void)
 		"sizeof(VbSharedDataHeader) V1");
 
 	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V2,
-		sizeof(VbSharedDataHeader),
+		(long)&((VbSharedDataHeader*)NULL)->timestamp_count,
 		"sizeof(VbSharedDataHeader) V2");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V3,
+		sizeof(VbSharedDataHeader),
+		"sizeof(VbSharedDataHeader) V3");
 }
 
 /* Test array size macro */
@@ -229,6 +233,44 @@ static void VbSharedDataTest(void)
 		 "VbSharedDataSetKernelKey null");
 }
 
+/* Boot event timestamp tests */
+static void VbSharedDataTimestampTest(void)
+{
+	uint8_t buf[VB_SHARED_DATA_MIN_SIZE];
+	VbSharedDataHeader *d = (VbSharedDataHeader *)buf;
+	int i;
+
+	VbSharedDataInit(d, sizeof(buf));
+	TEST_EQ(d->timestamp_count, 0, "Timestamp count starts at 0");
+
+	VbSharedDataAddTimestamp(d, VBSD_TS_LK_BODY_START, 2);
+	TEST_EQ(d->timestamp_count, 1, "Timestamp added");
+	TEST_EQ(d->timestamps[0].event, VBSD_TS_LK_BODY_START,
+		"  event");
+	TEST_EQ(d->timestamps[0].data, 2, "  data");
+
+	/* The ring keeps the most recent ones */
+	for (i = 1; i < VBSD_MAX_TIMESTAMPS + 3; i++)
+		VbSharedDataAddTimestamp(d, VBSD_TS_LK_BODY_END, i);
+	TEST_EQ(d->timestamp_count, VBSD_MAX_TIMESTAMPS + 3,
+		"Timestamp count keeps counting");
+	TEST_EQ(d->timestamps[0].event, VBSD_TS_LK_BODY_END,
+		"  oldest overwritten");
+	TEST_EQ(d->timestamps[0].data, VBSD_MAX_TIMESTAMPS, "  data");
+	TEST_EQ(d->timestamps[2].data, VBSD_MAX_TIMESTAMPS + 2,
+		"  newest");
+	TEST_EQ(d->timestamps[3].data, 3, "  older kept");
+
+	/* Older structs don't have the ring */
+	VbSharedDataInit(d, sizeof(buf));
+	d->struct_version = 2;
+	VbSharedDataAddTimestamp(d, VBSD_TS_LK_BODY_START, 0);
+	TEST_EQ(d->timestamp_count, 0, "No timestamps in v2 struct");
+
+	/* Shouldn't crash */
+	VbSharedDataAddTimestamp(NULL, VBSD_TS_LK_BODY_START, 0);
+}
+
 int main(int argc, char* argv[])
 {
 	StructPackingTest();
@@ -236,6 +278,7 @@ int main(int argc, char* argv[])
 	VerifyHelperFunctions();
 	PublicKeyTest();
 	VbSharedDataTest();
+	VbSharedDataTimestampTest();
 
 	return gTestSuccess ? 0 : 255;
 }
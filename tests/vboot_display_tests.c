@@ -53,6 +53,8 @@ static void ResetMocks(void)
 	bhdr->minor_version = BMPBLOCK_MINOR_VERSION;
 	bhdr->number_of_localizations = 3;
 
+	VbDisplayFreeBmpfv();
+
 	Memset(&cparams, 0, sizeof(cparams));
 	cparams.shared_data_size = sizeof(shared_data);
 	cparams.shared_data_blob = shared_data;
@@ -136,6 +138,70 @@ static void LocalizationTest(void)
 
 }
 
+/* Display a screen from the bitmap block as it is now */
+static VbError_t ShowScreen(void)
+{
+	VbDisplayFreeBmpfv();
+	return VbDisplayScreenFromGBB(&cparams, VB_SCREEN_DEVELOPER_WARNING,
+				      &vnc);
+}
+
+/* Test bounds checks on the bitmap block */
+static void ScreenFromGBBTest(void)
+{
+	ScreenLayout *layout;
+	ImageInfo *info;
+	FontArrayHeader *font;
+	uint32_t info_offset = sizeof(BmpBlockHeader) + sizeof(ScreenLayout);
+
+	/* One localization with one screen, showing one image */
+	ResetMocks();
+	bhdr->number_of_localizations = 1;
+	bhdr->number_of_screenlayouts = 1;
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV,
+		"Layout past end of bmpfv");
+
+	layout = (ScreenLayout *)(bhdr + 1);
+	layout->images[0].image_info_offset = info_offset;
+	info = (ImageInfo *)((uint8_t *)bhdr + info_offset);
+	info->format = FORMAT_BMP;
+	info->compression = COMPRESS_NONE;
+	gbb->bmpfv_size = info_offset + sizeof(ImageInfo);
+	TEST_EQ(ShowScreen(), VBERROR_SUCCESS, "Empty image");
+
+	info->original_size = 16;
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV,
+		"Image data past end of bmpfv");
+	gbb->bmpfv_size += 16;
+	TEST_EQ(ShowScreen(), VBERROR_SUCCESS, "Image data");
+
+	layout->images[0].image_info_offset = 0xfffffff0;
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV,
+		"Image info past end of bmpfv");
+	layout->images[0].image_info_offset = info_offset;
+
+	/* Fonts must have all their glyphs */
+	info->format = FORMAT_FONT;
+	font = (FontArrayHeader *)(info + 1);
+	font->num_entries = 0;
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV, "Font with no glyphs");
+	font->num_entries = 1;
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV,
+		"Font glyph past end of font");
+	info->original_size = sizeof(FontArrayHeader) +
+		sizeof(FontArrayEntryHeader);
+	gbb->bmpfv_size = info_offset + sizeof(ImageInfo) +
+		info->original_size;
+	TEST_EQ(ShowScreen(), VBERROR_SUCCESS, "Font");
+
+	/* Localizations past the end of the block */
+	bhdr->number_of_localizations = 256;
+	bhdr->number_of_screenlayouts = 0x01000000;
+	VbNvSet(&vnc, VBNV_LOCALIZATION_INDEX, 255);
+	TEST_EQ(ShowScreen(), VBERROR_INVALID_BMPFV,
+		"Localization past end of bmpfv");
+}
+
 /* Test display key checking */
 static void DisplayKeyTest(void)
 {
@@ -228,6 +294,7 @@ int main(void)
 {
 	DebugInfoTest();
 	LocalizationTest();
+	ScreenFromGBBTest();
 	DisplayKeyTest();
 	FontTest();
 
@@ -117,6 +117,11 @@ RSAPublicKey* PublicKeyToRSA(const VbPublicKey* key) {
   return &data_key;
 }
 
+RSAPublicKey* PublicKeyToRSAView(const VbPublicKey* key,
+                                 RSAPublicKey* storage) {
+  return PublicKeyToRSA(key);
+}
+
 void RSAPublicKeyFree(RSAPublicKey* key) {
   TEST_PTR_EQ(key, &data_key, "  RSA data key");
   data_key.len--;
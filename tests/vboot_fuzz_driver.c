@@ -0,0 +1,647 @@
+/* Copyright (c) 2013 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * In-process fuzzing driver for the firmware parsers.  Each target takes one
+ * input buffer and feeds it to a parser; the driver replays a seed corpus
+ * through a target, then runs mutated copies of it, all in one process.
+ *
+ * This is linked with a build of the RSA code which accepts any signature of
+ * the right size (see rsa.c), so don't use it to check signatures.
+ *
+ * The same targets can be built for other fuzzers:
+ *   - with -DVBOOT_LIBFUZZER, this file provides LLVMFuzzerTestOneInput()
+ *     instead of main(), for the target named by $VBOOT_FUZZ_TARGET.
+ *   - built with afl-clang-fast, main() runs the target in AFL's persistent
+ *     mode on inputs from stdin.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bmpblk_header.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gbb_header.h"
+#include "gpt.h"
+#include "host_common.h"
+#include "mtdlib.h"
+#include "vboot_common.h"
+#include "vboot_display.h"
+#include "vboot_nvstorage.h"
+
+/* Largest input fed to a target; anything longer is truncated */
+#define DEFAULT_MAX_LEN (256 * 1024)
+
+/* Disk used by the GPT target; inputs are images of its first sectors */
+#define GPT_DRIVE_SECTORS 128
+#define GPT_SECTOR_BYTES 512
+
+/* Flash geometry used by the MTD target */
+#define MTD_DRIVE_SECTORS 8192
+
+/*
+ * Inputs to the GPT and MTD targets start with a flags byte; for GPT it's the
+ * first byte of the protective MBR, which cgptlib ignores.  If this bit is
+ * set, the target fixes up the CRCs before parsing, so mutations get past the
+ * CRC checks to the rest of the parser.
+ */
+#define FUZZ_FIX_CRC 0x01
+
+typedef struct FuzzTarget {
+	const char *name;
+	/* Parse [size] bytes of [data]; returns 0 if the parser accepted it */
+	int (*run)(const uint8_t *data, size_t size);
+} FuzzTarget;
+
+/* Key used to check key block signatures, if any */
+static VbPublicKey *keyblock_key;
+
+/* Aligned copy of the current input */
+static uint64_t input_buf[DEFAULT_MAX_LEN / sizeof(uint64_t)];
+
+static const uint8_t *CopyInput(const uint8_t *data, size_t *size)
+{
+	if (*size > sizeof(input_buf))
+		*size = sizeof(input_buf);
+	memcpy(input_buf, data, *size);
+	return (const uint8_t *)input_buf;
+}
+
+static int FuzzKeyBlock(const uint8_t *data, size_t size)
+{
+	const VbKeyBlockHeader *block;
+	int rv;
+
+	block = (const VbKeyBlockHeader *)CopyInput(data, &size);
+	rv = KeyBlockVerify(block, size, NULL, 1);
+	if (keyblock_key)
+		rv = KeyBlockVerify(block, size, keyblock_key, 0);
+	return rv;
+}
+
+/*
+ * Check the key block at the start of [data] (by hash only, so inputs don't
+ * need a real signature), and return a view of its data key in [storage].
+ * Returns the key, or NULL if error.  [size] is set to the bytes which follow
+ * the key block.
+ */
+static RSAPublicKey *ParseKeyBlock(const uint8_t *data, size_t *size,
+				   RSAPublicKey *storage)
+{
+	const VbKeyBlockHeader *block = (const VbKeyBlockHeader *)data;
+
+	if (KeyBlockVerify(block, *size, NULL, 1))
+		return NULL;
+	*size -= block->key_block_size;
+	return PublicKeyToRSAView(&block->data_key, storage);
+}
+
+static int FuzzFirmwarePreamble(const uint8_t *data, size_t size)
+{
+	const VbKeyBlockHeader *block;
+	RSAPublicKey storage, *key;
+	int rv;
+
+	data = CopyInput(data, &size);
+	key = ParseKeyBlock(data, &size, &storage);
+	if (!key)
+		return 1;
+	block = (const VbKeyBlockHeader *)data;
+	rv = VerifyFirmwarePreamble((const VbFirmwarePreambleHeader *)
+				    (data + block->key_block_size), size, key);
+	RSAPublicKeyFree(key);
+	return rv;
+}
+
+static int FuzzKernelPreamble(const uint8_t *data, size_t size)
+{
+	const VbKeyBlockHeader *block;
+	RSAPublicKey storage, *key;
+	int rv;
+
+	data = CopyInput(data, &size);
+	key = ParseKeyBlock(data, &size, &storage);
+	if (!key)
+		return 1;
+	block = (const VbKeyBlockHeader *)data;
+	rv = VerifyKernelPreamble((const VbKernelPreambleHeader *)
+				  (data + block->key_block_size), size, key);
+	RSAPublicKeyFree(key);
+	return rv;
+}
+
+static void FixGptCrcs(uint8_t *header, uint8_t *entries)
+{
+	GptHeader *h = (GptHeader *)header;
+
+	h->entries_crc32 = Crc32(entries, TOTAL_ENTRIES_SIZE);
+	if (h->size >= MIN_SIZE_OF_HEADER && h->size <= MAX_SIZE_OF_HEADER)
+		h->header_crc32 = HeaderCrc(h);
+}
+
+static int FuzzGpt(const uint8_t *data, size_t size)
+{
+	static uint8_t disk[GPT_DRIVE_SECTORS * GPT_SECTOR_BYTES];
+	GptData gpt;
+	uint64_t start, sectors;
+	int rv;
+
+	if (size > sizeof(disk))
+		size = sizeof(disk);
+	memcpy(disk, data, size);
+	memset(disk + size, 0, sizeof(disk) - size);
+
+	Memset(&gpt, 0, sizeof(gpt));
+	gpt.sector_bytes = GPT_SECTOR_BYTES;
+	gpt.drive_sectors = GPT_DRIVE_SECTORS;
+	gpt.primary_header = disk + GPT_SECTOR_BYTES;
+	gpt.primary_entries = disk + 2 * GPT_SECTOR_BYTES;
+	gpt.secondary_header = disk +
+		(GPT_DRIVE_SECTORS - 1) * GPT_SECTOR_BYTES;
+	gpt.secondary_entries = gpt.secondary_header -
+		GPT_ENTRIES_SECTORS * GPT_SECTOR_BYTES;
+	if (size && (data[0] & FUZZ_FIX_CRC)) {
+		FixGptCrcs(gpt.primary_header, gpt.primary_entries);
+		FixGptCrcs(gpt.secondary_header, gpt.secondary_entries);
+	}
+
+	/* GptInit() does GptSanityCheck() and repairs what it can */
+	rv = GptInit(&gpt);
+	if (rv != GPT_SUCCESS)
+		return rv;
+
+	/* Try each kernel in turn, using up tries */
+	while (GptNextKernelEntry(&gpt, &start, &sectors) == GPT_SUCCESS)
+		GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_TRY);
+	GptFree(&gpt);
+	return 0;
+}
+
+static int FuzzMtd(const uint8_t *data, size_t size)
+{
+	MtdData mtd;
+	uint64_t start, sectors;
+	int rv;
+
+	Memset(&mtd, 0, sizeof(mtd));
+	mtd.sector_bytes = 512;
+	mtd.drive_sectors = MTD_DRIVE_SECTORS;
+	mtd.flash_page_bytes = 8 * 512;
+	mtd.flash_block_bytes = 64 * 512;
+	mtd.fts_block_offset = 1;
+	mtd.fts_block_size = 1;
+	if (size > 1)
+		memcpy(&mtd.primary, data + 1,
+		       size - 1 < sizeof(mtd.primary) ?
+		       size - 1 : sizeof(mtd.primary));
+	if (size && (data[0] & FUZZ_FIX_CRC) &&
+	    mtd.primary.size <= sizeof(mtd.primary))
+		mtd.primary.crc32 = MtdHeaderCrc(&mtd.primary);
+
+	/* MtdInit() does MtdSanityCheck() */
+	rv = MtdInit(&mtd);
+	if (rv != GPT_SUCCESS)
+		return rv;
+
+	while (MtdNextKernelEntry(&mtd, &start, &sectors) == GPT_SUCCESS)
+		MtdUpdateKernelEntry(&mtd, GPT_UPDATE_ENTRY_TRY);
+	MtdFree(&mtd);
+	return 0;
+}
+
+static int FuzzBmpBlock(const uint8_t *data, size_t size)
+{
+	static const uint32_t screens[] = {
+		VB_SCREEN_DEVELOPER_WARNING,
+		VB_SCREEN_RECOVERY_REMOVE,
+		VB_SCREEN_RECOVERY_NO_GOOD,
+		VB_SCREEN_RECOVERY_INSERT,
+		VB_SCREEN_RECOVERY_TO_DEV,
+		VB_SCREEN_DEVELOPER_TO_NORM,
+		VB_SCREEN_WAIT,
+		VB_SCREEN_TO_NORM_CONFIRMED,
+	};
+	/* The bitmap block goes in a GBB, after the header and HWID */
+	static uint64_t gbb_buf[(sizeof(GoogleBinaryBlockHeader) + 64 +
+				 DEFAULT_MAX_LEN) / sizeof(uint64_t)];
+	GoogleBinaryBlockHeader *gbb = (GoogleBinaryBlockHeader *)gbb_buf;
+	uint32_t bmpfv_offset = sizeof(GoogleBinaryBlockHeader) + 64;
+	VbCommonParams cparams;
+	VbNvContext vnc;
+	uint32_t count = 0, loc;
+	int rv = 1;
+	int i;
+
+	if (size > DEFAULT_MAX_LEN)
+		size = DEFAULT_MAX_LEN;
+	Memset(gbb, 0, bmpfv_offset);
+	Memcpy(gbb->signature, GBB_SIGNATURE, GBB_SIGNATURE_SIZE);
+	gbb->major_version = GBB_MAJOR_VER;
+	gbb->minor_version = GBB_MINOR_VER;
+	gbb->header_size = GBB_HEADER_SIZE;
+	gbb->hwid_offset = sizeof(GoogleBinaryBlockHeader);
+	gbb->hwid_size = 64;
+	strcpy((char *)gbb + gbb->hwid_offset, "FUZZ HWID");
+	gbb->bmpfv_offset = bmpfv_offset;
+	gbb->bmpfv_size = size;
+	memcpy((uint8_t *)gbb + bmpfv_offset, data, size);
+
+	Memset(&cparams, 0, sizeof(cparams));
+	cparams.gbb_data = gbb;
+	cparams.gbb_size = bmpfv_offset + size;
+	Memset(&vnc, 0, sizeof(vnc));
+	VbNvSetup(&vnc);
+
+	if (VbGetLocalizationCount(&cparams, &count))
+		return 1;
+
+	/* Only the first few localizations; they're all parsed the same */
+	for (loc = 0; loc < count && loc < 4; loc++) {
+		VbNvSet(&vnc, VBNV_LOCALIZATION_INDEX, loc);
+		for (i = 0; i < ARRAY_SIZE(screens); i++) {
+			VbDisplayFreeBmpfv();
+			if (!VbDisplayScreenFromGBB(&cparams, screens[i], &vnc))
+				rv = 0;
+		}
+	}
+	VbDisplayFreeBmpfv();
+	return rv;
+}
+
+static const FuzzTarget targets[] = {
+	{"keyblock", FuzzKeyBlock},
+	{"fw_preamble", FuzzFirmwarePreamble},
+	{"kernel_preamble", FuzzKernelPreamble},
+	{"gpt", FuzzGpt},
+	{"mtd", FuzzMtd},
+	{"bmpblock", FuzzBmpBlock},
+};
+
+static const FuzzTarget *FindTarget(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(targets); i++) {
+		if (!strcmp(targets[i].name, name))
+			return &targets[i];
+	}
+	return NULL;
+}
+
+#ifdef VBOOT_LIBFUZZER
+
+static const FuzzTarget *libfuzzer_target;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	const char *name = getenv("VBOOT_FUZZ_TARGET");
+
+	libfuzzer_target = name ? FindTarget(name) : NULL;
+	if (!libfuzzer_target) {
+		fprintf(stderr, "Set VBOOT_FUZZ_TARGET to a fuzz target\n");
+		exit(1);
+	}
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	libfuzzer_target->run(data, size);
+	return 0;
+}
+
+#else  /* !VBOOT_LIBFUZZER */
+
+typedef struct Input {
+	uint8_t *data;
+	size_t size;
+} Input;
+
+static Input *corpus;
+static int corpus_count;
+static size_t max_len = DEFAULT_MAX_LEN;
+
+/* Input being run, written out if it crashes the target */
+static const uint8_t *current_data;
+static size_t current_size;
+static const char *crash_file = "vboot_fuzz_crash";
+
+static void AddInput(const char *filename)
+{
+	uint64_t size;
+	uint8_t *data = ReadFile(filename, &size);
+
+	if (!data)
+		return;
+	if (size > max_len)
+		size = max_len;
+	corpus = realloc(corpus, (corpus_count + 1) * sizeof(*corpus));
+	if (!corpus) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	corpus[corpus_count].data = data;
+	corpus[corpus_count].size = size;
+	corpus_count++;
+}
+
+/* Add a file, or all the files in a directory, to the corpus */
+static void AddInputs(const char *path)
+{
+	char filename[PATH_MAX];
+	struct dirent *ent;
+	struct stat sb;
+	DIR *dir;
+
+	if (stat(path, &sb)) {
+		perror(path);
+		exit(1);
+	}
+	if (!S_ISDIR(sb.st_mode)) {
+		AddInput(path);
+		return;
+	}
+
+	dir = opendir(path);
+	if (!dir) {
+		perror(path);
+		exit(1);
+	}
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(filename, sizeof(filename), "%s/%s", path,
+			 ent->d_name);
+		if (!stat(filename, &sb) && S_ISREG(sb.st_mode))
+			AddInput(filename);
+	}
+	closedir(dir);
+}
+
+static void CrashHandler(int sig)
+{
+	int fd;
+
+	fd = open(crash_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd >= 0) {
+		if (write(fd, current_data, current_size) !=
+		    (ssize_t)current_size) {
+			/* Nothing more we can do about it here */
+		}
+		close(fd);
+	}
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void RunInput(const FuzzTarget *target, const uint8_t *data,
+		     size_t size)
+{
+	current_data = data;
+	current_size = size;
+	target->run(data, size);
+}
+
+/* xorshift64*; deterministic so runs can be repeated with --seed */
+static uint64_t rng_state;
+
+static uint32_t Rand(uint32_t limit)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return limit ? (uint32_t)((rng_state * 2685821657736338717ULL) >> 32)
+		% limit : 0;
+}
+
+/*
+ * Mutate [buf], which holds [size] bytes of data and has room for [max_len].
+ * Returns the new size.
+ */
+static size_t Mutate(uint8_t *buf, size_t size)
+{
+	static const uint32_t interesting[] = {
+		0, 1, 0x7f, 0x80, 0xff, 0x100, 0x7fff, 0x8000, 0xffff,
+		0x10000, 0x7fffffff, 0x80000000, 0xffffffff,
+	};
+	const Input *other;
+	uint32_t value;
+	size_t pos, len, from;
+	int n = 1 + Rand(4);
+
+	while (n--) {
+		if (!size) {
+			buf[0] = Rand(256);
+			size = 1;
+			continue;
+		}
+		pos = Rand(size);
+		switch (Rand(8)) {
+		case 0:		/* Flip a bit */
+			buf[pos] ^= 1 << Rand(8);
+			break;
+		case 1:		/* Random byte */
+			buf[pos] = Rand(256);
+			break;
+		case 2:		/* Interesting little-endian word */
+			value = interesting[Rand(ARRAY_SIZE(interesting))];
+			pos &= ~3;
+			for (len = 0; len < 4 && pos + len < size; len++)
+				buf[pos + len] = value >> (8 * len);
+			break;
+		case 3:		/* Add or subtract a little */
+			pos &= ~3;
+			if (pos + 4 > size)
+				break;
+			memcpy(&value, buf + pos, 4);
+			value += Rand(33) - 16;
+			memcpy(buf + pos, &value, 4);
+			break;
+		case 4:		/* Copy a chunk over another */
+			from = Rand(size);
+			len = Rand(size - (pos > from ? pos : from)) + 1;
+			memmove(buf + pos, buf + from, len);
+			break;
+		case 5:		/* Truncate */
+			size = pos;
+			break;
+		case 6:		/* Extend */
+			len = Rand(max_len - size + 1);
+			memset(buf + size, Rand(256), len);
+			size += len;
+			break;
+		case 7:		/* Splice in another input */
+			other = &corpus[Rand(corpus_count)];
+			if (other->size <= pos)
+				break;
+			len = other->size - pos;
+			from = Rand(max_len - pos) + 1;
+			if (len > from)
+				len = from;
+			memcpy(buf + pos, other->data + pos, len);
+			if (size < pos + len)
+				size = pos + len;
+			break;
+		}
+	}
+	return size;
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void PrintHelp(const char *progname)
+{
+	int i;
+
+	fprintf(stderr,
+		"Usage: %s TARGET [options] [FILE | DIR]...\n"
+		"\n"
+		"Runs the inputs in the files and directories through the "
+		"parser TARGET,\n"
+		"then runs mutated copies of them.\n"
+		"\n"
+		"Options:\n"
+		"  --runs NUM       Mutated inputs to run (default 0)\n"
+		"  --seed NUM       Random seed (default 1)\n"
+		"  --max_len NUM    Maximum input size (default %d)\n"
+		"  --key FILE       Public key to check key block "
+		"signatures with\n"
+		"  --crash FILE     Where to write an input which crashes\n"
+		"                     (default %s)\n"
+		"\n"
+		"Targets:\n", progname, DEFAULT_MAX_LEN, crash_file);
+	for (i = 0; i < ARRAY_SIZE(targets); i++)
+		fprintf(stderr, "  %s\n", targets[i].name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_opts[] = {
+		{"runs", 1, 0, 'r'},
+		{"seed", 1, 0, 's'},
+		{"max_len", 1, 0, 'm'},
+		{"key", 1, 0, 'k'},
+		{"crash", 1, 0, 'c'},
+		{NULL, 0, 0, 0}
+	};
+	const FuzzTarget *target;
+	uint64_t runs = 0, execs = 0, r;
+	uint8_t *buf;
+	size_t size;
+	double start, secs;
+	char *e;
+	int i;
+
+	rng_state = 1;
+	while ((i = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (i) {
+		case 'r':
+			runs = strtoull(optarg, &e, 0);
+			if (!*optarg || *e) {
+				fprintf(stderr, "Bad --runs\n");
+				return 1;
+			}
+			break;
+		case 's':
+			rng_state = strtoull(optarg, &e, 0) | 1;
+			if (!*optarg || *e) {
+				fprintf(stderr, "Bad --seed\n");
+				return 1;
+			}
+			break;
+		case 'm':
+			max_len = strtoull(optarg, &e, 0);
+			if (!*optarg || *e || !max_len ||
+			    max_len > DEFAULT_MAX_LEN) {
+				fprintf(stderr, "Bad --max_len\n");
+				return 1;
+			}
+			break;
+		case 'k':
+			keyblock_key = PublicKeyRead(optarg);
+			if (!keyblock_key) {
+				fprintf(stderr, "Can't read key %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'c':
+			crash_file = optarg;
+			break;
+		default:
+			PrintHelp(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc || !(target = FindTarget(argv[optind]))) {
+		PrintHelp(argv[0]);
+		return 1;
+	}
+
+	signal(SIGSEGV, CrashHandler);
+	signal(SIGBUS, CrashHandler);
+	signal(SIGABRT, CrashHandler);
+	signal(SIGFPE, CrashHandler);
+
+	buf = malloc(DEFAULT_MAX_LEN);
+	if (!buf) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+	/* AFL's persistent mode: run each input AFL hands us on stdin */
+	while (__AFL_LOOP(10000)) {
+		ssize_t n = read(0, buf, max_len);
+		if (n >= 0)
+			RunInput(target, buf, n);
+	}
+	return 0;
+#endif
+
+	for (i = optind + 1; i < argc; i++)
+		AddInputs(argv[i]);
+	if (!corpus_count) {
+		/* Start from an empty input */
+		static Input empty;
+
+		corpus = &empty;
+		corpus_count = 1;
+	}
+
+	start = Now();
+	for (i = 0; i < corpus_count; i++, execs++)
+		RunInput(target, corpus[i].data, corpus[i].size);
+	for (r = 0; r < runs; r++, execs++) {
+		const Input *in = &corpus[Rand(corpus_count)];
+
+		if (in->size)
+			memcpy(buf, in->data, in->size);
+		size = Mutate(buf, in->size);
+		RunInput(target, buf, size);
+	}
+	secs = Now() - start;
+
+	printf("%s: %d inputs, %llu execs in %.2f s (%.0f execs/sec)\n",
+	       target->name, corpus_count, (unsigned long long)execs, secs,
+	       secs > 0 ? execs / secs : 0.0);
+	return 0;
+}
+
+#endif  /* VBOOT_LIBFUZZER */
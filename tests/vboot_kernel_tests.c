@@ -5,12 +5,14 @@
  * Tests for vboot_kernel.c
  */
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cgptlib.h"
+#include "cgptlib_internal.h"
 #include "gbb_header.h"
 #include "gpt.h"
 #include "host_common.h"
@@ -39,13 +41,19 @@ static int mock_part_next;
 static char call_log[4096];
 static uint8_t kernel_buffer[80000];
 static int disk_read_to_fail;
+static int disk_async_supported;
+static int disk_async_pending;
+static int disk_async_wait_fail;
 static int disk_write_to_fail;
 static int gpt_init_fail;
 static int key_block_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
 static RSAPublicKey *mock_data_key;
+static RSAPublicKey mock_data_key_data;
 static int mock_data_key_allocated;
+static int mock_parallel;  /* Mocks may be called from several threads */
+static pthread_mutex_t mock_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static GoogleBinaryBlockHeader gbb;
 static VbExDiskHandle_t handle;
@@ -70,14 +78,20 @@ static void ResetMocks(void)
 
 	disk_read_to_fail = -1;
 	disk_write_to_fail = -1;
+	disk_async_supported = 0;
+	disk_async_pending = 0;
+	disk_async_wait_fail = 0;
 
 	gpt_init_fail = 0;
 	key_block_verify_fail = 0;
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
 
-	mock_data_key = (RSAPublicKey *)"TestDataKey";
+	memset(&mock_data_key_data, 0, sizeof(mock_data_key_data));
+	mock_data_key_data.algorithm = 4;  /* RSA2048 SHA256 */
+	mock_data_key = &mock_data_key_data;
 	mock_data_key_allocated = 0;
+	mock_parallel = 0;
 
 	memset(&gbb, 0, sizeof(gbb));
 	gbb.major_version = GBB_MAJOR_VER;
@@ -124,7 +138,9 @@ static void ResetMocks(void)
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
                        uint64_t lba_count, void *buffer)
 {
+	pthread_mutex_lock(&mock_lock);
 	LOGCALL("VbExDiskRead(h, %d, %d)\n", (int)lba_start, (int)lba_count);
+	pthread_mutex_unlock(&mock_lock);
 
 	if ((int)lba_start == disk_read_to_fail)
 		return VBERROR_SIMULATED;
@@ -132,6 +148,35 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 	return VBERROR_SUCCESS;
 }
 
+VbError_t VbExDiskReadAsync(VbExDiskHandle_t handle, uint64_t lba_start,
+			    uint64_t lba_count, void *buffer)
+{
+	if (!disk_async_supported)
+		return VBERROR_NO_ASYNC_DISK_READ;
+
+	LOGCALL("VbExDiskReadAsync(h, %d, %d)\n", (int)lba_start,
+		(int)lba_count);
+	TEST_EQ(disk_async_pending, 0, "  no async read pending");
+	disk_async_pending = 1;
+
+	if ((int)lba_start == disk_read_to_fail)
+		return VBERROR_SIMULATED;
+
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskReadWait(VbExDiskHandle_t handle)
+{
+	LOGCALL("VbExDiskReadWait(h)\n");
+	TEST_EQ(disk_async_pending, 1, "  async read pending");
+	disk_async_pending = 0;
+
+	if (disk_async_wait_fail)
+		return VBERROR_SIMULATED;
+
+	return VBERROR_SUCCESS;
+}
+
 VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 			uint64_t lba_count, const void *buffer)
 {
@@ -145,20 +190,23 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 
 int GptInit(GptData *gpt)
 {
+	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	return gpt_init_fail;
 }
 
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 {
-	struct mock_part *p = mock_parts + mock_part_next;
+	int next = gpt->current_kernel + 1;
+	struct mock_part *p = mock_parts + next;
 
 	if (!p->size)
 		return GPT_ERROR_NO_VALID_KERNEL;
 
-	gpt->current_kernel = mock_part_next;
+	gpt->current_kernel = next;
 	*start_sector = p->start;
 	*size = p->size;
-	mock_part_next++;
+	if (mock_part_next < next + 1)
+		mock_part_next = next + 1;
 	return GPT_SUCCESS;
 }
 
@@ -184,19 +232,34 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 
 RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
 {
-	TEST_EQ(mock_data_key_allocated, 0, "  mock data key not allocated");
+	pthread_mutex_lock(&mock_lock);
+	if (!mock_parallel)
+		TEST_EQ(mock_data_key_allocated, 0,
+			"  mock data key not allocated");
 
 	if (mock_data_key)
 		mock_data_key_allocated++;
+	pthread_mutex_unlock(&mock_lock);
 
 	return mock_data_key;
 }
 
+RSAPublicKey *PublicKeyToRSAView(const VbPublicKey *key,
+				 RSAPublicKey *storage)
+{
+	return PublicKeyToRSA(key);
+}
+
 void RSAPublicKeyFree(RSAPublicKey* key)
 {
-	TEST_EQ(mock_data_key_allocated, 1, "  mock data key allocated");
-	TEST_PTR_EQ(key, mock_data_key, "  data key ptr");
+	pthread_mutex_lock(&mock_lock);
+	if (!mock_parallel) {
+		TEST_EQ(mock_data_key_allocated, 1,
+			"  mock data key allocated");
+		TEST_PTR_EQ(key, mock_data_key, "  data key ptr");
+	}
 	mock_data_key_allocated--;
+	pthread_mutex_unlock(&mock_lock);
 }
 
 int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
@@ -210,8 +273,8 @@ int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 	return VBERROR_SUCCESS;
 }
 
-int VerifyData(const uint8_t *data, uint64_t size, const VbSignature *sig,
-	       const RSAPublicKey *key)
+int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
+		 const RSAPublicKey *key)
 {
 	if (verify_data_fail)
 		return VBERROR_SIMULATED;
@@ -233,13 +296,16 @@ static void ReadWriteGptTest(void)
 
 	ResetMocks();
 	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 2, 32)\n"
-		   "VbExDiskRead(h, 991, 32)\n"
-		   "VbExDiskRead(h, 1023, 1)\n");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
+	TEST_PTR_EQ(g.primary_entries, g.primary_header + 512,
+		    "Primary entries follow header");
+	TEST_PTR_EQ(g.secondary_header, g.secondary_entries + 16384,
+		    "Secondary header follows entries");
 	ResetCallLog();
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree");
 	TEST_CALLS("");
+	TEST_PTR_EQ(g.primary_header, NULL, "WriteAndFree clears pointers");
 
 	/* Data which is changed is written */
 	ResetMocks();
@@ -247,8 +313,7 @@ static void ReadWriteGptTest(void)
 	g.modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1;
 	ResetCallLog();
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree mod 1");
-	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
-		   "VbExDiskWrite(h, 2, 32)\n");
+	TEST_CALLS("VbExDiskWrite(h, 1, 33)\n");
 
 	/* Data which is changed is written */
 	ResetMocks();
@@ -256,11 +321,26 @@ static void ReadWriteGptTest(void)
 	g.modified = -1;
 	ResetCallLog();
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree mod all");
+	TEST_CALLS("VbExDiskWrite(h, 1, 33)\n"
+		   "VbExDiskWrite(h, 991, 33)\n");
+
+	/* Only the parts which changed are written */
+	ResetMocks();
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_HEADER1 | GPT_MODIFIED_HEADER2;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree headers");
 	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
-		   "VbExDiskWrite(h, 2, 32)\n"
-		   "VbExDiskWrite(h, 991, 32)\n"
 		   "VbExDiskWrite(h, 1023, 1)\n");
 
+	ResetMocks();
+	AllocAndReadGptData(handle, &g);
+	g.modified = GPT_MODIFIED_ENTRIES1 | GPT_MODIFIED_ENTRIES2;
+	ResetCallLog();
+	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree entries");
+	TEST_CALLS("VbExDiskWrite(h, 2, 32)\n"
+		   "VbExDiskWrite(h, 991, 32)\n");
+
 	/* If legacy signature, don't modify GPT header/entries 1 */
 	ResetMocks();
 	AllocAndReadGptData(handle, &g);
@@ -269,8 +349,7 @@ static void ReadWriteGptTest(void)
 	g.modified = -1;
 	ResetCallLog();
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree mod all");
-	TEST_CALLS("VbExDiskWrite(h, 991, 32)\n"
-		   "VbExDiskWrite(h, 1023, 1)\n");
+	TEST_CALLS("VbExDiskWrite(h, 991, 33)\n");
 
 	/* Error reading */
 	ResetMocks();
@@ -278,32 +357,25 @@ static void ReadWriteGptTest(void)
 	TEST_NEQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead disk fail");
 	WriteAndFreeGptData(handle, &g);
 
-	ResetMocks();
-	disk_read_to_fail = 2;
-	TEST_NEQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead disk fail");
-	WriteAndFreeGptData(handle, &g);
-
 	ResetMocks();
 	disk_read_to_fail = 991;
 	TEST_NEQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead disk fail");
 	WriteAndFreeGptData(handle, &g);
 
-	ResetMocks();
-	disk_read_to_fail = 1023;
-	TEST_NEQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead disk fail");
-	WriteAndFreeGptData(handle, &g);
-
 	/* Error writing */
 	ResetMocks();
 	disk_write_to_fail = 1;
 	AllocAndReadGptData(handle, &g);
+	memset(g.primary_header, 0, 512);  /* Not legacy */
 	g.modified = -1;
 	TEST_NEQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree disk fail");
+	TEST_PTR_EQ(g.primary_header, NULL, "WriteAndFree fail still frees");
 
 	ResetMocks();
 	disk_write_to_fail = 2;
 	AllocAndReadGptData(handle, &g);
-	g.modified = -1;
+	memset(g.primary_header, 0, 512);  /* Not legacy */
+	g.modified = GPT_MODIFIED_ENTRIES1;
 	TEST_NEQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree disk fail");
 
 	ResetMocks();
@@ -315,9 +387,8 @@ static void ReadWriteGptTest(void)
 	ResetMocks();
 	disk_write_to_fail = 1023;
 	AllocAndReadGptData(handle, &g);
-	g.modified = -1;
+	g.modified = GPT_MODIFIED_HEADER2;
 	TEST_NEQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree disk fail");
-
 }
 
 /**
@@ -529,11 +600,181 @@ static void LoadKernelTest(void)
 	TEST_EQ(LoadKernel(&lkp), VBERROR_INVALID_KERNEL_FOUND,	"Bad data");
 }
 
+/**
+ * Test reading the kernel body in chunks
+ */
+static void LoadKernelBodyTest(void)
+{
+	/* Without async reads, a small body is read in one go */
+	ResetMocks();
+	TEST_EQ(LoadKernel(&lkp), 0, "Sync body read");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n"
+		   "VbExDiskRead(h, 100, 128)\n"
+		   "VbExDiskRead(h, 108, 137)\n");
+
+	/* Async reads overlap the next read with hashing */
+	ResetMocks();
+	disk_async_supported = 1;
+	kph.body_signature.data_size = 300 * 1024;
+	mock_parts[0].size = 1000;
+	lkp.kernel_buffer = NULL;
+	kph.body_load_address = (size_t)VbExMalloc(300 * 1024);
+	ResetCallLog();
+	TEST_EQ(LoadKernel(&lkp), 0, "Async body read");
+	TEST_EQ(disk_async_pending, 0, "  no read left pending");
+	TEST_EQ(strstr(call_log, "VbExDiskReadAsync(h, 108, 512)\n"
+		       "VbExDiskReadWait(h)\n"
+		       "VbExDiskReadAsync(h, 620, 88)\n"
+		       "VbExDiskReadWait(h)\n") != NULL, 1,
+		"  calls");
+	VbExFree((void *)(size_t)kph.body_load_address);
+
+	ResetMocks();
+	disk_async_supported = 1;
+	disk_read_to_fail = 108;
+	TEST_EQ(LoadKernel(&lkp), VBERROR_INVALID_KERNEL_FOUND,
+		"Fail starting async read");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_DATA, "  check result");
+
+	ResetMocks();
+	disk_async_supported = 1;
+	disk_async_wait_fail = 1;
+	TEST_EQ(LoadKernel(&lkp), VBERROR_INVALID_KERNEL_FOUND,
+		"Fail waiting for async read");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_READ_DATA, "  check result");
+}
+
+/* Results of a LoadKernel() call which must not depend on threading */
+struct lk_result {
+	VbError_t retval;
+	uint64_t partition_number;
+	uint32_t kernel_version_tpm;
+	uint32_t kernel_version_lowest;
+	uint8_t check_result[MOCK_PART_COUNT];
+	uint32_t combined_version[MOCK_PART_COUNT];
+};
+
+/**
+ * Run LoadKernel() with [threads] header check threads on the mock setup
+ * [setup] and record the results.
+ */
+static void RunLoadKernel(void (*setup)(void), uint32_t threads,
+			  struct lk_result *r)
+{
+	int i;
+
+	ResetMocks();
+	setup();
+	mock_parallel = (threads > 1);
+	lkp.header_check_threads = threads;
+	memset(r, 0, sizeof(*r));
+	r->retval = LoadKernel(&lkp);
+	r->partition_number = lkp.partition_number;
+	r->kernel_version_tpm = shared->kernel_version_tpm;
+	r->kernel_version_lowest = shared->kernel_version_lowest;
+	for (i = 0; i < MOCK_PART_COUNT &&
+		     i < shared->lk_calls[0].kernel_parts_found; i++) {
+		r->check_result[i] = shared->lk_calls[0].parts[i].check_result;
+		r->combined_version[i] =
+			shared->lk_calls[0].parts[i].combined_version;
+	}
+	TEST_EQ(mock_data_key_allocated, 0, "  data keys freed");
+}
+
+static void SetupMultiPart(void)
+{
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		mock_parts[i].start = 100 + 150 * i;
+		mock_parts[i].size = 150;
+	}
+}
+
+static void SetupRollForward(void)
+{
+	SetupMultiPart();
+	kbh.data_key.key_version = 3;
+}
+
+static void SetupBadReads(void)
+{
+	SetupRollForward();
+	disk_read_to_fail = 250;  /* Start of second partition */
+	mock_parts[2].size = 10;  /* Too small */
+}
+
+static void SetupBadPreamble(void)
+{
+	SetupMultiPart();
+	preamble_verify_fail = 1;
+}
+
+static void SetupDevSelfSigned(void)
+{
+	SetupRollForward();
+	lkp.boot_flags |= BOOT_FLAG_DEVELOPER;
+	key_block_verify_fail = 1;
+}
+
+static void SetupDevBadHash(void)
+{
+	SetupMultiPart();
+	lkp.boot_flags |= BOOT_FLAG_DEVELOPER;
+	key_block_verify_fail = 2;
+}
+
+static void SetupRecovery(void)
+{
+	SetupMultiPart();
+	lkp.boot_flags |= BOOT_FLAG_RECOVERY;
+	kbh.key_block_flags =
+		KEY_BLOCK_FLAG_RECOVERY_1 | KEY_BLOCK_FLAG_DEVELOPER_0;
+}
+
+/**
+ * Test checking kernel headers on a pool of threads gives the same results
+ */
+static void ParallelCheckTest(void)
+{
+	static void (*const setups[])(void) = {
+		SetupMultiPart, SetupRollForward, SetupBadReads,
+		SetupBadPreamble, SetupDevSelfSigned, SetupDevBadHash,
+		SetupRecovery,
+	};
+	struct lk_result serial, parallel;
+	char name[64];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(setups); i++) {
+		RunLoadKernel(setups[i], 0, &serial);
+		RunLoadKernel(setups[i], 4, &parallel);
+		sprintf(name, "Parallel header check matches serial %d", i);
+		TEST_EQ(memcmp(&serial, &parallel, sizeof(serial)), 0, name);
+	}
+
+	/* Every partition's headers get read by the precheck */
+	ResetMocks();
+	SetupMultiPart();
+	lkp.header_check_threads = 3;
+	mock_parallel = 1;
+	TEST_EQ(LoadKernel(&lkp), 0, "Parallel first kernel good");
+	TEST_EQ(lkp.partition_number, 1, "  part num");
+	TEST_EQ(mock_part_next, 6, "  found all partitions");
+	TEST_NEQ(strstr(call_log, "VbExDiskRead(h, 850, 128)") != NULL, 0,
+		 "  read last partition");
+}
+
 int main(void)
 {
 	ReadWriteGptTest();
 	InvalidParamsTest();
 	LoadKernelTest();
+	LoadKernelBodyTest();
+	ParallelCheckTest();
 
 	return gTestSuccess ? 0 : 255;
 }
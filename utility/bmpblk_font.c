@@ -11,12 +11,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "bmpblk_font.h"
+#include "host_file.h"
 #include "image_types.h"
 #include "vboot_api.h"
 
@@ -68,52 +68,6 @@ static void HelpAndDie(void) {
 
 //////////////////////////////////////////////////////////////////////////////
 
-// Returns pointer to buffer containing entire file, sets length.
-static void *read_entire_file(const char *filename, size_t *length) {
-  int fd;
-  struct stat sbuf;
-  void *ptr;
-
-  *length = 0;                          // just in case
-
-  if (0 != stat(filename, &sbuf)) {
-    error("Unable to stat %s: %s\n", filename, strerror(errno));
-    return 0;
-  }
-
-  if (!sbuf.st_size) {
-    error("File %s is empty\n", filename);
-    return 0;
-  }
-
-  fd = open(filename, O_RDONLY);
-  if (fd < 0) {
-    error("Unable to open %s: %s\n", filename, strerror(errno));
-    return 0;
-  }
-
-  ptr = mmap(0, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (MAP_FAILED == ptr) {
-    error("Unable to mmap %s: %s\n", filename, strerror(errno));
-    close(fd);
-    return 0;
-  }
-
-  *length = sbuf.st_size;
-
-  close(fd);
-
-  return ptr;
-}
-
-
-// Reclaims buffer from read_entire_file().
-static void discard_file(void *ptr, size_t length) {
-  munmap(ptr, length);
-}
-
-//////////////////////////////////////////////////////////////////////////////
-
 
 
 int main(int argc, char* argv[]) {
@@ -168,6 +122,7 @@ int main(int argc, char* argv[]) {
     char *imgfile = argv[optind+i];
     char *s;
     uint32_t ascii;
+    MappedFile img;
     void *imgdata = 0;
     size_t imgsize, filesize, diff;
 
@@ -177,9 +132,16 @@ int main(int argc, char* argv[]) {
       goto bad1;
     }
 
-    imgdata = read_entire_file(imgfile, &imgsize);
-    if (!imgdata)
+    if (0 != MapFile(imgfile, &img)) {
+      error("Unable to read %s: %s\n", imgfile, strerror(errno));
       goto bad1;
+    }
+    if (!img.size) {
+      error("File %s is empty\n", imgfile);
+      goto bad1;
+    }
+    imgdata = (void *)img.data;
+    imgsize = img.size;
 
     if (FORMAT_BMP != identify_image_type(imgdata, imgsize, &entry.info)) {
       error("%s does not contain a valid BMP image\n", imgfile);
@@ -215,7 +177,7 @@ int main(int argc, char* argv[]) {
     }
 
 
-    discard_file(imgdata, imgsize);
+    UnmapFile(&img);
   }
 
   fclose(ofp);
@@ -10,59 +10,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "bmpblk_util.h"
 #include "eficompress.h"
+#include "host_file.h"
+#include "image_scan.h"
 #include "vboot_api.h"
 
-// Returns pointer to buffer containing entire file, sets length.
-static void *read_entire_file(const char *filename, size_t *length) {
-  int fd;
-  struct stat sbuf;
-  void *ptr;
-
-  *length = 0;                          // just in case
-
-  if (0 != stat(filename, &sbuf)) {
-    fprintf(stderr, "Unable to stat %s: %s\n", filename, strerror(errno));
-    return 0;
-  }
-
-  if (!sbuf.st_size) {
-    fprintf(stderr, "File %s is empty\n", filename);
-    return 0;
-  }
-
-  fd = open(filename, O_RDONLY);
-  if (fd < 0) {
-    fprintf(stderr, "Unable to open %s: %s\n", filename, strerror(errno));
-    return 0;
-  }
-
-  ptr = mmap(0, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (MAP_FAILED == ptr) {
-    fprintf(stderr, "Unable to mmap %s: %s\n", filename, strerror(errno));
-    close(fd);
-    return 0;
-  }
-
-  *length = sbuf.st_size;
-
-  close(fd);
-
-  return ptr;
-}
-
-
-// Reclaims buffer from read_entire_file().
-static void discard_file(void *ptr, size_t length) {
-  munmap(ptr, length);
-}
-
 //////////////////////////////////////////////////////////////////////////////
 
 static int require_dir(const char *dirname) {
@@ -186,9 +143,35 @@ static void *do_lzma_decompress(ImageInfo *img) {
 
 
 
+// Find the first BMPBLOCK header in an image. The signature is short enough
+// to turn up by chance, so only accept it with a version we understand.
+// Returns the offset, or -1 if there isn't one.
+static int64_t find_bmpblock(const uint8_t *data, uint64_t size) {
+  ImageScan scan;
+  const BmpBlockHeader *hdr;
+  int64_t found = -1;
+  size_t i;
+
+  if (0 == ScanImage(data, size, &scan)) {
+    for (i = 0; i < scan.count[IMAGE_SIG_BMPBLOCK]; i++) {
+      uint64_t offset = scan.offsets[IMAGE_SIG_BMPBLOCK][i];
+      if (size - offset < sizeof(BmpBlockHeader))
+        break;
+      hdr = (const BmpBlockHeader *)(data + offset);
+      if (hdr->major_version == BMPBLOCK_MAJOR_VERSION) {
+        found = offset;
+        break;
+      }
+    }
+  }
+  FreeImageScan(&scan);
+  return found;
+}
+
 // Show what's inside. If todir is NULL, just print. Otherwise unpack.
 int dump_bmpblock(const char *infile, int show_as_yaml,
                   const char *todir, int overwrite) {
+  MappedFile file;
   void *ptr, *data_ptr;
   size_t length = 0;
   BmpBlockHeader *hdr;
@@ -205,26 +188,36 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
   FILE *yfp = stdout;
   FILE *bfp = stdout;
 
-  ptr = (void *)read_entire_file(infile, &length);
-  if (!ptr)
+  if (0 != MapFile(infile, &file)) {
+    fprintf(stderr, "Unable to read %s: %s\n", infile, strerror(errno));
     return 1;
+  }
+  ptr = (void *)file.data;
+  length = file.size;
 
   if (length < sizeof(BmpBlockHeader)) {
     fprintf(stderr, "File %s is too small to be a BMPBLOCK\n", infile);
-    discard_file(ptr, length);
+    UnmapFile(&file);
     return 1;
   }
 
+  // The BMPBLOCK is usually the whole file, but it may be inside a GBB or a
+  // whole firmware image.
   if (0 != memcmp(ptr, BMPBLOCK_SIGNATURE, BMPBLOCK_SIGNATURE_SIZE)) {
-    fprintf(stderr, "File %s is not a BMPBLOCK\n", infile);
-    discard_file(ptr, length);
-    return 1;
+    int64_t found = find_bmpblock(file.data, file.size);
+    if (found < 0) {
+      fprintf(stderr, "File %s is not a BMPBLOCK\n", infile);
+      UnmapFile(&file);
+      return 1;
+    }
+    ptr = (uint8_t *)ptr + found;
+    length -= found;
   }
 
   if (todir) {
     // Unpacking everything. Create the output directory if needed.
     if (0 != require_dir(todir)) {
-      discard_file(ptr, length);
+      UnmapFile(&file);
       return 1;
     }
 
@@ -238,7 +231,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
     if (yfd < 0) {
       fprintf(stderr, "Unable to open %s: %s\n", full_path_name,
               strerror(errno));
-      discard_file(ptr, length);
+      UnmapFile(&file);
       return 1;
     }
 
@@ -247,7 +240,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
       fprintf(stderr, "Unable to fdopen %s: %s\n", full_path_name,
               strerror(errno));
       close(yfd);
-      discard_file(ptr, length);
+      UnmapFile(&file);
       return 1;
     }
   }
@@ -260,7 +253,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
     printf("  %d screens\n", hdr->number_of_screenlayouts);
     printf("  %d localizations\n", hdr->number_of_localizations);
     printf("  %d discrete images\n", hdr->number_of_imageinfos);
-    discard_file(ptr, length);
+    UnmapFile(&file);
     return 0;
   }
 
@@ -314,7 +307,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
           fprintf(stderr, "Unable to open %s: %s\n", full_path_name,
                   strerror(errno));
           fclose(yfp);
-          discard_file(ptr, length);
+          UnmapFile(&file);
           return 1;
         }
         bfp = fdopen(bfd, "wb");
@@ -323,7 +316,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
                   strerror(errno));
           close(bfd);
           fclose(yfp);
-          discard_file(ptr, length);
+          UnmapFile(&file);
           return 1;
         }
         switch(img->compression) {
@@ -336,7 +329,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
           if (!data_ptr) {
             fclose(bfp);
             fclose(yfp);
-            discard_file(ptr, length);
+            UnmapFile(&file);
             return 1;
           }
           free_data = 1;
@@ -346,7 +339,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
           if (!data_ptr) {
             fclose(bfp);
             fclose(yfp);
-            discard_file(ptr, length);
+            UnmapFile(&file);
             return 1;
           }
           free_data = 1;
@@ -355,7 +348,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
           fprintf(stderr, "Unsupported compression method encountered.\n");
           fclose(bfp);
           fclose(yfp);
-          discard_file(ptr, length);
+          UnmapFile(&file);
           return 1;
         }
         if (1 != fwrite(data_ptr, img->original_size, 1, bfp)) {
@@ -363,7 +356,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
                   strerror(errno));
           fclose(bfp);
           fclose(yfp);
-          discard_file(ptr, length);
+          UnmapFile(&file);
           return 1;
         }
         fclose(bfp);
@@ -448,7 +441,7 @@ int dump_bmpblock(const char *infile, int show_as_yaml,
   if (todir)
     fclose(yfp);
 
-  discard_file(ptr, length);
+  UnmapFile(&file);
 
   return 0;
 }
@@ -84,6 +84,8 @@ const Param sys_param_list[] = {
   {"vdat_lkdebug", IS_STRING|NO_PRINT_ALL,
    "LoadKernel() debug data (not in print-all)"},
   {"vdat_timers", IS_STRING, "Timer values from VbSharedData"},
+  {"vdat_timestamps", IS_STRING|NO_PRINT_ALL,
+   "Boot event timestamps from VbSharedData (not in print-all)"},
   {"wpsw_boot", 0, "Firmware write protect hardware switch position at boot"},
   {"wpsw_cur", 0, "Firmware write protect hardware switch current position"},
   /* Terminate with null name */
@@ -103,11 +105,15 @@ void PrintHelp(const char *progname) {
          "    Prints the current value(s) of the parameter(s).\n"
          "  %s [param1=value1] [param2=value2 [...]]]\n"
          "    Sets the parameter(s) to the specified value(s).\n"
+         "    NV storage is read and written once for all of them, and\n"
+         "    none of the NV storage changes are kept if any set fails.\n"
+         "  %s --nvstats [param1=value1] [param2=value2 [...]]]\n"
+         "    As above, then reports the NV storage writes saved.\n"
          "  %s [param1?value1] [param2?value2 [...]]]\n"
          "    Checks if the parameter(s) all contain the specified value(s).\n"
          "Stops at the first error."
          "\n"
-         "Valid parameters:\n", progname, progname, progname, progname);
+         "Valid parameters:\n", progname, progname, progname, progname, progname);
   for (p = sys_param_list; p->name; p++)
     printf("  %-22s  %s\n", p->name, p->desc);
 }
@@ -222,6 +228,10 @@ int PrintAllParams(int force_all) {
 
 int main(int argc, char* argv[]) {
   int retval = 0;
+  int first_arg = 1;
+  int nvstats = 0;
+  int transaction = 0;
+  int writes_avoided = 0;
   int i;
 
   char* progname = strrchr(argv[0], '/');
@@ -248,8 +258,23 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  /* --nvstats reports how many NV storage writes the transaction saved */
+  if (!strcasecmp(argv[1], "--nvstats")) {
+    nvstats = 1;
+    first_arg++;
+  }
+
+  /* Make all the sets in one NV storage transaction.  If NV storage can't
+   * be read, each set falls back to whatever else it can do. */
+  for (i = first_arg; i < argc; i++) {
+    if (strchr(argv[i], '=')) {
+      transaction = (0 == VbBeginSystemPropertyTransaction());
+      break;
+    }
+  }
+
   /* Otherwise, loop through params and get/set them */
-  for (i = 1; i < argc && retval == 0; i++) {
+  for (i = first_arg; i < argc && retval == 0; i++) {
     char* has_set = strchr(argv[i], '=');
     char* has_expect = strchr(argv[i], '?');
     char* name = strtok(argv[i], "=?");
@@ -260,14 +285,16 @@ int main(int argc, char* argv[]) {
     if (!name || has_set == argv[i] || has_expect == argv[i]) {
       fprintf(stderr, "Poorly formed parameter\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
     if (!value)
       value=""; /* Allow setting/checking an empty string ('foo=' or 'foo?') */
     if (has_set && has_expect) {
       fprintf(stderr, "Use either = or ? in a parameter, but not both.\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     /* Find the parameter */
@@ -275,10 +302,11 @@ int main(int argc, char* argv[]) {
     if (!p) {
       fprintf(stderr, "Invalid parameter name: %s\n", name);
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
-    if (i > 1)
+    if (i > first_arg)
       printf(" ");  /* Output params space-delimited */
     if (has_set)
       retval = SetParam(p, value);
@@ -288,5 +316,14 @@ int main(int argc, char* argv[]) {
       retval = PrintParam(p);
   }
 
+  if (transaction) {
+    if (0 != retval)
+      VbAbortSystemPropertyTransaction();
+    else if (0 != VbCommitSystemPropertyTransaction(&writes_avoided))
+      retval = 1;
+  }
+  if (nvstats)
+    fprintf(stderr, "NV storage writes avoided: %d\n", writes_avoided);
+
   return retval;
 }
@@ -7,23 +7,31 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <sys/mman.h>
 
 #include "host_common.h"
+#include "image_scan.h"
 #include "kernel_blob.h"
 #include "vboot_api.h"
 #include "vboot_host.h"
 
-static uint8_t* GetKernelConfig(uint8_t* blob, size_t blob_size,
-                                uint64_t kernel_body_load_address) {
+/* Key blocks in a disk image start on a sector boundary */
+#define KERNEL_SECTOR_SIZE 512
 
-  VbKeyBlockHeader* key_block;
-  VbKernelPreambleHeader* preamble;
+static const uint8_t* GetKernelConfig(const uint8_t* blob, size_t blob_size,
+                                      uint64_t kernel_body_load_address) {
+
+  const VbKeyBlockHeader* key_block;
+  const VbKernelPreambleHeader* preamble;
   uint32_t now = 0;
   uint32_t offset = 0;
 
+  if (blob_size < sizeof(VbKeyBlockHeader)) {
+    VbExError("Too small to hold a key block\n");
+    return NULL;
+  }
+
   /* Skip the key block */
-  key_block = (VbKeyBlockHeader*)blob;
+  key_block = (const VbKeyBlockHeader*)blob;
   now += key_block->key_block_size;
   if (now + blob > blob + blob_size) {
     VbExError("key_block_size advances past the end of the blob\n");
@@ -31,7 +39,7 @@ static uint8_t* GetKernelConfig(uint8_t* blob, size_t blob_size,
   }
 
   /* Open up the preamble */
-  preamble = (VbKernelPreambleHeader*)(blob + now);
+  preamble = (const VbKernelPreambleHeader*)(blob + now);
   now += preamble->preamble_size;
   if (now + blob > blob + blob_size) {
     VbExError("preamble_size advances past the end of the blob\n");
@@ -55,65 +63,46 @@ static uint8_t* GetKernelConfig(uint8_t* blob, size_t blob_size,
   return blob + offset;
 }
 
-static void* MMapFile(const char* filename, size_t *size) {
-  FILE* f;
-  uint8_t* buf;
-  long file_size = 0;
-
-  f = fopen(filename, "rb");
-  if (!f) {
-    VBDEBUG(("Unable to open file %s\n", filename));
-    return NULL;
-  }
-
-  fseek(f, 0, SEEK_END);
-  file_size = ftell(f);
-  rewind(f);
-
-  if (file_size <= 0) {
-    fclose(f);
-    return NULL;
-  }
-  *size = (size_t) file_size;
-
-  /* Uses a host primitive as this is not meant for firmware use. */
-  buf = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
-  if (buf == MAP_FAILED) {
-    VbExError("Failed to mmap the file %s\n", filename);
-    fclose(f);
-    return NULL;
-  }
-
-  fclose(f);
-  return buf;
-}
-
-
 char *FindKernelConfig(const char *infile, uint64_t kernel_body_load_address)
 {
-  uint8_t* blob;
-  size_t blob_size;
-  uint8_t *config = NULL;
+  MappedFile file;
+  ImageScan scan;
+  int64_t offset = 0;
+  const uint8_t *config = NULL;
   char *newstr = NULL;
 
-  blob = MMapFile(infile, &blob_size);
-  if (!blob) {
+  if (0 != MapFile(infile, &file)) {
     VbExError("Error reading input file\n");
     return 0;
   }
 
-  config = GetKernelConfig(blob, blob_size, kernel_body_load_address);
+  /* The key block is at the start of a kernel partition, but the input may
+   * also be a whole disk image; the first key block on a sector boundary
+   * is the first kernel's.  Only scan if it isn't a partition, since the
+   * scan reads all of the input. */
+  if (file.size < KEY_BLOCK_MAGIC_SIZE ||
+      0 != memcmp(file.data, KEY_BLOCK_MAGIC, KEY_BLOCK_MAGIC_SIZE)) {
+    if (0 == ScanImage(file.data, file.size, &scan)) {
+      offset = ImageScanFirst(&scan, IMAGE_SIG_KEYBLOCK, KERNEL_SECTOR_SIZE);
+      if (offset < 0)
+        offset = 0;
+    }
+    FreeImageScan(&scan);
+  }
+
+  config = GetKernelConfig(file.data + offset, file.size - offset,
+                           kernel_body_load_address);
   if (!config) {
     VbExError("Error parsing input file\n");
-    munmap(blob, blob_size);
+    UnmapFile(&file);
     return 0;
   }
 
-  newstr = strndup((char *)config, CROS_CONFIG_SIZE);
+  newstr = strndup((const char *)config, CROS_CONFIG_SIZE);
   if (!newstr)
     VbExError("Can't allocate new string\n");
 
-  munmap(blob, blob_size);
+  UnmapFile(&file);
 
   return newstr;
 }
@@ -17,6 +17,8 @@
 #include <algorithm>
 
 #include "gbb_utility.h"
+#include "host_file.h"
+#include "image_scan.h"
 
 using std::string;
 
@@ -27,30 +29,15 @@ using std::string;
 // return file content, or empty for any failure.
 static string read_nonempty_file(const char *filename) {
   string file_content;
-  std::vector<char> buffer;     // since image files are small, should be OK
+  MappedFile file;
 
-  FILE *fp = fopen(filename, "rb");
-  if (!fp) {
+  // Copied once, straight from the page cache
+  if (MapFile(filename, &file) != 0) {
     perror(filename);
     return file_content;
   }
-
-  // prepare buffer on successful seek
-  if (fseek(fp, 0, SEEK_END) == 0) {
-    buffer.resize(ftell(fp));
-    rewind(fp);
-  }
-
-  if (!buffer.empty()) {
-    if (fread(&buffer[0], buffer.size(), 1, fp) != 1) {
-      perror(filename);
-      buffer.clear();  // discard buffer when read fail.
-    } else {
-      file_content.assign(buffer.begin(), buffer.end());
-    }
-  }
-
-  fclose(fp);
+  file_content.assign(reinterpret_cast<const char*>(file.data), file.size);
+  UnmapFile(&file);
   return file_content;
 }
 
@@ -203,16 +190,16 @@ bool GoogleBinaryBlockUtil::save_to_file(const char *filename) {
 
 int GoogleBinaryBlockUtil::search_header_signatures(const string &image,
                                                     long *poffset) const {
+  ImageScan scan;
   int found_signatures = 0;
-  size_t last_found_pos = 0;
-
-  while ((last_found_pos =
-          file_content_.find(GBB_SIGNATURE, last_found_pos, GBB_SIGNATURE_SIZE))
-            != file_content_.npos) {
-    *poffset = last_found_pos;
-    found_signatures++;
-    last_found_pos++;  // for next iteration
+
+  if (ScanImage(reinterpret_cast<const uint8_t*>(image.data()), image.size(),
+                &scan) == 0) {
+    found_signatures = scan.count[IMAGE_SIG_GBB];
+    if (found_signatures)
+      *poffset = scan.offsets[IMAGE_SIG_GBB][found_signatures - 1];
   }
+  FreeImageScan(&scan);
 
   return found_signatures;
 }
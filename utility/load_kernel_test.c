@@ -52,6 +52,21 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 }
 
 
+/* Reads complete immediately; the result is reported by the wait */
+static VbError_t async_read_result = VBERROR_SUCCESS;
+
+VbError_t VbExDiskReadAsync(VbExDiskHandle_t handle, uint64_t lba_start,
+                            uint64_t lba_count, void *buffer) {
+  async_read_result = VbExDiskRead(handle, lba_start, lba_count, buffer);
+  return VBERROR_SUCCESS;
+}
+
+
+VbError_t VbExDiskReadWait(VbExDiskHandle_t handle) {
+  return async_read_result;
+}
+
+
 VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
                         uint64_t lba_count, const void *buffer) {
   printf("Write(%" PRIu64 ", %" PRIu64 ")\n", lba_start, lba_count);
@@ -5,6 +5,7 @@
  * Verified boot firmware utility
  */
 
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>  /* For PRIu64 */
 #include <stddef.h>
@@ -177,8 +178,7 @@ static int Verify(const char* infile, const char* signpubkey,
   RSAPublicKey* rsa;
   uint8_t* blob;
   uint64_t blob_size;
-  uint8_t* fv_data;
-  uint64_t fv_size;
+  int fv_fd;
   uint64_t now = 0;
   uint32_t flags;
 
@@ -201,9 +201,10 @@ static int Verify(const char* infile, const char* signpubkey,
     return 1;
   }
 
-  /* Read firmware volume */
-  fv_data = ReadFile(fv_file, &fv_size);
-  if (!fv_data) {
+  /* Open firmware volume.  It's only read a chunk at a time, as it's
+   * hashed. */
+  fv_fd = open(fv_file, O_RDONLY);
+  if (fv_fd < 0) {
     VbExError("Error reading firmware volume\n");
     return 1;
   }
@@ -212,6 +213,7 @@ static int Verify(const char* infile, const char* signpubkey,
   key_block = (VbKeyBlockHeader*)blob;
   if (0 != KeyBlockVerify(key_block, blob_size, sign_key, 0)) {
     VbExError("Error verifying key block.\n");
+    close(fv_fd);
     return 1;
   }
   free(sign_key);
@@ -233,6 +235,7 @@ static int Verify(const char* infile, const char* signpubkey,
   rsa = PublicKeyToRSA(&key_block->data_key);
   if (!rsa) {
     VbExError("Error parsing data key.\n");
+    close(fv_fd);
     return 1;
   }
 
@@ -240,6 +243,7 @@ static int Verify(const char* infile, const char* signpubkey,
   preamble = (VbFirmwarePreambleHeader*)(blob + now);
   if (0 != VerifyFirmwarePreamble(preamble, blob_size - now, rsa)) {
     VbExError("Error verifying preamble.\n");
+    close(fv_fd);
     return 1;
   }
   now += preamble->preamble_size;
@@ -270,12 +274,15 @@ static int Verify(const char* infile, const char* signpubkey,
   if (flags & VB_FIRMWARE_PREAMBLE_USE_RO_NORMAL) {
     printf("Preamble requests USE_RO_NORMAL; skipping body verification.\n");
   } else {
-    if (0 != VerifyData(fv_data, fv_size, &preamble->body_signature, rsa)) {
+    if (0 != VerifyDataInFile(fv_fd, 0, FdSize(fv_fd),
+                              &preamble->body_signature, rsa)) {
       VbExError("Error verifying firmware body.\n");
+      close(fv_fd);
       return 1;
     }
     printf("Body verification succeeded.\n");
   }
+  close(fv_fd);
 
   if (kernelkey_file) {
     if (0 != PublicKeyWrite(kernelkey_file, kernel_subkey)) {
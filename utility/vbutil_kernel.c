@@ -9,15 +9,15 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>  /* For PRIu64 */
-#include <sys/ioctl.h>
-#include <linux/fs.h>  /* For BLKGETSIZE64 */
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "cryptolib.h"
@@ -208,9 +208,12 @@ static unsigned int find_cmdline_start(char *input, unsigned int max_len) {
 /****************************************************************************/
 /* Here are globals containing all the bits & pieces I'm working on. */
 
-/* The individual parts that go into the kernel blob */
+/* The individual parts that go into the kernel blob.  The kernel may be left
+ * in its file, at [g_kernel_offset] in [g_kernel_fd], instead of in memory. */
 uint8_t *g_kernel_data;
 uint64_t g_kernel_size;
+int g_kernel_fd = -1;
+uint64_t g_kernel_offset;
 uint8_t *g_param_data;
 uint64_t g_param_size;
 uint8_t *g_config_data;
@@ -264,20 +267,29 @@ static uint64_t CmdLineOffset(VbKernelPreambleHeader *preamble) {
 }
 
 /* This initializes g_vmlinuz and g_param from a standard vmlinuz file.
- * It returns 0 on error. */
+ * Only the header is read into memory; the kernel is left in the file, to be
+ * read as it's packed.  It returns 0 on error. */
 static int ImportVmlinuzFile(const char *vmlinuz_file, arch_t arch,
                              uint64_t kernel_body_load_address) {
-  uint8_t *kernel_buf;
+  struct linux_kernel_params header;
+  struct stat statbuf;
   uint64_t kernel_size;
   uint64_t kernel32_start = 0;
   uint64_t kernel32_size = 0;
   struct linux_kernel_params *params = NULL, *lh = NULL;
+  ssize_t got;
+  int fd;
 
-  /* Read the kernel */
+  /* Open the kernel */
   Debug("Reading %s\n", vmlinuz_file);
-  kernel_buf = ReadFile(vmlinuz_file, &kernel_size);
-  if (!kernel_buf)
+  fd = open(vmlinuz_file, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  if (0 != fstat(fd, &statbuf)) {
+    close(fd);
     return 0;
+  }
+  kernel_size = statbuf.st_size;
   Debug(" kernel file size=0x%" PRIx64 "\n", kernel_size);
   if (!kernel_size)
     Fatal("Empty kernel file\n");
@@ -290,14 +302,21 @@ static int ImportVmlinuzFile(const char *vmlinuz_file, arch_t arch,
 
   /* Unless we're handling x86, the kernel is the kernel, so we're done. */
   if (arch != ARCH_X86) {
-    g_kernel_data = kernel_buf;
+    g_kernel_fd = fd;
+    g_kernel_offset = 0;
     g_kernel_size = kernel_size;
     return 1;
   }
 
   /* The first part of the x86 vmlinuz is a header, followed by a real-mode
    * boot stub.  We only want the 32-bit part. */
-  lh = (struct linux_kernel_params *)kernel_buf;
+  Memset(&header, 0, sizeof(header));
+  got = pread(fd, &header, sizeof(header), 0);
+  if (got < 0) {
+    close(fd);
+    return 0;
+  }
+  lh = &header;
   kernel32_start = (lh->setup_sects + 1) << 9;
   if (kernel32_start >= kernel_size)
     Fatal("Malformed kernel\n");
@@ -307,13 +326,11 @@ static int ImportVmlinuzFile(const char *vmlinuz_file, arch_t arch,
   Debug(" kernel32_size=0x%" PRIx64 "\n", kernel32_size);
 
   /* Keep just the 32-bit kernel. */
-  if (kernel32_size) {
-    g_kernel_size = kernel32_size;
-    g_kernel_data = VbExMalloc(g_kernel_size);
-    Memcpy(g_kernel_data, kernel_buf + kernel32_start, kernel32_size);
-  }
+  g_kernel_fd = fd;
+  g_kernel_offset = kernel32_start;
+  g_kernel_size = kernel32_size;
 
-  /* Copy the original zeropage data from kernel_buf into g_param_data, then
+  /* Copy the original zeropage data from the header into g_param_data, then
    * tweak a few fields for our purposes */
   params = (struct linux_kernel_params *)(g_param_data);
   Memcpy(&(params->setup_sects), &(lh->setup_sects),
@@ -342,46 +359,34 @@ static int ImportVmlinuzFile(const char *vmlinuz_file, arch_t arch,
   params->e820_entries[1].segment_type = E820_TYPE_RESERVED;
 
   /* done */
-  free(kernel_buf);
   return 1;
 }
 
-/* This returns just the kernel blob, with the verification blob separated
- * and copied to new memory in g_keyblock and g_preamble. */
-static uint8_t* ReadOldBlobFromFileOrDie(const char *filename,
+/* This reads just the verification blob from the start of the file,
+ * copying it to new memory in g_keyblock and g_preamble.  Returns the open
+ * file, with [offset_ptr] and [size_ptr] set to where the kernel blob which
+ * follows is and how big it is. */
+static FILE* ReadOldHeadersFromFileOrDie(const char *filename,
+                                         uint64_t* offset_ptr,
                                          uint64_t* size_ptr) {
   FILE* fp = NULL;
-  struct stat statbuf;
   VbKeyBlockHeader* key_block;
   VbKernelPreambleHeader* preamble;
   uint64_t now = 0;
   uint8_t* buf;
-  uint8_t* kernel_blob_data;
   uint64_t kernel_blob_size;
-  uint64_t file_size = 0;
-
-  if (0 != stat(filename, &statbuf))
-    Fatal("Unable to stat %s: %s\n", filename, strerror(errno));
-
-  if (S_ISBLK(statbuf.st_mode)) {
-    int fd;
-
-    if ((fd = open(filename, O_RDONLY)) >= 0) {
-      ioctl(fd, BLKGETSIZE64, &file_size);
-      close(fd);
-    }
-  } else {
-    file_size = statbuf.st_size;
-  }
-  Debug("%s size is 0x%" PRIx64 "\n", filename, file_size);
-  if (file_size < opt_pad)
-    Fatal("%s is too small to be a valid kernel blob\n");
+  uint64_t file_size;
 
   Debug("Reading %s\n", filename);
   fp = fopen(filename, "rb");
   if (!fp)
     Fatal("Unable to open file %s: %s\n", filename, strerror(errno));
 
+  file_size = FdSize(fileno(fp));
+  Debug("%s size is 0x%" PRIx64 "\n", filename, file_size);
+  if (file_size < opt_pad)
+    Fatal("%s is too small to be a valid kernel blob\n", filename);
+
   buf = VbExMalloc(opt_pad);
   if (1 != fread(buf, opt_pad, 1, fp))
     Fatal("Unable to read header from %s: %s\n", filename, error_fread(fp));
@@ -419,9 +424,6 @@ static uint8_t* ReadOldBlobFromFileOrDie(const char *filename,
 
   /* Now for the kernel blob */
   Debug("kernel blob is at offset 0x%" PRIx64 "\n", now);
-  if (0 != fseek(fp, now, SEEK_SET))
-    Fatal("Unable to seek to 0x%" PRIx64 " in %s: %s\n", now, filename,
-          strerror(errno));
 
   /* Sanity check */
   kernel_blob_size = file_size - now;
@@ -430,18 +432,30 @@ static uint8_t* ReadOldBlobFromFileOrDie(const char *filename,
   if (kernel_blob_size < preamble->body_signature.data_size)
     fprintf(stderr, "Warning: kernel file only has 0x%" PRIx64 " bytes\n",
       kernel_blob_size);
-  kernel_blob_data = VbExMalloc(kernel_blob_size);
-
-  /* Read it in */
-  if (1 != fread(kernel_blob_data, kernel_blob_size, 1, fp))
-    Fatal("Unable to read kernel blob from %s: %s\n", filename,
-              error_fread(fp));
 
   /* Done */
   VbExFree(buf);
 
-  if (size_ptr)
-    *size_ptr = kernel_blob_size;
+  *offset_ptr = now;
+  *size_ptr = kernel_blob_size;
+
+  return fp;
+}
+
+/* This returns just the kernel blob from an open file, as found by
+ * ReadOldHeadersFromFileOrDie(). */
+static uint8_t* ReadOldBlobFromFileOrDie(FILE* fp, const char* filename,
+                                         uint64_t offset, uint64_t size) {
+  uint8_t* kernel_blob_data;
+
+  if (0 != fseek(fp, offset, SEEK_SET))
+    Fatal("Unable to seek to 0x%" PRIx64 " in %s: %s\n", offset, filename,
+          strerror(errno));
+
+  kernel_blob_data = VbExMalloc(size);
+  if (1 != fread(kernel_blob_data, size, 1, fp))
+    Fatal("Unable to read kernel blob from %s: %s\n", filename,
+              error_fread(fp));
 
   return kernel_blob_data;
 }
@@ -488,67 +502,258 @@ static void UnpackKernelBlob(uint8_t *kernel_blob_data,
 
 /****************************************************************************/
 
-static uint8_t* CreateKernelBlob(uint64_t kernel_body_load_address,
-                                 arch_t arch,
-                                 uint64_t *size_ptr) {
-  uint8_t *kern_blob;
+/* The kernel blob is described as a list of extents rather than put together
+ * in memory, so a large kernel is only read to hash it and then copied.  What
+ * was copied is hashed again, in case the input changed in between. */
+
+/* How much of a file is read at a time */
+#define PACK_CHUNK_SIZE (1 << 20)
+
+/* [size] bytes from [data], or from [fd] at [offset] if [data] is NULL,
+ * followed by [pad] zero bytes */
+typedef struct BlobExtent {
+  const uint8_t *data;
+  int fd;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t pad;
+} BlobExtent;
+
+enum {
+  EXTENT_KERNEL,
+  EXTENT_CONFIG,
+  EXTENT_PARAMS,
+  EXTENT_BOOTLOADER,
+  NUM_EXTENTS
+};
+
+/* Enough for any one pad, which never reaches past the next CROS_ALIGN
+ * boundary or fills more than one of the config and params slots. */
+static const uint8_t zero_pad[CROS_ALIGN];
+
+/* Fills in [ext] with the NUM_EXTENTS parts of the kernel blob, and returns
+ * its size. */
+static uint64_t DescribeKernelBlob(uint64_t kernel_body_load_address,
+                                   BlobExtent *ext) {
   uint64_t kern_blob_size;
   uint64_t now;
   uint64_t bootloader_size = roundup(g_bootloader_size, CROS_ALIGN);
 
-  /* Put the kernel blob together */
+  /* Lay out the kernel blob */
   kern_blob_size = roundup(g_kernel_size, CROS_ALIGN) +
     CROS_CONFIG_SIZE + CROS_PARAMS_SIZE + bootloader_size;
   Debug("kern_blob_size=0x%" PRIx64 "\n", kern_blob_size);
-  kern_blob = VbExMalloc(kern_blob_size);
-  Memset(kern_blob, 0, kern_blob_size);
+  Memset(ext, 0, NUM_EXTENTS * sizeof(*ext));
   now = 0;
 
   Debug("kernel goes at kern_blob+0x%" PRIx64 "\n", now);
-
-  Memcpy(kern_blob+now, g_kernel_data, g_kernel_size);
+  ext[EXTENT_KERNEL].data = g_kernel_data;
+  ext[EXTENT_KERNEL].fd = g_kernel_fd;
+  ext[EXTENT_KERNEL].offset = g_kernel_offset;
+  ext[EXTENT_KERNEL].size = g_kernel_size;
+  ext[EXTENT_KERNEL].pad = roundup(g_kernel_size, CROS_ALIGN) - g_kernel_size;
   now += roundup(g_kernel_size, CROS_ALIGN);
 
   Debug("config goes at kern_blob+0x%" PRIx64 "\n", now);
-  if (g_config_size)
-    Memcpy(kern_blob + now, g_config_data, g_config_size);
+  ext[EXTENT_CONFIG].data = g_config_data;
+  ext[EXTENT_CONFIG].size = g_config_size;
+  ext[EXTENT_CONFIG].pad = CROS_CONFIG_SIZE - g_config_size;
   now += CROS_CONFIG_SIZE;
 
   Debug("params goes at kern_blob+0x%" PRIx64 "\n", now);
-  if (g_param_size) {
-    Memcpy(kern_blob + now, g_param_data, g_param_size);
-  }
+  ext[EXTENT_PARAMS].data = g_param_data;
+  ext[EXTENT_PARAMS].size = g_param_size;
+  ext[EXTENT_PARAMS].pad = CROS_PARAMS_SIZE - g_param_size;
   now += CROS_PARAMS_SIZE;
 
   Debug("bootloader goes at kern_blob+0x%" PRIx64 "\n", now);
   g_bootloader_address = kernel_body_load_address + now;
   Debug(" bootloader_address=0x%" PRIx64 "\n", g_bootloader_address);
   Debug(" bootloader_size=0x%" PRIx64 "\n", bootloader_size);
-  if (bootloader_size)
-    Memcpy(kern_blob + now, g_bootloader_data, g_bootloader_size);
+  ext[EXTENT_BOOTLOADER].data = g_bootloader_data;
+  ext[EXTENT_BOOTLOADER].size = g_bootloader_size;
+  ext[EXTENT_BOOTLOADER].pad = bootloader_size - g_bootloader_size;
   now += bootloader_size;
   Debug("end of kern_blob at kern_blob+0x%" PRIx64 "\n", now);
 
-  /* Done */
-  if (size_ptr)
-    *size_ptr = kern_blob_size;
+  return kern_blob_size;
+}
+
+/* Reads exactly [size] bytes from [fd] at [offset].  Returns 0 on success. */
+static int ReadChunk(int fd, uint8_t *buf, uint64_t size, uint64_t offset) {
+  ssize_t n;
+
+  while (size) {
+    n = pread(fd, buf, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 1;
+    buf += n;
+    size -= n;
+    offset += n;
+  }
+  return 0;
+}
+
+/* Hashes the kernel blob with the hash for [algorithm], one extent at a time.
+ * Returns the digest, which the caller must free, or NULL on error. */
+static uint8_t* DigestKernelBlob(const BlobExtent *ext, int algorithm) {
+  DigestContext ctx;
+  uint8_t *buf = NULL;
+  uint64_t done, len;
+  int i;
+
+  DigestInit(&ctx, algorithm);
+  for (i = 0; i < NUM_EXTENTS; i++, ext++) {
+    for (done = 0; done < ext->size; done += len) {
+      len = ext->size - done;
+      if (len > PACK_CHUNK_SIZE)
+        len = PACK_CHUNK_SIZE;
+      if (ext->data) {
+        DigestUpdate(&ctx, ext->data + done, len);
+        continue;
+      }
+      if (!buf)
+        buf = VbExMalloc(PACK_CHUNK_SIZE);
+      if (0 != ReadChunk(ext->fd, buf, len, ext->offset + done)) {
+        VbExError("Unable to read kernel: %s\n", strerror(errno));
+        free(buf);
+        free(DigestFinal(&ctx));
+        return NULL;
+      }
+      DigestUpdate(&ctx, buf, len);
+    }
+    for (done = 0; done < ext->pad; done += len) {
+      len = ext->pad - done;
+      if (len > sizeof(zero_pad))
+        len = sizeof(zero_pad);
+      DigestUpdate(&ctx, zero_pad, len);
+    }
+  }
+
+  free(buf);
+  return DigestFinal(&ctx);
+}
+
+/* Writes all of [iov] to [fd], however many calls it takes.  Returns 0 on
+ * success. */
+static int WriteAll(int fd, struct iovec *iov, int iovcnt) {
+  ssize_t n;
+
+  while (iovcnt) {
+    n = writev(fd, iov, iovcnt);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 1;
+    for (; iovcnt && n >= iov->iov_len; iov++, iovcnt--)
+      n -= iov->iov_len;
+    if (iovcnt) {
+      iov->iov_base = (uint8_t *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+/* Copies [size] bytes from [fd] at [offset] to the current position in [out],
+ * adding the bytes written to [ctx].  The kernel does the copy where it can;
+ * those bytes are read back from [out] to hash them.  Returns 0 on success. */
+static int CopyFromFile(int out, int fd, uint64_t offset, uint64_t size,
+                        DigestContext *ctx) {
+  uint8_t *buf = VbExMalloc(PACK_CHUNK_SIZE);
+  uint64_t len;
+  ssize_t n;
+  struct iovec iov;
+
+#ifdef __NR_copy_file_range
+  /* Pipes can't be read back, but copy_file_range() can't write them anyway */
+  off_t out_pos = lseek(out, 0, SEEK_CUR);
+
+  while (size && out_pos >= 0) {
+    loff_t in_offset = offset;
+
+    len = size > PACK_CHUNK_SIZE ? PACK_CHUNK_SIZE : size;
+    n = syscall(__NR_copy_file_range, fd, &in_offset, out, NULL, len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;  /* Not supported here; fall back to copying it ourselves */
+    if (0 != ReadChunk(out, buf, n, out_pos)) {
+      free(buf);
+      return 1;
+    }
+    DigestUpdate(ctx, buf, n);
+    out_pos += n;
+    offset += n;
+    size -= n;
+  }
+#endif
+
+  for (; size; size -= len, offset += len) {
+    len = size > PACK_CHUNK_SIZE ? PACK_CHUNK_SIZE : size;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    if (0 != ReadChunk(fd, buf, len, offset) || 0 != WriteAll(out, &iov, 1))
+      break;
+    DigestUpdate(ctx, buf, len);
+  }
+  free(buf);
+  return size ? 1 : 0;
+}
 
-  return kern_blob;
+/* Writes the kernel blob to [out], gathering everything that's in memory into
+ * as few writes as possible, and adds what it writes to [ctx].  Returns 0 on
+ * success. */
+static int WriteKernelBlob(int out, const BlobExtent *ext,
+                           DigestContext *ctx) {
+  struct iovec iov[2 * NUM_EXTENTS];
+  int iovcnt = 0;
+  int i;
+
+  for (i = 0; i < NUM_EXTENTS; i++, ext++) {
+    if (ext->size && !ext->data) {
+      if (0 != WriteAll(out, iov, iovcnt) ||
+          0 != CopyFromFile(out, ext->fd, ext->offset, ext->size, ctx))
+        return 1;
+      iovcnt = 0;
+    } else if (ext->size) {
+      iov[iovcnt].iov_base = (void *)ext->data;
+      iov[iovcnt].iov_len = ext->size;
+      iovcnt++;
+      DigestUpdate(ctx, ext->data, ext->size);
+    }
+    if (ext->pad) {
+      iov[iovcnt].iov_base = (void *)zero_pad;
+      iov[iovcnt].iov_len = ext->pad;
+      iovcnt++;
+      DigestUpdate(ctx, zero_pad, ext->pad);
+    }
+  }
+  return WriteAll(out, iov, iovcnt);
 }
 
 static int Pack(const char* outfile,
-                uint8_t *kernel_blob,
+                const BlobExtent *kernel_blob,
                 uint64_t kernel_size,
                 int version,
                 uint64_t kernel_body_load_address,
                 VbPrivateKey* signpriv_key) {
   VbSignature* body_sig;
-  FILE* f;
-  uint64_t i;
+  DigestContext ctx;
+  uint8_t* digest;
+  uint8_t* written_digest;
+  struct iovec iov[2];
+  int fd;
+  int rv;
   uint64_t written = 0;
 
   /* Sign the kernel data */
-  body_sig = CalculateSignature(kernel_blob, kernel_size, signpriv_key);
+  digest = DigestKernelBlob(kernel_blob, signpriv_key->algorithm);
+  if (!digest)
+    Fatal("Error calculating body signature\n");
+  body_sig = CalculateSignatureFromDigest(digest, kernel_size, signpriv_key);
   if (!body_sig)
     Fatal("Error calculating body signature\n");
 
@@ -562,23 +767,29 @@ static int Pack(const char* outfile,
                                     signpriv_key);
   if (!g_preamble) {
     VbExError("Error creating preamble.\n");
+    free(digest);
     return 1;
   }
-  /* Write the output file */
+  /* Write the output file.  It's opened for reading too, so the kernel blob
+   * can be read back to check it. */
   Debug("writing %s...\n", outfile);
-  f = fopen(outfile, "wb");
-  if (!f) {
+  fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
     VbExError("Can't open output file %s\n", outfile);
+    free(digest);
     return 1;
   }
   Debug("0x%" PRIx64 " bytes of key_block\n", g_keyblock->key_block_size);
   Debug("0x%" PRIx64 " bytes of preamble\n", g_preamble->preamble_size);
-  i = ((1 != fwrite(g_keyblock, g_keyblock->key_block_size, 1, f)) ||
-       (1 != fwrite(g_preamble, g_preamble->preamble_size, 1, f)));
-  if (i) {
+  iov[0].iov_base = g_keyblock;
+  iov[0].iov_len = g_keyblock->key_block_size;
+  iov[1].iov_base = g_preamble;
+  iov[1].iov_len = g_preamble->preamble_size;
+  if (0 != WriteAll(fd, iov, 2)) {
     VbExError("Can't write output file %s\n", outfile);
-    fclose(f);
+    close(fd);
     unlink(outfile);
+    free(digest);
     return 1;
   }
   written += g_keyblock->key_block_size;
@@ -586,22 +797,40 @@ static int Pack(const char* outfile,
 
   if (!opt_vblockonly) {
     Debug("0x%" PRIx64 " bytes of kern_blob\n", kernel_size);
-    i = (1 != fwrite(kernel_blob, kernel_size, 1, f));
-    if (i) {
-      fclose(f);
+    DigestInit(&ctx, signpriv_key->algorithm);
+    if (0 != WriteKernelBlob(fd, kernel_blob, &ctx)) {
+      free(DigestFinal(&ctx));
+      close(fd);
       unlink(outfile);
       Fatal("Can't write output file %s\n", outfile);
     }
     written += kernel_size;
+
+    /* The kernel was read once to sign it and again to copy it, so make sure
+     * it didn't change in between. */
+    written_digest = DigestFinal(&ctx);
+    rv = SafeMemcmp(written_digest, digest,
+                    hash_size_map[signpriv_key->algorithm]);
+    free(written_digest);
+    if (rv) {
+      close(fd);
+      unlink(outfile);
+      Fatal("Kernel changed while packing %s\n", outfile);
+    }
   }
   Debug("0x%" PRIx64 " bytes total\n", written);
-  fclose(f);
+  close(fd);
+  free(digest);
 
   /* Success */
   return 0;
 }
 
-static int Verify(uint8_t* kernel_blob,
+/* Verifies the kernel blob at [kernel_offset] in [fp] against g_keyblock and
+ * g_preamble.  The blob is streamed through the hash rather than read into
+ * memory, since it may be a whole kernel partition. */
+static int Verify(FILE* fp,
+                  uint64_t kernel_offset,
                   uint64_t kernel_size,
                   VbPublicKey* signpub_key,
                   const char* keyblock_outfile,
@@ -679,14 +908,22 @@ static int Verify(uint8_t* kernel_blob,
               g_preamble->kernel_version, (min_version & 0xFFFF));
 
   /* Verify body */
-  if (0 != VerifyData(kernel_blob, kernel_size,
-                      &g_preamble->body_signature, rsa))
+  if (0 != VerifyDataInFile(fileno(fp), kernel_offset, kernel_size,
+                            &g_preamble->body_signature, rsa))
     Fatal("Error verifying kernel body.\n");
   printf("Body verification succeeded.\n");
 
 
-   if (opt_verbose)
-     printf("Config:\n%s\n", kernel_blob + CmdLineOffset(g_preamble));
+  if (opt_verbose) {
+    char config[CROS_CONFIG_SIZE + 1];
+    uint64_t offset = CmdLineOffset(g_preamble);
+    ssize_t n = 0;
+
+    if (offset < kernel_size)
+      n = pread(fileno(fp), config, CROS_CONFIG_SIZE, kernel_offset + offset);
+    config[n > 0 ? n : 0] = '\0';
+    printf("Config:\n%s\n", config);
+  }
 
   return 0;
 }
@@ -715,7 +952,11 @@ int main(int argc, char* argv[]) {
   VbPrivateKey* signpriv_key = NULL;
   VbPublicKey* signpub_key = NULL;
   uint8_t* kernel_blob = NULL;
+  BlobExtent kernel_extents[NUM_EXTENTS];
+  uint64_t kernel_offset = 0;
   uint64_t kernel_size = 0;
+  FILE* fp;
+  int r;
 
   char *progname = strrchr(argv[0], '/');
   if (progname)
@@ -874,10 +1115,10 @@ int main(int argc, char* argv[]) {
 
     /* Do it */
 
-    kernel_blob = CreateKernelBlob(kernel_body_load_address, arch,
-                                   &kernel_size);
+    kernel_size = DescribeKernelBlob(kernel_body_load_address,
+                                     kernel_extents);
 
-    return Pack(filename, kernel_blob, kernel_size,
+    return Pack(filename, kernel_extents, kernel_size,
                 version, kernel_body_load_address,
                 signpriv_key);
 
@@ -897,9 +1138,12 @@ int main(int argc, char* argv[]) {
 
     /* Load the old blob */
 
-    kernel_blob = ReadOldBlobFromFileOrDie(oldfile, &kernel_size);
-    if (0 != Verify(kernel_blob, kernel_size, 0, 0, 0))
+    fp = ReadOldHeadersFromFileOrDie(oldfile, &kernel_offset, &kernel_size);
+    if (0 != Verify(fp, kernel_offset, kernel_size, 0, 0, 0))
       Fatal("The oldblob doesn't verify\n");
+    kernel_blob = ReadOldBlobFromFileOrDie(fp, oldfile, kernel_offset,
+                                           kernel_size);
+    fclose(fp);
 
     /* Take it apart */
 
@@ -933,10 +1177,10 @@ int main(int argc, char* argv[]) {
 
     /* Put it back together */
 
-    kernel_blob = CreateKernelBlob(kernel_body_load_address, arch,
-                                   &kernel_size);
+    kernel_size = DescribeKernelBlob(kernel_body_load_address,
+                                     kernel_extents);
 
-    return Pack(filename, kernel_blob, kernel_size,
+    return Pack(filename, kernel_extents, kernel_size,
                 version, kernel_body_load_address,
                 signpriv_key);
 
@@ -953,10 +1197,11 @@ int main(int argc, char* argv[]) {
 
     /* Do it */
 
-    kernel_blob = ReadOldBlobFromFileOrDie(filename, &kernel_size);
-
-    return Verify(kernel_blob, kernel_size, signpub_key,
-                  keyblock_file, min_version);
+    fp = ReadOldHeadersFromFileOrDie(filename, &kernel_offset, &kernel_size);
+    r = Verify(fp, kernel_offset, kernel_size, signpub_key,
+               keyblock_file, min_version);
+    fclose(fp);
+    return r;
   }
 
   fprintf(stderr, "You must specify a mode: --pack, --repack or --verify\n");